@@ -28,6 +28,9 @@
 #include "../../currennt_lib/src/layers/MulticlassClassificationLayer.hpp"
 #include "../../currennt_lib/src/optimizers/SteepestDescentOptimizer.hpp"
 #include "../../currennt_lib/src/helpers/JsonClasses.hpp"
+#include "../../currennt_lib/src/helpers/BinaryModel.hpp"
+#include "../../currennt_lib/src/helpers/AllReduce.hpp"
+#include "../../currennt_lib/src/helpers/Checkpoint.hpp"
 #include "../../currennt_lib/src/rapidjson/prettywriter.h"
 #include "../../currennt_lib/src/rapidjson/filestream.h"
 
@@ -40,6 +43,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include <boost/algorithm/string/replace.hpp>
 
 #include <fstream>
@@ -103,7 +107,7 @@ template <typename TDevice> void printOptimizer(
 template <typename TDevice> void saveNetwork(
  const NeuralNetwork<TDevice> &nn, 
  const std::string &filename, const real_t nnlr, 
- const real_t welr
+ const real_t welr, const bool binaryModel = false
 );
 
 void createModifiedTrainingSet(
@@ -116,6 +120,16 @@ void createModifiedTrainingSet(
 template <typename TDevice> void saveState(
  const NeuralNetwork<TDevice> &nn, 
  const optimizers::Optimizer<TDevice> &optimizer, 
+ const data_sets::DataSet &trainingSet,
+ const std::string &infoRows, const real_t nnlr, 
+ const real_t welr
+);
+
+template <typename TDevice> void saveCheckpoint(
+ helpers::checkpoint::CheckpointWriter &writer,
+ const NeuralNetwork<TDevice> &nn, 
+ const optimizers::Optimizer<TDevice> &optimizer, 
+ const data_sets::DataSet &trainingSet,
  const std::string &infoRows, const real_t nnlr, 
  const real_t welr
 );
@@ -123,13 +137,70 @@ template <typename TDevice> void saveState(
 template <typename TDevice> void restoreState(
  NeuralNetwork<TDevice> *nn, 
  optimizers::Optimizer<TDevice> *optimizer, 
+ data_sets::DataSet *trainingSet,
  std::string *infoRows
 );
 
+std::string autosaveFilename(
+ const int epoch,
+ const bool midEpoch = false
+);
+
+void exportLoaderState(
+ const data_sets::DataSet &dataSet,
+ rapidjson::Document *jsonDoc
+);
+
+void importLoaderState(
+ const rapidjson::Document &jsonDoc,
+ data_sets::DataSet *dataSet
+);
+
 std::string printfRow(
  const char *format, ...
 );
 
+bool flagBatchNormNetwork(
+ const rapidjson::Document &netDoc
+);
+
+// Add 20171101: information shared by the generation threads
+struct generation_task_t
+{
+    data_sets::DataSet *dataSet;       // data set shared by all the threads
+    boost::mutex        dataMutex;     // lock for dataSet and the counters below
+    int                 fracIdx;       // number of fractions that have been taken
+    bool                finished;      // all fractions have been taken (or error)
+    std::string         errorMsg;      // error message from one of the threads
+    boost::mutex        printMutex;    // lock for the per-fraction report on stdout
+
+    Cpu::real_vector    outputMeans;
+    Cpu::real_vector    outputStdevs;
+    bool                unstandardize;
+    bool                htkoutput;
+    int                 outputLag;
+};
+
+template <typename TDevice> void generateFractions(
+ NeuralNetwork<TDevice> *nn,
+ generation_task_t *task
+);
+
+// Add 20181018: arguments of the autosave written inside the epoch
+template <typename TDevice>
+struct mid_epoch_autosave_t
+{
+    helpers::checkpoint::CheckpointWriter *writer;
+    NeuralNetwork<TDevice>                *nn;
+    optimizers::Optimizer<TDevice>        *optimizer;
+    data_sets::DataSet                    *trainingSet;
+    const std::string                     *infoRows;
+};
+
+template <typename TDevice> void midEpochAutosave(
+ void *userData
+);
+
 
 // main function
 template <typename TDevice>
@@ -153,10 +224,24 @@ int trainerMain(const Configuration &config)
 	// rapidjson::Document *netDocPtr(0); No Need to use netDocPtr
 	rapidjson::Document netDocParameter;
         rapidjson::Document netDoc;
+	// Add 20181018: binary model, the file is mapped as long as netDoc is in use
+	//  (the replicas below also read the weights from netDoc)
+	helpers::binaryModel::MappedModelGuard netDocGuard(netDoc);
+	helpers::binaryModel::MappedModelGuard netDocParameterGuard(netDocParameter);
 
         readJsonFile(&netDoc, networkFile);
         printf("done.\n");
         printf("\n");
+
+	// Add 20181018: distributed training
+	// Each process trains on its shard of the data sets, and the gradients are summed
+	// over the processes before updating. Only rank 0 writes the network files
+	if (config.trainingMode() && config.distSize() > 1){
+	    if (config.weUpdate())
+		throw std::runtime_error("Distributed training does not support WE updating");
+	    helpers::allReduce::initialize(config.distRank(), config.distSize(),
+					   config.distAddress());
+	}
 	
         // load data sets
         boost::shared_ptr<data_sets::DataSet> trainingSet    = 
@@ -361,7 +446,7 @@ int trainerMain(const Configuration &config)
             if (!config.continueFile().empty()) {
                 printf("Restoring state from '%s'... ", config.continueFile().c_str());
                 fflush(stdout);
-                restoreState(&neuralNetwork, &*optimizer, &infoRows);
+                restoreState(&neuralNetwork, &*optimizer, &*trainingSet, &infoRows);
                 printf("done.\n\n");
             }
 	    
@@ -382,6 +467,8 @@ int trainerMain(const Configuration &config)
 		
 		neuralNetwork.importWeights(netDocParameter,
 					    config.trainedParameterCtr());
+		// Add 20181018: the weights are copied, unmap the file
+		helpers::binaryModel::releaseBinaryModel(netDocParameter);
 		
 	    }else if (!config.continueFile().empty() &&
 		      !config.trainedParameterPath().empty()){
@@ -391,6 +478,96 @@ int trainerMain(const Configuration &config)
 		// nothing
 	    }
 
+	    // Add 20181018: data-parallel training
+	    // With --training_threads N, N-1 replicas of the network are created.
+	    // The replicas share the weights of neuralNetwork. The optimizer gives each
+	    // network one of N consecutive fractions and sums the gradients
+	    std::vector<boost::shared_ptr<NeuralNetwork<TDevice> > > trainReplicas;
+	    int numTrainThreads = config.trainingThreads();
+	    if (numTrainThreads > 1 && config.useCuda()){
+		printf("\nWARNING: training_threads is only supported on CPU. Use 1 thread\n");
+		numTrainThreads = 1;
+	    }
+	    if (numTrainThreads > 1 && config.weUpdate() && !config.asyncTraining()){
+		printf("\nWARNING: training_threads does not support WE updating. Use 1 thread");
+		printf("\n         (or use --async_training)\n");
+		numTrainThreads = 1;
+	    }
+	    if (numTrainThreads > 1 && flagBatchNormNetwork(netDoc)){
+		// batchnorm writes the running mean and std into the shared weights
+		printf("\nWARNING: training_threads does not support batchnorm. Use 1 thread\n");
+		numTrainThreads = 1;
+	    }
+	    if (numTrainThreads > 1 && neuralNetwork.flagNetworkForGAN()){
+		// the networks would train the generator and discriminator in one step
+		printf("\nWARNING: training_threads does not support GAN. Use 1 thread\n");
+		numTrainThreads = 1;
+	    }
+	    if (numTrainThreads < 2 && config.asyncTraining())
+		printf("\nWARNING: async_training is not used with 1 thread (synchronous training)\n");
+	    if (numTrainThreads > 1){
+		std::vector<NeuralNetwork<TDevice>*> replicaPtrs;
+		for (int i = 1; i < numTrainThreads; i++){
+		    printf("\nCreating replica %d of the neural network...", i);
+		    trainReplicas.push_back(boost::make_shared<NeuralNetwork<TDevice> >(
+				netDoc, parallelSequences, maxSeqLength,
+				inputSize, outputSize, &neuralNetwork));
+		    if (config.mseWeightPath().size()>0)
+			trainReplicas.back()->initMseWeight(config.mseWeightPath());
+		    if (config.datamvPath().size()>0)
+			trainReplicas.back()->readMVForOutput(*dataMV);
+		    // Add 20181018: asynchronous training updates one WE bank
+		    if (config.weUpdate())
+			trainReplicas.back()->initWeUpdate(neuralNetwork);
+		    replicaPtrs.push_back(trainReplicas.back().get());
+		}
+		optimizer->setReplicas(replicaPtrs);
+		printf("\nTraining with %d threads", numTrainThreads);
+		if (config.asyncTraining())
+		    printf(" (asynchronous, staleness bound %d)", config.asyncStaleness());
+		printf("\n");
+	    }
+
+	    // Add 20181018: overlapped validation
+	    // A network with its own weights computes the validation and test errors of
+	    // the last epoch in a background thread while the next epoch is trained
+	    boost::shared_ptr<NeuralNetwork<TDevice> > evalNetwork;
+	    if (config.overlapValidation() && (!validationSet->empty() || !testSet->empty())){
+		if (config.useCuda())
+		    printf("\nWARNING: overlap_validation is only supported on CPU\n");
+		else if (helpers::allReduce::distributed())
+		    printf("\nWARNING: overlap_validation is not supported in distributed training\n");
+		else if (config.weUpdate())
+		    printf("\nWARNING: overlap_validation does not support WE updating\n");
+		else{
+		    printf("\nCreating the network for overlapped validation...");
+		    evalNetwork = boost::make_shared<NeuralNetwork<TDevice> >(
+				netDoc, parallelSequences, maxSeqLength, inputSize, outputSize);
+		    if (config.mseWeightPath().size()>0)
+			evalNetwork->initMseWeight(config.mseWeightPath());
+		    if (config.datamvPath().size()>0)
+			evalNetwork->readMVForOutput(*dataMV);
+		    optimizer->setEvalNetwork(evalNetwork.get());
+		    printf("\nValidation and test errors are printed one epoch later\n");
+		}
+	    }
+	    
+	    // Add 20181018: writer of the binary checkpoint (background thread)
+	    helpers::checkpoint::CheckpointWriter checkpointWriter;
+
+	    // Add 20181018: autosave inside the epoch (called by the optimizer)
+	    mid_epoch_autosave_t<TDevice> midEpochArg = {&checkpointWriter, &neuralNetwork,
+							 &*optimizer, &*trainingSet, &infoRows};
+	    if (config.autosave() &&
+		(config.autosaveInterval() > 0 || config.autosaveFractions() > 0)){
+		if (!config.hybridOnlineBatch() || numTrainThreads > 1 ||
+		    helpers::allReduce::distributed())
+		    printf("\nWARNING: autosave_interval needs hybrid_online_batch and 1 thread\n");
+		else
+		    optimizer->setMidEpochCheckpoint(config.autosaveInterval() * 60,
+						     config.autosaveFractions(),
+						     &midEpochAutosave<TDevice>, &midEpochArg);
+	    }
 	    
             printf("Starting training...");
 	    printf("\nPrint error per sequence / per timestep / secondary error (optional)");
@@ -428,6 +605,10 @@ int trainerMain(const Configuration &config)
                 double duration = (double)(endTime - startTime).total_milliseconds() / 1000.0;
                 infoRows += printfRow("%8.1lf |", duration);
 
+		// Add 20181018: the epoch of the validation and test errors
+		//  (the last epoch with overlapped validation, 0 if not computed)
+		int evalEpoch = optimizer->evaluatedEpoch();
+		
 		
 		// print errors
                 if (classificationTask)
@@ -441,8 +622,8 @@ int trainerMain(const Configuration &config)
 					  (double)optimizer->curTrainingErrorPerFrame(),
 					  (double)optimizer->curTrainingErrorSec());
                 
-                if (!validationSet->empty() && 
-		    optimizer->currentEpoch() % config.validateEvery() == 0) {
+                if (!validationSet->empty() && evalEpoch > 0 &&
+		    evalEpoch % config.validateEvery() == 0) {
                     if (classificationTask)
                         infoRows += printfRow(errFormat, 
 					      (double)optimizer->curValidationClassError()*100.0, 
@@ -457,8 +638,8 @@ int trainerMain(const Configuration &config)
                 else
                     infoRows += printfRow("%s", errSpace);
 
-                if (!testSet->empty() && optimizer->currentEpoch() %
-		    config.testEvery() == 0) {
+                if (!testSet->empty() && evalEpoch > 0 &&
+		    evalEpoch % config.testEvery() == 0) {
                     if (classificationTask)
                         infoRows += printfRow(errFormat, 
 					      (double)optimizer->curTestClassError()*100.0, 
@@ -474,8 +655,8 @@ int trainerMain(const Configuration &config)
                     infoRows += printfRow("%s", errSpace);
 		
 		// check whether to terminate training
-                if (!validationSet->empty()&&
-		    optimizer->currentEpoch()%config.validateEvery()==0){
+                if (!validationSet->empty() && evalEpoch > 0 &&
+		    evalEpoch % config.validateEvery() == 0){
 		    
                     if (optimizer->epochsSinceLowestValidationError() == 0) {
                         infoRows += printfRow("  yes %s\n",
@@ -494,10 +675,12 @@ int trainerMain(const Configuration &config)
 			    }
 			    
                             saveFileS << ".best.jsn";
-                            saveNetwork(neuralNetwork,
-					saveFileS.str(), 
-					config.learningRate(),
-					config.weLearningRate());
+			    // the evaluation network holds the weights of evalEpoch
+			    if (helpers::allReduce::rank() == 0)
+				saveNetwork((evalNetwork ? *evalNetwork : neuralNetwork),
+					    saveFileS.str(), 
+					    config.learningRate(),
+					    config.weLearningRate());
                         }
                     }else{
 			infoRows += printfRow("  no  %s\n", optimizer->optStatus().c_str());
@@ -508,14 +691,25 @@ int trainerMain(const Configuration &config)
 		}
 		
                 // autosave
-                if (config.autosave()){
-                    saveState(neuralNetwork,
-			      *optimizer,
-			      infoRows, 
-			      config.learningRate(), 
-			      config.weLearningRate());
+                if (config.autosave() && helpers::allReduce::rank() == 0){
+		    if (config.autosaveBinary())
+			saveCheckpoint(checkpointWriter,
+				       neuralNetwork,
+				       *optimizer,
+				       *trainingSet,
+				       infoRows, 
+				       config.learningRate(), 
+				       config.weLearningRate());
+		    else
+			saveState(neuralNetwork,
+				  *optimizer,
+				  *trainingSet,
+				  infoRows, 
+				  config.learningRate(), 
+				  config.weLearningRate());
 		}
             }
+	    checkpointWriter.wait();
 	    
 
 	    // Finish training
@@ -534,13 +728,16 @@ int trainerMain(const Configuration &config)
             printf("\n");
 
             // save the trained network to the output file
-            printf("Storing the trained network in '%s'... ",
-		   config.trainedNetworkFile().c_str());
-            saveNetwork(neuralNetwork,
-			config.trainedNetworkFile(), 
-			config.learningRate(),
-			config.weLearningRate());
-            printf("done.\n");
+	    if (helpers::allReduce::rank() == 0){
+		printf("Storing the trained network in '%s'... ",
+		       config.trainedNetworkFile().c_str());
+		saveNetwork(neuralNetwork,
+			    config.trainedNetworkFile(), 
+			    config.learningRate(),
+			    config.weLearningRate());
+		printf("done.\n");
+	    }
+	    helpers::allReduce::finalize();
 
             std::cout << "Removing cache file(s) ..." << std::endl;
             if (trainingSet != boost::shared_ptr<data_sets::DataSet>())
@@ -571,6 +768,17 @@ int trainerMain(const Configuration &config)
 			    config.learningRate(),
 			    config.weLearningRate());
 		printf("done.\n");
+
+	    // convert the network into the binary model
+	    }else if (config.printWeightOpt() == 3){
+		printf("Translate the network into binary model '%s'... ",
+		       config.printWeightPath().c_str());
+		saveNetwork(neuralNetwork,
+			    config.printWeightPath(),
+			    config.learningRate(),
+			    config.weLearningRate(),
+			    true);
+		printf("done.\n");
 	    }
 	    
 	/********************* Data Generation    *************************/
@@ -684,111 +892,58 @@ int trainerMain(const Configuration &config)
 		printf("WARNING: output only for HTK format");
             }else if (config.feedForwardFormat() == Configuration::FORMAT_HTK) {
 		
-                // process all data set fractions
-                int fracIdx = 0;
-                boost::shared_ptr<data_sets::DataSetFraction> frac;
-		    
-                while (((frac = feedForwardSet->getNextFraction()))) {
-		    // print fraction information
-                    printf("Computing outputs for data fraction %d ... ", ++fracIdx);
-		    for (int i = 0; i<frac->numSequences(); i++)
-			printf("%s ", frac->seqInfo(i).seqTag.c_str());
-                    fflush(stdout);
-		    
-		    // generationOpt:
-		    //      if mdnVarScale is specified 
-		    //          if config.mdnPara is -1, 
-		    //               this is MDN parameter generation with mdnVarScale specified
-		    //          else
-		    //               this is sampling, scaled by mdnVarScake
-		    //      else
-		    //          directly use the mdnPara()
-		    real_t generationOpt = ((config.mdnVarScaleGen().size()>0) ? 
-					 ((config.mdnPara() > -1.5) ? config.mdnPara() : 1 ) : 
-					 (config.mdnPara()));
-		    neuralNetwork.notifyCurrentEpoch(config.fakeEpochNum());
-		    neuralNetwork.updateNNStateForGeneration();
-                    neuralNetwork.loadSequences(*frac);
-		    boost::posix_time::ptime sTime=boost::posix_time::microsec_clock::local_time();
-                    neuralNetwork.computeForwardPassGen(frac->maxSeqLength(), generationOpt);
-		    boost::posix_time::ptime eTime=boost::posix_time::microsec_clock::local_time();
+		// Modify 20171101: the fractions are processed by generateFractions().
+		// With --inference_threads N, N-1 replicas of the network are created.
+		// The replicas share the weights of neuralNetwork and have their own
+		// output buffers. Each thread takes the next fraction from feedForwardSet
+		generation_task_t genTask;
+		genTask.dataSet       = feedForwardSet.get();
+		genTask.fracIdx       = 0;
+		genTask.finished      = false;
+		genTask.outputMeans   = outputMeans;
+		genTask.outputStdevs  = outputStdevs;
+		genTask.unstandardize = unstandardize;
+		genTask.htkoutput     = htkoutput;
+		genTask.outputLag     = output_lag;
+
+		int numThreads = config.inferenceThreads();
+		if (numThreads > 1 && config.useCuda()){
+		    printf("\nWARNING: inference_threads is only supported on CPU. Use 1 thread\n");
+		    numThreads = 1;
+		}
+		
+		if (numThreads <= 1){
+		    generateFractions(&neuralNetwork, &genTask);
+		}else{
+		    std::vector<boost::shared_ptr<NeuralNetwork<TDevice> > > replicas;
+		    for (int i = 1; i < numThreads; i++){
+			printf("\nCreating replica %d of the neural network...", i);
+			replicas.push_back(boost::make_shared<NeuralNetwork<TDevice> >(
+				netDoc, parallelSequences, maxSeqLength,
+				inputSize, outputSize, &neuralNetwork));
+			if (config.weUpdate()){
+			    // Modify 20181018: read the WE bank of the master network
+			    replicas.back()->initWeUpdate(neuralNetwork);
+			    replicas.back()->initWeNoiseOpt(config.weNoiseStartDim(),
+							    config.weNoiseEndDim(),
+							    config.weNoiseDev());
+			}
+			if (config.datamvPath().size()>0)
+			    replicas.back()->readMVForOutput(*dataMV);
+		    }
+		    printf("\nGeneration with %d threads\n", numThreads);
 		    
-		    printf("\nTime (s): %f\n", (real_t)(eTime-sTime).total_milliseconds()/1000.0);
-
-                    std::vector<std::vector<std::vector<real_t> > > outputs = 
-			neuralNetwork.getOutputs(config.outputFromWhichLayer(), 
-						 config.outputFromGateLayer(),
-						 generationOpt); 
-
-                    // write one output file per sequence
-                    for (int psIdx = 0; psIdx < (int)outputs.size(); ++psIdx) {
-                        if (outputs[psIdx].size() > 0) {
-                            // replace_extension does not work in all Boost versions ...
-                            //std::string seqTag = frac->seqInfo(psIdx).seqTag;
-                            /*size_t dot_pos = seqTag.find_last_of('.');
-                            if (dot_pos != std::string::npos && dot_pos > 0) {
-                                seqTag = seqTag.substr(0, dot_pos);
-                            }*/
-                            //seqTag += ".htk";
-                            //std::cout << seqTag << std::endl;
-			    
-			    std::string seqTagSuf;
-			    if (htkoutput) {seqTagSuf = ".htk";} else{seqTagSuf = ".bin";}
-                            boost::filesystem::path seqPath(frac->seqInfo(psIdx).seqTag+seqTagSuf);
-                            std::string filename(seqPath.filename().string());
-                            boost::filesystem::path oPath = 
-				boost::filesystem::path(config.feedForwardOutputFile()) / 
-				seqPath.relative_path().parent_path();
-                            boost::filesystem::create_directories(oPath);
-                            boost::filesystem::path filepath = oPath / filename;
-                            std::ofstream file(filepath.string().c_str(), 
-					       std::ofstream::out | std::ios::binary);
-
-                            int nComps = outputs[psIdx][0].size();
-
-                            // write header
-			    if (htkoutput){
-				unsigned tmp = (unsigned)outputs[psIdx].size();
-				swap32(&tmp);
-				file.write((const char*)&tmp, sizeof(unsigned));
-				tmp = (unsigned)(config.featurePeriod() * 1e4);
-				swap32(&tmp);
-				file.write((const char*)&tmp, sizeof(unsigned));
-				unsigned short tmp2 = (unsigned short)(nComps) * sizeof(float);
-				swap16(&tmp2);
-				file.write((const char*)&tmp2, sizeof(unsigned short));
-				tmp2 = (unsigned short)(config.outputFeatureKind());
-				swap16(&tmp2);
-				file.write((const char*)&tmp2, sizeof(unsigned short));
-			    }
-			    
-
-                            // write the patterns
-                            for (int time=0; time<(int)outputs[psIdx].size(); ++time) 
-			    {
-                                for (int outIdx=0;outIdx<(int)outputs[psIdx][time].size();++outIdx)
-				{
-                                    float v;
-				    v = (time < outputs[psIdx].size() - output_lag) ? 
-					((float)outputs[psIdx][time+output_lag][outIdx]) :
-					((float)outputs[psIdx][outputs[psIdx].size()-1][outIdx]);
-
-                                    if (unstandardize) {
-                                        v *= outputStdevs[outIdx];
-                                        v += outputMeans[outIdx];
-                                    }
-				    
-				    if (htkoutput)
-					swapFloat(&v); 
-				    
-                                    file.write((const char*)&v, sizeof(float));
-                                }
-                            }
-                            file.close();
-                        }
-                    }
-                    printf(" done.\n");
-                }
+		    boost::thread_group genThreads;
+		    genThreads.create_thread(
+			boost::bind(&generateFractions<TDevice>, &neuralNetwork, &genTask));
+		    for (size_t i = 0; i < replicas.size(); i++)
+			genThreads.create_thread(
+			   boost::bind(&generateFractions<TDevice>, replicas[i].get(), &genTask));
+		    genThreads.join_all();
+		}
+		
+		if (!genTask.errorMsg.empty())
+		    throw std::runtime_error(genTask.errorMsg);
             }
             if (feedForwardSet != boost::shared_ptr<data_sets::DataSet>()) 
                 std::cout << "Removing cache file: "<<feedForwardSet->cacheFileName()<<std::endl;
@@ -853,6 +1008,12 @@ int main(int argc, const char *argv[])
 
 void readJsonFile(rapidjson::Document *doc, const std::string &filename)
 {
+    // Add 20171101: binary model, the weights are loaded from the mapped file
+    if (helpers::binaryModel::isBinaryModel(filename)){
+	helpers::binaryModel::readBinaryModel(filename, doc);
+	return;
+    }
+    
     // open the file
     std::ifstream ifs(filename.c_str(), std::ios::binary);
     if (!ifs.good())
@@ -957,6 +1118,13 @@ boost::shared_ptr<data_sets::DataSet> loadDataSet(data_set_type dsType)
 		noiseDev,   cachePath);
     
     printf("done.\n");
+    
+    // Add 20181018: distributed training, each process uses one shard
+    if (helpers::allReduce::distributed() && dsType != DATA_SET_FEEDFORWARD){
+	ds->setShard(helpers::allReduce::rank(), helpers::allReduce::size());
+	printf("Data shard:       %d of %d\n", helpers::allReduce::rank(),
+	       helpers::allReduce::size());
+    }
     printf("Loaded fraction:  %d%%\n",    (int)(fraction*100));
     printf("Sequences:        %d\n",      ds->totalSequences());
     printf("Sequence lengths: %d..%d\n",  ds->minSeqLength(),
@@ -1037,15 +1205,24 @@ void printOptimizer(const Configuration &config, const optimizers::Optimizer<TDe
 
 template <typename TDevice> 
 void saveNetwork(const NeuralNetwork<TDevice> &nn, const std::string &filename,
-		 const real_t nnlr, const real_t welr)
+		 const real_t nnlr, const real_t welr, const bool binaryModel)
 {
 
-    if (nnlr > 0){
+    if (binaryModel && nnlr > 0){
+	// Add 20171101: JSON header + float32 blobs
+	// Modify 20181018: the blobs are copied from the weight vectors of the layers
+	helpers::checkpoint::Checkpoint staging;
+	nn.exportLayers (&staging.header());
+	nn.exportWeights(&staging);
+	helpers::binaryModel::writeBinaryModel(filename, staging.header(),
+					       staging.blobs(), staging.blobNum());
+	
+    }else if (nnlr > 0){
 	rapidjson::Document jsonDoc;
 	jsonDoc.SetObject();
 	nn.exportLayers (&jsonDoc);
 	nn.exportWeights(&jsonDoc);
-	
+
 	FILE *file = fopen(filename.c_str(), "w");
 	if (!file)
 	    throw std::runtime_error("Cannot open file");
@@ -1070,9 +1247,73 @@ void saveNetwork(const NeuralNetwork<TDevice> &nn, const std::string &filename,
 }
 
 
+std::string autosaveFilename(const int epoch, const bool midEpoch)
+{
+    std::stringstream autosaveFilename;
+    std::string prefix = Configuration::instance().autosavePrefix(); 
+    autosaveFilename << prefix;
+    if (!prefix.empty())
+	autosaveFilename << '_';
+    autosaveFilename << "epoch";
+    autosaveFilename << std::setfill('0') << std::setw(3) << epoch;
+    // Add 20181018: the autosave inside epoch N is overwritten until the epoch ends
+    if (midEpoch)
+	autosaveFilename << ".mid";
+    autosaveFilename << ".autosave";
+    return autosaveFilename.str();
+}
+
+// Add 20181018: the position of the data loader in the autosave
+void exportLoaderState(const data_sets::DataSet &dataSet, rapidjson::Document *jsonDoc)
+{
+    data_sets::DataSet::loader_state_t state;
+    dataSet.exportLoaderState(&state);
+
+    // the strings are copied, the document may be written after this function
+    rapidjson::Value loaderObject(rapidjson::kObjectType);
+    rapidjson::Value shuffleRng(state.shuffleRng.c_str(),
+				(rapidjson::SizeType)state.shuffleRng.size(),
+				jsonDoc->GetAllocator());
+    rapidjson::Value sequenceOrder(rapidjson::kArrayType);
+    sequenceOrder.Reserve((rapidjson::SizeType)state.sequenceOrder.size(),
+			  jsonDoc->GetAllocator());
+    for (size_t i = 0; i < state.sequenceOrder.size(); ++i)
+	sequenceOrder.PushBack(state.sequenceOrder[i], jsonDoc->GetAllocator());
+    
+    loaderObject.AddMember("noise_pass",     state.noisePass, jsonDoc->GetAllocator());
+    loaderObject.AddMember("frac_pos",       state.fracPos,   jsonDoc->GetAllocator());
+    loaderObject.AddMember("shuffle_rng",    shuffleRng,      jsonDoc->GetAllocator());
+    loaderObject.AddMember("sequence_order", sequenceOrder,   jsonDoc->GetAllocator());
+    jsonDoc->AddMember("data_loader", loaderObject, jsonDoc->GetAllocator());
+}
+
+void importLoaderState(const rapidjson::Document &jsonDoc, data_sets::DataSet *dataSet)
+{
+    // autosave of older versions
+    if (!jsonDoc.HasMember("data_loader"))
+	return;
+    
+    const rapidjson::Value &loaderObject = jsonDoc["data_loader"];
+    if (!loaderObject.IsObject() || !loaderObject.HasMember("noise_pass") ||
+	!loaderObject.HasMember("frac_pos") || !loaderObject.HasMember("shuffle_rng") ||
+	!loaderObject.HasMember("sequence_order") || !loaderObject["sequence_order"].IsArray())
+	throw std::runtime_error("Invalid 'data_loader' in the autosave");
+    
+    data_sets::DataSet::loader_state_t state;
+    state.noisePass  = loaderObject["noise_pass"].GetInt();
+    state.fracPos    = loaderObject["frac_pos"].GetInt();
+    state.shuffleRng = loaderObject["shuffle_rng"].GetString();
+    const rapidjson::Value &sequenceOrder = loaderObject["sequence_order"];
+    for (rapidjson::Value::ConstValueIterator it = sequenceOrder.Begin();
+	 it != sequenceOrder.End(); ++it)
+	state.sequenceOrder.push_back(it->GetInt());
+    dataSet->importLoaderState(state);
+}
+
 template <typename TDevice> 
 void saveState(const NeuralNetwork<TDevice> &nn, 
 	       const optimizers::Optimizer<TDevice> &optimizer, 
+	       const data_sets::DataSet &trainingSet,
 	       const std::string &infoRows,
 	       const real_t nnlr, const real_t welr)
 {
@@ -1097,17 +1338,13 @@ void saveState(const NeuralNetwork<TDevice> &nn,
 
 	// add the state of the optimizer
 	optimizer.exportState(&jsonDoc);
+
+	// Add 20181018: the position of the data loader
+	exportLoaderState(trainingSet, &jsonDoc);
     
 	// open the file
-	std::stringstream autosaveFilename;
-	std::string prefix = Configuration::instance().autosavePrefix(); 
-	autosaveFilename << prefix;
-	if (!prefix.empty())
-	    autosaveFilename << '_';
-	autosaveFilename << "epoch";
-	autosaveFilename << std::setfill('0') << std::setw(3) << optimizer.currentEpoch();
-	autosaveFilename << ".autosave";
-	std::string autosaveFilename_str = autosaveFilename.str();
+	std::string autosaveFilename_str = autosaveFilename(optimizer.currentEpoch(),
+							    optimizer.midEpoch());
 	FILE *file = fopen(autosaveFilename_str.c_str(), "w");
 	if (!file)
 	    throw std::runtime_error("Cannot open file");
@@ -1122,18 +1359,50 @@ void saveState(const NeuralNetwork<TDevice> &nn,
     if (welr > 0){
 	/* Add 16-02-22 Wang: for WE updating */
 	// save WE
-	// open the file
-	std::stringstream autosaveFilename;
-	std::string prefix = Configuration::instance().autosavePrefix(); 
-	autosaveFilename << prefix;
-	if (!prefix.empty())
-	    autosaveFilename << '_';
-	autosaveFilename << "epoch";
-	autosaveFilename << std::setfill('0') << std::setw(3) << optimizer.currentEpoch();
-	autosaveFilename << ".autosave";
-	autosaveFilename << ".we";
 	if (nn.flagInputWeUpdate()){
-	    if (!nn.saveWe(autosaveFilename.str())){
+	    if (!nn.saveWe(autosaveFilename(optimizer.currentEpoch(),
+					    optimizer.midEpoch()) + ".we")){
+		throw std::runtime_error("Fail to save we data");
+	    }
+	}
+    }
+}
+
+// Add 20181018: binary checkpoint
+//  The state is copied into the staging buffer here, and the file is written by the
+//  background thread of the writer. The WE bank is still saved as .autosave.we
+template <typename TDevice> 
+void saveCheckpoint(helpers::checkpoint::CheckpointWriter &writer,
+		    const NeuralNetwork<TDevice> &nn, 
+		    const optimizers::Optimizer<TDevice> &optimizer, 
+		    const data_sets::DataSet &trainingSet,
+		    const std::string &infoRows,
+		    const real_t nnlr, const real_t welr)
+{
+    if (nnlr > 0){
+	// wait for the last checkpoint and reuse its buffer
+	helpers::checkpoint::Checkpoint &ckpt = writer.stage();
+	rapidjson::Document &jsonDoc = ckpt.header();
+	
+	jsonDoc.AddMember("configuration", 
+			  Configuration::instance().serializedOptions().c_str(), 
+			  jsonDoc.GetAllocator());
+	std::string tmp = boost::replace_all_copy(infoRows, "\n", ";;;");
+	jsonDoc.AddMember("info_rows", tmp.c_str(), jsonDoc.GetAllocator());
+
+	nn.exportLayers (&jsonDoc);
+	nn.exportWeights(&ckpt);
+	optimizer.exportCheckpoint(&ckpt);
+	exportLoaderState(trainingSet, &jsonDoc);
+
+	// the header is converted into text before this function returns
+	writer.write(autosaveFilename(optimizer.currentEpoch(), optimizer.midEpoch()));
+    }
+
+    if (welr > 0){
+	if (nn.flagInputWeUpdate()){
+	    if (!nn.saveWe(autosaveFilename(optimizer.currentEpoch(),
+					    optimizer.midEpoch()) + ".we")){
 		throw std::runtime_error("Fail to save we data");
 	    }
 	}
@@ -1145,9 +1414,12 @@ template <typename TDevice>
 void restoreState(
  NeuralNetwork<TDevice> *nn,
  optimizers::Optimizer<TDevice> *optimizer, 
+ data_sets::DataSet *trainingSet,
  std::string *infoRows)
 {
     rapidjson::Document jsonDoc;
+    // Add 20181018: unmap the binary autosave once the state is restored
+    helpers::binaryModel::MappedModelGuard jsonDocGuard(jsonDoc);
     readJsonFile(&jsonDoc, Configuration::instance().continueFile());
 
     // extract info rows
@@ -1158,9 +1430,50 @@ void restoreState(
 
     // extract the state of the optimizer
     optimizer->importState(jsonDoc);
+
+    // Add 20181018: continue the data loader from the saved position
+    importLoaderState(jsonDoc, trainingSet);
 }
 
+// Add 20181018: autosave inside the epoch
+//  The row of the epoch in progress is not finished, and it is printed again
+//  when the training continues from this autosave
+template <typename TDevice>
+void midEpochAutosave(void *userData)
+{
+    mid_epoch_autosave_t<TDevice> *arg = static_cast<mid_epoch_autosave_t<TDevice>*>(userData);
+    const Configuration &config = Configuration::instance();
+    std::string infoRows = arg->infoRows->substr(0, arg->infoRows->rfind('\n') + 1);
+    
+    if (config.autosaveBinary())
+	saveCheckpoint(*arg->writer, *arg->nn, *arg->optimizer, *arg->trainingSet,
+		       infoRows, config.learningRate(), config.weLearningRate());
+    else
+	saveState(*arg->nn, *arg->optimizer, *arg->trainingSet,
+		  infoRows, config.learningRate(), config.weLearningRate());
+}
+
+
 
+// Add 20181018: whether the network uses batchnorm (layer or feedforward option)
+bool flagBatchNormNetwork(const rapidjson::Document &netDoc)
+{
+    if (!netDoc.HasMember("layers") || !netDoc["layers"].IsArray())
+	return false;
+    const rapidjson::Value &layersSection = netDoc["layers"];
+    for (rapidjson::Value::ConstValueIterator layerChild = layersSection.Begin();
+	 layerChild != layersSection.End(); ++layerChild){
+	if (!layerChild->IsObject())
+	    continue;
+	if (layerChild->HasMember("type") && (*layerChild)["type"].IsString() &&
+	    std::string((*layerChild)["type"].GetString()) == "batchnorm")
+	    return true;
+	if (layerChild->HasMember("batchnorm") && (*layerChild)["batchnorm"].IsInt() &&
+	    (*layerChild)["batchnorm"].GetInt() > 0)
+	    return true;
+    }
+    return false;
+}
 
 std::string printfRow(const char *format, ...)
 {
@@ -1179,3 +1492,146 @@ std::string printfRow(const char *format, ...)
     return std::string(buffer);
 }
 
+
+
+template <typename TDevice>
+void generateFractions(NeuralNetwork<TDevice> *nn, generation_task_t *task)
+{
+    const Configuration &config = Configuration::instance();
+    
+    boost::shared_ptr<data_sets::DataSetFraction> frac;
+    int fracIdx;
+    
+    try{
+	while (true){
+	    // take the next fraction
+	    // (getNextFraction() starts from the first fraction again after it returns
+	    //  an empty pointer, thus task->finished is used to stop all the threads)
+	    {
+		boost::lock_guard<boost::mutex> lock(task->dataMutex);
+		if (task->finished)
+		    break;
+		frac = task->dataSet->getNextFraction();
+		if (!frac){
+		    task->finished = true;
+		    break;
+		}
+		fracIdx = ++(task->fracIdx);
+	    }
+	    
+	    // Modify 20181018: the fraction information is buffered and printed once
+	    //  the fraction is done, so that the reports of the threads do not interleave
+	    std::ostringstream report;
+	    report << "Computing outputs for data fraction " << fracIdx << " ... ";
+	    for (int i = 0; i<frac->numSequences(); i++)
+		report << frac->seqInfo(i).seqTag << " ";
+
+	    // generationOpt:
+	    //      if mdnVarScale is specified 
+	    //          if config.mdnPara is -1, 
+	    //               this is MDN parameter generation with mdnVarScale specified
+	    //          else
+	    //               this is sampling, scaled by mdnVarScake
+	    //      else
+	    //          directly use the mdnPara()
+	    real_t generationOpt = ((config.mdnVarScaleGen().size()>0) ? 
+				 ((config.mdnPara() > -1.5) ? config.mdnPara() : 1 ) : 
+				 (config.mdnPara()));
+	    nn->notifyCurrentEpoch(config.fakeEpochNum());
+	    // Modify 20181018: random streams are keyed by the fraction index, not by
+	    //  the number of fractions this replica has processed
+	    nn->notifyCurrentFrac(fracIdx);
+	    nn->updateNNStateForGeneration();
+	    nn->loadSequences(*frac);
+	    boost::posix_time::ptime sTime=boost::posix_time::microsec_clock::local_time();
+	    nn->computeForwardPassGen(frac->maxSeqLength(), generationOpt);
+	    boost::posix_time::ptime eTime=boost::posix_time::microsec_clock::local_time();
+
+	    report << std::endl << "Time (s): " << std::fixed
+		   << (real_t)(eTime-sTime).total_milliseconds()/1000.0 << std::endl;
+
+	    std::vector<std::vector<std::vector<real_t> > > outputs = 
+		nn->getOutputs(config.outputFromWhichLayer(), 
+					 config.outputFromGateLayer(),
+					 generationOpt); 
+
+	    // write one output file per sequence
+	    for (int psIdx = 0; psIdx < (int)outputs.size(); ++psIdx) {
+		if (outputs[psIdx].size() > 0) {
+		    // replace_extension does not work in all Boost versions ...
+		    //std::string seqTag = frac->seqInfo(psIdx).seqTag;
+		    /*size_t dot_pos = seqTag.find_last_of('.');
+		    if (dot_pos != std::string::npos && dot_pos > 0) {
+			seqTag = seqTag.substr(0, dot_pos);
+		    }*/
+		    //seqTag += ".htk";
+		    //std::cout << seqTag << std::endl;
+
+		    std::string seqTagSuf;
+		    if (task->htkoutput) {seqTagSuf = ".htk";} else{seqTagSuf = ".bin";}
+		    boost::filesystem::path seqPath(frac->seqInfo(psIdx).seqTag+seqTagSuf);
+		    std::string filename(seqPath.filename().string());
+		    boost::filesystem::path oPath = 
+			boost::filesystem::path(config.feedForwardOutputFile()) / 
+			seqPath.relative_path().parent_path();
+		    boost::filesystem::create_directories(oPath);
+		    boost::filesystem::path filepath = oPath / filename;
+		    std::ofstream file(filepath.string().c_str(), 
+				       std::ofstream::out | std::ios::binary);
+
+		    int nComps = outputs[psIdx][0].size();
+
+		    // write header
+		    if (task->htkoutput){
+			unsigned tmp = (unsigned)outputs[psIdx].size();
+			swap32(&tmp);
+			file.write((const char*)&tmp, sizeof(unsigned));
+			tmp = (unsigned)(config.featurePeriod() * 1e4);
+			swap32(&tmp);
+			file.write((const char*)&tmp, sizeof(unsigned));
+			unsigned short tmp2 = (unsigned short)(nComps) * sizeof(float);
+			swap16(&tmp2);
+			file.write((const char*)&tmp2, sizeof(unsigned short));
+			tmp2 = (unsigned short)(config.outputFeatureKind());
+			swap16(&tmp2);
+			file.write((const char*)&tmp2, sizeof(unsigned short));
+		    }
+
+
+		    // write the patterns
+		    for (int time=0; time<(int)outputs[psIdx].size(); ++time) 
+		    {
+			for (int outIdx=0;outIdx<(int)outputs[psIdx][time].size();++outIdx)
+			{
+			    float v;
+			    v = (time < outputs[psIdx].size() - task->outputLag) ? 
+				((float)outputs[psIdx][time+task->outputLag][outIdx]) :
+				((float)outputs[psIdx][outputs[psIdx].size()-1][outIdx]);
+
+			    if (task->unstandardize) {
+				v *= task->outputStdevs[outIdx];
+				v += task->outputMeans[outIdx];
+			    }
+
+			    if (task->htkoutput)
+				swapFloat(&v); 
+
+			    file.write((const char*)&v, sizeof(float));
+			}
+		    }
+		    file.close();
+		}
+	    }
+	    report << " done." << std::endl;
+	    {
+		boost::lock_guard<boost::mutex> lock(task->printMutex);
+		printf("%s", report.str().c_str());
+		fflush(stdout);
+	    }
+	}
+    }catch (const std::exception &e){
+	boost::lock_guard<boost::mutex> lock(task->dataMutex);
+	task->finished = true;
+	task->errorMsg = e.what();
+    }
+}
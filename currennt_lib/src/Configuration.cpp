@@ -21,6 +21,8 @@
  *****************************************************************************/
 
 #include "Configuration.hpp"
+#include "MacroDefine.hpp"
+#include "helpers/BinaryModel.hpp"
 #include "rapidjson/document.h"
 #include "rapidjson/filestream.h"
 
@@ -75,25 +77,32 @@ std::string serializeOptions(const po::variables_map &vm)
 
 void deserializeOptions(const std::string &autosaveFile, std::stringstream *ss)
 {
-    // open the file
-    std::ifstream ifs(autosaveFile.c_str(), std::ios::binary);
-    if (!ifs.good())
-        throw std::runtime_error("Cannot open file");
-
-    // calculate the file size in bytes
-    ifs.seekg(0, std::ios::end);
-    size_t size = ifs.tellg();
-    ifs.seekg(0, std::ios::beg);
-
-    // read the file into a buffer
-    char *buffer = new char[size + 1];
-    ifs.read(buffer, size);
-    buffer[size] = '\0';
-
-    // parse the JSON file
     rapidjson::Document jsonDoc;
-    if (jsonDoc.Parse<0>(buffer).HasParseError())
-        throw std::runtime_error(std::string("Parse error: ") + jsonDoc.GetParseError());
+    
+    if (helpers::binaryModel::isBinaryModel(autosaveFile)) {
+	// Add 20181018: binary checkpoint, the options are in the header
+	helpers::binaryModel::readBinaryHeader(autosaveFile, &jsonDoc);
+	
+    }else{
+	// open the file
+	std::ifstream ifs(autosaveFile.c_str(), std::ios::binary);
+	if (!ifs.good())
+	    throw std::runtime_error("Cannot open file");
+
+	// calculate the file size in bytes
+	ifs.seekg(0, std::ios::end);
+	size_t size = ifs.tellg();
+	ifs.seekg(0, std::ios::beg);
+
+	// read the file into a buffer
+	char *buffer = new char[size + 1];
+	ifs.read(buffer, size);
+	buffer[size] = '\0';
+
+	// parse the JSON file
+	if (jsonDoc.Parse<0>(buffer).HasParseError())
+	    throw std::runtime_error(std::string("Parse error: ") + jsonDoc.GetParseError());
+    }
 
     // extract the options
     if (!jsonDoc.HasMember("configuration"))
@@ -209,6 +218,21 @@ Configuration::Configuration(int argc, const char *argv[])
 	("vaeCodeInputDir",
 	 po::value(&m_vaeCodeInputDir)->default_value(""),
 	 std::string("Directory of latent variables that will be fed into VAE decoder").c_str())
+	("inference_threads",
+	 po::value(&m_inferenceThreads)->default_value(1),
+	 std::string(
+	      std::string("Number of threads for generation (CPU only, default 1). ") +
+	      std::string("Each thread runs one copy of the network on its own data fraction;") +
+	      std::string(" the weights are shared by all the copies")).c_str())
+	("inference_graph_opt",
+	 po::value(&m_inferenceGraphOpt)->default_value(0),
+	 std::string(
+	      std::string("Optimize the network for generation (default 0). ") +
+	      std::string("Batchnorm is folded into feedforward layers, feedforward_identity ") +
+	      std::string("is merged with the next feedforward layer, and skipadd is fused into ") +
+	      std::string("the preceding feedforward layer. Layers are removed and renumbered, ") +
+	      std::string("thus it is not used with output_from, vaeEncoderOutputLayer, ") +
+	      std::string("print_weight_to or trainedModel. 1: use")).c_str())
 	;
 
     po::options_description trainingOptions("Training options");
@@ -224,13 +248,56 @@ Configuration::Configuration(int argc, const char *argv[])
 	 std::string(
 	     std::string("option for printing weight. 0: only weights (default) and macro; ")+
 	     std::string("1: weights, macro with layertype. For hts_engine.") +
-	     std::string("2: translate *.autosave to *.jsn")).c_str())
+	     std::string("2: translate *.autosave (or binary model) to *.jsn. ") +
+	     std::string("3: translate *.jsn or *.autosave to binary model")).c_str())
         ("stochastic", 
 	 po::value(&m_hybridOnlineBatch)->default_value(false),                          
 	 "enables weight updates after every mini-batch of parallel calculated sequences")
         ("hybrid_online_batch", 
 	 po::value(&m_hybridOnlineBatch)->default_value(false),                 
 	 "same as --stochastic (for compatibility)")
+	("training_threads",
+	 po::value(&m_trainingThreads)->default_value(1),
+	 std::string(
+	      std::string("Number of threads for data-parallel training (CPU only, default 1). ")+
+	      std::string("N consecutive fractions are processed by N copies of the network, ")+
+	      std::string("and the gradients are summed in a fixed order. ") +
+	      std::string("The result is reproducible for the same N. With hybrid_online_batch, ")+
+	      std::string("the weights are updated once per N fractions")).c_str())
+	("dist_size",
+	 po::value(&m_distSize)->default_value(1),
+	 std::string(
+	      std::string("Number of processes of a distributed training job (default 1). ")+
+	      std::string("The data sets are sharded by rank, and the gradients are summed ")+
+	      std::string("over the processes. --random_seed must be given")).c_str())
+	("dist_rank",
+	 po::value(&m_distRank)->default_value(0),
+	 "Rank of this process in the distributed training job (0 ... dist_size-1)")
+	("dist_address",
+	 po::value(&m_distAddress)->default_value("shm:currennt_dist"),
+	 std::string(
+	      std::string("Address of the distributed training job. shm:NAME (shared memory ")+
+	      std::string("on one machine), unix:PATH (UNIX domain socket) or tcp:HOST:PORT ")+
+	      std::string("(HOST is the machine of rank 0)")).c_str())
+	("async_training",
+	 po::value(&m_asyncTraining)->default_value(false),
+	 std::string(
+	      std::string("Asynchronous (Hogwild) training with --training_threads and ")+
+	      std::string("--hybrid_online_batch. Each thread updates the shared weights and ")+
+	      std::string("the WE bank after every fraction without locks (default false)")).c_str())
+	("async_staleness",
+	 po::value(&m_asyncStaleness)->default_value(0),
+	 std::string(
+	      std::string("Staleness bound for --async_training. A fraction waits until the ")+
+	      std::string("updates of all but the last N preceding fractions are done ")+
+	      std::string("(default 0, no bound)")).c_str())
+	("overlap_validation",
+	 po::value(&m_overlapValidation)->default_value(false),
+	 std::string(
+	      std::string("Compute the validation and test errors of epoch N on a copy of the ")+
+	      std::string("weights in a background thread while epoch N+1 is trained (CPU only). ")+
+	      std::string("The errors and the best network are reported one epoch later ")+
+	      std::string("(default false)")).c_str())
         ("shuffle_fractions",   
 	 po::value(&m_shuffleFractions) ->default_value(false),                 
 	 "shuffles mini-batches in stochastic gradient descent")
@@ -305,6 +372,9 @@ Configuration::Configuration(int argc, const char *argv[])
 	("mdn_EMGenIter",       
 	 po::value(&m_EMGenIter)        ->default_value(5, "5"),                  
 	 "Number of iterations for EM generation in MDN (default 5). ")
+	("mdn_EMGenThreshold",
+	 po::value(&m_EMGenThreshold)   ->default_value((real_t)0.0001, "0.0001"),
+	 "EM generation in MDN: a frame is converged when the change of its log-likelihood per dimension is less than this value (default 0.0001).")
 	("varInitPara",         
 	 po::value(&m_varInitPara)      ->default_value(0.5, "0.5"), 
 	 "Parameter to initialize the bias of MDN mixture unit (default 0.5)")
@@ -382,7 +452,8 @@ Configuration::Configuration(int argc, const char *argv[])
 	 "Parameter for schedule sampling. Default 0")
 	("runningMode",
 	 po::value(&m_runningMode)      ->default_value(0),
-	 "Training mode of CURRENNT.\n\t0: default\n\t1: skip layers with 0 LR during backprop")
+	 "Training mode of CURRENNT.\n\t0: default\n\t1: skip layers with 0 LR during backprop"
+	 "\n\t2: layers with 0 LR only propagate the errors (no weight gradients)")
 	("mdnVarFixEpochNum",
 	 po::value(&m_mdnVarFixEpochNum)->default_value(-1),
 	 "Fix the variance of mdn (GMM) as 1 for this number of epochs. Default (not use)")
@@ -399,6 +470,18 @@ Configuration::Configuration(int argc, const char *argv[])
         ("autosave_best",        
 	 po::value(&m_autosaveBest)        ->default_value(false), 
 	 "enables autosave on best validation error")
+        ("autosave_binary",        
+	 po::value(&m_autosaveBinary)      ->default_value(false), 
+	 "write the autosave as binary checkpoint (weights, optimizer and data loader state) "
+	 "in a background thread. It can be used by --continue as the JSON autosave")
+        ("autosave_interval",        
+	 po::value(&m_autosaveInterval)    ->default_value(0), 
+	 "also autosave inside the epoch every N minutes (hybrid_online_batch only). "
+	 "--continue resumes from the saved fraction. 0: disabled")
+        ("autosave_fractions",        
+	 po::value(&m_autosaveFractions)   ->default_value(0), 
+	 "also autosave inside the epoch after every N fractions, as autosave_interval. "
+	 "0: disabled")
         ("autosave_prefix", 
 	 po::value(&m_autosavePrefix),                 
 	 "prefix for autosave files; e.g. 'abc/mynet-' -> 'mynet-epoch005.autosave' in dir 'abc'")
@@ -680,6 +763,45 @@ Configuration::Configuration(int argc, const char *argv[])
         exit(1);
     }
 
+    // Add 20181018: check the distributed job
+    if (m_distSize > 1 && m_trainingMode){
+	if (m_distRank < 0 || m_distRank >= m_distSize){
+	    std::cout << "ERROR: dist_rank should be in [0, dist_size)" << std::endl;
+	    exit(1);
+	}
+	if (!m_randomSeed){
+	    // the processes must shuffle the data and initialize the weights in the same way
+	    std::cout << "ERROR: random_seed must be set for distributed training" << std::endl;
+	    exit(1);
+	}
+    }
+
+    // Add 20181018: check the asynchronous training
+    if (m_asyncTraining && m_trainingMode){
+	if (!m_hybridOnlineBatch){
+	    std::cout << "ERROR: async_training requires hybrid_online_batch" << std::endl;
+	    exit(1);
+	}
+	if (m_trainingThreads < 2){
+	    std::cout << "ERROR: async_training requires training_threads > 1" << std::endl;
+	    exit(1);
+	}
+	if (m_distSize > 1){
+	    std::cout << "ERROR: async_training can not be used with dist_size" << std::endl;
+	    exit(1);
+	}
+	if (m_weightNoiseSigma > 0){
+	    std::cout << "ERROR: async_training does not support weight_noise_sigma" << std::endl;
+	    exit(1);
+	}
+	if (m_optimizerOption != 0 && m_optimizerOption != OPTIMIZATION_AVEGRAD &&
+	    m_optimizerOption != OPTIMIZATION_SGD_DECAY){
+	    // AdaGrad and Adam keep statistics that can't be updated without locks
+	    std::cout << "ERROR: async_training only supports Optimizer 0, 2 and 4" << std::endl;
+	    exit(1);
+	}
+    }
+
     // create a random seed
     if (!m_randomSeed)
         m_randomSeed = boost::random::random_device()();
@@ -774,6 +896,17 @@ Configuration::Configuration(int argc, const char *argv[])
     if (m_autosaveBest) {
         std::cout << "\tAutosave on BEST VALIDATION ERROR enabled." << std::endl;
     }
+    if (m_autosave && m_autosaveBinary) {
+        std::cout << "\tAutosave as binary checkpoint." << std::endl;
+    }
+    if (m_autosave && m_autosaveInterval > 0) {
+        std::cout << "\tAutosave inside the epoch every " << m_autosaveInterval;
+	std::cout << " minutes." << std::endl;
+    }
+    if (m_autosave && m_autosaveFractions > 0) {
+        std::cout << "\tAutosave inside the epoch every " << m_autosaveFractions;
+	std::cout << " fractions." << std::endl;
+    }
 
     if (m_useCuda){
         std::cout << "\tUtilizing the GPU on ";
@@ -896,6 +1029,21 @@ bool Configuration::autosaveBest() const
     return m_autosaveBest;
 }
 
+bool Configuration::autosaveBinary() const
+{
+    return m_autosaveBinary;
+}
+
+int Configuration::autosaveInterval() const
+{
+    return m_autosaveInterval;
+}
+
+int Configuration::autosaveFractions() const
+{
+    return m_autosaveFractions;
+}
+
 Configuration::optimizer_type_t Configuration::optimizer() const
 {
     return m_optimizer;
@@ -1197,6 +1345,11 @@ const int& Configuration::EMIterNM() const
     return m_EMGenIter;
 }
 
+const real_t& Configuration::EMGenThreshold() const
+{
+    return m_EMGenThreshold;
+}
+
 const real_t& Configuration::getVarInitPara() const
 {
     return m_varInitPara;
@@ -1449,3 +1602,48 @@ const std::string& Configuration::vaeCodeInputDir() const
 {
     return m_vaeCodeInputDir;
 }
+
+const int& Configuration::inferenceThreads() const
+{
+    return m_inferenceThreads;
+}
+
+const int& Configuration::inferenceGraphOpt() const
+{
+    return m_inferenceGraphOpt;
+}
+
+const int& Configuration::trainingThreads() const
+{
+    return m_trainingThreads;
+}
+
+const int& Configuration::distSize() const
+{
+    return m_distSize;
+}
+
+const int& Configuration::distRank() const
+{
+    return m_distRank;
+}
+
+const std::string& Configuration::distAddress() const
+{
+    return m_distAddress;
+}
+
+const bool& Configuration::asyncTraining() const
+{
+    return m_asyncTraining;
+}
+
+const int& Configuration::asyncStaleness() const
+{
+    return m_asyncStaleness;
+}
+
+const bool& Configuration::overlapValidation() const
+{
+    return m_overlapValidation;
+}
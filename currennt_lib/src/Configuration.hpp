@@ -64,6 +64,9 @@ private:
     bool m_shuffleSequences;
     bool m_autosave;
     bool m_autosaveBest;
+    bool m_autosaveBinary;     // Add 20181018: binary checkpoint written in background
+    int  m_autosaveInterval;   // Add 20181018: minutes between the mid-epoch autosaves
+    int  m_autosaveFractions;  // Add 20181018: fractions between the mid-epoch autosaves
 
     optimizer_type_t         m_optimizer;
     distribution_type_t      m_weightsDistribution;
@@ -106,6 +109,7 @@ private:
     std::string m_mdnFlagPath;
     real_t      m_mdnSamplingPara;
     int         m_EMGenIter;
+    real_t      m_EMGenThreshold;
 
     /* Add 0514 Wang: data mv file*/
     std::string m_datamvPath;
@@ -200,6 +204,19 @@ private:
     /**/
     int         m_vaeEncoderOutputLayer;
     std::string m_vaeCodeInputDir;
+
+    /* Add 20171101 */
+    int         m_inferenceThreads;
+    int         m_inferenceGraphOpt;
+
+    /* Add 20181018 */
+    int         m_trainingThreads;
+    int         m_distSize;
+    int         m_distRank;
+    std::string m_distAddress;
+    bool        m_asyncTraining;
+    int         m_asyncStaleness;
+    bool        m_overlapValidation;
     
     unsigned m_truncSeqLength;
     unsigned m_parallelSequences;
@@ -335,6 +352,22 @@ public:
       */
     bool autosaveBest() const;
 
+    /**
+      * Add 20181018: returns true if the autosave is written as binary checkpoint
+      */
+    bool autosaveBinary() const;
+
+    /**
+      * Add 20181018: returns the interval (minutes) of the mid-epoch autosave, 0 if disabled
+      */
+    int autosaveInterval() const;
+
+    /**
+      * Add 20181018: returns the number of fractions between the mid-epoch autosaves,
+      * 0 if disabled
+      */
+    int autosaveFractions() const;
+
     /**
      * Returns the optimizer type
      *
@@ -623,6 +656,8 @@ public:
 
     const int& EMIterNM() const;
 
+    const real_t& EMGenThreshold() const;
+
     const real_t& getVarInitPara() const;
 
     const real_t& getVFloorPara() const;
@@ -726,6 +761,24 @@ public:
     const int& vaeEncoderOutputLayer() const;
 
     const std::string& vaeCodeInputDir() const;
+
+    const int& inferenceThreads() const;
+
+    const int& inferenceGraphOpt() const;
+
+    const int& trainingThreads() const;
+
+    const int& distSize() const;
+
+    const int& distRank() const;
+
+    const std::string& distAddress() const;
+
+    const bool& asyncTraining() const;
+
+    const int& asyncStaleness() const;
+
+    const bool& overlapValidation() const;
     
 };
 
@@ -66,7 +66,8 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createLayer(
 		const helpers::JsonValue &layerChild,
 		const helpers::JsonValue &weightsSection, 
 		int parallelSequences, int maxSeqLength, 
-		layers::Layer<TDevice> *precedingLayer
+		layers::Layer<TDevice> *precedingLayer,
+		typename TDevice::real_vector *sharedWeights
 		)
 {
     using namespace layers;
@@ -76,64 +77,64 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createLayer(
     	return new InputLayer<TDevice>(layerChild, parallelSequences, maxSeqLength);
     else if (layerType == "feedforward_tanh")
     	return new FeedForwardLayer<TDevice, Tanh>(layerChild, weightsSection,
-						   *precedingLayer, maxSeqLength);
+						   *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "feedforward_logistic")
     	return new FeedForwardLayer<TDevice, Logistic>(layerChild, weightsSection,
-						       *precedingLayer, maxSeqLength);
+						       *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "feedforward_identity")
     	return new FeedForwardLayer<TDevice, Identity>(layerChild, weightsSection,
-						       *precedingLayer, maxSeqLength);
+						       *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "feedforward_relu")
     	return new FeedForwardLayer<TDevice, Relu>(layerChild, weightsSection,
-						   *precedingLayer, maxSeqLength);
+						   *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "paralayer")
     	return new ParaLayer<TDevice, Identity>(layerChild, weightsSection,
-						*precedingLayer, maxSeqLength);    
+						*precedingLayer, maxSeqLength, sharedWeights);    
     else if (layerType == "softmax")
     	return new SoftmaxLayer<TDevice, Identity>(layerChild, weightsSection,
-						   *precedingLayer, maxSeqLength);
+						   *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "lstm")
     	return new LstmLayer<TDevice>(layerChild, weightsSection,
-				      *precedingLayer, maxSeqLength, false);
+				      *precedingLayer, maxSeqLength, false, sharedWeights);
     else if (layerType == "blstm")
     	return new LstmLayer<TDevice>(layerChild, weightsSection,
-				      *precedingLayer, maxSeqLength, true);
+				      *precedingLayer, maxSeqLength, true, sharedWeights);
     else if (layerType == "rnn")
     	return new RnnLayer<TDevice>(layerChild, weightsSection,
-				     *precedingLayer, maxSeqLength, false);
+				     *precedingLayer, maxSeqLength, false, sharedWeights);
     else if (layerType == "brnn")
     	return new RnnLayer<TDevice>(layerChild, weightsSection,
-				     *precedingLayer, maxSeqLength, true);
+				     *precedingLayer, maxSeqLength, true, sharedWeights);
     else if (layerType == "feedback")
     	return new FeedBackLayer<TDevice>(layerChild, weightsSection,
-					  *precedingLayer, maxSeqLength);
+					  *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "batchnorm")
     	return new BatchNormLayer<TDevice>(layerChild, weightsSection,
-					   *precedingLayer, maxSeqLength);
+					   *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "cnn")
         return new CNNLayer<TDevice>(layerChild, weightsSection,
-				     *precedingLayer, maxSeqLength);    
+				     *precedingLayer, maxSeqLength, sharedWeights);    
     else if (layerType == "maxpooling")
         return new MaxPoolingLayer<TDevice>(layerChild, weightsSection,
-					    *precedingLayer, maxSeqLength);    
+					    *precedingLayer, maxSeqLength, sharedWeights);    
     else if (layerType == "middleoutput")
         return new MiddleOutputLayer<TDevice>(layerChild, *precedingLayer, maxSeqLength);    
     else if (layerType == "operator")
         return new OperationLayer<TDevice>(layerChild, weightsSection,
-					   *precedingLayer, maxSeqLength);    
+					   *precedingLayer, maxSeqLength, sharedWeights);    
     else if (layerType == "featmatch")
         return new FeatMatchLayer<TDevice>(layerChild, *precedingLayer, maxSeqLength);    
     else if (layerType == "vae")
         return new VaeMiddleLayer<TDevice>(layerChild, *precedingLayer, maxSeqLength);    
     else if (layerType == "wavnetc")
     	return new WavNetCore<TDevice>(layerChild, weightsSection,
-				       *precedingLayer, maxSeqLength);
+				       *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "externalloader")
     	return new ExternalLoader<TDevice>(layerChild, weightsSection,
-					   *precedingLayer, maxSeqLength);
+					   *precedingLayer, maxSeqLength, sharedWeights);
     else if (layerType == "vqlayer")
     	return new vqLayer<TDevice>(layerChild, weightsSection,
-				    *precedingLayer, maxSeqLength);
+				    *precedingLayer, maxSeqLength, sharedWeights);
     /*
     // not implemented yet
     else if (layerType == "lstmw")
@@ -188,7 +189,8 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createSkipAddLayer(
 					   const helpers::JsonValue &weightsSection,
 					   int                       parallelSequences, 
 					   int                       maxSeqLength,
-					   std::vector<layers::Layer<TDevice>*> &precedingLayers
+					   std::vector<layers::Layer<TDevice>*> &precedingLayers,
+					   typename TDevice::real_vector *sharedWeights
 					   )
 {
     using namespace layers;
@@ -198,10 +200,10 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createSkipAddLayer(
     }
     if (layerType == "skipadd" || layerType == "skipini"){
 	return new SkipAddLayer<TDevice>(layerChild, weightsSection,
-					 precedingLayers, maxSeqLength);
+					 precedingLayers, maxSeqLength, sharedWeights);
     }else{
 	return new SkipCatLayer<TDevice>(layerChild, weightsSection,
-					 precedingLayers, maxSeqLength);
+					 precedingLayers, maxSeqLength, sharedWeights);
     }
 }
 
@@ -212,7 +214,8 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createSkipParaLayer(
 					   const helpers::JsonValue &weightsSection,
 					   int                       parallelSequences, 
 					   int                       maxSeqLength,
-					   std::vector<layers::Layer<TDevice>*> &precedingLayers
+					   std::vector<layers::Layer<TDevice>*> &precedingLayers,
+					   typename TDevice::real_vector *sharedWeights
 					   )
 {
     using namespace layers;
@@ -225,16 +228,16 @@ layers::Layer<TDevice>* LayerFactory<TDevice>::createSkipParaLayer(
     }else{
 	if (layerType == "skippara_tanh"){
 	    return new SkipParaLayer<TDevice, Tanh>(layerChild, weightsSection,
-						    precedingLayers, maxSeqLength);
+						    precedingLayers, maxSeqLength, sharedWeights);
 	}else if(layerType == "skippara_logistic"){
 	    return new SkipParaLayer<TDevice, Logistic>(layerChild, weightsSection,
-							precedingLayers, maxSeqLength);
+							precedingLayers, maxSeqLength, sharedWeights);
 	}else if(layerType == "skippara_identity"){
 	    return new SkipParaLayer<TDevice, Identity>(layerChild, weightsSection,
-							precedingLayers, maxSeqLength);	    
+							precedingLayers, maxSeqLength, sharedWeights);	    
 	}else if(layerType == "skippara_relu"){
 	    return new SkipParaLayer<TDevice, Relu>(layerChild, weightsSection,
-						    precedingLayers, maxSeqLength);
+						    precedingLayers, maxSeqLength, sharedWeights);
 	}else{
 	    printf("Type of Skippara can only be: skippara_tanh, skippara_logistic,");
 	    printf("skippara_identity, skippara_relu\n");
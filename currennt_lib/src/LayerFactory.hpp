@@ -46,6 +46,8 @@ public:
      * @param parallelSequences The maximum number of sequences that shall be computed in parallel
      * @param maxSeqLength      The maximum length of a sequence
      * @param precedingLayer    The layer preceding this one
+     * @param sharedWeights     Weights of the layer in the master network, used instead
+     *                          of weightsSection by a trainable layer (inference replicas)
      * @return The constructed layer
      */
     static layers::Layer<TDevice>* createLayer(
@@ -54,7 +56,8 @@ public:
         const helpers::JsonValue &weightsSection,
         int                       parallelSequences, 
         int                       maxSeqLength,
-        layers::Layer<TDevice>   *precedingLayer = NULL
+        layers::Layer<TDevice>   *precedingLayer = NULL,
+        typename TDevice::real_vector *sharedWeights = NULL
         );
 
     static layers::Layer<TDevice>* createSkipAddLayer(
@@ -63,7 +66,8 @@ public:
 	    const helpers::JsonValue &weightsSection,
 	    int                       parallelSequences, 
 	    int                       maxSeqLength,
-	    std::vector<layers::Layer<TDevice>*> &precedingLayers
+	    std::vector<layers::Layer<TDevice>*> &precedingLayers,
+	    typename TDevice::real_vector *sharedWeights = NULL
         );
 
     static layers::Layer<TDevice>* createSkipParaLayer(
@@ -72,7 +76,8 @@ public:
 	    const helpers::JsonValue &weightsSection,
 	    int                       parallelSequences, 
 	    int                       maxSeqLength,
-	    std::vector<layers::Layer<TDevice>*> &precedingLayers
+	    std::vector<layers::Layer<TDevice>*> &precedingLayers,
+	    typename TDevice::real_vector *sharedWeights = NULL
         );
 
 };
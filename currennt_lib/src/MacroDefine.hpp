@@ -43,6 +43,11 @@
 
 #define OP_BLOWED_THRESHOLD 5 // tolerance of blowed network
 
+/***    For running mode (backpropagation through layers with 0 LR) ***/
+#define  NN_RUNNINGMODE_DEFAULT      0   // normal backpropagation
+#define  NN_RUNNINGMODE_SKIP_ZERO_LR 1   // stop at the first layer with 0 LR
+#define  NN_RUNNINGMODE_ERRORS_ONLY  2   // layers with 0 LR only propagate the errors
+
 /***    For printing information ***/
 #define  OP_VERBOSE_LEVEL_0 0            // print nothing additional to cerr
 #define  OP_VERBOSE_LEVEL_1 1            // print error per utterance to cerr
@@ -86,6 +91,19 @@
 #define NN_OPERATOR_LAYER_NOISE_DIMREPEAT  2
 #define NN_OPERATOR_LAYER_NOISE_NOREPEAT   0
 
+// Number of frames kept by the recurrent layers in the memory-save mode of generation
+// (the current and the previous time step)
+#define NN_RECURRENT_RING_BUFFER_LENGTH    2
+
+// vqLayer: maximum number of elements in the buffer of code-input products
+// (the nearest code is searched block by block over the frames)
+#define NN_VQLAYER_PRODUCT_BUFFER_SIZE     (4 * 1024 * 1024)
+// vqLayer: number of k-means iterations to build the coarse-to-fine search index
+#define NN_VQLAYER_COARSE_KMEANS_ITER      10
+
+// BatchNorm: number of frames in one block of the statistics and gradient reductions
+#define NN_BATCHNORM_BLOCK_FRAMES          32
+
 /*** For postoutput layers ***/
 #define NN_POSTOUTPUTLAYER_LAST         1  // the true postoutput layer
 #define NN_POSTOUTPUTLAYER_MIDDLEOUTPUT 2  // the middle postoutput for GAN
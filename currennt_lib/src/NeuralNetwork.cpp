@@ -29,10 +29,15 @@
 #include "layers/PostOutputLayer.hpp"
 #include "layers/FeedBackLayer.hpp"
 #include "layers/vqLayer.hpp"
+#include "layers/SkipAddLayer.hpp"
+#include "layers/MulticlassClassificationLayer.hpp"
 
 #include "helpers/JsonClasses.hpp"
 #include "MacroDefine.hpp"
 #include "helpers/misFuncs.hpp"
+#include "helpers/philoxRandom.cuh"
+#include "helpers/InferenceGraph.hpp"
+#include "helpers/Checkpoint.hpp"
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
@@ -429,6 +434,41 @@ namespace internal {
 	return (layerType !="skipini" && layerType!="skipadd" && layerType!="skipcat" &&
 		layerType !="operator");
     }
+
+    bool flagInferenceGraphOpt(){
+	// whether to optimize the network for generation
+	// layer indices are changed after optimization, thus it is not used when
+	// the output or the VAE code is taken from a specific layer
+	// Modify 20181018: nor when weights are read by layer from another network
+	const Configuration &config = Configuration::instance();
+	return (!config.trainingMode() && config.inferenceGraphOpt() > 0 &&
+		config.printWeightPath().empty() && config.outputFromWhichLayer() < 0 &&
+		config.vaeEncoderOutputLayer() < 0 && config.trainedParameterPath().empty());
+    }
+
+    int jsonIntMember(const rapidjson::Value &layer, const char *name, const int defVal){
+	return ((layer.HasMember(name) && layer[name].IsInt()) ? layer[name].GetInt() : defVal);
+    }
+    
+    bool stepInputShiftReady(const rapidjson::Value &layer, const rapidjson::Value &preLayer){
+	// whether the layer only reads the current frame of the preceding layer in the
+	// time step computation (thus the preceding layer can be reduced in memory)
+	if (!layer.IsObject() || !layer.HasMember("type") || !preLayer.IsObject() ||
+	    jsonIntMember(layer, "resolution", 1) != jsonIntMember(preLayer, "resolution", 1))
+	    return false;
+	
+	std::string layerType = layer["type"].GetString();
+	if (layerType.compare(0, 12, "feedforward_") == 0 || layerType == "lstm" ||
+	    layerType == "rnn" || layerType == "batchnorm" || layerType == "feedback" ||
+	    layerType == "skipini" || layerType == "skipadd" || layerType == "skipcat" ||
+	    layerType.compare(0, 9, "skippara_") == 0 || layerType == "wavnetc")
+	    return true;
+	if (layerType == "operator")
+	    return (jsonIntMember(layer, "lastShot", 0) == 0 &&
+		    jsonIntMember(layer, "changeResolution", 0) == 0 &&
+		    jsonIntMember(layer, "outputDuplicating", 0) <= 1);
+	return false;
+    }
 }
 
 /* ----- Definition for NeuralNetwork  ----- */
@@ -439,25 +479,40 @@ NeuralNetwork<TDevice>::NeuralNetwork(
  int parallelSequences, 
  int maxSeqLength,
  int inputSizeOverride,
- int outputSizeOverride
+ int outputSizeOverride,
+ NeuralNetwork<TDevice> *weightsSource
  )
 {
     try {
 	
 	/* ----- initialization ----- */
 	const Configuration &config = Configuration::instance();
+
+	// Add 20171101: fold batchnorm and linear layers for generation
+	// Modify 20181018: the layers are folded in a copy of the network document,
+	//  jsonDoc is left untouched
+	rapidjson::Document  foldedDoc;
+	rapidjson::Document *netDoc = &(*jsonDoc);
+	if (internal::flagInferenceGraphOpt()){
+	    helpers::inferenceGraph::copyDocument(*jsonDoc, &foldedDoc);
+	    int foldedNum = helpers::inferenceGraph::foldLayers(&foldedDoc);
+	    if (foldedNum > 0){
+		printf("\n%d layer(s) folded for generation\n", foldedNum);
+		netDoc = &foldedDoc;
+	    }
+	}
 	
         // check the layers and weight sections
-        if (!jsonDoc->HasMember("layers"))
+        if (!netDoc->HasMember("layers"))
             throw std::runtime_error("Missing section 'layers'");
-        rapidjson::Value &layersSection  = (*jsonDoc)["layers"];
+        rapidjson::Value &layersSection  = (*netDoc)["layers"];
         if (!layersSection.IsArray())
             throw std::runtime_error("Section 'layers' is not an array");
         helpers::JsonValue weightsSection;
-        if (jsonDoc->HasMember("weights")) {
-            if (!(*jsonDoc)["weights"].IsObject())
+        if (netDoc->HasMember("weights")) {
+            if (!(*netDoc)["weights"].IsObject())
                 throw std::runtime_error("Section 'weights' is not an object");
-            weightsSection = helpers::JsonValue(&(*jsonDoc)["weights"]);
+            weightsSection = helpers::JsonValue(&(*netDoc)["weights"]);
         }
 	
 	
@@ -471,10 +526,12 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 	m_vaeLayer              = -1;     // Idx of the VAE interface layer
 	int tmp_wavNetCore      = -1;     // Idx of the first waveNet core module (for waveNet)
 	bool flagSaveMemWavNet  = false;  // Flag to save the mem usage of wavenet in generation
+	bool flagSaveMemGen     = false;  // Flag to save the mem usage of other networks
 	int outputLayerIdx      = -1;     // Idx of the output layer (before postoutput)           
 	
 	m_trainingEpoch         = -1;     // initialize the training epoch counter
 	m_trainingFrac          = -1;     // initialize the training data counter
+	m_randomSub             = 0;
 	m_trainingState         = -1;     // initialize the training state of the network
 
 	/* ----- processing loop ----- */
@@ -516,6 +573,13 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 	}
 	outputLayerIdx = counter - 2; // an output before the postoutput layer
 
+	// Add 20180710: save the mem usage of other networks that are generated frame by frame
+	// (beam search and the output of VAE encoder use the whole sequences)
+	if (!config.trainingMode() && m_firstFeedBackLayer > 0 && !flagSaveMemWavNet &&
+	    config.scheduleSampOpt() != NN_FEEDBACK_BEAMSEARCH &&
+	    config.vaeEncoderOutputLayer() < 0)
+	    flagSaveMemGen = true;
+
 	// loop to build each layer
 	counter = 0;
         for (rapidjson::Value::ValueIterator layerChild = layersSection.Begin(); 
@@ -557,6 +621,18 @@ NeuralNetwork<TDevice>::NeuralNetwork(
             try {
 		
             	layers::Layer<TDevice> *layer;
+
+		// Add 20171101: a replica network uses the weights of weightsSource
+		// Modify 20181018: given to the layer through the factory
+		typename TDevice::real_vector *sharedWeights = NULL;
+		if (weightsSource != NULL){
+		    if (counter >= (int)weightsSource->m_layers.size())
+			throw std::runtime_error("Replica network differs from the source network");
+		    layers::TrainableLayer<TDevice> *srcLayer = 
+			dynamic_cast<layers::TrainableLayer<TDevice>*>(
+				weightsSource->m_layers[counter].get());
+		    sharedWeights = (srcLayer ? (&srcLayer->weights()) : NULL);
+		}
 		
 		/* Original code of CURRENNT
                 if (m_layers.empty())
@@ -652,17 +728,29 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 			layer = LayerFactory<TDevice>::createSkipAddLayer(
 				  layerType,     &*layerChild,
 				  weightsSection, parallelSequences, 
-				  maxSeqLength,   SkipLayers);
+				  maxSeqLength,   SkipLayers, sharedWeights);
 		    }
 		    else
 		    {
 			layer = LayerFactory<TDevice>::createSkipParaLayer(
 				  layerType,     &*layerChild,
 				  weightsSection, parallelSequences, 
-				  maxSeqLength,   SkipLayers);
+				  maxSeqLength,   SkipLayers, sharedWeights);
 		    }
 		    // add the skipadd layer to the buffer of the network
 		    m_skipAddLayers.push_back(layer);
+
+		    // Add 20171101: let the preceding layer do the addition in generation
+		    // (only if the output of the preceding layer is not used by other layers)
+		    if (layerType == "skipadd" && internal::flagInferenceGraphOpt() &&
+			m_layers.back()->getLayerFlag().empty() &&
+			!helpers::inferenceGraph::layerNameReferred(layersSection,
+								    m_layers.back()->name())){
+			layers::SkipAddLayer<TDevice>* skipAddLayer =
+			    dynamic_cast<layers::SkipAddLayer<TDevice>*>(layer);
+			if (skipAddLayer)
+			    skipAddLayer->fuseIntoPrecedingLayer();
+		    }
 		
 		}
 		else
@@ -672,7 +760,7 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 			       layerType,      &*layerChild,
 			       weightsSection, parallelSequences, 
 			       maxSeqLength, 
-			       m_layers.back().get());
+			       m_layers.back().get(), sharedWeights);
 		}
 		
 
@@ -687,7 +775,35 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 			}
 		    }
 		    
-		    // other optimization methods can be used for other types of network
+		    // for other networks with feedback, reduce the memory in generation only if
+		    // the next layer reads the current frame and no other layer refers to it
+		    if (flagSaveMemGen){
+			if (counter < outputLayerIdx && counter >= m_firstFeedBackLayer &&
+			    counter != Configuration::instance().outputFromWhichLayer() &&
+			    layer->getLayerFlag().empty() &&
+			    internal::stepInputShiftReady(layersSection[counter + 1],
+							  *layerChild) &&
+			    !helpers::inferenceGraph::layerNameReferred(layersSection,
+									layer->name()))
+			    layer->reduceOutputBuffer();
+		    }
+
+		    // release the MDN parameter buffer, and the output layer if the MDN
+		    // only reads the current frame of the output layer
+		    if ((flagSaveMemWavNet || flagSaveMemGen) && counter == outputLayerIdx + 1){
+			layers::MDNLayer<TDevice>* mdnLayer =
+			    dynamic_cast<layers::MDNLayer<TDevice>*>(layer);
+			if (mdnLayer){
+			    mdnLayer->reduceOutputBuffer();
+			    if (mdnLayer->flagStepInputShift() &&
+				outputLayerIdx > m_firstFeedBackLayer &&
+				outputLayerIdx != Configuration::instance().outputFromWhichLayer() &&
+				m_layers.back()->getLayerFlag().empty() &&
+				!helpers::inferenceGraph::layerNameReferred(
+					layersSection, m_layers.back()->name()))
+				m_layers.back()->reduceOutputBuffer();
+			}
+		    }
 		}
 
 		// save the layer
@@ -811,6 +927,20 @@ NeuralNetwork<TDevice>::NeuralNetwork(
 	    }
 	}
 
+	// Add 20181018: softmax and cross-entropy gradients in one pass, only if the
+	//  classification layer is the only consumer of the softmax output
+	{
+	    layers::MulticlassClassificationLayer<TDevice>* mcLayer =
+		dynamic_cast<layers::MulticlassClassificationLayer<TDevice>*>(
+			m_layers.back().get());
+	    layers::Layer<TDevice> *preLayer = m_layers[m_layers.size() - 2].get();
+	    if (mcLayer && feedBacklayerId.empty() && preLayer->getLayerFlag().empty() &&
+		std::find(m_skipAddLayers.begin(), m_skipAddLayers.end(), preLayer) ==
+		m_skipAddLayers.end() &&
+		!helpers::inferenceGraph::layerNameReferred(layersSection, preLayer->name()))
+		mcLayer->fuseSoftmaxGradient();
+	}
+
 	// Check the tim resolution
 	for (size_t i = 1; i < m_layers.size(); ++i){
 	    if (m_layers[i]->getResolution() != m_layers[i-1]->getResolution()){
@@ -917,6 +1047,7 @@ void NeuralNetwork<TDevice>::loadSequences(const data_sets::DataSetFraction &fra
     {
         layer->loadSequences(fraction, m_trainingState);
     }
+    m_randomSub++;
 }
 
 template <typename TDevice>
@@ -965,12 +1096,10 @@ void NeuralNetwork<TDevice>::computeForwardPass(const int curMaxSeqLength,
     }else {
 	
 	// prepare random numbers
-    	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed()+98); // any random number
-	}
-	boost::random::uniform_real_distribution<real_t> dist(0, 1);
+	// Modify 20181018: counter-based stream, indexed by the time step
+	helpers::philox::stream_t randStream = helpers::philox::makeStream(
+		config.randomSeed()+98, helpers::philox::streamId("NeuralNetwork"),
+		m_trainingEpoch, m_trainingFrac, m_randomSub);
 
 	// options for schedule sampling
 	int scheduleSampOpt = config.scheduleSampOpt();
@@ -1014,7 +1143,7 @@ void NeuralNetwork<TDevice>::computeForwardPass(const int curMaxSeqLength,
 		Cpu::real_vector randNum;
 		randNum.reserve(curMaxSeqLength);
 		for (size_t i = 0; i < curMaxSeqLength; ++i){
-		    if (dist(*gen) > threshold){
+		    if (helpers::philox::uniform(randStream, i) > threshold){
 			randNum.push_back(0);
 		    }else{
 			randNum.push_back(1);
@@ -1105,7 +1234,7 @@ void NeuralNetwork<TDevice>::computeForwardPass(const int curMaxSeqLength,
 		    }
 		    
 		    // 
-		    if (dist(*gen) > sampThreshold){
+		    if (helpers::philox::uniform(randStream, timeStep) > sampThreshold){
 			//printf("\n %d HIT", timeStep);
 			layers::MDNLayer<TDevice> *olm;
 			olm = outMDNLayer();
@@ -1146,13 +1275,10 @@ void NeuralNetwork<TDevice>::computeForwardPassGen(const int curMaxSeqLength,
     // feedback layer exists
     }else{
 
-	// Prepare the random seed
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed()+98); // any random number
-	}
-	boost::random::uniform_real_distribution<real_t> dist(0, 1);
+	// Prepare the random stream
+	helpers::philox::stream_t randStream = helpers::philox::makeStream(
+		config.randomSeed()+98, helpers::philox::streamId("NeuralNetwork"),
+		m_trainingEpoch, m_trainingFrac, m_randomSub);
 
 	
 	int scheduleSampOpt = config.scheduleSampOpt();
@@ -1261,7 +1387,7 @@ void NeuralNetwork<TDevice>::computeForwardPassGen(const int curMaxSeqLength,
 		if (olm != NULL) olm->getOutput(timeStep, generationOpt);
 		
 		// Feedback the data
-		if (dist(*gen) < sampThreshold){
+		if (helpers::philox::uniform(randStream, timeStep) < sampThreshold){
 		    this->postOutputLayer().retrieveFeedBackData(timeStep, 0);
 		}else{
 		    this->postOutputLayer().retrieveFeedBackData(timeStep, methodCode);
@@ -1411,16 +1537,71 @@ void NeuralNetwork<TDevice>::computeForwardPassGen(const int curMaxSeqLength,
 template <typename TDevice>
 void NeuralNetwork<TDevice>::computeBackwardPass()
 {
+    const int runningMode = Configuration::instance().runningMode();
+
+    // Add 20181018: for the errors-only mode, find the lowest layer to be trained.
+    //  No layer below it needs the errors. The trainable MDN layer counts as trained
+    int lowestTrained = 0;
+    if (runningMode == NN_RUNNINGMODE_ERRORS_ONLY && !m_layers[0]->inputWeUpdate()){
+	lowestTrained = (int)m_layers.size();
+	for (size_t i = 0; i < m_layers.size(); ++i){
+	    layers::TrainableLayer<TDevice> *trainableLayer = 
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(m_layers[i].get());
+	    layers::MDNLayer<TDevice> *mdnLayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(m_layers[i].get());
+	    if ((trainableLayer && !misFuncs::closeToZero(trainableLayer->learningRate())) ||
+		(mdnLayer && mdnLayer->flagTrainable())){
+		lowestTrained = (int)i;
+		break;
+	    }
+	}
+    }
+
+    // Add 20181018: in the discriminator phases of GAN, the middle output layer sends
+    //  zero errors to the generator, and the weight updates of the generator are zero.
+    //  Clean them instead of back-propagating through the generator, unless the
+    //  generator has its own error (MDN, VAE) or the word vectors are updated
+    int ganGeneratorEnd = -1;
+    if (flagNetworkForGAN() && m_vaeLayer <= 0 && !m_layers[0]->inputWeUpdate() &&
+	(m_trainingState == NN_STATE_GAN_DIS_NATDATA ||
+	 m_trainingState == NN_STATE_GAN_DIS_GENDATA)){
+	ganGeneratorEnd = m_middlePostOutputLayer;
+	for (int i = 0; i < m_middlePostOutputLayer; ++i)
+	    if (dynamic_cast<layers::PostOutputLayer<TDevice>*>(m_layers[i].get()))
+		ganGeneratorEnd = -1;
+    }
+    
+    int layerIdx = (int)m_layers.size();
     BOOST_REVERSE_FOREACH (boost::shared_ptr<layers::Layer<TDevice> > &layer, m_layers) {
 
+	layerIdx--;
+
+	// Add 20181018: generator part in the discriminator phases of GAN
+	if (layerIdx < ganGeneratorEnd){
+	    for (int i = 0; i <= layerIdx; ++i)
+		m_layers[i]->cleanGradidents();
+	    break;
+	}
+	
 	// runningMode
-	if (Configuration::instance().runningMode() > 0){
+	if (runningMode > 0){
 
-	    // Stop the backpropagation when the layer's learning rate is specified as 0
 	    layers::TrainableLayer<TDevice> *trainableLayer = 
 		dynamic_cast<layers::TrainableLayer<TDevice>*>(layer.get());
-	    if (trainableLayer && misFuncs::closeToZero(trainableLayer->learningRate()))
+	    
+	    if (runningMode == NN_RUNNINGMODE_ERRORS_ONLY){
+		// Add 20181018: the layer with 0 LR only propagates the errors
+		if (layerIdx < lowestTrained)
+		    break;
+		if (trainableLayer)
+		    trainableLayer->setErrorsOnlyBackward(
+			misFuncs::closeToZero(trainableLayer->learningRate()));
+		
+	    }else if (trainableLayer &&
+		      misFuncs::closeToZero(trainableLayer->learningRate())){
+		// Stop the backpropagation when the layer's learning rate is specified as 0
 		break;
+	    }
 
 	    // Or, stop if it is a mdn output layer in acoustic model
 	    // Note, this is specific for GAN
@@ -1462,7 +1643,8 @@ void NeuralNetwork<TDevice>::cleanGradientsForDiscriminator()
 
 
 template <typename TDevice>
-real_t NeuralNetwork<TDevice>::calculateError(const bool flagGenerateMainError) const
+real_t NeuralNetwork<TDevice>::calculateError(const bool flagGenerateMainError,
+					      const bool flagGradients) const
 {
     if (flagNetworkForGAN()){
 	if (flagGenerateMainError)
@@ -1472,7 +1654,10 @@ real_t NeuralNetwork<TDevice>::calculateError(const bool flagGenerateMainError)
 	    return static_cast<layers::PostOutputLayer<TDevice>&>(*m_layers.back()).calculateError();
 	
     }else if (m_vaeLayer > 0){
-	if (flagGenerateMainError)
+	if (flagGenerateMainError && flagGradients)
+	    return static_cast<layers::PostOutputLayer<TDevice>&>(
+			*m_layers.back()).calculateErrorAndGradients();
+	else if (flagGenerateMainError)
 	    return static_cast<layers::PostOutputLayer<TDevice>&>(*m_layers.back()).calculateError();
 	else if (m_layers[m_vaeLayer]->type() == "vae")
 	    return static_cast<layers::PostOutputLayer<TDevice>&>(*m_layers[m_vaeLayer]).calculateError();
@@ -1481,7 +1666,10 @@ real_t NeuralNetwork<TDevice>::calculateError(const bool flagGenerateMainError)
 	else
 	    return 0;
     }else{
-	if(flagGenerateMainError)
+	if (flagGenerateMainError && flagGradients)
+	    return static_cast<layers::PostOutputLayer<TDevice>&>(
+			*m_layers.back()).calculateErrorAndGradients();
+	else if(flagGenerateMainError)
 	    return static_cast<layers::PostOutputLayer<TDevice>&>(*m_layers.back()).calculateError();
 	else
 	    return 0;
@@ -1541,6 +1729,54 @@ void NeuralNetwork<TDevice>::exportWeights(const helpers::JsonDocument& jsonDoc)
     jsonDoc->AddMember("weights", weightsObject, jsonDoc->GetAllocator());
 }
 
+template <typename TDevice>
+void NeuralNetwork<TDevice>::exportWeights(helpers::checkpoint::Checkpoint *ckpt) const
+{
+    rapidjson::Document &jsonDoc = ckpt->header();
+    rapidjson::Value weightsObject(rapidjson::kObjectType);
+
+    BOOST_FOREACH (const boost::shared_ptr<layers::Layer<TDevice> > &layer, m_layers) {
+    	layers::TrainableLayer<TDevice> *trainableLayer = 
+	    dynamic_cast<layers::TrainableLayer<TDevice>*>(layer.get());
+        if (trainableLayer){
+	    if (trainableLayer->weights().empty())
+		continue;
+	    
+	    // one blob for the layer, the three arrays refer to the parts of it
+	    int inputNum, biasNum, internalNum;
+	    trainableLayer->weightArraySizes(&inputNum, &biasNum, &internalNum);
+	    size_t weightNum = inputNum + biasNum + internalNum;
+	    if (weightNum > trainableLayer->weights().size())
+		throw std::runtime_error("Invalid weight size of " + trainableLayer->name());
+
+	    uint64_t offset;
+	    real_t  *blob = ckpt->addBlob(weightNum, &offset);
+	    thrust::copy(trainableLayer->weights().begin(),
+			 trainableLayer->weights().begin() + weightNum, blob);
+	    
+	    rapidjson::Value inputRef, biasRef, internalRef;
+	    ckpt->blobReference(offset, inputNum, &inputRef);
+	    ckpt->blobReference(offset + inputNum * sizeof(real_t), biasNum, &biasRef);
+	    ckpt->blobReference(offset + (inputNum + biasNum) * sizeof(real_t), internalNum,
+				&internalRef);
+	    
+	    rapidjson::Value weightsSection(rapidjson::kObjectType);
+	    weightsSection.AddMember("input",    inputRef,    jsonDoc.GetAllocator());
+	    weightsSection.AddMember("bias",     biasRef,     jsonDoc.GetAllocator());
+	    weightsSection.AddMember("internal", internalRef, jsonDoc.GetAllocator());
+	    weightsObject.AddMember(trainableLayer->name().c_str(), weightsSection,
+				    jsonDoc.GetAllocator());
+	}else{
+	    // the configuration and weights of the MDN layer are small, keep them in JSON
+	    layers::MDNLayer<TDevice> *mdnlayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(layer.get());
+	    if (mdnlayer)
+		mdnlayer->exportConfig(&weightsObject, &jsonDoc.GetAllocator());
+	}
+    }
+    jsonDoc.AddMember("weights", weightsObject, jsonDoc.GetAllocator());
+}
+
 template <typename TDevice>
 std::vector<std::vector<std::vector<real_t> > > NeuralNetwork<TDevice>::getOutputs(
     const int layerID, const bool getGateOutput, const real_t mdnoutput)
@@ -1698,6 +1934,18 @@ bool NeuralNetwork<TDevice>::initWeUpdate(const std::string weBankPath, const un
     }
 }
 
+template <typename TDevice>
+bool NeuralNetwork<TDevice>::initWeUpdate(NeuralNetwork<TDevice> &sourceNN)
+{
+    layers::InputLayer<TDevice>* inputLayer = 
+	dynamic_cast<layers::InputLayer<TDevice>*>(m_layers.front().get());
+    layers::InputLayer<TDevice>* sourceLayer = 
+	dynamic_cast<layers::InputLayer<TDevice>*>(sourceNN.layers().front().get());
+    if (!inputLayer || !sourceLayer)
+	throw std::runtime_error("The first layer is not an input layer");
+    return inputLayer->shareWeBank(*sourceLayer);
+}
+
 template <typename TDevice>
 bool NeuralNetwork<TDevice>::initWeNoiseOpt(const int weNoiseStartDim, const int weNoiseEndDim,
 					    const real_t weNoiseDev)
@@ -1851,6 +2099,7 @@ void NeuralNetwork<TDevice>::notifyCurrentFrac(const int fracNum)
 	layer->setCurrTrainingFrac(fracNum);
     }
     m_trainingFrac = fracNum;
+    m_randomSub    = 0;
 }
 
 template <typename TDevice>
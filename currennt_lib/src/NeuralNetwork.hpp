@@ -39,6 +39,7 @@
 #include <vector>
 #include <memory>
 
+namespace helpers { namespace checkpoint { class Checkpoint; } }
 
 /*****************************************************************************************************************//**
  * Represents the neural network
@@ -60,6 +61,7 @@ private:
     int m_vaeLayer;
     int m_trainingEpoch;
     int m_trainingFrac;
+    unsigned int m_randomSub;                                  // fractions loaded in this frac
     int m_trainingState;
     
 public:
@@ -69,9 +71,12 @@ public:
      * @param jsonDoc           The JSON document containing the network configuration
      * @param parallelSequences The maximum number of sequences that shall be computed in parallel
      * @param maxSeqLength      The maximum length of a sequence
+     * @param weightsSource     If given, the trainable layers share (read-only) the weights
+     *                          of this network instead of allocating their own copy
      */
     NeuralNetwork(const helpers::JsonDocument &jsonDoc, int parallelSequences, 
-		  int maxSeqLength, int inputSizeOverride=-1, int outputSizeOverride=-1);
+		  int maxSeqLength, int inputSizeOverride=-1, int outputSizeOverride=-1,
+		  NeuralNetwork<TDevice> *weightsSource=NULL);
 
     /**
      * Destructs the neural network
@@ -143,9 +148,13 @@ public:
      *
      * The forward pass must be computed first!
      *
+     * @param flagGenerateMainError main error (true) or the secondary error (false)
+     * @param flagGradients         Add 20181018: also compute the gradients of the main
+     *                              error, which are reused by computeBackwardPass()
      * @return The computed error
      */
-    real_t calculateError(const bool flagGenerateMainError) const;
+    real_t calculateError(const bool flagGenerateMainError,
+			  const bool flagGradients = false) const;
 
     /**
      * Stores the description of the layers in a JSON tree
@@ -161,6 +170,14 @@ public:
      */
     void exportWeights(const helpers::JsonDocument& jsonDoc) const;
 
+    /**
+     * Add 20181018: stores the weights in the binary checkpoint
+     *  The weights section of the header refers to blobs copied from the layers
+     *
+     * @param ckpt The staging buffer of the checkpoint
+     */
+    void exportWeights(helpers::checkpoint::Checkpoint *ckpt) const;
+
     /**
      * Returns the outputs of the processed fraction
      *
@@ -183,6 +200,9 @@ public:
     // repare for we updateing
     bool initWeUpdate(const std::string weBankPath, const unsigned weDim, 
 		      const unsigned weIDDim, const unsigned maxLength);
+
+    // Add 20181018: use the WE bank of sourceNN (replicas for asynchronous training)
+    bool initWeUpdate(NeuralNetwork<TDevice> &sourceNN);
     
     bool initWeNoiseOpt(const int weNoiseStartDim, const int weNoiseEndDim,
 			const real_t weNoiseDev);
@@ -55,6 +55,7 @@ struct Cpu
     typedef thrust::host_vector<int>    int_vector;
     typedef thrust::host_vector<bool>   bool_vector;
     typedef thrust::host_vector<char>   pattype_vector;
+    typedef thrust::host_vector<real_t*> real_ptr_vector;
 };
 
 
@@ -69,6 +70,7 @@ struct Gpu
     typedef thrust::device_vector<int>    int_vector;
     typedef thrust::device_vector<bool>   bool_vector;
     typedef thrust::device_vector<char>   pattype_vector;
+    typedef thrust::device_vector<real_t*> real_ptr_vector;
 };
 
 
@@ -37,11 +37,13 @@
 #include "../netcdf/netcdf.h"
 
 #include "../helpers/misFuncs.hpp"
+#include "../helpers/philoxRandom.cuh"
 
 #include <stdexcept>
 #include <algorithm>
 #include <limits>
 #include <cassert>
+#include <sstream>
 
 #define DATASET_EXINPUT_TYPE_0 0 // nothing
 #define DATASET_EXINPUT_TYPE_1 1 // input is the index in a increasing order ([1 1 1 2..2 3..3])
@@ -364,17 +366,22 @@ namespace internal {
         return (a.length < b.length);
     }
 
+    // Modify 20181018: the generator is accessible to save it in the checkpoint
+    boost::mt19937& shuffleGenerator()
+    {
+	static boost::mt19937 *gen = NULL;
+	if (!gen) {
+	    gen = new boost::mt19937;
+	    gen->seed(Configuration::instance().randomSeed());
+	}
+	return *gen;
+    }
+    
     struct rand_gen {
         unsigned operator()(unsigned i)
         {
-            static boost::mt19937 *gen = NULL;
-            if (!gen) {
-                gen = new boost::mt19937;
-                gen->seed(Configuration::instance().randomSeed());
-            }
-
             boost::uniform_int<> dist(0, i-1);
-            return dist(*gen);
+            return dist(shuffleGenerator());
         }
     };
 
@@ -444,21 +451,20 @@ namespace data_sets {
         }
     }
 
-    void DataSet::_addNoise(Cpu::real_vector *v)
+    void DataSet::_addNoise(Cpu::real_vector *v, const sequence_t &seq)
     {
         if (!m_noiseDeviation)
             return;
 
-        static boost::mt19937 *gen = NULL;
-        if (!gen) {
-            gen = new boost::mt19937;
-            gen->seed(Configuration::instance().randomSeed());
-        }
-
-        boost::normal_distribution<real_t> dist((real_t)0, m_noiseDeviation);
+	// Modify 20181018: counter-based noise keyed by (seed, sequence, pass, element).
+	// The noise of a sequence does not depend on the shuffling or loading order
+	helpers::philox::stream_t stream = helpers::philox::makeStream(
+		Configuration::instance().randomSeed(),
+		helpers::philox::streamId(std::string("DataSet") + seq.seqTag),
+		m_noisePass, seq.originalSeqIdx, 0);
 
         for (size_t i = 0; i < v->size(); ++i)
-            (*v)[i] += dist(*gen);
+            (*v)[i] += helpers::philox::normal(stream, i, (real_t)0, m_noiseDeviation);
     }
 
     Cpu::real_vector DataSet::_loadInputsFromCache(const sequence_t &seq)
@@ -708,7 +714,7 @@ namespace data_sets {
 
             // load inputs data
             Cpu::real_vector inputs = _loadInputsFromCache(seq);
-            _addNoise(&inputs);
+            _addNoise(&inputs, seq);
 	    //int tmpInputPatternSize = (m_exInputFlag)?(m_exInputDim[0]):(m_inputPatternSize);
             for (int timestep = 0; timestep < seq.length; ++timestep) {
                 int srcStart = m_inputPatternSize * timestep;
@@ -884,13 +890,20 @@ namespace data_sets {
         if (m_fractionShuffling)
             _shuffleFractions();
 
-        return _makeFractionTask(0);
+	m_noisePass++;
+	
+	// no fraction for this shard
+	if (m_shardIdx * m_parallelSequences >= (int)m_sequences.size())
+	    return boost::shared_ptr<DataSetFraction>();
+	
+        return _makeFractionTask(m_shardIdx * m_parallelSequences);
     }
 
     DataSet::DataSet()
         : m_fractionShuffling(false)
         , m_sequenceShuffling(false)
         , m_noiseDeviation   (0)
+        , m_noisePass        (0)
         , m_parallelSequences(0)
         , m_totalSequences   (0)
         , m_totalTimesteps   (0)
@@ -899,6 +912,8 @@ namespace data_sets {
         , m_inputPatternSize (0)
         , m_outputPatternSize(0)
         , m_curFirstSeqIdx   (-1)
+	, m_shardIdx         (0)
+	, m_shardNum         (1)
 	, m_exInputFlag      (false)
 	, m_exOutputFlag     (false)
 	, m_auxDirPath       ("")
@@ -914,11 +929,14 @@ namespace data_sets {
         : m_fractionShuffling(fracShuf)
         , m_sequenceShuffling(seqShuf)
         , m_noiseDeviation   (noiseDev)
+        , m_noisePass        (0)
         , m_parallelSequences(parSeq)
         , m_totalTimesteps   (0)
         , m_minSeqLength     (std::numeric_limits<int>::max())
         , m_maxSeqLength     (std::numeric_limits<int>::min())
         , m_curFirstSeqIdx   (-1)
+	, m_shardIdx         (0)
+	, m_shardNum         (1)
     {
         int ret;
         int ncid;
@@ -1380,6 +1398,8 @@ namespace data_sets {
         // sort sequences by length
         if (Configuration::instance().trainingMode())
             std::sort(m_sequences.begin(), m_sequences.end(), internal::comp_seqs);
+	for (size_t i = 0; i < m_sequences.size(); ++i)
+	    m_sequences[i].loadIdx = i;
     }
 
     DataSet::~DataSet()
@@ -1414,7 +1434,7 @@ namespace data_sets {
             m_threadData->taskFn = boost::bind(&DataSet::_makeFirstFractionTask, this);
             m_threadData->finished = false;
             m_threadData->cv.notify_one();
-            m_curFirstSeqIdx = 0;
+            m_curFirstSeqIdx = m_shardIdx * m_parallelSequences;
         }
 
         // wait for the thread to finish
@@ -1426,7 +1446,7 @@ namespace data_sets {
         boost::shared_ptr<DataSetFraction> frac;
         if (m_curFirstSeqIdx < (int)m_sequences.size()) {
             frac = m_threadData->frac;
-            m_curFirstSeqIdx += m_parallelSequences;
+            m_curFirstSeqIdx += m_parallelSequences * m_shardNum;
 
             // start new task
             if (m_curFirstSeqIdx < (int)m_sequences.size())
@@ -1440,12 +1460,94 @@ namespace data_sets {
             m_threadData->cv.notify_one();
         }
         else  {
-            m_curFirstSeqIdx = 0;
+            m_curFirstSeqIdx = m_shardIdx * m_parallelSequences;
         }
 
         return frac;
     }
 
+    void DataSet::setShard(const int shardIdx, const int shardNum)
+    {
+	if (shardNum < 1 || shardIdx < 0 || shardIdx >= shardNum)
+	    throw std::runtime_error("Invalid shard of the data set");
+	if (m_curFirstSeqIdx != -1)
+	    throw std::runtime_error("The data set can't be sharded after loading fractions");
+	m_shardIdx = shardIdx;
+	m_shardNum = shardNum;
+    }
+
+    void DataSet::exportLoaderState(loader_state_t *state) const
+    {
+	// wait for the prefetching thread (the first fraction of a pass shuffles the data)
+	if (m_curFirstSeqIdx != -1) {
+            boost::unique_lock<boost::mutex> lock(m_threadData->mutex);
+            while (!m_threadData->finished)
+                m_threadData->cv.wait(lock);
+	}
+	
+	state->noisePass = m_noisePass;
+	state->fracPos   = (m_curFirstSeqIdx == -1 ? -1 :
+			    (m_curFirstSeqIdx - m_shardIdx * m_parallelSequences) /
+			    (m_parallelSequences * m_shardNum));
+
+	std::ostringstream os;
+	os << internal::shuffleGenerator();
+	state->shuffleRng = os.str();
+
+	state->sequenceOrder.resize(m_sequences.size());
+	for (size_t i = 0; i < m_sequences.size(); ++i)
+	    state->sequenceOrder[i] = m_sequences[i].loadIdx;
+    }
+
+    void DataSet::importLoaderState(const loader_state_t &state)
+    {
+	if (m_curFirstSeqIdx != -1)
+	    throw std::runtime_error("The data loader can't be restored after loading fractions");
+	if (state.sequenceOrder.size() != m_sequences.size())
+	    throw std::runtime_error("The saved data loader does not match the data set");
+
+	// m_sequences is still in the loading order
+	std::vector<sequence_t> sequences;
+	std::vector<bool>       restored(m_sequences.size(), false);
+	sequences.reserve(m_sequences.size());
+	for (size_t i = 0; i < state.sequenceOrder.size(); ++i) {
+	    int idx = state.sequenceOrder[i];
+	    if (idx < 0 || idx >= (int)m_sequences.size() || restored[idx])
+		throw std::runtime_error("The saved data loader does not match the data set");
+	    restored[idx] = true;
+	    sequences.push_back(m_sequences[idx]);
+	}
+	m_sequences.swap(sequences);
+	m_noisePass = state.noisePass;
+
+	std::istringstream is(state.shuffleRng);
+	is >> internal::shuffleGenerator();
+	if (is.fail())
+	    throw std::runtime_error("Invalid state of the shuffling generator");
+
+	if (state.fracPos < 0)
+	    return;
+	if (!m_threadData)
+	    throw std::runtime_error("The data loader can't be restored on an empty data set");
+
+	// prefetch the fraction at the saved position. If all the fractions of the pass
+	// have been taken, the sequences are already in the order of the next pass
+	m_curFirstSeqIdx = (m_shardIdx + state.fracPos * m_shardNum) * m_parallelSequences;
+	int firstSeqIdx  = (m_curFirstSeqIdx < (int)m_sequences.size() ?
+			    m_curFirstSeqIdx : m_shardIdx * m_parallelSequences);
+	
+	boost::unique_lock<boost::mutex> lock(m_threadData->mutex);
+	if (firstSeqIdx < (int)m_sequences.size()) {
+	    m_threadData->taskFn   = boost::bind(&DataSet::_makeFractionTask, this, firstSeqIdx);
+	    m_threadData->finished = false;
+	    m_threadData->cv.notify_one();
+	}else{
+	    // no fraction for this shard
+	    m_threadData->frac.reset();
+	    m_threadData->finished = true;
+	}
+    }
+
     int DataSet::totalSequences() const
     {
         return m_totalSequences;
@@ -47,8 +47,20 @@ namespace data_sets {
     class DataSet : boost::noncopyable
     {
     public:
+	/**
+	 * Add 20181018: position of the data loader (saved in the checkpoint)
+	 */
+	struct loader_state_t {
+	    int              noisePass;     // number of passes over the data
+	    int              fracPos;       // fractions taken from this shard in the current
+	                                    // pass (-1: no fraction has been loaded)
+	    std::string      shuffleRng;    // state of the shuffling generator
+	    std::vector<int> sequenceOrder; // loadIdx of the (shuffled) sequences
+	};
+	
         struct sequence_t {
             int         originalSeqIdx;
+            int         loadIdx;          // Add 20181018: position after loading (checkpoint)
             int         length;
             std::string seqTag;
 
@@ -86,7 +98,7 @@ namespace data_sets {
         void _nextFracThreadFn();
         void _shuffleSequences();
         void _shuffleFractions();
-        void _addNoise(Cpu::real_vector *v);
+        void _addNoise(Cpu::real_vector *v, const sequence_t &seq);
         Cpu::real_vector    _loadInputsFromCache(const sequence_t &seq);
         Cpu::real_vector    _loadOutputsFromCache(const sequence_t &seq);
 	Cpu::real_vector    _loadExInputsFromCache(const sequence_t &seq);
@@ -108,6 +120,7 @@ namespace data_sets {
         bool   m_sequenceShuffling;
         bool   m_isClassificationData;
         real_t m_noiseDeviation;
+        int    m_noisePass;         // Add 20181018: number of passes over the data (noise stream)
         int    m_parallelSequences;
         int    m_totalSequences;
         unsigned long int    m_totalTimesteps;
@@ -126,6 +139,10 @@ namespace data_sets {
 
         boost::scoped_ptr<thread_data_t> m_threadData; // just because nvcc hates boost headers
         int    m_curFirstSeqIdx;
+
+	// Add 20181018: sharding for distributed training
+	int    m_shardIdx;                 // this process takes the fractions n * m_shardNum + 
+	int    m_shardNum;                 //  m_shardIdx of the (shuffled) data set
 	
 	// Add 0620: Wang support to the txt input data
 	// (Support for the txt data should be merged with the auxillary data)
@@ -221,6 +238,24 @@ namespace data_sets {
          */
         boost::shared_ptr<DataSetFraction> getNextFraction();
 
+	/**
+	 * Add 20181018: only use one shard of the data set (distributed training)
+	 * The fractions are dealt to the shards in turn after shuffling. 
+	 * totalSequences() and totalTimesteps() still count the whole data set
+	 *
+	 * @param shardIdx  index of the shard
+	 * @param shardNum  number of shards
+	 */
+	void setShard(const int shardIdx, const int shardNum);
+
+	/**
+	 * Add 20181018: save and restore the position of the data loader
+	 *  importLoaderState must be called before any fraction is loaded. The next
+	 *  getNextFraction() continues from the saved position with the same order
+	 */
+	void exportLoaderState(loader_state_t *state) const;
+	void importLoaderState(const loader_state_t &state);
+
         /**
          * Returns the local file name used to cache the data
          *
@@ -0,0 +1,454 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "AllReduce.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace {
+
+    namespace bip = boost::interprocess;
+
+    const size_t SHM_SLOT_SIZE   = 1 << 20;   // elements of each process in one round
+    const int    CONNECT_RETRY   = 600;       // wait for the other processes for 60s
+    const int    CONNECT_WAIT_MS = 100;
+    const int    JOIN_RETRY      = 20;        // wait for rank 0 to accept the join for 2s
+
+    void waitMs(const int ms)
+    {
+	boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+    }
+    
+    // barrier of the processes, placed in the shared memory
+    struct shm_barrier_t
+    {
+	bip::interprocess_mutex     mutex;
+	bip::interprocess_condition cond;
+	int                         count;      // number of processes
+	int                         waiting;    // number of processes waiting
+	unsigned int                generation; // number of times the barrier is passed
+
+	shm_barrier_t(const int c) : count(c), waiting(0), generation(0) {}
+
+	void wait()
+	{
+	    bip::scoped_lock<bip::interprocess_mutex> lock(mutex);
+	    unsigned int gen = generation;
+	    if (++waiting == count){
+		waiting = 0;
+		generation++;
+		cond.notify_all();
+	    }else{
+		while (gen == generation)
+		    cond.wait(lock);
+	    }
+	}
+    };
+    
+    // handshake of the shared memory job
+    //  rank 0 writes a nonce of this job. Ranks > 0 copy it into joined[rank], and
+    //  rank 0 sets started to the nonce when all of them have joined. A segment left by
+    //  a crashed job never starts, or has already started, and is not used
+    struct shm_join_t
+    {
+	bip::interprocess_mutex     mutex;
+	uint64_t                    nonce;
+	uint64_t                    started;
+
+	shm_join_t(const uint64_t n) : nonce(n), started(0) {}
+    };
+
+    uint64_t jobNonce()
+    {
+	boost::posix_time::ptime now   = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	uint64_t nonce = (uint64_t)(now - epoch).total_microseconds();
+	int      local = 0;
+	nonce = (nonce * 6364136223846793005ULL) ^ (uint64_t)(size_t)&local;
+	return (nonce == 0) ? 1 : nonce;
+    }
+    
+    class transport_t
+    {
+    public:
+	virtual ~transport_t() {}
+	virtual void sum(real_t *data, const size_t num) = 0;
+    };
+
+    /* 
+     * Shared memory transport
+     *  each process copies its data into its own slot. Reduce-scatter: process r sums
+     *  its 1/N of the slots in the order of rank and writes the result into slot 0.
+     *  Allgather: every process copies slot 0
+     */
+    class shmTransport : public transport_t
+    {
+    private:
+	bip::managed_shared_memory m_segment;
+	shm_barrier_t             *m_barrier;
+	uint64_t                  *m_sizes;    // number of elements of each process
+	shm_join_t                *m_join;
+	uint64_t                  *m_joined;   // nonce seen by each process
+	real_t                    *m_slots;
+	int                        m_rank;
+	int                        m_size;
+
+    public:
+	shmTransport(const int rank, const int size, const std::string &name)
+	    : m_barrier(NULL), m_sizes(NULL), m_join(NULL), m_joined(NULL), m_slots(NULL),
+	      m_rank(rank), m_size(size)
+	{
+	    size_t segSize = (sizeof(real_t) * SHM_SLOT_SIZE + 2 * sizeof(uint64_t)) * size +
+		65536;
+	    
+	    if (rank == 0){
+		// remove the segment left by a crashed job
+		bip::shared_memory_object::remove(name.c_str());
+		bip::managed_shared_memory seg(bip::create_only, name.c_str(), segSize);
+		m_segment.swap(seg);
+		m_barrier = m_segment.construct<shm_barrier_t>("barrier")(size);
+		m_sizes   = m_segment.construct<uint64_t>("sizes")[size](0);
+		m_slots   = m_segment.construct<real_t>("slots")[SHM_SLOT_SIZE * size](0.0);
+		m_join    = m_segment.construct<shm_join_t>("join")(jobNonce());
+		m_joined  = m_segment.construct<uint64_t>("joined")[size](0);
+		m_segment.construct<int>("ready")(1);
+
+		// wait for the other processes to join this job
+		for (int i = 0; ; i++){
+		    {
+			bip::scoped_lock<bip::interprocess_mutex> lock(m_join->mutex);
+			int r = 1;
+			while (r < size && m_joined[r] == m_join->nonce)
+			    r++;
+			if (r == size){
+			    m_join->started = m_join->nonce;
+			    break;
+			}
+		    }
+		    if (i >= CONNECT_RETRY)
+			throw std::runtime_error(std::string("Processes did not join ") + name);
+		    waitMs(CONNECT_WAIT_MS);
+		}
+		
+	    }else{
+		// wait for rank 0 to create the segment and accept this process
+		for (int i = 0; ; i++){
+		    try{
+			bip::managed_shared_memory seg(bip::open_only, name.c_str());
+			if (seg.find<int>("ready").first != NULL && _join(seg, rank, size)){
+			    m_segment.swap(seg);
+			    break;
+			}
+		    }catch (const bip::interprocess_exception &e){
+			// not created yet
+		    }
+		    if (i >= CONNECT_RETRY)
+			throw std::runtime_error(std::string("Cannot open shared memory ") + name);
+		    waitMs(CONNECT_WAIT_MS);
+		}
+		m_barrier = m_segment.find<shm_barrier_t>("barrier").first;
+		std::pair<uint64_t*, size_t> sizes = m_segment.find<uint64_t>("sizes");
+		std::pair<real_t*,   size_t> slots = m_segment.find<real_t>("slots");
+		if (m_barrier == NULL || sizes.second != (size_t)size ||
+		    slots.second != SHM_SLOT_SIZE * size)
+		    throw std::runtime_error(std::string("Shared memory ") + name +
+					     " does not match the job");
+		m_sizes = sizes.first;
+		m_slots = slots.first;
+	    }
+	    
+	    // all the processes are attached, the name is no longer needed
+	    m_barrier->wait();
+	    if (rank == 0)
+		bip::shared_memory_object::remove(name.c_str());
+	}
+
+	// join the job of seg. False if seg is left by another job
+	static bool _join(bip::managed_shared_memory &seg, const int rank, const int size)
+	{
+	    shm_join_t *join = seg.find<shm_join_t>("join").first;
+	    std::pair<uint64_t*, size_t> joined = seg.find<uint64_t>("joined");
+	    if (join == NULL || joined.second != (size_t)size)
+		return false;
+	    
+	    uint64_t nonce = 0;
+	    {
+		bip::scoped_lock<bip::interprocess_mutex> lock(join->mutex);
+		if (join->started != 0)
+		    return false;   // started without this process
+		nonce = join->nonce;
+		joined.first[rank] = nonce;
+	    }
+	    for (int i = 0; i < JOIN_RETRY; i++){
+		{
+		    bip::scoped_lock<bip::interprocess_mutex> lock(join->mutex);
+		    if (join->started == nonce)
+			return true;
+		}
+		waitMs(CONNECT_WAIT_MS);
+	    }
+	    return false;           // rank 0 of this segment is gone
+	}
+
+	virtual void sum(real_t *data, const size_t num)
+	{
+	    // check the size
+	    m_sizes[m_rank] = num;
+	    m_barrier->wait();
+	    for (int r = 0; r < m_size; r++)
+		if (m_sizes[r] != num)
+		    throw std::runtime_error("Different vector sizes in the distributed sum");
+	    m_barrier->wait();
+	    
+	    for (size_t start = 0; start < num; start += SHM_SLOT_SIZE){
+		size_t len = std::min(SHM_SLOT_SIZE, num - start);
+		std::memcpy(m_slots + m_rank * SHM_SLOT_SIZE, data + start, len * sizeof(real_t));
+		m_barrier->wait();
+
+		// reduce-scatter: this process owns [chunkS, chunkE) of the slots
+		size_t chunkS = len * m_rank / m_size;
+		size_t chunkE = len * (m_rank + 1) / m_size;
+		for (int r = 1; r < m_size; r++){
+		    const real_t *slot = m_slots + r * SHM_SLOT_SIZE;
+		    for (size_t i = chunkS; i < chunkE; i++)
+			m_slots[i] += slot[i];
+		}
+		m_barrier->wait();
+
+		// allgather
+		std::memcpy(data + start, m_slots, len * sizeof(real_t));
+		// the slots can be overwritten after all the processes have read them
+		m_barrier->wait();
+	    }
+	}
+    };
+
+    /*
+     * Socket transport (UNIX domain or TCP)
+     *  rank 0 receives the data of the other processes in the order of rank,
+     *  sums them and sends the result back
+     */
+    template <typename TProtocol>
+    class socketTransport : public transport_t
+    {
+    private:
+	typedef typename TProtocol::socket   socket_t;
+	typedef typename TProtocol::endpoint endpoint_t;
+	typedef typename TProtocol::acceptor acceptor_t;
+	
+	boost::asio::io_service                   m_io;
+	std::vector<boost::shared_ptr<socket_t> > m_peers; // rank 0: peers of rank 1...N-1
+	                                                   // others: [rank 0]
+	std::vector<real_t>                       m_buf;
+	int                                       m_rank;
+	int                                       m_size;
+
+    public:
+	socketTransport(const int rank, const int size, const endpoint_t &endpoint)
+	    : m_rank(rank), m_size(size)
+	{
+	    if (rank == 0){
+		acceptor_t acceptor(m_io, endpoint);
+		m_peers.resize(size);
+		for (int i = 1; i < size; i++){
+		    boost::shared_ptr<socket_t> sock(new socket_t(m_io));
+		    acceptor.accept(*sock);
+		    int32_t peerRank = -1;
+		    boost::asio::read(*sock, boost::asio::buffer(&peerRank, sizeof(peerRank)));
+		    if (peerRank < 1 || peerRank >= size || m_peers[peerRank])
+			throw std::runtime_error("Invalid or duplicated rank of a process");
+		    m_peers[peerRank] = sock;
+		}
+	    }else{
+		m_peers.resize(1);
+		m_peers[0].reset(new socket_t(m_io));
+		for (int i = 0; ; i++){
+		    boost::system::error_code ec;
+		    m_peers[0]->connect(endpoint, ec);
+		    if (!ec)
+			break;
+		    m_peers[0]->close();
+		    if (i >= CONNECT_RETRY)
+			throw std::runtime_error("Cannot connect to the process of rank 0");
+		    waitMs(CONNECT_WAIT_MS);
+		}
+		int32_t myRank = rank;
+		boost::asio::write(*m_peers[0], boost::asio::buffer(&myRank, sizeof(myRank)));
+	    }
+	}
+
+	virtual void sum(real_t *data, const size_t num)
+	{
+	    uint64_t len = num;
+	    if (m_rank == 0){
+		m_buf.resize(num);
+		for (int r = 1; r < m_size; r++){
+		    uint64_t peerLen = 0;
+		    boost::asio::read(*m_peers[r], boost::asio::buffer(&peerLen, sizeof(peerLen)));
+		    if (peerLen != len)
+			throw std::runtime_error("Different vector sizes in the distributed sum");
+		    boost::asio::read(*m_peers[r],
+				      boost::asio::buffer(&m_buf[0], num * sizeof(real_t)));
+		    for (size_t i = 0; i < num; i++)
+			data[i] += m_buf[i];
+		}
+		for (int r = 1; r < m_size; r++)
+		    boost::asio::write(*m_peers[r], boost::asio::buffer(data, num*sizeof(real_t)));
+	    }else{
+		// header and data in one write
+		std::vector<boost::asio::const_buffer> msg;
+		msg.push_back(boost::asio::buffer(&len, sizeof(len)));
+		msg.push_back(boost::asio::buffer(data, num * sizeof(real_t)));
+		boost::asio::write(*m_peers[0], msg);
+		boost::asio::read(*m_peers[0], boost::asio::buffer(data, num * sizeof(real_t)));
+	    }
+	}
+    };
+    
+    int                           g_rank = 0;
+    int                           g_size = 1;
+    boost::scoped_ptr<transport_t> g_transport;
+    
+}
+
+namespace helpers {
+namespace allReduce {
+
+    void initialize(const int rank, const int size, const std::string &address)
+    {
+	if (size < 1 || rank < 0 || rank >= size)
+	    throw std::runtime_error("Invalid rank or size of the distributed job");
+	
+	g_transport.reset();
+	g_rank = rank;
+	g_size = size;
+	if (size == 1)
+	    return;
+
+	if (address.compare(0, 4, "shm:") == 0){
+	    g_transport.reset(new shmTransport(rank, size, address.substr(4)));
+	    
+	}else if (address.compare(0, 5, "unix:") == 0){
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	    typedef boost::asio::local::stream_protocol protocol_t;
+	    std::string path = address.substr(5);
+	    if (rank == 0)
+		std::remove(path.c_str());   // socket file left by a crashed job
+	    g_transport.reset(new socketTransport<protocol_t>(rank, size,
+							      protocol_t::endpoint(path)));
+	    if (rank == 0)
+		std::remove(path.c_str());   // all the processes are connected
+#else
+	    throw std::runtime_error("UNIX domain socket is not supported on this system");
+#endif
+	    
+	}else if (address.compare(0, 4, "tcp:") == 0){
+	    typedef boost::asio::ip::tcp protocol_t;
+	    std::string hostPort = address.substr(4);
+	    size_t pos = hostPort.find_last_of(':');
+	    if (pos == std::string::npos)
+		throw std::runtime_error(std::string("Invalid address ") + address);
+	    std::string host = hostPort.substr(0, pos);
+	    std::string port = hostPort.substr(pos + 1);
+	    
+	    protocol_t::endpoint endpoint;
+	    if (rank == 0){
+		// listen on all the interfaces
+		endpoint = protocol_t::endpoint(protocol_t::v4(),
+						boost::lexical_cast<unsigned short>(port));
+	    }else{
+		boost::asio::io_service io;
+		protocol_t::resolver resolver(io);
+		protocol_t::resolver::query query(host, port);
+		endpoint = *resolver.resolve(query);
+	    }
+	    g_transport.reset(new socketTransport<protocol_t>(rank, size, endpoint));
+	    
+	}else{
+	    throw std::runtime_error(std::string("Unknown address of the distributed job: ") +
+				     address);
+	}
+	printf("\nDistributed job: process %d of %d (%s)\n", rank, size, address.c_str());
+    }
+
+    void finalize()
+    {
+	g_transport.reset();
+	g_rank = 0;
+	g_size = 1;
+    }
+
+    bool distributed()
+    {
+	return g_size > 1;
+    }
+
+    int rank()
+    {
+	return g_rank;
+    }
+
+    int size()
+    {
+	return g_size;
+    }
+
+    void sum(real_t *data, const size_t num)
+    {
+	if (g_size == 1 || num == 0)
+	    return;
+	if (!g_transport)
+	    throw std::runtime_error("Distributed job is not initialized");
+	g_transport->sum(data, num);
+    }
+
+    void broadcast(real_t *data, const size_t num)
+    {
+	// x + 0 + ... + 0 is exactly x
+	if (g_rank != 0)
+	    std::fill(data, data + num, (real_t)0.0);
+	sum(data, num);
+    }
+    
+}
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_ALLREDUCE_HPP
+#define HELPERS_ALLREDUCE_HPP
+
+#include <string>
+#include "../Types.hpp"
+
+/*
+ * Sum of vectors over the processes of a distributed job
+ *
+ *  address of the job:
+ *   shm:NAME          shared memory (processes on the same machine)
+ *   unix:PATH         UNIX domain socket, rank 0 listens on PATH
+ *   tcp:HOST:PORT     TCP socket, rank 0 listens on HOST:PORT
+ *
+ *  The vectors are added in the order of rank, ((x_0 + x_1) + x_2) + ...,
+ *  by every transport, so that the result is the same on all the processes and
+ *  does not depend on the transport.
+ *  The thread and socket libraries are only used in AllReduce.cpp (nvcc hates boost)
+ */
+
+namespace helpers {
+namespace allReduce {
+
+    /* Connect the processes. Must be called by all the processes of the job */
+    void initialize(const int rank, const int size, const std::string &address);
+
+    /* Disconnect */
+    void finalize();
+
+    /* Whether there are more than 1 processes */
+    bool distributed();
+
+    int  rank();
+
+    int  size();
+
+    /* In-place sum of data[0:num] over all the processes */
+    void sum(real_t *data, const size_t num);
+
+    /* Copy data[0:num] of rank 0 to all the processes */
+    void broadcast(real_t *data, const size_t num);
+    
+}
+}
+
+#endif
@@ -0,0 +1,330 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2017
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "BinaryModel.hpp"
+#include "../rapidjson/writer.h"
+#include "../rapidjson/stringbuffer.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+#define BINARYMODEL_MAGIC      "CRNTBIN1"
+#define BINARYMODEL_MAGIC_LEN  8
+#define BINARYMODEL_ALIGNMENT  64
+
+namespace {
+
+    // one mapped model file
+    struct mapped_model_t
+    {
+	boost::interprocess::file_mapping  mapping;
+	boost::interprocess::mapped_region region;
+	size_t                             blobStart;  // start of the blob area (bytes)
+	const rapidjson::Document         *owner;      // document read from the file
+    };
+
+    // Modify 20181018: the mapped files, kept until the owner document is released.
+    //  The index is the "file" of the blob references
+    std::map<int, boost::shared_ptr<mapped_model_t> > g_mappedModels;
+    int                                                g_mappedModelCnt = 0;
+
+    const char *g_weightArrayNames[] = {"input", "bias", "internal"};
+
+    size_t alignedSize(const size_t size)
+    {
+	return (size + BINARYMODEL_ALIGNMENT - 1) / BINARYMODEL_ALIGNMENT * BINARYMODEL_ALIGNMENT;
+    }
+
+    bool writePadding(FILE *file, const size_t curPos)
+    {
+	static const char zeros[BINARYMODEL_ALIGNMENT] = {0};
+	size_t padding = alignedSize(curPos) - curPos;
+	return (padding == 0 || fwrite(zeros, 1, padding, file) == padding);
+    }
+
+    bool isBlobReference(const rapidjson::Value &value)
+    {
+	return (value.IsObject() && value.HasMember("offset") && value.HasMember("size") &&
+		value.HasMember("file"));
+    }
+
+    // check the blob reference and link it to the mapped file
+    void linkBlobReference(rapidjson::Value &blobRef, const int fileIdx,
+			   const mapped_model_t &model, const std::string &filename,
+			   rapidjson::Document *jsonDoc)
+    {
+	if (!blobRef.HasMember("offset") || !blobRef.HasMember("size"))
+	    throw std::runtime_error(filename + ": broken weight reference");
+	if (model.blobStart + blobRef["offset"].GetUint64() +
+	    blobRef["size"].GetUint64() * sizeof(float) > model.region.get_size())
+	    throw std::runtime_error(filename + ": weight blob exceeds the file");
+	// Add 20181018: the blobs are read as float arrays in place
+	if ((model.blobStart + blobRef["offset"].GetUint64()) % BINARYMODEL_ALIGNMENT != 0)
+	    throw std::runtime_error(filename + ": misaligned weight blob");
+	blobRef.AddMember("file", fileIdx, jsonDoc->GetAllocator());
+    }
+
+    // parse the header at the start of the file content
+    size_t parseHeader(const char *base, const size_t fileSize, const std::string &filename,
+		       rapidjson::Document *jsonDoc)
+    {
+	if (fileSize < BINARYMODEL_MAGIC_LEN + sizeof(uint64_t) ||
+	    std::memcmp(base, BINARYMODEL_MAGIC, BINARYMODEL_MAGIC_LEN) != 0)
+	    throw std::runtime_error(filename + " is not a binary model");
+
+	uint64_t headerSize;
+	std::memcpy(&headerSize, base + BINARYMODEL_MAGIC_LEN, sizeof(uint64_t));
+	size_t headerStart = BINARYMODEL_MAGIC_LEN + sizeof(uint64_t);
+	if (headerStart + headerSize > fileSize){
+	    // Add 20181018: the size fits the file if read in the other byte order
+	    uint64_t swapped = 0;
+	    for (size_t i = 0; i < sizeof(uint64_t); i++)
+		swapped = (swapped << 8) | ((headerSize >> (8 * i)) & 0xff);
+	    if (headerStart + swapped <= fileSize)
+		throw std::runtime_error(filename + ": binary model of the other byte order "
+					 "(endianness) is not supported");
+	    throw std::runtime_error(filename + ": broken header of binary model");
+	}
+
+	std::string headerStr(base + headerStart, headerSize);
+	if (jsonDoc->Parse<0>(headerStr.c_str()).HasParseError())
+	    throw std::runtime_error(std::string("Parse error: ") + jsonDoc->GetParseError());
+
+	// start of the blob area
+	return alignedSize(headerStart + headerSize);
+    }
+}
+
+namespace helpers {
+namespace binaryModel {
+
+    bool isBinaryModel(const std::string &filename)
+    {
+	std::ifstream ifs(filename.c_str(), std::ios::binary);
+	if (!ifs.good())
+	    return false;
+	char magic[BINARYMODEL_MAGIC_LEN];
+	ifs.read(magic, BINARYMODEL_MAGIC_LEN);
+	return (ifs.gcount() == BINARYMODEL_MAGIC_LEN &&
+		std::memcmp(magic, BINARYMODEL_MAGIC, BINARYMODEL_MAGIC_LEN) == 0);
+    }
+
+    void readBinaryModel(const std::string &filename, rapidjson::Document *jsonDoc)
+    {
+	// the document is overwritten: the files read into it before are not used
+	releaseBinaryModel(*jsonDoc);
+	
+	boost::shared_ptr<mapped_model_t> model(new mapped_model_t);
+	model->owner = jsonDoc;
+	try{
+	    model->mapping = boost::interprocess::file_mapping(
+				filename.c_str(), boost::interprocess::read_only);
+	    model->region  = boost::interprocess::mapped_region(
+				model->mapping, boost::interprocess::read_only);
+	}catch (const std::exception &e){
+	    throw std::runtime_error(std::string("Cannot map binary model: ") + e.what());
+	}
+
+	// parse the header
+	model->blobStart = parseHeader(static_cast<const char*>(model->region.get_address()),
+				       model->region.get_size(), filename, jsonDoc);
+
+	// link the blob references to this file
+	int fileIdx = g_mappedModelCnt++;
+	if (jsonDoc->HasMember("weights") && (*jsonDoc)["weights"].IsObject()){
+	    rapidjson::Value &weightsSection = (*jsonDoc)["weights"];
+	    for (rapidjson::Value::MemberIterator layerIt = weightsSection.MemberBegin();
+		 layerIt != weightsSection.MemberEnd(); ++layerIt){
+		if (!layerIt->value.IsObject())
+		    continue;
+		for (int i = 0; i < 3; i++){
+		    if (!layerIt->value.HasMember(g_weightArrayNames[i]))
+			continue;
+		    rapidjson::Value &blobRef = layerIt->value[g_weightArrayNames[i]];
+		    if (!blobRef.IsObject())
+			continue;
+		    linkBlobReference(blobRef, fileIdx, *model, filename, jsonDoc);
+		}
+	    }
+	}
+
+	// Add 20181018: optimizer state of the binary checkpoint (arrays of blob references)
+	for (rapidjson::Value::MemberIterator it = jsonDoc->MemberBegin();
+	     it != jsonDoc->MemberEnd(); ++it){
+	    if (!it->value.IsArray() || std::string(it->name.GetString()) == "layers")
+		continue;
+	    for (rapidjson::Value::ValueIterator blobRef = it->value.Begin();
+		 blobRef != it->value.End(); ++blobRef){
+		if (blobRef->IsObject() && blobRef->HasMember("offset"))
+		    linkBlobReference(*blobRef, fileIdx, *model, filename, jsonDoc);
+	    }
+	}
+	g_mappedModels[fileIdx] = model;
+    }
+
+    void releaseBinaryModel(const rapidjson::Document &jsonDoc)
+    {
+	std::map<int, boost::shared_ptr<mapped_model_t> >::iterator it = g_mappedModels.begin();
+	while (it != g_mappedModels.end()){
+	    if (it->second->owner == &jsonDoc)
+		g_mappedModels.erase(it++);
+	    else
+		++it;
+	}
+    }
+
+    MappedModelGuard::MappedModelGuard(const rapidjson::Document &jsonDoc)
+	: m_jsonDoc(jsonDoc)
+    {
+    }
+
+    MappedModelGuard::~MappedModelGuard()
+    {
+	releaseBinaryModel(m_jsonDoc);
+    }
+
+    void readBinaryHeader(const std::string &filename, rapidjson::Document *jsonDoc)
+    {
+	std::ifstream ifs(filename.c_str(), std::ios::binary);
+	if (!ifs.good())
+	    throw std::runtime_error(std::string("Cannot open file ") + filename);
+
+	char prefix[BINARYMODEL_MAGIC_LEN + sizeof(uint64_t)];
+	ifs.read(prefix, sizeof(prefix));
+	if (ifs.gcount() != (std::streamsize)sizeof(prefix))
+	    throw std::runtime_error(filename + " is not a binary model");
+
+	uint64_t headerSize;
+	std::memcpy(&headerSize, prefix + BINARYMODEL_MAGIC_LEN, sizeof(uint64_t));
+	std::vector<char> buffer(sizeof(prefix) + headerSize);
+	std::memcpy(&buffer[0], prefix, sizeof(prefix));
+	ifs.read(&buffer[sizeof(prefix)], headerSize);
+	if (ifs.gcount() != (std::streamsize)headerSize)
+	    throw std::runtime_error(filename + ": broken header of binary model");
+	
+	parseHeader(&buffer[0], buffer.size(), filename, jsonDoc);
+    }
+
+    void writeBinaryModel(const std::string &filename, const rapidjson::Document &header,
+			  const std::vector<std::vector<float> > &blobs, const size_t blobNum)
+    {
+	// header
+	rapidjson::StringBuffer headerBuf;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(headerBuf);
+	header.Accept(writer);
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file)
+	    throw std::runtime_error(std::string("Cannot open file ") + filename);
+	try{
+	    writeBinaryFile(file, std::string(headerBuf.GetString(), headerBuf.Size()),
+			    blobs, blobNum);
+	}catch (const std::exception &){
+	    fclose(file);
+	    throw std::runtime_error(std::string("Fail to write ") + filename);
+	}
+	if (fclose(file) != 0)
+	    throw std::runtime_error(std::string("Fail to write ") + filename);
+    }
+
+    uint64_t blobBytes(const size_t size)
+    {
+	return alignedSize(size * sizeof(float));
+    }
+
+    void writeBinaryFile(FILE *file, const std::string &header,
+			 const std::vector<std::vector<float> > &blobs, const size_t blobNum)
+    {
+	uint64_t headerSize = header.size();
+	bool     good       = true;
+	
+	good = good && fwrite(BINARYMODEL_MAGIC, 1, BINARYMODEL_MAGIC_LEN, file) ==
+	    BINARYMODEL_MAGIC_LEN;
+	good = good && fwrite(&headerSize, sizeof(uint64_t), 1, file) == 1;
+	good = good && fwrite(header.c_str(), 1, headerSize, file) == headerSize;
+	good = good && writePadding(file, BINARYMODEL_MAGIC_LEN + sizeof(uint64_t) + headerSize);
+
+	// blobs
+	for (size_t i = 0; good && i < blobNum; i++){
+	    if (blobs[i].empty())
+		continue;
+	    good = good && fwrite(&blobs[i][0], sizeof(float), blobs[i].size(), file) ==
+		blobs[i].size();
+	    good = good && writePadding(file, blobs[i].size() * sizeof(float));
+	}
+	if (!good || fflush(file) != 0)
+	    throw std::runtime_error("Fail to write the binary model");
+    }
+
+    bool isWeightArray(const rapidjson::Value &value)
+    {
+	return value.IsArray() || isBlobReference(value);
+    }
+
+    size_t weightArraySize(const rapidjson::Value &value)
+    {
+	if (value.IsArray())
+	    return value.Size();
+	else if (isBlobReference(value))
+	    return value["size"].GetUint64();
+	else
+	    throw std::runtime_error("Not a weight array");
+    }
+
+    void readWeightArray(const rapidjson::Value &value, Cpu::real_vector *weights)
+    {
+	if (value.IsArray()){
+	    for (rapidjson::Value::ConstValueIterator it = value.Begin(); it != value.End(); ++it)
+		weights->push_back(static_cast<real_t>(it->GetDouble()));
+
+	}else if (isBlobReference(value)){
+	    std::map<int, boost::shared_ptr<mapped_model_t> >::const_iterator it =
+		g_mappedModels.find(value["file"].GetInt());
+	    if (it == g_mappedModels.end())
+		throw std::runtime_error("Invalid reference to binary model (the file has been "
+					 "released after the weights were read)");
+	    const mapped_model_t &model = *(it->second);
+	    const float *blob = reinterpret_cast<const float*>(
+		static_cast<const char*>(model.region.get_address()) + model.blobStart +
+		value["offset"].GetUint64());
+	    weights->insert(weights->end(), blob, blob + value["size"].GetUint64());
+
+	}else{
+	    throw std::runtime_error("Not a weight array");
+	}
+    }
+
+}
+}
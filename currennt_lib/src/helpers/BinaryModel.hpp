@@ -0,0 +1,113 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2017
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_BINARYMODEL_HPP
+#define HELPERS_BINARYMODEL_HPP
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include "../Types.hpp"
+#include "../rapidjson/document.h"
+
+/*
+ * Binary model container
+ *
+ *  [magic "CRNTBIN1"][uint64 header size][header: JSON text][padding]
+ *  [float32 blob][padding][float32 blob][padding] ...
+ *
+ * The header is the network JSON document, where the "input", "bias" and "internal"
+ * arrays in the "weights" section are replaced by {"offset": N, "size": M}.
+ * Offset is counted in bytes from the start of the blob area, and each blob starts
+ * at a 64-byte aligned position of the file.
+ * The file is mapped into memory when it is read, and the weights are copied from
+ * the blobs directly (without text-to-float conversion)
+ *
+ * Modify 20181018: the mapping belongs to the document that the file is read into,
+ * and it is released by releaseBinaryModel() (or MappedModelGuard). Files written on
+ * a machine of the other byte order, or with misaligned blobs, are rejected
+ *
+ * Add 20181018: the same container is used by the binary checkpoint (helpers/Checkpoint),
+ * where the top-level arrays of the optimizer state may also hold blob references
+ */
+
+namespace helpers {
+namespace binaryModel {
+
+    /* Check whether the file is a binary model */
+    bool   isBinaryModel(const std::string &filename);
+
+    /* Map the binary model and parse the header into jsonDoc
+       The mapping is kept until releaseBinaryModel(*jsonDoc) */
+    void   readBinaryModel(const std::string &filename, rapidjson::Document *jsonDoc);
+
+    /* Add 20181018: unmap the binary models read into jsonDoc
+       The blob references in jsonDoc can not be read after that */
+    void   releaseBinaryModel(const rapidjson::Document &jsonDoc);
+
+    /* Add 20181018: unmap the binary models read into jsonDoc at the end of the scope */
+    class MappedModelGuard : boost::noncopyable
+    {
+    public:
+	explicit MappedModelGuard(const rapidjson::Document &jsonDoc);
+	~MappedModelGuard();
+    private:
+	const rapidjson::Document &m_jsonDoc;
+    };
+
+    /* Parse the header into jsonDoc without mapping the blobs */
+    void   readBinaryHeader(const std::string &filename, rapidjson::Document *jsonDoc);
+
+    /* Write the header and the first blobNum blobs as a binary model
+       The weight arrays in the header are blob references, which are made while the
+       blobs are copied from the layers (see NeuralNetwork::exportWeights(Checkpoint*)) */
+    void   writeBinaryModel(const std::string &filename, const rapidjson::Document &header,
+			    const std::vector<std::vector<float> > &blobs, const size_t blobNum);
+
+    /* Number of bytes taken by a blob of size elements in the blob area */
+    uint64_t blobBytes(const size_t size);
+
+    /* Write the header and the first blobNum blobs to the file
+       The blob references in the header must follow the order of the blobs */
+    void   writeBinaryFile(FILE *file, const std::string &header,
+			   const std::vector<std::vector<float> > &blobs, const size_t blobNum);
+
+    /* Whether the value is a weight array (JSON array or blob reference) */
+    bool   isWeightArray(const rapidjson::Value &value);
+
+    /* Number of elements in the weight array */
+    size_t weightArraySize(const rapidjson::Value &value);
+
+    /* Append the elements of the weight array to weights */
+    void   readWeightArray(const rapidjson::Value &value, Cpu::real_vector *weights);
+
+}
+}
+
+#endif
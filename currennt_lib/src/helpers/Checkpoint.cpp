@@ -0,0 +1,213 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "Checkpoint.hpp"
+#include "BinaryModel.hpp"
+#include "../rapidjson/writer.h"
+#include "../rapidjson/stringbuffer.h"
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace helpers {
+namespace checkpoint {
+
+    struct checkpoint_writer_t
+    {
+	Checkpoint    staging;
+	std::string   header;        // header text (made by the calling thread)
+	std::string   filename;
+	std::string   errorMsg;
+	boost::thread thread;
+    };
+
+    namespace {
+
+	// make the rename of a file in the directory durable
+	void syncDirectory(const std::string &filename)
+	{
+	    size_t pos = filename.find_last_of('/');
+	    std::string dirName = (pos == std::string::npos ? 
+				   std::string(".") : filename.substr(0, pos + 1));
+	    int fd = open(dirName.c_str(), O_RDONLY);
+	    if (fd < 0)
+		return;
+	    fsync(fd);
+	    close(fd);
+	}
+	
+	void writeCheckpoint(checkpoint_writer_t *writer)
+	{
+	    std::string tmpName = writer->filename + ".tmp";
+	    try{
+		FILE *file = fopen(tmpName.c_str(), "wb");
+		if (!file)
+		    throw std::runtime_error(std::string("Cannot open file ") + tmpName);
+		try{
+		    binaryModel::writeBinaryFile(file, writer->header, writer->staging.blobs(),
+						 writer->staging.blobNum());
+		    if (fsync(fileno(file)) != 0)
+			throw std::runtime_error("fsync failed");
+		}catch (const std::exception &){
+		    fclose(file);
+		    remove(tmpName.c_str());
+		    throw;
+		}
+		if (fclose(file) != 0)
+		    throw std::runtime_error(std::string("Fail to close ") + tmpName);
+		
+		// the old checkpoint (if any) is replaced at once
+		if (rename(tmpName.c_str(), writer->filename.c_str()) != 0)
+		    throw std::runtime_error(std::string("Fail to rename ") + tmpName);
+		syncDirectory(writer->filename);
+		
+	    }catch (const std::exception &e){
+		writer->errorMsg = writer->filename + ": " + e.what();
+	    }
+	}
+    }
+
+    Checkpoint::Checkpoint()
+	: m_header     (new rapidjson::Document)
+	, m_blobNum    (0)
+	, m_blobOffset (0)
+    {
+	m_header->SetObject();
+    }
+
+    Checkpoint::~Checkpoint()
+    {
+	delete m_header;
+    }
+
+    void Checkpoint::clear()
+    {
+	// the allocator of the document can't be reused after clearing it
+	delete m_header;
+	m_header     = new rapidjson::Document;
+	m_header->SetObject();
+	m_blobNum    = 0;
+	m_blobOffset = 0;
+    }
+
+    rapidjson::Document& Checkpoint::header()
+    {
+	return *m_header;
+    }
+    
+    real_t* Checkpoint::addBlob(const size_t size, uint64_t *offset)
+    {
+	if (m_blobNum == m_blobs.size())
+	    m_blobs.resize(m_blobNum + 1);
+	std::vector<real_t> &blob = m_blobs[m_blobNum++];
+	blob.resize(size);
+	
+	*offset       = m_blobOffset;
+	m_blobOffset += binaryModel::blobBytes(size);
+	return (size > 0 ? &blob[0] : NULL);
+    }
+
+    void Checkpoint::blobReference(const uint64_t offset, const size_t size,
+				   rapidjson::Value *blobRef)
+    {
+	blobRef->SetObject();
+	blobRef->AddMember("offset", offset,         m_header->GetAllocator());
+	blobRef->AddMember("size",   (uint64_t)size, m_header->GetAllocator());
+    }
+
+    size_t Checkpoint::blobNum() const
+    {
+	return m_blobNum;
+    }
+
+    const std::vector<std::vector<real_t> >& Checkpoint::blobs() const
+    {
+	return m_blobs;
+    }
+
+    
+    CheckpointWriter::CheckpointWriter()
+	: m_impl (new checkpoint_writer_t)
+    {
+    }
+
+    CheckpointWriter::~CheckpointWriter()
+    {
+	checkpoint_writer_t *writer = static_cast<checkpoint_writer_t*>(m_impl);
+	if (writer->thread.joinable())
+	    writer->thread.join();
+	if (!writer->errorMsg.empty())
+	    printf("\nERROR in writing the checkpoint %s\n", writer->errorMsg.c_str());
+	delete writer;
+    }
+
+    Checkpoint& CheckpointWriter::stage()
+    {
+	checkpoint_writer_t *writer = static_cast<checkpoint_writer_t*>(m_impl);
+	this->wait();
+	writer->staging.clear();
+	return writer->staging;
+    }
+
+    void CheckpointWriter::write(const std::string &filename)
+    {
+	checkpoint_writer_t *writer = static_cast<checkpoint_writer_t*>(m_impl);
+	if (writer->thread.joinable())
+	    throw std::runtime_error("The last checkpoint is still being written");
+
+	// the header may refer to strings of the caller, thus it is converted here
+	rapidjson::StringBuffer headerBuf;
+	rapidjson::Writer<rapidjson::StringBuffer> headerWriter(headerBuf);
+	writer->staging.header().Accept(headerWriter);
+	writer->header.assign(headerBuf.GetString(), headerBuf.Size());
+	
+	writer->filename = filename;
+	writer->errorMsg.clear();
+	writer->thread   = boost::thread(boost::bind(&writeCheckpoint, writer));
+    }
+
+    void CheckpointWriter::wait()
+    {
+	checkpoint_writer_t *writer = static_cast<checkpoint_writer_t*>(m_impl);
+	if (writer->thread.joinable())
+	    writer->thread.join();
+	if (!writer->errorMsg.empty()){
+	    std::string errorMsg = writer->errorMsg;
+	    writer->errorMsg.clear();
+	    throw std::runtime_error(std::string("Fail to write the checkpoint ") + errorMsg);
+	}
+    }
+    
+}
+}
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#ifndef HELPERS_CHECKPOINT_HPP
+#define HELPERS_CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../Types.hpp"
+#include "../rapidjson/document.h"
+
+/*
+ * Binary checkpoint
+ *
+ *  The checkpoint uses the container of the binary model (helpers/BinaryModel.hpp): the
+ *  JSON header holds the configuration, the network, the scalar state of the optimizer
+ *  and of the data loader, and the weights and optimizer vectors are blob references.
+ *  The file can be given to --continue (and to --network) like a .autosave.
+ *
+ *  Saving is split in two steps:
+ *   1. the training thread fills the staging buffer (Checkpoint), which only copies the
+ *      vectors into host memory,
+ *   2. CheckpointWriter converts the header into text, and writes it and the blobs in
+ *      a background thread to a temporary file, calls fsync and renames the file, so
+ *      that the checkpoint is either complete or absent.
+ *  The thread library is only used in Checkpoint.cpp (nvcc hates boost headers)
+ */
+
+namespace helpers {
+namespace checkpoint {
+
+    /* Staging buffer of one checkpoint */
+    class Checkpoint
+    {
+    private:
+	rapidjson::Document              *m_header;     // a new document for each checkpoint
+	std::vector<std::vector<real_t> > m_blobs;      // kept between checkpoints
+	size_t                            m_blobNum;    // blobs used by this checkpoint
+	uint64_t                          m_blobOffset; // byte offset of the next blob
+	
+	Checkpoint(const Checkpoint &);
+	Checkpoint& operator=(const Checkpoint &);
+	
+    public:
+	Checkpoint();
+	~Checkpoint();
+
+	/* clear the header and the blobs (the memory of the blobs is kept) */
+	void clear();
+	
+	rapidjson::Document& header();
+
+	/* Add a blob of size elements and return the pointer to fill it
+	   offset: byte offset of the blob in the blob area */
+	real_t* addBlob(const size_t size, uint64_t *offset);
+
+	/* Set blobRef to the reference {"offset", "size"} of size elements from offset (bytes) */
+	void blobReference(const uint64_t offset, const size_t size, rapidjson::Value *blobRef);
+
+	size_t blobNum() const;
+	const std::vector<std::vector<real_t> >& blobs() const;
+    };
+
+    /* Writes the staged checkpoints in a background thread */
+    class CheckpointWriter
+    {
+    private:
+	void *m_impl;
+	
+    public:
+	CheckpointWriter();
+	
+	/* wait for the thread (the error of the last writing is printed) */
+	~CheckpointWriter();
+
+	/* Wait for the last writing and return the cleared staging buffer */
+	Checkpoint& stage();
+
+	/* Start writing the staging buffer to filename */
+	void write(const std::string &filename);
+
+	/* Wait for the last writing, throw if it failed */
+	void wait();
+    };
+
+}
+}
+
+#endif
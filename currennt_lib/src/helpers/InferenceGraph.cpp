@@ -0,0 +1,405 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2017
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "InferenceGraph.hpp"
+#include "BinaryModel.hpp"
+#include "misFuncs.hpp"
+#include "../Types.hpp"
+
+#include <vector>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+    typedef rapidjson::MemoryPoolAllocator<> allocator_t;
+    
+    bool isFeedForward(const rapidjson::Value &layer)
+    {
+	std::string layerType = layer["type"].GetString();
+	return (layerType.compare(0, 12, "feedforward_") == 0);
+    }
+
+    bool isIdentityFeedForward(const rapidjson::Value &layer)
+    {
+	return (std::string(layer["type"].GetString()) == "feedforward_identity");
+    }
+
+    bool isBatchNorm(const rapidjson::Value &layer)
+    {
+	return (std::string(layer["type"].GetString()) == "batchnorm");
+    }
+    
+    bool withBatchNorm(const rapidjson::Value &layer)
+    {
+	return (layer.HasMember("batchnorm") && layer["batchnorm"].GetInt());
+    }
+
+    real_t biasScalar(const rapidjson::Value &layer)
+    {
+	return (layer.HasMember("bias") ? static_cast<real_t>(layer["bias"].GetDouble()) : 0.0);
+    }
+
+    int layerResolution(const rapidjson::Value &layer)
+    {
+	return (layer.HasMember("resolution") ? layer["resolution"].GetInt() : 1);
+    }
+
+    bool sameResolution(const rapidjson::Value &layer1, const rapidjson::Value &layer2)
+    {
+	return layerResolution(layer1) == layerResolution(layer2);
+    }
+
+    // read the input, bias and internal weights of one layer
+    bool readWeights(rapidjson::Value &weightsSection, const char *layerName,
+		     Cpu::real_vector *input, Cpu::real_vector *bias, Cpu::real_vector *internal)
+    {
+	if (!weightsSection.HasMember(layerName))
+	    return false;
+	const rapidjson::Value &weightsChild = weightsSection[layerName];
+	if (!weightsChild.IsObject()                   ||
+	    !weightsChild.HasMember("input")           ||
+	    !weightsChild.HasMember("bias")            ||
+	    !weightsChild.HasMember("internal")        ||
+	    !helpers::binaryModel::isWeightArray(weightsChild["input"]) ||
+	    !helpers::binaryModel::isWeightArray(weightsChild["bias"])  ||
+	    !helpers::binaryModel::isWeightArray(weightsChild["internal"]))
+	    return false;
+	input->clear(); bias->clear(); internal->clear();
+	helpers::binaryModel::readWeightArray(weightsChild["input"],    input);
+	helpers::binaryModel::readWeightArray(weightsChild["bias"],     bias);
+	helpers::binaryModel::readWeightArray(weightsChild["internal"], internal);
+	return true;
+    }
+
+    void writeWeightArray(rapidjson::Value &weightsChild, const char *arrayName,
+			  const Cpu::real_vector &data, allocator_t &allocator)
+    {
+	rapidjson::Value weightArray(rapidjson::kArrayType);
+	weightArray.Reserve(data.size(), allocator);
+	for (size_t i = 0; i < data.size(); i++)
+	    weightArray.PushBack((double)data[i], allocator);
+	weightsChild[arrayName] = weightArray;
+    }
+
+    // overwrite the weights of one layer (as JSON arrays)
+    void writeWeights(rapidjson::Value &weightsSection, const char *layerName,
+		      const Cpu::real_vector &input, const Cpu::real_vector &bias,
+		      const Cpu::real_vector &internal, allocator_t &allocator)
+    {
+	rapidjson::Value &weightsChild = weightsSection[layerName];
+	writeWeightArray(weightsChild, "input",    input,    allocator);
+	writeWeightArray(weightsChild, "bias",     bias,     allocator);
+	writeWeightArray(weightsChild, "internal", internal, allocator);
+    }
+
+    // remove the layerIdx-th layer from the layers section
+    void removeLayer(rapidjson::Value &layersSection, const int layerIdx)
+    {
+	for (rapidjson::SizeType i = layerIdx; i + 1 < layersSection.Size(); i++)
+	    layersSection[i] = layersSection[i + 1];
+	layersSection.PopBack();
+    }
+
+    // set the bias scalar of the layer and return it
+    // (bias scalar 0 would disable the folded bias)
+    // deep copy of a json value
+    void copyValue(const rapidjson::Value &src, rapidjson::Value &dst, allocator_t &allocator)
+    {
+	if (src.IsObject()){
+	    dst.SetObject();
+	    for (rapidjson::Value::ConstMemberIterator it = src.MemberBegin();
+		 it != src.MemberEnd(); ++it){
+		rapidjson::Value name(it->name.GetString(), it->name.GetStringLength(),
+				      allocator);
+		rapidjson::Value value;
+		copyValue(it->value, value, allocator);
+		dst.AddMember(name, value, allocator);
+	    }
+	}else if (src.IsArray()){
+	    dst.SetArray();
+	    dst.Reserve(src.Size(), allocator);
+	    for (rapidjson::SizeType idx = 0; idx < src.Size(); idx++){
+		rapidjson::Value value;
+		copyValue(src[idx], value, allocator);
+		dst.PushBack(value, allocator);
+	    }
+	}else if (src.IsString()){
+	    dst.SetString(src.GetString(), src.GetStringLength(), allocator);
+	}else if (src.IsBool()){
+	    dst.SetBool(src.GetBool());
+	}else if (src.IsInt()){
+	    dst.SetInt(src.GetInt());
+	}else if (src.IsUint()){
+	    dst.SetUint(src.GetUint());
+	}else if (src.IsInt64()){
+	    dst.SetInt64(src.GetInt64());
+	}else if (src.IsUint64()){
+	    dst.SetUint64(src.GetUint64());
+	}else if (src.IsNumber()){
+	    dst.SetDouble(src.GetDouble());
+	}else{
+	    dst.SetNull();
+	}
+    }
+
+    real_t resetBiasScalar(rapidjson::Value &layer, allocator_t &allocator)
+    {
+	real_t bias = biasScalar(layer);
+	if (bias == 0.0){
+	    bias = 1.0;
+	    if (layer.HasMember("bias"))
+		layer["bias"].SetDouble(bias);
+	    else
+		layer.AddMember("bias", (double)bias, allocator);
+	}
+	return bias;
+    }
+    
+    /* Case 1: feedforward layer with batch normalization
+       y = f(alpha * (Wx - mean) / std + beta)
+       input:    W (pre x size), bias: alpha, internal: beta, mean, std
+    */
+    bool foldBatchNormFeedForward(rapidjson::Value &layer, rapidjson::Value &weightsSection,
+				  allocator_t &allocator)
+    {
+	const char *layerName = layer["name"].GetString();
+	int layerSize = layer["size"].GetInt();
+	Cpu::real_vector input, bias, internal;
+	if (!readWeights(weightsSection, layerName, &input, &bias, &internal))
+	    return false;
+	if (layerSize < 1 || bias.size() != layerSize || internal.size() != 3 * layerSize ||
+	    input.size() % layerSize != 0)
+	    return false;
+
+	int preSize = input.size() / layerSize;
+	real_t biasS = resetBiasScalar(layer, allocator);
+
+	Cpu::real_vector newBias(layerSize, 0.0);
+	for (int j = 0; j < layerSize; j++){
+	    real_t alpha = bias[j];
+	    real_t beta  = internal[j];
+	    real_t mean  = internal[j + layerSize];
+	    real_t std   = internal[j + layerSize * 2];
+	    real_t scale = alpha / std;
+	    for (int i = 0; i < preSize; i++)
+		input[j * preSize + i] *= scale;
+	    newBias[j] = (beta - mean * scale) / biasS;
+	}
+	
+	writeWeights(weightsSection, layerName, input, newBias, Cpu::real_vector(), allocator);
+	layer["batchnorm"].SetInt(0);
+	printf("\n\tFold batchnorm into %s", layerName);
+	return true;
+    }
+    
+    /* Case 2: feedforward_identity + batchnorm
+       y = alpha * (Wx + s * b - mean) / std + beta
+       batchnorm internal: alpha, beta, mean, std
+    */
+    bool foldBatchNormLayer(rapidjson::Value &ffLayer, rapidjson::Value &bnLayer,
+			    rapidjson::Value &weightsSection, allocator_t &allocator)
+    {
+	const char *ffName = ffLayer["name"].GetString();
+	const char *bnName = bnLayer["name"].GetString();
+	int layerSize = ffLayer["size"].GetInt();
+	Cpu::real_vector input, bias, internal;
+	Cpu::real_vector bnInput, bnBias, bnInternal;
+	if (!readWeights(weightsSection, ffName, &input, &bias, &internal) ||
+	    !readWeights(weightsSection, bnName, &bnInput, &bnBias, &bnInternal))
+	    return false;
+	if (layerSize < 1 || bnLayer["size"].GetInt() != layerSize  ||
+	    bias.size() != layerSize || internal.size() != 0        ||
+	    bnInternal.size() != 4 * layerSize || input.size() % layerSize != 0)
+	    return false;
+
+	int preSize = input.size() / layerSize;
+	real_t oldBiasS = biasScalar(ffLayer);
+	real_t biasS    = resetBiasScalar(ffLayer, allocator);
+
+	Cpu::real_vector newBias(layerSize, 0.0);
+	for (int j = 0; j < layerSize; j++){
+	    real_t alpha = bnInternal[j];
+	    real_t beta  = bnInternal[j + layerSize];
+	    real_t mean  = bnInternal[j + layerSize * 2];
+	    real_t std   = bnInternal[j + layerSize * 3];
+	    real_t scale = alpha / std;
+	    for (int i = 0; i < preSize; i++)
+		input[j * preSize + i] *= scale;
+	    newBias[j] = ((oldBiasS * bias[j] - mean) * scale + beta) / biasS;
+	}
+	
+	writeWeights(weightsSection, ffName, input, newBias, internal, allocator);
+	weightsSection.RemoveMember(bnName);
+	printf("\n\tFold batchnorm layer %s into %s", bnName, ffName);
+	return true;
+    }
+
+    /* Case 3: feedforward_identity (W1, b1) + feedforward_* (W2, b2)
+       y = f(W2^T (W1^T x + s1 b1) + s2 b2) = f((W1 W2)^T x + W2^T s1 b1 + s2 b2)
+    */
+    bool mergeFeedForward(rapidjson::Value &ffLayer1, rapidjson::Value &ffLayer2,
+			  rapidjson::Value &weightsSection, allocator_t &allocator)
+    {
+	const char *ffName1 = ffLayer1["name"].GetString();
+	const char *ffName2 = ffLayer2["name"].GetString();
+	int midSize = ffLayer1["size"].GetInt();
+	int outSize = ffLayer2["size"].GetInt();
+	Cpu::real_vector input1, bias1, internal1;
+	Cpu::real_vector input2, bias2, internal2;
+	if (midSize < 1 || outSize < 1 ||
+	    !readWeights(weightsSection, ffName1, &input1, &bias1, &internal1) ||
+	    !readWeights(weightsSection, ffName2, &input2, &bias2, &internal2))
+	    return false;
+	if (bias1.size() != midSize || internal1.size() != 0 || input1.size() % midSize != 0 ||
+	    bias2.size() != outSize || internal2.size() != 0 || input2.size() != midSize * outSize)
+	    return false;
+	
+	int preSize = input1.size() / midSize;
+	// merging is only useful if the merged matrix is smaller
+	if ((long)preSize * outSize > (long)preSize * midSize + (long)midSize * outSize)
+	    return false;
+	
+	real_t biasS1   = biasScalar(ffLayer1);
+	real_t oldBiasS = biasScalar(ffLayer2);
+	real_t biasS2   = resetBiasScalar(ffLayer2, allocator);
+	
+	Cpu::real_vector newInput(preSize * outSize, 0.0);
+	Cpu::real_vector newBias(outSize, 0.0);
+	for (int k = 0; k < outSize; k++){
+	    for (int j = 0; j < midSize; j++){
+		real_t w2 = input2[k * midSize + j];
+		for (int i = 0; i < preSize; i++)
+		    newInput[k * preSize + i] += input1[j * preSize + i] * w2;
+		newBias[k] += w2 * biasS1 * bias1[j];
+	    }
+	    newBias[k] = (newBias[k] + oldBiasS * bias2[k]) / biasS2;
+	}
+
+	writeWeights(weightsSection, ffName2, newInput, newBias, internal2, allocator);
+	weightsSection.RemoveMember(ffName1);
+	printf("\n\tMerge %s into %s", ffName1, ffName2);
+	return true;
+    }
+}
+
+namespace helpers {
+namespace inferenceGraph {
+
+    bool layerNameReferred(const rapidjson::Value &layersSection, const std::string &layerName)
+    {
+	std::vector<std::string> tmpOpt;
+	for (rapidjson::Value::ConstValueIterator layerIt = layersSection.Begin();
+	     layerIt != layersSection.End(); ++layerIt){
+	    if (!layerIt->IsObject())
+		continue;
+	    for (rapidjson::Value::ConstMemberIterator memIt = layerIt->MemberBegin();
+		 memIt != layerIt->MemberEnd(); ++memIt){
+		std::string memName = memIt->name.GetString();
+		if (memName == "name" || memName == "type" || !memIt->value.IsString())
+		    continue;
+		// the value may be a list of layer names
+		tmpOpt.clear();
+		misFuncs::ParseStrOpt(memIt->value.GetString(), tmpOpt, ",");
+		for (size_t i = 0; i < tmpOpt.size(); i++)
+		    if (tmpOpt[i] == layerName)
+			return true;
+	    }
+	}
+	return false;
+    }
+    
+    int foldLayers(rapidjson::Document *jsonDoc)
+    {
+	if (!jsonDoc->HasMember("layers") || !(*jsonDoc)["layers"].IsArray() ||
+	    !jsonDoc->HasMember("weights") || !(*jsonDoc)["weights"].IsObject())
+	    return 0;
+	
+	rapidjson::Value &layersSection  = (*jsonDoc)["layers"];
+	rapidjson::Value &weightsSection = (*jsonDoc)["weights"];
+	allocator_t      &allocator      = jsonDoc->GetAllocator();
+
+	int foldedCnt = 0;
+	bool flagChanged = true;
+	while (flagChanged){
+	    flagChanged = false;
+	    for (rapidjson::SizeType idx = 0; idx < layersSection.Size(); idx++){
+		rapidjson::Value &layer = layersSection[idx];
+		if (!layer.IsObject() || !layer.HasMember("type") || !layer.HasMember("name") ||
+		    !layer.HasMember("size") || !isFeedForward(layer))
+		    continue;
+		
+		// Case 1
+		if (withBatchNorm(layer)){
+		    if (foldBatchNormFeedForward(layer, weightsSection, allocator)){
+			foldedCnt++;
+			flagChanged = true;
+		    }
+		    continue;
+		}
+		
+		if (!isIdentityFeedForward(layer) || idx + 1 >= layersSection.Size() ||
+		    layer.HasMember("layerFlag") ||
+		    layerNameReferred(layersSection, layer["name"].GetString()))
+		    continue;
+		
+		rapidjson::Value &nextLayer = layersSection[idx + 1];
+		if (!nextLayer.IsObject() || !nextLayer.HasMember("type") ||
+		    !nextLayer.HasMember("name") || !nextLayer.HasMember("size") ||
+		    !sameResolution(layer, nextLayer))
+		    continue;
+		
+		// Case 2
+		if (isBatchNorm(nextLayer) && !nextLayer.HasMember("layerFlag") &&
+		    !layerNameReferred(layersSection, nextLayer["name"].GetString()) &&
+		    foldBatchNormLayer(layer, nextLayer, weightsSection, allocator)){
+		    removeLayer(layersSection, idx + 1);
+		    foldedCnt++;
+		    flagChanged = true;
+		    continue;
+		}
+		
+		// Case 3
+		if (isFeedForward(nextLayer) && !withBatchNorm(nextLayer) &&
+		    mergeFeedForward(layer, nextLayer, weightsSection, allocator)){
+		    removeLayer(layersSection, idx);
+		    foldedCnt++;
+		    flagChanged = true;
+		    continue;
+		}
+	    }
+	}
+	return foldedCnt;
+    }
+
+    void copyDocument(const rapidjson::Document &srcDoc, rapidjson::Document *dstDoc)
+    {
+	copyValue(srcDoc, *dstDoc, dstDoc->GetAllocator());
+    }
+
+}
+}
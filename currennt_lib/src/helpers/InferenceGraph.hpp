@@ -0,0 +1,69 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2017
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_INFERENCEGRAPH_HPP
+#define HELPERS_INFERENCEGRAPH_HPP
+
+#include <string>
+#include "../rapidjson/document.h"
+
+/*
+ * Load-time optimization of the network for generation
+ *
+ *  1. feedforward layer with "batchnorm": 
+ *     the mean, std, alpha and beta are folded into the transformation matrix and bias
+ *  2. feedforward_identity + batchnorm layer:
+ *     the batchnorm layer is folded into the feedforward layer and removed
+ *  3. feedforward_identity + feedforward_*:
+ *     the two matrices are multiplied and the first layer is removed, only if
+ *     the merged matrix is not larger than the two original matrices
+ *
+ * The network document (layers and weights) is modified in place. A layer is only 
+ * folded when its name is not referred to by other layers (e.g. through preSkipLayer)
+ *
+ * Modify 20181018: the network folds a copy of its document (copyDocument), so that
+ * the document given by the caller still describes the original network
+ */
+
+namespace helpers {
+namespace inferenceGraph {
+
+    /* Fold the layers in jsonDoc until no more layer can be folded
+       Return the number of folded layers */
+    int  foldLayers(rapidjson::Document *jsonDoc);
+
+    /* Deep copy of srcDoc into dstDoc (the strings are copied into the allocator
+       of dstDoc) */
+    void copyDocument(const rapidjson::Document &srcDoc, rapidjson::Document *dstDoc);
+
+    /* Whether the layer name is referred to by the configuration of another layer */
+    bool layerNameReferred(const rapidjson::Value &layersSection, const std::string &layerName);
+
+}
+}
+
+#endif
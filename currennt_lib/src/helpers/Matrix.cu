@@ -31,6 +31,7 @@
 #include <stdexcept>
 
 #include <thrust/transform.h>
+#include <thrust/for_each.h>
 
 #define USE_CUBLAS 1
 
@@ -44,6 +45,8 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
@@ -51,11 +54,11 @@ namespace {
         __host__ __device__ real_t operator() (const int &idx) const
         {
             const real_t *offRowA = a + (idx % rowsA);
-            const real_t *offColB = b + (idx / rowsA) * rowsB;
+            const real_t *offColB = b + (idx / rowsA) * ldB;
 
             real_t x = 0;
             for (int i = 0; i < colsA; ++i)
-                x += offRowA[i * rowsA] * offColB[i];
+                x += offRowA[i * ldA] * offColB[i];
 
             return x;
         }
@@ -67,6 +70,8 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
@@ -74,11 +79,11 @@ namespace {
         __host__ __device__ real_t operator() (const int &idx, const real_t &oldX) const
         {
             const real_t *offRowA = a + (idx % rowsA);
-            const real_t *offColB = b + (idx / rowsA) * rowsB;
+            const real_t *offColB = b + (idx / rowsA) * ldB;
 
             real_t x = 0;
             for (int i = 0; i < colsA; ++i)
-                x += offRowA[i * rowsA] * offColB[i];
+                x += offRowA[i * ldA] * offColB[i];
 
             return oldX + x;
         }
@@ -90,14 +95,16 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
 
         __host__ __device__ real_t operator() (const int &idx) const
         {
-            const real_t *offColA = a + (idx % colsA) * rowsA;
-            const real_t *offColB = b + (idx / colsA) * rowsB;
+            const real_t *offColA = a + (idx % colsA) * ldA;
+            const real_t *offColB = b + (idx / colsA) * ldB;
 
             real_t x = 0;
             for (int i = 0; i < rowsA; ++i)
@@ -113,14 +120,16 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
 
         __host__ __device__ real_t operator() (const int &idx, const real_t &oldX) const
         {
-            const real_t *offColA = a + (idx % colsA) * rowsA;
-            const real_t *offColB = b + (idx / colsA) * rowsB;
+            const real_t *offColA = a + (idx % colsA) * ldA;
+            const real_t *offColB = b + (idx / colsA) * ldB;
 
             real_t x = 0;
             for (int i = 0; i < rowsA; ++i)
@@ -136,6 +145,8 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
@@ -148,8 +159,8 @@ namespace {
             real_t x = 0;
             for (int i = 0; i < colsA; ++i) {
                 x += *offRowA * *offRowB;
-                offRowA += rowsA;
-                offRowB += rowsB;
+                offRowA += ldA;
+                offRowB += ldB;
             }
 
             return x;
@@ -162,6 +173,8 @@ namespace {
         int rowsB;
         int colsA;
         int colsB;
+        int ldA;
+        int ldB;
 
         const real_t *a;
         const real_t *b;
@@ -174,14 +187,45 @@ namespace {
             real_t x = 0;
             for (int i = 0; i < colsA; ++i) {
                 x += *offRowA * *offRowB;
-                offRowA += rowsA;
-                offRowB += rowsB;
+                offRowA += ldA;
+                offRowB += ldB;
             }
 
             return oldX + x;
         }
     };
 
+    // Add 20181018: store the product into a sub-block of a larger matrix
+    // (the leading dimension of the result is larger than its number of rows)
+    template <typename TFn>
+    struct StridedAssignProductFn
+    {
+        TFn     fn;
+        real_t *c;
+        int     rowsC;
+        int     ldC;
+
+        __host__ __device__ void operator() (const int &idx) const
+        {
+            c[(idx % rowsC) + (idx / rowsC) * ldC] = fn(idx);
+        }
+    };
+
+    template <typename TFn>
+    struct StridedAddProductFn
+    {
+        TFn     fn;
+        real_t *c;
+        int     rowsC;
+        int     ldC;
+
+        __host__ __device__ void operator() (const int &idx) const
+        {
+            real_t &x = c[(idx % rowsC) + (idx / rowsC) * ldC];
+            x = fn(idx, x);
+        }
+    };
+
 } // anonymous namespace
 } // namespace internal
 
@@ -195,18 +239,22 @@ namespace helpers {
         , m_data            (NULL)
         , m_rows            (0)
         , m_cols            (0)
+        , m_ld              (0)
     {
     }
 
     template <typename TDevice>
-    Matrix<TDevice>::Matrix(real_vector *data, int rows, int cols, int dataOffset)
+    Matrix<TDevice>::Matrix(real_vector *data, int rows, int cols, int dataOffset, int leadingDim)
         : m_dataVector      (data)
         , m_dataVectorOffset(dataOffset)
         , m_data            (getRawPointer(*data) + dataOffset)
         , m_rows            (rows)
         , m_cols            (cols)
+        , m_ld              (leadingDim > 0 ? leadingDim : rows)
     {
-        if (rows * cols > data->size() - dataOffset)
+        if (m_ld < rows)
+            throw std::runtime_error("Matrix leading dimension is smaller than the rows");
+        if (cols > 0 && (cols - 1) * m_ld + rows > data->size() - dataOffset)
             throw std::runtime_error("Matrix exceeds available space in vector");
     }
 
@@ -227,15 +275,31 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAssignProductFn<internal::MatrixMultiplyTransposedAFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
         else if (!transposeA && !transposeB) {
             if (m_rows != a.m_rows || m_cols != b.m_cols || a.m_cols != b.m_rows)
@@ -246,15 +310,31 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAssignProductFn<internal::MatrixMultiplyFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
         else if (transposeA && transposeB) {
             throw std::runtime_error("Not implemented");
@@ -268,15 +348,31 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAssignProductFn<internal::MatrixMultiplyTransposedBFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
     }
 
@@ -292,16 +388,32 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAddProductFn<internal::AddMatrixMultiplyTransposedAFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
         else if (!transposeA && !transposeB) {
             if (m_rows != a.m_rows || m_cols != b.m_cols || a.m_cols != b.m_rows)
@@ -312,16 +424,32 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAddProductFn<internal::AddMatrixMultiplyFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
         else if (transposeA && transposeB) {
             throw std::runtime_error("Not implemented");
@@ -335,16 +463,32 @@ namespace helpers {
             fn.rowsB = b.m_rows;
             fn.colsA = a.m_cols;
             fn.colsB = b.m_cols;
+            fn.ldA   = a.m_ld;
+            fn.ldB   = b.m_ld;
             fn.a     = a.m_data;
             fn.b     = b.m_data;
 
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + m_rows * m_cols,
-                m_dataVector->begin() + m_dataVectorOffset,
-                m_dataVector->begin() + m_dataVectorOffset,
-                fn
-                );
+            if (m_ld == m_rows) {
+                thrust::transform(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    m_dataVector->begin() + m_dataVectorOffset,
+                    fn
+                    );
+            }
+            else {
+                internal::StridedAddProductFn<internal::AddMatrixMultiplyTransposedBFn> st;
+                st.fn    = fn;
+                st.c     = m_data;
+                st.rowsC = m_rows;
+                st.ldC   = m_ld;
+                thrust::for_each(
+                    thrust::counting_iterator<int>(0),
+                    thrust::counting_iterator<int>(0) + m_rows * m_cols,
+                    st
+                    );
+            }
         }
     }
 
@@ -356,9 +500,9 @@ namespace helpers {
         cublas::multiplyMatrices(
             transposeA, transposeB,
             m_rows, m_cols, (transposeA ? a.m_rows : a.m_cols),
-            a.m_data, a.m_rows,
-            b.m_data, b.m_rows,
-            m_data,     m_rows,
+            a.m_data, a.m_ld,
+            b.m_data, b.m_ld,
+            m_data,     m_ld,
             false
             );
     }
@@ -369,9 +513,9 @@ namespace helpers {
         cublas::multiplyMatrices(
             transposeA, transposeB,
             m_rows, m_cols, (transposeA ? a.m_rows : a.m_cols),
-            a.m_data, a.m_rows,
-            b.m_data, b.m_rows,
-            m_data,     m_rows,
+            a.m_data, a.m_ld,
+            b.m_data, b.m_ld,
+            m_data,     m_ld,
             true
             );
     }
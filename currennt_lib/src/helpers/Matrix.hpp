@@ -39,10 +39,13 @@ namespace helpers {
         real_t      *m_data;
         int          m_rows;
         int          m_cols;
+        int          m_ld;              // leading dimension (column stride)
 
     public:
         Matrix();
-        Matrix(real_vector *data, int rows, int cols, int dataOffset = 0);
+        // Add 20181018: leadingDim > rows makes the matrix a sub-block of a larger matrix
+        //  (0: leadingDim = rows)
+        Matrix(real_vector *data, int rows, int cols, int dataOffset = 0, int leadingDim = 0);
         ~Matrix();
 
         void assignProduct(const Matrix<TDevice> &a, bool transposeA, const Matrix<TDevice> &b, bool transposeB);
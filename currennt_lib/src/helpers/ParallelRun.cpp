@@ -0,0 +1,155 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ParallelRun.hpp"
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <vector>
+#include <set>
+#include <string>
+#include <stdexcept>
+
+namespace {
+    
+    void runTask(helpers::parallel_task_fn_t taskFn, void *taskArg, const int taskIdx,
+		 std::string *errorMsg)
+    {
+	try{
+	    taskFn(taskArg, taskIdx);
+	}catch (const std::exception &e){
+	    *errorMsg = e.what();
+	    if (errorMsg->empty())
+		*errorMsg = "unknown error";
+	}
+    }
+    
+}
+
+namespace helpers {
+
+    void runParallel(parallel_task_fn_t taskFn, void *taskArg, const int taskNum)
+    {
+	if (taskNum < 1)
+	    return;
+	
+	std::vector<std::string> errorMsg(taskNum);
+	
+	boost::thread_group threads;
+	for (int i = 1; i < taskNum; i++)
+	    threads.create_thread(boost::bind(&runTask, taskFn, taskArg, i, &errorMsg[i]));
+	runTask(taskFn, taskArg, 0, &errorMsg[0]);
+	threads.join_all();
+
+	for (int i = 0; i < taskNum; i++)
+	    if (!errorMsg[i].empty())
+		throw std::runtime_error(errorMsg[i]);
+    }
+
+    struct async_tickets_t
+    {
+	boost::mutex              userMutex;
+	boost::mutex              mutex;
+	boost::condition_variable cond;
+	int                       staleness;
+	int                       nextTicket;
+	int                       lowWater;     // tickets < lowWater are all released
+	std::set<int>             released;     // released tickets >= lowWater
+	bool                      aborted;
+    };
+
+    AsyncTickets::AsyncTickets(const int staleness)
+    {
+	async_tickets_t *t = new async_tickets_t;
+	t->staleness  = staleness;
+	t->nextTicket = 0;
+	t->lowWater   = 0;
+	t->aborted    = false;
+	m_impl = t;
+    }
+
+    AsyncTickets::~AsyncTickets()
+    {
+	delete static_cast<async_tickets_t*>(m_impl);
+    }
+
+    void AsyncTickets::lock()
+    {
+	static_cast<async_tickets_t*>(m_impl)->userMutex.lock();
+    }
+
+    void AsyncTickets::unlock()
+    {
+	static_cast<async_tickets_t*>(m_impl)->userMutex.unlock();
+    }
+
+    int AsyncTickets::take()
+    {
+	async_tickets_t *t = static_cast<async_tickets_t*>(m_impl);
+	boost::mutex::scoped_lock lock(t->mutex);
+	return t->nextTicket++;
+    }
+
+    bool AsyncTickets::wait(const int ticket)
+    {
+	async_tickets_t *t = static_cast<async_tickets_t*>(m_impl);
+	boost::mutex::scoped_lock lock(t->mutex);
+	if (t->staleness > 0)
+	    while (!t->aborted && t->lowWater < ticket - t->staleness)
+		t->cond.wait(lock);
+	return !t->aborted;
+    }
+
+    void AsyncTickets::release(const int ticket)
+    {
+	async_tickets_t *t = static_cast<async_tickets_t*>(m_impl);
+	boost::mutex::scoped_lock lock(t->mutex);
+	t->released.insert(ticket);
+	while (!t->released.empty() && *(t->released.begin()) == t->lowWater){
+	    t->released.erase(t->released.begin());
+	    t->lowWater++;
+	}
+	t->cond.notify_all();
+    }
+
+    void AsyncTickets::abort()
+    {
+	async_tickets_t *t = static_cast<async_tickets_t*>(m_impl);
+	boost::mutex::scoped_lock lock(t->mutex);
+	t->aborted = true;
+	t->cond.notify_all();
+    }
+
+    bool AsyncTickets::aborted()
+    {
+	async_tickets_t *t = static_cast<async_tickets_t*>(m_impl);
+	boost::mutex::scoped_lock lock(t->mutex);
+	return t->aborted;
+    }
+    
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_PARALLELRUN_HPP
+#define HELPERS_PARALLELRUN_HPP
+
+/*
+ * Run a task in several host threads and wait for all of them
+ *
+ *  The thread library is only used in ParallelRun.cpp, so that the header can be
+ *  included by the .cu files (nvcc hates boost headers)
+ */
+
+namespace helpers {
+
+    // task function: taskFn(taskArg, taskIdx)
+    typedef void (*parallel_task_fn_t)(void *taskArg, const int taskIdx);
+    
+    /**
+     * Runs taskFn(taskArg, i) for i = 0 ... taskNum-1 in parallel
+     *  task 0 is executed in the calling thread, others in new threads.
+     *  If any of the tasks throws, a std::runtime_error with the message of 
+     *  the task with the smallest index is thrown after all the tasks are done
+     *
+     * @param taskFn   the task function
+     * @param taskArg  argument shared by all the tasks
+     * @param taskNum  number of tasks
+     */
+    void runParallel(parallel_task_fn_t taskFn, void *taskArg, const int taskNum);
+
+    /**
+     * Add 20181018: tickets for the asynchronous training
+     *  take() gives the tickets 0, 1, 2 ... in order, and release() marks a ticket as done.
+     *  With a staleness bound S > 0, wait(n) blocks until tickets 0 ... n-S-1 are released.
+     *  lock() and unlock() protect the resources shared by the threads (e.g. the data set)
+     */
+    class AsyncTickets
+    {
+    private:
+	void *m_impl;
+	
+    public:
+	AsyncTickets(const int staleness);
+	~AsyncTickets();
+
+	void lock();
+	void unlock();
+
+	// a new ticket
+	int  take();
+
+	// wait for the staleness bound. Return false if abort() has been called
+	bool wait(const int ticket);
+	
+	void release(const int ticket);
+
+	// wake up and stop all the threads (e.g. one of them failed)
+	void abort();
+	bool aborted();
+    };
+    
+}
+
+#endif
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_FUSEDFOREACH_CUH
+#define HELPERS_FUSEDFOREACH_CUH
+
+#include "../Types.hpp"
+#include "ParallelRun.hpp"
+
+#include <thrust/for_each.h>
+#include <thrust/tuple.h>
+#include <thrust/iterator/zip_iterator.h>
+#include <thrust/iterator/counting_iterator.h>
+
+#include <algorithm>
+
+/*
+ * One pass over a flat arena made of segments (one segment per layer):
+ *  fn(thrust::tuple<real_t&, const int&>) is called for each element with its index.
+ *  fn.seg is the segment of the elements of the call, or -1 if the elements of
+ *  the pass belong to different segments (fn then finds it by findSegment()).
+ *  This replaces many small per-layer passes by one.
+ *  GPU: one kernel
+ *  CPU: the arena is split into chunks processed by several host threads, and a
+ *       chunk is processed segment by segment (no search)
+ */
+
+namespace helpers {
+namespace fused {
+
+    // minimum number of elements for one CPU thread (thread creation is not free)
+    const int CHUNK_MIN = 1 << 16;
+
+    // segment that element idx belongs to, start[0..num] are the boundaries of the
+    // segments (binary search, the table has one entry per layer and stays in cache;
+    // the neighbouring threads of a warp take the same path)
+    __host__ __device__ inline int findSegment(const int *start, const int num, const int idx)
+    {
+	int lo = 0;
+	int hi = num - 1;
+	while (lo < hi){
+	    int mid = (lo + hi + 1) / 2;
+	    if (start[mid] <= idx)
+		lo = mid;
+	    else
+		hi = mid - 1;
+	}
+	return lo;
+    }
+    
+    template <typename TFn>
+    struct chunk_task_t {
+	Cpu::real_vector *arena;
+	const int        *segStart;
+	int               segNum;
+	const TFn        *fn;
+	int               num;
+	int               chunkNum;
+    };
+    
+    template <typename TFn>
+    void runChunk(void *taskArg, const int chunkIdx)
+    {
+	chunk_task_t<TFn> *t = static_cast<chunk_task_t<TFn>*>(taskArg);
+	int s = (int)((long int)t->num * chunkIdx       / t->chunkNum);
+	int e = (int)((long int)t->num * (chunkIdx + 1) / t->chunkNum);
+	TFn fn = *(t->fn);
+	for (int seg = findSegment(t->segStart, t->segNum, s);
+	     seg < t->segNum && t->segStart[seg] < e; seg++){
+	    int segS = std::max(s, t->segStart[seg]);
+	    int segE = std::min(e, t->segStart[seg + 1]);
+	    fn.seg   = seg;
+	    thrust::for_each(
+	     thrust::make_zip_iterator(thrust::make_tuple(t->arena->begin() + segS,
+							  thrust::counting_iterator<int>(segS))),
+	     thrust::make_zip_iterator(thrust::make_tuple(t->arena->begin() + segE,
+							  thrust::counting_iterator<int>(segE))),
+	     fn);
+	}
+    }
+
+    // segStart: the segNum + 1 boundaries of the segments, in the memory of the device
+    template <typename TFn>
+    void forEach(Cpu::real_vector &arena, const int *segStart, const int segNum,
+		 const int num, const TFn &fn, const int threadNum)
+    {
+	if (num < 1 || segNum < 1)
+	    return;
+	chunk_task_t<TFn> task;
+	task.arena    = &arena;
+	task.segStart = segStart;
+	task.segNum   = segNum;
+	task.fn       = &fn;
+	task.num      = num;
+	task.chunkNum = std::max(1, std::min(threadNum, num / CHUNK_MIN));
+	if (task.chunkNum == 1)
+	    runChunk<TFn>(&task, 0);
+	else
+	    helpers::runParallel(&runChunk<TFn>, &task, task.chunkNum);
+    }
+
+    template <typename TFn>
+    void forEach(Gpu::real_vector &arena, const int *segStart, const int segNum,
+		 const int num, const TFn &fn, const int threadNum)
+    {
+	if (num < 1 || segNum < 1)
+	    return;
+	TFn kernelFn = fn;
+	kernelFn.seg = -1;
+	thrust::for_each(
+	    thrust::make_zip_iterator(thrust::make_tuple(arena.begin(),
+							 thrust::counting_iterator<int>(0))),
+	    thrust::make_zip_iterator(thrust::make_tuple(arena.begin() + num,
+							 thrust::counting_iterator<int>(num))),
+	    kernelFn);
+    }
+    
+}
+}
+
+#endif
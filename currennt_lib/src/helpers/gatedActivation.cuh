@@ -0,0 +1,159 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_GATEDACTIVATION_CUH
+#define HELPERS_GATEDACTIVATION_CUH
+
+#include "../activation_functions/Tanh.cuh"
+#include "vecMath.cuh"
+
+/*
+ * Gated activation of the WaveNet core, for num channels of one time step
+ *  tanh half at x[0:num], sigmoid half at x[half:half+num]
+ *
+ *  gatedForward:  a_tanh = conv_tanh + tanh(proj_tanh), a_sig = conv_sig + tanh(proj_sig)
+ *                 out    = tanh(a_tanh) * sigmoid(a_sig)
+ *                 proj is NULL without context. The pre-activations and tanh(proj)
+ *                 are stored if coreBuf and contextTanh are not NULL (training)
+ *  gatedBackward: gradients of both halves w.r.t. the conv outputs to preErrors,
+ *                 contextTanh (if not NULL) is replaced by the gradients w.r.t. proj
+ *
+ * GPU: num = 1, one thread per channel. CPU: num = layer size, the loops run over
+ * contiguous channels with the branches of the time step taken once. The buffers
+ * must not overlap (__restrict__), and tanh/sigmoid are the branch-free vecTanh and
+ * vecLogistic on the host (helpers/vecMath.cuh), so that the loops are vectorized
+ * with the default flags
+ */
+
+namespace helpers {
+
+    // the tests of the buffers are taken out of the loop by the template arguments
+    //  TStore: 0, nothing is stored; 1, coreBuf; 2, coreBuf and contextTanh
+    template <typename T, bool TWithProj, int TStore>
+    static inline __host__ __device__ void gatedForwardLoop(const int num, const int half,
+							    const T *__restrict__ fromConv,
+							    const T *__restrict__ proj,
+							    T *__restrict__ coreBuf,
+							    T *__restrict__ contextTanh,
+							    T *__restrict__ out)
+    {
+	for (int i = 0; i < num; ++i){
+	    T conTanh = (TWithProj ? vecTanh(proj[i])        : (T)0.0);
+	    T conSig  = (TWithProj ? vecTanh(proj[i + half]) : (T)0.0);
+	    T actTanh = fromConv[i]        + conTanh;
+	    T actSig  = fromConv[i + half] + conSig;
+	    if (TStore > 0){
+		coreBuf[i]        = actTanh;
+		coreBuf[i + half] = actSig;
+	    }
+	    if (TStore > 1){
+		contextTanh[i]        = conTanh;
+		contextTanh[i + half] = conSig;
+	    }
+	    out[i] = vecTanh(actTanh) * vecLogistic(actSig);
+	}
+    }
+
+    // contextTanh is only stored together with coreBuf
+    template <typename T>
+    static inline __host__ __device__ void gatedForward(const int num, const int half,
+							const T *fromConv, const T *proj,
+							T *coreBuf, T *contextTanh, T *out)
+    {
+	if (coreBuf && contextTanh){
+	    if (proj)
+		gatedForwardLoop<T, true,  2>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	    else
+		gatedForwardLoop<T, false, 2>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	}else if (coreBuf){
+	    if (proj)
+		gatedForwardLoop<T, true,  1>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	    else
+		gatedForwardLoop<T, false, 1>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	}else{
+	    if (proj)
+		gatedForwardLoop<T, true,  0>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	    else
+		gatedForwardLoop<T, false, 0>(num, half, fromConv, proj, coreBuf, contextTanh, out);
+	}
+    }
+
+    template <typename T, bool TWithContext>
+    static inline __host__ __device__ void gatedBackwardLoop(const int num, const int half,
+							     const T *__restrict__ coreBuf,
+							     const T *__restrict__ errors,
+							     T *__restrict__ preErrors,
+							     T *__restrict__ contextTanh)
+    {
+	for (int i = 0; i < num; ++i){
+	    /* Note: Tanh::deriv(y) requires y = tanh(x) */
+	    T tmpTanh  = vecTanh(coreBuf[i]);
+	    T tmpSig   = vecLogistic(coreBuf[i + half]);
+	    T gradTanh = ((T)1.0 - tmpTanh * tmpTanh) * tmpSig * errors[i];
+	    T gradSig  = tmpTanh * (tmpSig * ((T)1.0 - tmpSig)) * errors[i];
+	    preErrors[i]        = gradTanh;
+	    preErrors[i + half] = gradSig;
+	    if (TWithContext){
+		contextTanh[i]        = activation_functions::Tanh::deriv(contextTanh[i]) * gradTanh;
+		contextTanh[i + half] = (activation_functions::Tanh::deriv(contextTanh[i + half]) *
+					 gradSig);
+	    }
+	}
+    }
+
+    template <typename T>
+    static inline __host__ __device__ void gatedBackward(const int num, const int half,
+							 const T *coreBuf, const T *errors,
+							 T *preErrors, T *contextTanh)
+    {
+	if (contextTanh)
+	    gatedBackwardLoop<T, true>(num, half, coreBuf, errors, preErrors, contextTanh);
+	else
+	    gatedBackwardLoop<T, false>(num, half, coreBuf, errors, preErrors, contextTanh);
+    }
+
+    // zero output and zero gradients of a dummy time step
+    template <typename T>
+    static inline __host__ __device__ void gatedZero(const int num, const int half, T *a, T *b)
+    {
+	if (a){
+	    for (int i = 0; i < num; ++i){
+		a[i]        = 0.0;
+		a[i + half] = 0.0;
+	    }
+	}
+	if (b){
+	    for (int i = 0; i < num; ++i){
+		b[i]        = 0.0;
+		b[i + half] = 0.0;
+	    }
+	}
+    }
+    
+}
+
+#endif
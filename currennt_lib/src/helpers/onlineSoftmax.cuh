@@ -0,0 +1,153 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_ONLINESOFTMAX_CUH
+#define HELPERS_ONLINESOFTMAX_CUH
+
+#include "vecMath.cuh"
+
+/*
+ * Softmax over a contiguous vector x[0:n] on the host (one call per pattern)
+ *  1. softmaxMax:    the maximum of x
+ *  2. softmaxExpSum: y_i = exp(x_i - max), and sum_i y_i
+ *  3. softmaxScale:  y_i = y_i / sum
+ * Each step is a loop without branches (vecExp, the maximum over the ordered bits of
+ * the floats, and partial sums), which GCC vectorizes with the default flags.
+ * x and y may point to the same buffer.
+ *
+ * On the GPU, the layers keep one thread per element for the exp and the
+ * normalization (see SoftmaxLayer and MDNUnit_softmax)
+ *
+ * softmaxJacobianOffset is sum_i y_i * e_i of the softmax Jacobian
+ * softmaxCEGrad is the gradient of the cross-entropy -log y_target w.r.t. the
+ * softmax input: y_i - 1 if i is the target, y_i otherwise
+ */
+
+#define SOFTMAX_PARTIAL_SUM 8
+
+namespace helpers {
+
+    template <typename T>
+    static inline __host__ __device__ T softmaxMax(const T *x, const int n)
+    {
+	if (n < 1)
+	    return 0;
+	T maxValue = x[0];
+	for (int i = 1; i < n; ++i)
+	    maxValue = (x[i] > maxValue) ? x[i] : maxValue;
+	return maxValue;
+    }
+
+    static inline __host__ __device__ float softmaxMax(const float *x, const int n)
+    {
+	if (n < 1)
+	    return 0;
+#ifdef __CUDA_ARCH__
+	float maxValue = x[0];
+	for (int i = 1; i < n; ++i)
+	    maxValue = fmaxf(maxValue, x[i]);
+	return maxValue;
+#else
+	// the bits b of a float are mapped to b ^ ((b >> 31) & 0x7fffffff), which are
+	// ordered as the floats, and the maximum over them is an integer reduction
+	int maxBits = ~0x7fffffff;
+	for (int i = 0; i < n; ++i){
+	    int bits;
+	    std::memcpy(&bits, x + i, sizeof(float));
+	    bits   ^= (bits >> 31) & 0x7fffffff;
+	    maxBits = (bits > maxBits) ? bits : maxBits;
+	}
+	maxBits ^= (maxBits >> 31) & 0x7fffffff;
+	float maxValue;
+	std::memcpy(&maxValue, &maxBits, sizeof(float));
+	return maxValue;
+#endif
+    }
+
+    template <typename T>
+    static inline __host__ __device__ T softmaxExpSum(const T *x, T *y, const int n,
+						      const T maxValue)
+    {
+	T part[SOFTMAX_PARTIAL_SUM];
+	for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k)
+	    part[k] = 0;
+	
+	int i = 0;
+	for (; i + SOFTMAX_PARTIAL_SUM <= n; i += SOFTMAX_PARTIAL_SUM){
+	    for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k){
+		T e = vecExp(x[i + k] - maxValue);
+		y[i + k] = e;
+		part[k] += e;
+	    }
+	}
+	T sum = 0;
+	for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k)
+	    sum += part[k];
+	for (; i < n; ++i){
+	    y[i] = vecExp(x[i] - maxValue);
+	    sum += y[i];
+	}
+	return sum;
+    }
+
+    template <typename T>
+    static inline __host__ __device__ void softmaxScale(T *y, const int n, const T sum)
+    {
+	T normFact = 1 / sum;
+	for (int i = 0; i < n; ++i)
+	    y[i] *= normFact;
+    }
+
+    template <typename T>
+    static inline __host__ __device__ T softmaxJacobianOffset(const T *y, const T *e,
+							      const int n)
+    {
+	T part[SOFTMAX_PARTIAL_SUM];
+	for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k)
+	    part[k] = 0;
+	
+	int i = 0;
+	for (; i + SOFTMAX_PARTIAL_SUM <= n; i += SOFTMAX_PARTIAL_SUM)
+	    for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k)
+		part[k] += y[i + k] * e[i + k];
+	T offset = 0;
+	for (int k = 0; k < SOFTMAX_PARTIAL_SUM; ++k)
+	    offset += part[k];
+	for (; i < n; ++i)
+	    offset += y[i] * e[i];
+	return offset;
+    }
+
+    template <typename T>
+    static inline __host__ __device__ T softmaxCEGrad(const T prob, const bool isTarget)
+    {
+	return isTarget ? (prob - 1) : prob;
+    }
+    
+}
+
+#endif
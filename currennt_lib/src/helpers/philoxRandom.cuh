@@ -0,0 +1,146 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_PHILOXRANDOM_CUH
+#define HELPERS_PHILOXRANDOM_CUH
+
+#include "../Types.hpp"
+#include <string>
+
+/*
+ * Counter-based random number generator (Philox4x32-10)
+ *  random(key, counter): 10 rounds of multiply-xor over the 4x32bit counter
+ *    key:      (random seed, stream ID)
+ *    counter:  (element index, epoch, fraction, sub-stream)
+ *
+ *  The random number of each element only depends on the key and counter. It can be
+ *  generated in any thread and in any order, and it is reproducible across
+ *  devices and thread numbers (no engine state is shared)
+ */
+
+namespace helpers {
+namespace philox {
+
+    // key and counter (except the element index) of one random stream
+    struct stream_t {
+	unsigned int seed;      // random seed
+	unsigned int stream;    // stream ID (layer, data set, ...)
+	unsigned int epoch;     // training epoch
+	unsigned int frac;      // fraction index
+	unsigned int sub;       // sub-stream, e.g. number of fractions loaded
+    };
+
+    static inline __host__ __device__ unsigned int mulhilo(const unsigned int a,
+							    const unsigned int b,
+							    unsigned int &hi)
+    {
+	unsigned long long prod = (unsigned long long)a * (unsigned long long)b;
+	hi = (unsigned int)(prod >> 32);
+	return (unsigned int)prod;
+    }
+
+    // Philox4x32-10, ctr is overwritten by the random bits
+    static inline __host__ __device__ void philox4x32(unsigned int *ctr,
+						       unsigned int key0, unsigned int key1)
+    {
+	unsigned int hi0, hi1, lo0, lo1;
+	for (int round = 0; round < 10; round++){
+	    lo0    = mulhilo(0xD2511F53, ctr[0], hi0);
+	    lo1    = mulhilo(0xCD9E8D57, ctr[2], hi1);
+	    ctr[0] = hi1 ^ ctr[1] ^ key0;
+	    ctr[1] = lo1;
+	    ctr[2] = hi0 ^ ctr[3] ^ key1;
+	    ctr[3] = lo0;
+	    key0  += 0x9E3779B9;
+	    key1  += 0xBB67AE85;
+	}
+    }
+
+    // 4 random unsigned integers for the index-th element of the stream
+    static inline __host__ __device__ void random4(const stream_t &s, const unsigned int index,
+						    unsigned int *out)
+    {
+	out[0] = index;
+	out[1] = s.epoch;
+	out[2] = s.frac;
+	out[3] = s.sub;
+	philox4x32(out, s.seed, s.stream);
+    }
+
+    // uniform in (0, 1), both ends excluded
+    static inline __host__ __device__ real_t toUniform(const unsigned int x)
+    {
+	return ((real_t)(x >> 8) + (real_t)0.5) * (real_t)(1.0 / 16777216.0);
+    }
+
+    // uniform in (a, b)
+    static inline __host__ __device__ real_t uniform(const stream_t &s, const unsigned int index,
+						      const real_t a = 0.0, const real_t b = 1.0)
+    {
+	unsigned int r[4];
+	random4(s, index, r);
+	return a + (b - a) * toUniform(r[0]);
+    }
+
+    // normal N(mean, std^2), Box-Muller
+    static inline __host__ __device__ real_t normal(const stream_t &s, const unsigned int index,
+						     const real_t mean = 0.0, const real_t std = 1.0)
+    {
+	unsigned int r[4];
+	random4(s, index, r);
+	real_t u1 = toUniform(r[0]);
+	real_t u2 = toUniform(r[1]);
+	return mean + std * sqrt((real_t)-2.0 * log(u1)) * cos((real_t)6.283185307179586 * u2);
+    }
+
+    // stream ID from a name (FNV-1a)
+    static inline unsigned int streamId(const std::string &name)
+    {
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < name.size(); i++){
+	    hash ^= (unsigned char)name[i];
+	    hash *= 16777619u;
+	}
+	return hash;
+    }
+
+    static inline stream_t makeStream(const unsigned int seed, const unsigned int stream,
+				      const int epoch, const int frac, const unsigned int sub)
+    {
+	stream_t s;
+	s.seed   = seed;
+	s.stream = stream;
+	s.epoch  = (unsigned int)epoch;
+	s.frac   = (unsigned int)frac;
+	s.sub    = sub;
+	return s;
+    }
+
+}
+}
+
+#endif
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef HELPERS_VECMATH_CUH
+#define HELPERS_VECMATH_CUH
+
+#include "../activation_functions/Tanh.cuh"
+#include "../activation_functions/Logistic.cuh"
+
+#ifndef __CUDA_ARCH__
+#include <cstring>
+#endif
+
+/*
+ * Branch-free exp, logistic and tanh for the loops over contiguous vectors on the host
+ *
+ *  vecExp(x) = exp(x) for |x| <= 86, the input is clamped to [-86, 86] otherwise.
+ *  The argument is reduced to x = n * ln2 + r (|r| <= ln2/2), exp(r) is the polynomial
+ *  of Cephes expf, and 2^n is added to the exponent bits. The clamp is done on the bits,
+ *  as a comparison of floats blocks the if-conversion of GCC without -ffast-math.
+ *  Thus, the loops that use these functions are vectorized with the default flags
+ *  (relative error < 1e-7 w.r.t. exp).
+ *
+ *  On the device, vecLogistic and vecTanh are the activation functions, and vecExp is
+ *  exp of the clamped input
+ */
+
+namespace helpers {
+
+    static inline __host__ __device__ float vecExp(float x)
+    {
+#ifdef __CUDA_ARCH__
+	return exp(fminf(fmaxf(x, -86.0f), 86.0f));
+#else
+	// clamp |x| to 86 (0x42ac0000)
+	int xBits;
+	std::memcpy(&xBits, &x, sizeof(float));
+	xBits = (((xBits & 0x7fffffff) > 0x42ac0000) ?
+		 ((xBits & ~0x7fffffff) | 0x42ac0000) : xBits);
+	std::memcpy(&x, &xBits, sizeof(float));
+
+	// n = round(x / ln2) by the 1.5 * 2^23 shifter, r = x - n * ln2 (Cody-Waite)
+	float shifted = x * 1.44269504088896341f + 12582912.0f;
+	float n       = shifted - 12582912.0f;
+	int   nBits;
+	std::memcpy(&nBits, &shifted, sizeof(float));
+	nBits        -= 0x4b400000;
+	float r       = x - n * 0.693359375f + n * 2.12194440e-4f;
+
+	float p = 1.9875691500e-4f;
+	p = p * r + 1.3981999507e-3f;
+	p = p * r + 8.3334519073e-3f;
+	p = p * r + 4.1665795894e-2f;
+	p = p * r + 1.6666665459e-1f;
+	p = p * r + 5.0000001201e-1f;
+	p = p * r * r + r + 1.0f;
+
+	int pBits;
+	std::memcpy(&pBits, &p, sizeof(float));
+	pBits += (nBits << 23);
+	std::memcpy(&p, &pBits, sizeof(float));
+	return p;
+#endif
+    }
+
+    static inline __host__ __device__ double vecExp(double x)
+    {
+	return exp(x < -700.0 ? -700.0 : (x > 700.0 ? 700.0 : x));
+    }
+
+    template <typename T>
+    static inline __host__ __device__ T vecLogistic(const T x)
+    {
+#ifdef __CUDA_ARCH__
+	return activation_functions::Logistic::fn(x);
+#else
+	return (T)1.0 / ((T)1.0 + vecExp(-x));
+#endif
+    }
+
+    template <typename T>
+    static inline __host__ __device__ T vecTanh(const T x)
+    {
+#ifdef __CUDA_ARCH__
+	return activation_functions::Tanh::fn(x);
+#else
+	// same as Tanh: 2 * logistic(2x) - 1
+	return (T)2.0 / ((T)1.0 + vecExp((T)-2.0 * x)) - (T)1.0;
+#endif
+    }
+    
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include "../helpers/getRawPointer.cuh"
 #include "../helpers/Matrix.hpp"
 #include "../helpers/JsonClasses.hpp"
+#include "../MacroDefine.hpp"
 
 #include <thrust/transform.h>
 #include <thrust/transform_reduce.h>
@@ -50,103 +51,59 @@
 namespace internal{
 namespace {
 
-    struct BatchSize
-    {
-	// over time t * parallel sentence
-	const char *patTypes;
-	
-	__host__ __device__ real_t operator() (const thrust::tuple<const real_t&, int> &t) const
-	{
-	    int timeIdx = t.get<1>();
-	    if (patTypes[timeIdx] == PATTYPE_NONE)
-		return 0.0;// skip dummy node
-	    else
-		return 1.0;
-	}
-    };
-    
-    struct PrepareForMeanStd
+    // Add 20181010: statistics of one block of frames
+    //  the frames are split into blocks of NN_BATCHNORM_BLOCK_FRAMES frames, and each
+    //  thread handles one (block, dimension). Threads of neighbouring dimensions read
+    //  contiguous memory of the same frame
+    struct ComputeBlockMeanStd
     {
 	int layerSize;
-	bool   meanNotVar;
+	int frameNM;            // frame * parallel
+	int blockNM;            // number of blocks
 
-	
-	const char *patTypes;   
-	real_t     *data;
-	real_t     *outdata;
-	real_t     *mean;
-	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-	{
-	    int dataIdx = t.get<1>();
-	    int timeIdx = dataIdx / layerSize;
-	    int dimIdx  = dataIdx % layerSize;
-	    if (patTypes[timeIdx] == PATTYPE_NONE){
-		// skip dummy node
-		outdata[dataIdx] = 0.0; //
-	    }else{
-		if (meanNotVar)
-		    outdata[dataIdx] = data[dataIdx]; //
-		else
-		    outdata[dataIdx] = (data[dataIdx]-mean[dimIdx]) * (data[dataIdx]-mean[dimIdx]);
-	    }
-	}
-    };
-    struct PrepareGrad
-    {
-	int    layerSize;
-	bool   alphaNotBeta;
 	const char *patTypes;   
-	real_t     *grad;
-	real_t     *buff;
 	real_t     *data;
+	real_t     *blockStats; // [cnt, mean, M2] x blockNM x layerSize
 	
 	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
 	{
-	    int dataIdx = t.get<1>();
-	    int timeIdx = dataIdx / layerSize;
-	    if (patTypes[timeIdx] == PATTYPE_NONE){
-		buff[dataIdx] = 0.0; // skip dummy node
-	    }else{
-		if (alphaNotBeta)
-		    buff[dataIdx] = grad[dataIdx] * data[dataIdx];
-		else
-		    buff[dataIdx] = grad[dataIdx];
-	    }
-	}
-    };
+	    int blockIdx = t.get<1>() / layerSize;
+	    int dimIdx   = t.get<1>() % layerSize;
 
-    struct GetStd
-    {
-	real_t  stdConst;
-	real_t *meanStd;
-	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-	{
-	    int dimIdx = t.get<1>();
-	    meanStd[dimIdx] = sqrt(meanStd[dimIdx]+stdConst);
+	    int frameS   = blockIdx * NN_BATCHNORM_BLOCK_FRAMES;
+	    int frameE   = frameS + NN_BATCHNORM_BLOCK_FRAMES;
+	    frameE       = (frameE < frameNM) ? frameE : frameNM;
+	    
+	    real_t mean   = 0.0;
+	    real_t m2     = 0.0;
+	    real_t delta  = 0.0;
+	    real_t cnt    = 0.0;
+	    int    idx    = 0;
+
+	    // online algorithm to compute mean, var (Welford)
+	    for (int n = frameS; n < frameE; n++){
+		if (patTypes[n] == PATTYPE_NONE)
+		    continue; // skip dummy node
+		idx    = layerSize * n + dimIdx;
+		cnt   += 1.0;
+		delta  = data[idx] - mean;
+		mean  += delta / cnt;
+		m2    += delta * (data[idx] - mean);
+	    }
+	    blockStats[t.get<1>()]                           = cnt;
+	    blockStats[t.get<1>() + blockNM * layerSize]     = mean;
+	    blockStats[t.get<1>() + blockNM * layerSize * 2] = m2;
 	}
     };
 
-    struct AveMeanStd
-    {
-	real_t *meanStd;
-	real_t *meanStdBuf;
-	real_t  cnt;
-	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-	{
-	    int dimIdx = t.get<1>();
-	    meanStdBuf[dimIdx] += (meanStd[dimIdx] - meanStdBuf[dimIdx]) / cnt;
-	}
-    };
-    
-    
-    struct ComputeBatchMeanStd
+    // Add 20181010: merge the block statistics of one dimension
+    struct MergeBlockMeanStd
     {
 	int layerSize;
-	int frameNM;            // frame * parallel
+	int blockNM;
 	real_t  stdConst;
 
-	const char *patTypes;   
-	real_t     *data;
+	real_t     *blockStats;
 	real_t     *meanStd;
 	
 	real_t     *meanStdBuf;	
@@ -158,36 +115,28 @@ namespace {
 	    int dimIdx = t.get<1>();
 
 	    real_t mean   = 0.0;
-	    real_t var    = 0.0;
+	    real_t m2     = 0.0;
+	    real_t cnt    = 0.0;
 	    real_t delta  = 0.0;
-	    real_t delta2 = 0.0;
-
-	    int cnt = 0;
-	    int idx = 0;
-
-	    // online algorithm to compute mean, var
-	    for (int n = 0; n < frameNM; n++){
-		idx = layerSize * n + dimIdx;
-		if (patTypes[n] == PATTYPE_NONE){
-		    // skip dummy node
-		}else{
-		    cnt++;
-		    delta  = data[idx] - mean;
-		    mean  += delta/cnt;
-		    delta2 = data[idx] - mean;
-		    var   += delta * delta2;
-		}
+	    real_t bCnt   = 0.0;
+	    int    idx    = 0;
+
+	    // pairwise merge of (cnt, mean, M2), in a fixed order of blocks
+	    for (int b = 0; b < blockNM; b++){
+		idx  = b * layerSize + dimIdx;
+		bCnt = blockStats[idx];
+		if (bCnt < 1.0)
+		    continue;
+		delta = blockStats[idx + blockNM * layerSize] - mean;
+		cnt  += bCnt;
+		mean += delta * bCnt / cnt;
+		m2   += blockStats[idx + blockNM * layerSize * 2] +
+		    delta * delta * (cnt - bCnt) * bCnt / cnt;
 	    }
-	    if (cnt < 2){
-		mean = 0.0;
-		var  = 1.0;
-	    }else{
-		var  = var / cnt;
-	    }
-
+	    
 	    // save mean, std, and number of frames
 	    meanStd[dimIdx]                 = mean;
-	    meanStd[dimIdx + layerSize]     = sqrt(var + stdConst);
+	    meanStd[dimIdx + layerSize]     = sqrt(((cnt < 1.0) ? 0.0 : (m2 / cnt)) + stdConst);
 	    meanStd[dimIdx + layerSize * 2] = cnt;
 
 	    // If training, to accumulat the mean, std, for generation stage
@@ -236,34 +185,64 @@ namespace {
 
 
     
-    struct ComputeBatchGradient_alphabeta
+    // Add 20181010: partial sums of \deltaE/\delta{\alpha} and \deltaE/\delta{\beta}
+    //  over one block of frames, for one dimension
+    struct ComputeBlockGradient_alphabeta
     {
 	int     layerSize;
 	int     frameNM;            // frame * parallel
+	int     blockNM;
 
 	const char *patTypes;   
 	real_t     *outNormed;
 	real_t     *errors;
-	real_t     *grad;
+	real_t     *blockStats;     // [alpha, beta] x blockNM x layerSize
 	
 	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
 	{
-	    int dimIdx = t.get<1>();
+	    int blockIdx = t.get<1>() / layerSize;
+	    int dimIdx   = t.get<1>() % layerSize;
+
+	    int frameS   = blockIdx * NN_BATCHNORM_BLOCK_FRAMES;
+	    int frameE   = frameS + NN_BATCHNORM_BLOCK_FRAMES;
+	    frameE       = (frameE < frameNM) ? frameE : frameNM;
 
 	    real_t bufAlpha = 0.0;
 	    real_t bufBeta  = 0.0;
 
 	    int idx = 0;
-	    for (int n = 0; n < frameNM; n++){
+	    for (int n = frameS; n < frameE; n++){
+		if (patTypes[n] == PATTYPE_NONE)
+		    continue; // skip dummy node
 		idx = layerSize * n + dimIdx;
-		if (patTypes[n] == PATTYPE_NONE){
-		    // skip dummy node
-		}else{
-		    // sum_i \deltaE/\delta{y}_i * \hat{x}_i 
-		    bufAlpha += errors[idx] * outNormed[idx];
-		    // sum_i \deltaE/\delta{y}_i 
-		    bufBeta  += errors[idx];
-		}
+		// sum_i \deltaE/\delta{y}_i * \hat{x}_i 
+		bufAlpha += errors[idx] * outNormed[idx];
+		// sum_i \deltaE/\delta{y}_i 
+		bufBeta  += errors[idx];
+	    }
+	    blockStats[t.get<1>()]                       = bufAlpha;
+	    blockStats[t.get<1>() + blockNM * layerSize] = bufBeta;
+	}
+    };
+
+    // Add 20181010: sum the partial gradients of the blocks
+    struct MergeBlockGradient_alphabeta
+    {
+	int     layerSize;
+	int     blockNM;
+
+	real_t     *blockStats;
+	real_t     *grad;
+	
+	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+	{
+	    int dimIdx = t.get<1>();
+
+	    real_t bufAlpha = 0.0;
+	    real_t bufBeta  = 0.0;
+	    for (int b = 0; b < blockNM; b++){
+		bufAlpha += blockStats[b * layerSize + dimIdx];
+		bufBeta  += blockStats[b * layerSize + dimIdx + blockNM * layerSize];
 	    }
 	    grad[dimIdx]               = bufAlpha;
 	    grad[dimIdx + layerSize]   = bufBeta;
@@ -271,7 +250,6 @@ namespace {
 	    // slots for mean, std (to be output)
 	    grad[dimIdx + 2*layerSize] = 0;
 	    grad[dimIdx + 3*layerSize] = 0;
-	    
 	}
     };
     
@@ -320,8 +298,10 @@ namespace layers{
     BatchNormLayer<TDevice>::BatchNormLayer(const helpers::JsonValue &layerChild, 
 					    const helpers::JsonValue &weightsSection, 
 					    Layer<TDevice> &precedingLayer,
-					    int maxSeqLength)
-        : TrainableLayer<TDevice>(layerChild, weightsSection, 0, 4, precedingLayer, maxSeqLength)
+					    int maxSeqLength,
+					    typename TDevice::real_vector *sharedWeights)
+        : TrainableLayer<TDevice>(layerChild, weightsSection, 0, 4,
+                                  precedingLayer, maxSeqLength, sharedWeights)
     {
 	// Trainable parameters: alpha + beta, for each dimension of previous output
 	if (this->size() != precedingLayer.size()){
@@ -339,12 +319,11 @@ namespace layers{
 	tmp.resize(this->size() * 3, 0.0); 
 	m_stats     = tmp;
 
-	// all-one vector for vector summation
-	tmp.resize(this->outputs().size()/this->size(), 1.0);
-	m_oneVector = tmp;
-
-	// a tempopary buff
-	m_buff = this->outputs();
+	// statistics of each block of frames
+	m_blockNM   = ((this->outputs().size() / this->size() + NN_BATCHNORM_BLOCK_FRAMES - 1) /
+		       NN_BATCHNORM_BLOCK_FRAMES);
+	tmp.resize(m_blockNM * this->size() * 3, 0.0);
+	m_blockStats = tmp;
 	
 	// initialize scale parameter
 	if (weightsSection.isValid() && weightsSection->HasMember(this->name().c_str())) {
@@ -361,7 +340,7 @@ namespace layers{
 	//const Configuration &config = Configuration::instance();
 	//m_trainFlag = config.trainingMode();
 	
-	if (this->precedingLayer().getSaveMemoryFlag())
+	if (this->precedingLayer().getSaveMemoryFlag() && this->flagTrainingMode())
 	    throw std::runtime_error("layer before batchnorm is reduced in mem");  
 
     }
@@ -392,114 +371,39 @@ namespace layers{
 	
 	m_batchCnt++;
 	{{
-	   // Step1. calculate the batch size
-	   //        For parallel sentences, there is dummy node. BatchSize should not count it.
-	   internal::BatchSize fn0;
-	   fn0.patTypes = helpers::getRawPointer(this->patTypes());
-	   int tmp      = this->curMaxSeqLength() * this->parallelSequences();	   
-	   m_batchSize  = thrust::transform_reduce(
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin(), 
-					   thrust::counting_iterator<int>(0))),
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin() + tmp, 
-					   thrust::counting_iterator<int>(0) + tmp)),
-		fn0,
-		(real_t)0.0,
-		thrust::plus<real_t>());
-	   thrust::fill(this->m_oneVector.begin(), this->m_oneVector.end(), 1.0/m_batchSize);
- 
-	   // Step2. accumulate the mean
-	   internal::PrepareForMeanStd fn1;
-	   fn1.layerSize = this->size();
-	   fn1.meanNotVar= true;
-	   fn1.mean      = NULL;
-	   fn1.patTypes  = helpers::getRawPointer(this->patTypes());
-	   fn1.data      = helpers::getRawPointer(this->precedingLayer().outputs());
-	   fn1.outdata   = helpers::getRawPointer(m_buff);	   
-	   tmp       = this->size() * this->curMaxSeqLength() * this->parallelSequences();
-	   thrust::for_each(
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin(), 
-					   thrust::counting_iterator<int>(0))),
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin() + tmp, 
-					   thrust::counting_iterator<int>(0) + tmp)),
-		fn1);
+	   int frameNM = this->curMaxSeqLength() * this->parallelSequences();
+	   int blockNM = (frameNM + NN_BATCHNORM_BLOCK_FRAMES - 1) / NN_BATCHNORM_BLOCK_FRAMES;
+	   int tmp     = blockNM * this->size();
 	   
-	   helpers::Matrix<TDevice> onevec  (&this->m_oneVector, 
-					     this->curMaxSeqLength() * this->parallelSequences(), 
-					     1);
-	   helpers::Matrix<TDevice> data    (&this->m_buff, 
-					     this->size(),
-					     this->curMaxSeqLength() * this->parallelSequences());
-	   helpers::Matrix<TDevice> meanVec (&this->m_stats, 
-					     this->size(),
-					     1);
-	   meanVec.assignProduct(data, false, onevec, false);
-
-	   // Step3. accumulate the var
-	   fn1.meanNotVar= false;
-	   fn1.mean      = helpers::getRawPointer(this->m_stats);; 
+	   // Step1. mean and M2 of each block of frames
+	   //        For parallel sentences, there is dummy node, which is not counted
+	   internal::ComputeBlockMeanStd fn1;
+	   fn1.layerSize  = this->size();
+	   fn1.frameNM    = frameNM;
+	   fn1.blockNM    = blockNM;
+	   fn1.patTypes   = helpers::getRawPointer(this->patTypes());
+	   fn1.data       = helpers::getRawPointer(this->precedingLayer().outputs());
+	   fn1.blockStats = helpers::getRawPointer(m_blockStats);
 	   thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin(), 
+			thrust::make_tuple(m_blockStats.begin(), 
 					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin() + tmp, 
+			thrust::make_tuple(m_blockStats.begin() + tmp, 
 					   thrust::counting_iterator<int>(0) + tmp)),
 		fn1);
 
-	   helpers::Matrix<TDevice> data2   (&this->m_buff, 
-					     this->size(),
-					     this->curMaxSeqLength() * this->parallelSequences());
-	   helpers::Matrix<TDevice> stdVec  (&this->m_stats, 
-					     this->size(),
-					     1,
-					     this->size());
-	   stdVec.assignProduct(data2, false, onevec, false);
-	   internal::GetStd fn3;
-	   fn3.stdConst = m_stdConst;
-	   fn3.meanStd  = helpers::getRawPointer(m_stats) + this->size();
-	   thrust::for_each(
-		thrust::make_zip_iterator(
-			thrust::make_tuple(m_stats.begin() + this->size(), 
-					   thrust::counting_iterator<int>(0))),
-		thrust::make_zip_iterator(
-			thrust::make_tuple(m_stats.begin() + this->size() * 2, 
-					   thrust::counting_iterator<int>(0) + this->size())),
-		fn3);
-
-	   // Step4. accumulate the mean and std, for generation stage
-	   if (this->flagTrainingMode()){
-	       internal::AveMeanStd fn5;
-	       fn5.meanStd    = helpers::getRawPointer(m_stats);
-	       fn5.meanStdBuf = helpers::getRawPointer(this->weights()) + this->size() * 2;
-	       fn5.cnt        = m_batchCnt;
-	       thrust::for_each(
-		thrust::make_zip_iterator(
-			thrust::make_tuple(m_stats.begin(), 
-					   thrust::counting_iterator<int>(0))),
-		thrust::make_zip_iterator(
-			thrust::make_tuple(m_stats.begin() + this->size() * 2, 
-					   thrust::counting_iterator<int>(0) + this->size() * 2)),
-		fn5);
-	   }
-	   
-	   
-	   /*internal::ComputeBatchMeanStd fn;
-	   fn.layerSize = this->size();
-	   fn.frameNM   = this->curMaxSeqLength() * this->parallelSequences();
-	   fn.stdConst  = m_stdConst;
-	   
-	   fn.patTypes  = helpers::getRawPointer(this->patTypes());
-	   fn.data      = helpers::getRawPointer(this->precedingLayer().outputs());
-	   fn.meanStd   = helpers::getRawPointer(m_stats);
-	   
-	   // one additional buffer to accumulate the mean, std over entire corpus
-	   fn.meanStdBuf= helpers::getRawPointer(this->weights()) + this->size() * 2;
-	   fn.trainFlag = m_trainFlag;
-	   fn.batchCnt  = m_batchCnt;
+	   // Step2. merge the blocks into the mean and std,
+	   //        and accumulate the mean and std for generation stage
+	   internal::MergeBlockMeanStd fn3;
+	   fn3.layerSize  = this->size();
+	   fn3.blockNM    = blockNM;
+	   fn3.stdConst   = m_stdConst;
+	   fn3.blockStats = helpers::getRawPointer(m_blockStats);
+	   fn3.meanStd    = helpers::getRawPointer(m_stats);
+	   fn3.meanStdBuf = helpers::getRawPointer(this->weights()) + this->size() * 2;
+	   fn3.batchCnt   = m_batchCnt;
+	   fn3.trainFlag  = this->flagTrainingMode();
 	   thrust::for_each(
 		thrust::make_zip_iterator(
 			thrust::make_tuple(m_stats.begin(), 
@@ -507,9 +411,10 @@ namespace layers{
 		thrust::make_zip_iterator(
 			thrust::make_tuple(m_stats.begin() + this->size(), 
 					   thrust::counting_iterator<int>(0) + this->size())),
-					   fn);*/
-	   
+		fn3);
 
+	   // Step3. the batch size (number of valid frames)
+	   m_batchSize = m_stats[this->size() * 2];
 
 	   // Step4: normalize and scale the data
 	   internal::ComputeBatchNorm fn2;
@@ -539,7 +444,61 @@ namespace layers{
     template <typename TDevice>
     void BatchNormLayer<TDevice>::computeForwardPass(const int timeStep, const int nnState)
     {
-	throw std::runtime_error("Error: Batch norm is not implemented for online propagation");
+	// Add 20171101: online propagation uses the mean and std accumulated in training
+	if (this->flagTrainingMode())
+	    throw std::runtime_error("Error: Batch norm is not implemented for online training");
+
+	int frameSize = this->size() * this->parallelSequences();
+	int st        = timeStep * frameSize;
+
+	// the pointers are shifted to the current frame, in case the buffers are reduced
+	internal::ComputeBatchNorm fn2;
+	fn2.layerSize = this->size();
+	fn2.patTypes  = (helpers::getRawPointer(this->patTypes()) +
+			 timeStep * this->parallelSequences());
+	fn2.data      = (helpers::getRawPointer(this->precedingLayer().outputs()) + st -
+			 this->precedingLayer().outputBufPtrBias(st / this->size(), nnState));
+	fn2.outdata   = (helpers::getRawPointer(this->outputs()) + st -
+			 this->outputBufPtrBias(st / this->size(), nnState));
+	fn2.outNormed = (helpers::getRawPointer(m_outNormed) + st -
+			 this->outputBufPtrBias(st / this->size(), nnState));
+	fn2.scale     = helpers::getRawPointer(this->weights());
+	fn2.meanStd   = NULL;
+	fn2.meanStdBuf= helpers::getRawPointer(this->weights()) + this->size() * 2;
+	fn2.trainFlag = false;
+
+	thrust::for_each(
+		thrust::make_zip_iterator(
+			thrust::make_tuple(this->outputs().begin() + st -
+					   this->outputBufPtrBias(st / this->size(), nnState),
+					   thrust::counting_iterator<int>(0))),
+		thrust::make_zip_iterator(
+			thrust::make_tuple(this->outputs().begin() + st + frameSize -
+					   this->outputBufPtrBias(st / this->size(), nnState),
+					   thrust::counting_iterator<int>(0) + frameSize)),
+		fn2);
+    }
+
+    template <typename TDevice>
+    void BatchNormLayer<TDevice>::reduceOutputBuffer()
+    {
+	// only one frame is kept for generation
+	this->resizeOutputBuffer(this->parallelSequences() * this->size());
+	m_outNormed = this->outputs();
+	m_blockStats.clear(); m_blockStats.shrink_to_fit();
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+    
+    template <typename TDevice>
+    int BatchNormLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel,
+						  const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    return timeStepTimesParallel * this->size();
+	}else{
+	    return 0;
+	}
     }
 
     template <typename TDevice>
@@ -547,67 +506,34 @@ namespace layers{
     {
 	{{
 
-	   thrust::fill(m_oneVector.begin(), m_oneVector.end(), 1.0);
-	   thrust::fill(this->_weightUpdates().begin(), this->_weightUpdates().end(), 0.0);
-	   int tmp          = this->size() * this->curMaxSeqLength() * this->parallelSequences();
-
-	   // Step1. Calculate \deltaE/\delta{\alpha}
-	   internal::PrepareGrad fn1;
-	   fn1.layerSize    = this->size();
-	   fn1.alphaNotBeta = true;
-	   fn1.patTypes     = helpers::getRawPointer(this->patTypes());
-	   fn1.grad         = helpers::getRawPointer(this->outputErrors());
-	   fn1.buff         = helpers::getRawPointer(m_buff);
-	   fn1.data         = helpers::getRawPointer(m_outNormed);
-	   
-	   thrust::for_each(
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin(), 
-					   thrust::counting_iterator<int>(0))),
-		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin() + tmp, 
-					   thrust::counting_iterator<int>(0) + tmp)),
-		fn1);
-	   
-	   helpers::Matrix<TDevice> onevec    (&this->m_oneVector, 
-					       this->curMaxSeqLength() * this->parallelSequences(), 
-					       1);
-	   helpers::Matrix<TDevice> data      (&this->m_buff, 
-					       this->size(),
-					       this->curMaxSeqLength() * this->parallelSequences());
-	   helpers::Matrix<TDevice> gradAlpha (&this->_weightUpdates(), 
-					       this->size(),
-					       1);
-	   gradAlpha.assignProduct(data, false, onevec, false);
-
-	   // Step2. Calculate \deltaE/\delta{\beta}
-	   fn1.alphaNotBeta = false;	   
+	   int tmp     = this->size() * this->curMaxSeqLength() * this->parallelSequences();
+	   int frameNM = this->curMaxSeqLength() * this->parallelSequences();
+	   int blockNM = (frameNM + NN_BATCHNORM_BLOCK_FRAMES - 1) / NN_BATCHNORM_BLOCK_FRAMES;
+
+	   // Step1. partial sums of \deltaE/\delta{\alpha} and \deltaE/\delta{\beta}
+	   internal::ComputeBlockGradient_alphabeta fn1;
+	   fn1.layerSize  = this->size();
+	   fn1.frameNM    = frameNM;
+	   fn1.blockNM    = blockNM;
+	   fn1.patTypes   = helpers::getRawPointer(this->patTypes());
+	   fn1.outNormed  = helpers::getRawPointer(m_outNormed);
+	   fn1.errors     = helpers::getRawPointer(this->outputErrors());
+	   fn1.blockStats = helpers::getRawPointer(m_blockStats);
 	   thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin(), 
+			thrust::make_tuple(m_blockStats.begin(), 
 					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->outputs().begin() + tmp, 
-					   thrust::counting_iterator<int>(0) + tmp)),
+			thrust::make_tuple(m_blockStats.begin() + blockNM * this->size(), 
+					   thrust::counting_iterator<int>(0) + blockNM * this->size())),
 		fn1);
-	   
-	   helpers::Matrix<TDevice> gradBeta (&this->_weightUpdates(), 
-					      this->size(),
-					      1,
-					      this->size());
-	   gradBeta.assignProduct(data, false, onevec, false);
-	   
 
-	   /*
-	   internal::ComputeBatchGradient_alphabeta fn;
-	   fn.layerSize = this->size();
-	   fn.frameNM   = this->curMaxSeqLength() * this->parallelSequences();
-	   
-	   fn.patTypes  = helpers::getRawPointer(this->patTypes());
-	   fn.outNormed = helpers::getRawPointer(m_outNormed);
-	   fn.errors    = helpers::getRawPointer(this->outputErrors());
-	   fn.grad      = helpers::getRawPointer(this->_weightUpdates());
-	   
+	   // Step2. sum over blocks
+	   internal::MergeBlockGradient_alphabeta fn3;
+	   fn3.layerSize  = this->size();
+	   fn3.blockNM    = blockNM;
+	   fn3.blockStats = helpers::getRawPointer(m_blockStats);
+	   fn3.grad       = helpers::getRawPointer(this->_weightUpdates());
 	   thrust::for_each(
 		thrust::make_zip_iterator(
 			thrust::make_tuple(m_stats.begin(), 
@@ -615,8 +541,7 @@ namespace layers{
 		thrust::make_zip_iterator(
 			thrust::make_tuple(m_stats.begin() + this->size(), 
 					   thrust::counting_iterator<int>(0) + this->size())),
-		fn);
-	   */
+		fn3);
 
 	   // Step3. Calculate \deltaE/\delta{x}
 	   internal::ComputeBatchGradient_output fn2;
@@ -49,8 +49,8 @@ namespace layers{
 	int         m_preEpoch;
 	real_t      m_batchSize; //
 
-	real_vector m_oneVector; // all-one vector
-	real_vector m_buff;
+	real_vector m_blockStats; // statistics of each block of frames
+	int         m_blockNM;    // maximum number of blocks
 
 	
     public:
@@ -59,7 +59,8 @@ namespace layers{
 		const helpers::JsonValue &layerChild, 
 		const helpers::JsonValue &weightsSection,
 		Layer<TDevice>           &precedingLayer,
-		int                       maxSeqLength);
+		int                       maxSeqLength,
+		typename TDevice::real_vector *sharedWeights = NULL);
 
 	virtual ~BatchNormLayer();
 
@@ -79,6 +80,11 @@ namespace layers{
 	 * 
 	 */
 	virtual void computeForwardPass(const int timeStep, const int nnState);
+
+	// memory save mode for generation
+	virtual void reduceOutputBuffer();
+
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
 	
 	
     };
@@ -111,6 +111,44 @@ namespace {
         }
     };
 
+    // Add 20181018: cross entropy, correct classification and gradient in one pass
+    //  the gradient is written to outputErrors
+    struct ComputeErrorAndOutputErrorFn
+    {
+        const char *patTypes;
+	real_t     *outputErrors;
+
+        __host__ __device__ thrust::tuple<real_t, int> operator() (
+		const thrust::tuple<real_t, real_t, int> &t) const
+        {
+            // unpack the tuple
+            int outputIdx = t.get<2>();
+
+            // check if we actually need to continue
+            if (patTypes[outputIdx] == PATTYPE_NONE)
+                return thrust::make_tuple((real_t)0, 0);
+
+            real_t target = t.get<0>();
+            real_t output = t.get<1>();
+
+            real_t act        = helpers::max(output, helpers::NumericLimits<real_t>::min());
+            real_t targetProb = (target > 0 ? act : 1-act);
+	    outputErrors[outputIdx] = (target > 0 ? -(1/targetProb) : (1/targetProb));
+	    
+            return thrust::make_tuple(-log(targetProb),
+				      (int)((target > (real_t)0.5) == (output > (real_t)0.5)));
+        }
+    };
+
+    struct SumErrorAndCorrectFn
+    {
+        __host__ __device__ thrust::tuple<real_t, int> operator() (
+		const thrust::tuple<real_t, int> &a, const thrust::tuple<real_t, int> &b) const
+        {
+            return thrust::make_tuple(a.get<0>() + b.get<0>(), a.get<1>() + b.get<1>());
+        }
+    };
+
 } // anonymous namespace
 } // namespace anonymous
 
@@ -133,6 +171,10 @@ namespace layers {
     template <typename TDevice>
     int BinaryClassificationLayer<TDevice>::countCorrectClassifications()
     {
+	// Add 20181018: counted by calculateErrorAndGradients
+	if (this->_cachedCorrect() >= 0)
+	    return this->_cachedCorrect();
+	
         internal::CountCorrectClassificationsFn fn;
 
         int n = this->curMaxSeqLength() * this->parallelSequences();
@@ -186,6 +228,30 @@ namespace layers {
         return error;
     }
 
+    template <typename TDevice>
+    real_t BinaryClassificationLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+        internal::ComputeErrorAndOutputErrorFn fn;
+        fn.patTypes     = helpers::getRawPointer(this->patTypes());
+	fn.outputErrors = helpers::getRawPointer(this->_outputErrors());
+
+        int n = this->curMaxSeqLength() * this->parallelSequences();
+
+        thrust::tuple<real_t, int> res = thrust::transform_reduce(
+            thrust::make_zip_iterator(thrust::make_tuple(this->_targets().begin(),   this->_actualOutputs().begin(),   thrust::counting_iterator<int>(0))),
+            thrust::make_zip_iterator(thrust::make_tuple(this->_targets().begin()+n, this->_actualOutputs().begin()+n, thrust::counting_iterator<int>(0)+n)),
+            fn,
+            thrust::make_tuple((real_t)0, 0),
+            internal::SumErrorAndCorrectFn()
+            );
+
+	this->_cacheFusedPass(res.get<1>());
+        return res.get<0>();
+    }
+
     template <typename TDevice>
     void BinaryClassificationLayer<TDevice>::computeForwardPass(const int nnState)
     {
@@ -200,6 +266,10 @@ namespace layers {
     template <typename TDevice>
     void BinaryClassificationLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
         internal::ComputeOutputErrorFn fn;
         fn.patTypes = helpers::getRawPointer(this->patTypes());
 
@@ -380,6 +380,22 @@ namespace{
 
 
 
+    struct CopyCausalTapWeight
+    {
+	// Add 20180712: copy the weights of the two causal taps (previous and current)
+	// from the weight buffer [prev, cur, next] * curLayerSize to [prev, cur] * curLayerSize
+	real_t *weightBuffer;
+	int     preLayerSize;
+
+	// for preLayerSize * 2 * curLayerSize
+	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+        {
+	    int colIdx = t.get<1>() / preLayerSize;   // column in the tap weight matrix
+	    int rowIdx = t.get<1>() % preLayerSize;
+	    t.get<0>() = weightBuffer[((colIdx / 2) * 3 + colIdx % 2) * preLayerSize + rowIdx];
+	}
+    };
+    
     struct ConvolutionCoreMemSaveMode
     {
 
@@ -388,7 +404,7 @@ namespace{
        
 	int     recFieldSize;     // recep field size
 	int     curLayerSize;     // output feature dimension
-	int     winTotalLength;   // dimension of the con buffer (3 * curLayerSize)
+	int     winTotalLength;   // dimension of the con buffer (2 * curLayerSize)
 
 	int     timeStep;         // absolute time index
 	int     parallel;
@@ -408,8 +424,8 @@ namespace{
 	    int timeIdxBuf1 = (timeStep % (recFieldSize+1)) * parallel + uttIdx;
 	    int timeIdxBuf2 = ((timeStep+1) % (recFieldSize+1)) * parallel + uttIdx;
 	    // (time+1) % (recFieldSize+1) = (time - recFieldSize) % (recFieldSize+1)
-	    int dimIdxBuf1  = dimIdx * 3 + 1; // transformed by the curennt link of CNN
-	    int dimIdxBuf2  = dimIdx * 3;     // transformed by the previous link of CNN
+	    int dimIdxBuf1  = dimIdx * 2 + 1; // transformed by the curennt link of CNN
+	    int dimIdxBuf2  = dimIdx * 2;     // transformed by the previous link of CNN
 	    real_t summedOutput = (dataBuffer[timeIdxBuf1 * winTotalLength + dimIdxBuf1] +
 				   dataBuffer[timeIdxBuf2 * winTotalLength + dimIdxBuf2]);
 	    // add bias and pass through the activation function
@@ -862,7 +878,8 @@ namespace layers {
     CNNLayer<TDevice>::CNNLayer(
         const helpers::JsonValue &layerChild, 
         const helpers::JsonValue &weightsSection,
-        Layer<TDevice> &precedingLayer, int maxSeqLength)
+        Layer<TDevice> &precedingLayer, int maxSeqLength,
+        typename TDevice::real_vector *sharedWeights)
 	: m_winWidth_Opt    ((layerChild->HasMember("window_width")) ? 
 			     ((*layerChild)["window_width"].GetString()) : (""))
 	, m_winInterval_Opt ((layerChild->HasMember("window_tap_interval")) ? 
@@ -883,7 +900,8 @@ namespace layers {
 					(layerChild->HasMember("size")) ? 
 					((*layerChild)["size"].GetInt()) : (0),
 					precedingLayer.size(), false, false),
-				    precedingLayer, maxSeqLength)
+				    precedingLayer, maxSeqLength,
+				    sharedWeights)
 	, m_outputTanh(1)
     {
 	
@@ -1211,6 +1229,22 @@ namespace layers {
 
 	    // initialize the data buffer
 	    thrust::fill(m_conBuffer.begin(), m_conBuffer.end(), 0.0);
+
+	    // weights of the two causal taps for memory save mode
+	    if (this->getSaveMemoryFlag()){
+		internal::CopyCausalTapWeight fn2;
+		fn2.weightBuffer = helpers::getRawPointer(m_weightBuffer);
+		fn2.preLayerSize = this->precedingLayer().size();
+		int n = this->precedingLayer().size() * 2 * this->size();
+		thrust::for_each(
+		  thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_tapWeight.begin(),
+					   thrust::counting_iterator<int>(0))),
+		  thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_tapWeight.begin() + n, 
+					   thrust::counting_iterator<int>(0) + n)),
+		  fn2);
+	    }
 	}}
 
 
@@ -1221,22 +1255,26 @@ namespace layers {
 	// Step1-2: matrix transformation and data summation
 	if (this->getSaveMemoryFlag()){
 	    // memory save mode for wavenet
+	    // The current input is transformed by the previous and current taps in one
+	    // matrix product. The output of the previous tap is kept in a queue of
+	    // (recField + 1) frames and used recField steps later
 	    
 	    // Step1. matrix transformation
 	    // receptive filed size
 	    int recField = m_winInterval_H[0];
+	    int tapDim   = 2 * this->size();
 	    // absolute address in the conv buffer
-	    int bufAddr  = (timeStep % (recField+1)) * this->parallelSequences() * m_winTotalL;
+	    int bufAddr  = (timeStep % (recField+1)) * this->parallelSequences() * tapDim;
 	    // This transofmration will transform the input data 
-	    helpers::Matrix<TDevice> weightMatrix   (&this->m_weightBuffer,
+	    helpers::Matrix<TDevice> weightMatrix   (&this->m_tapWeight,
 						     this->precedingLayer().size(),
-						     this->m_winTotalL);
+						     tapDim);
 	    helpers::Matrix<TDevice> plOutputsMatrix(&this->precedingLayer().outputs(), 
 						     this->precedingLayer().size(), 
 						     this->parallelSequences(),
 						     st * this->precedingLayer().size() - shiftIn);
             helpers::Matrix<TDevice> outputsMatrix  (&this->m_conBuffer,                 
-						     this->m_winTotalL,                   
+						     tapDim,                   
 						     this->parallelSequences(),
 						     bufAddr);
             outputsMatrix.assignProduct(weightMatrix, true, plOutputsMatrix, false);
@@ -1249,7 +1287,7 @@ namespace layers {
 
 	    fn.recFieldSize     = recField;
 	    fn.curLayerSize     = this->size();
-	    fn.winTotalLength   = this->m_winTotalL;
+	    fn.winTotalLength   = tapDim;
 
 	    fn.timeStep         = timeStep;
 	    fn.outputTanh       = this->m_outputTanh;
@@ -1570,8 +1608,10 @@ namespace layers {
 		    return;
 	    
 	    // save the intermediate buffer
-	    m_conBuffer.resize(this->parallelSequences() * m_winTotalL * (recepField + 1), 0);
+	    // only the outputs of the previous and current taps are kept
+	    m_conBuffer.resize(this->parallelSequences() * 2 * this->size() * (recepField + 1), 0);
 	    m_conBuffer.shrink_to_fit();
+	    m_tapWeight.resize(this->precedingLayer().size() * 2 * this->size(), 0);
 	    
 	    // save the output buffer size
 	    this->resizeOutputBuffer(this->parallelSequences() * this->size());
@@ -100,6 +100,7 @@ namespace layers {
 	//int_vector      m_weightIdx;      // idx to access the weight of each window filter
 
 	real_vector     m_conBuffer;        // data buffer
+	real_vector     m_tapWeight;        // weights of the two causal taps (memory save mode)
 	int             m_winTotalL;        // sum of the width of filter
 
 	int             m_causalFlag;       // whether the CNN filter is casual filter
@@ -111,7 +112,8 @@ namespace layers {
 	// initializer and destructor
 	CNNLayer(const helpers::JsonValue &layerChild,
 		 const helpers::JsonValue &weightsSection,
-		 Layer<TDevice> &precedingLayer, int maxSeqLength);
+		 Layer<TDevice> &precedingLayer, int maxSeqLength,
+		 typename TDevice::real_vector *sharedWeights = NULL);
 
 	virtual ~CNNLayer();
 
@@ -98,6 +98,36 @@ namespace {
             return bp_error;
         }
     };
+
+    // Add 20181018: the divergence and the gradient in one pass
+    //  the gradient is written to outputErrors
+    struct ComputeCeAndOutputErrorFn
+    {
+        int layerSize;
+
+        const char *patTypes;
+	real_t     *outputErrors;
+
+        __host__ __device__ real_t operator() (const thrust::tuple<real_t, real_t, int> &values) const
+        {
+            // unpack the tuple
+            real_t target = values.get<0>();
+            real_t output = values.get<1>();
+            int outputIdx = values.get<2>();
+
+            // dummy pattern
+            int patIdx = outputIdx / layerSize;
+            if (patTypes[patIdx] == PATTYPE_NONE){
+		outputErrors[outputIdx] = 0;
+                return 0;
+	    }
+
+            real_t ftarget = helpers::max(helpers::NumericLimits<real_t>::min(), target);
+            output = helpers::max(helpers::NumericLimits<real_t>::min(), output);
+	    outputErrors[outputIdx] = helpers::boundRange(-target / output, -100, +100);
+            return target * log(ftarget / output);
+        }
+    };
     
 } // anonymous namespace
 } // namespace anonymous
@@ -149,6 +179,35 @@ namespace layers {
         return ce;
     }
 
+    template <typename TDevice>
+    real_t CePostOutputLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+        internal::ComputeCeAndOutputErrorFn fn;
+        fn.layerSize    = this->size();
+        fn.patTypes     = helpers::getRawPointer(this->patTypes());
+	fn.outputErrors = helpers::getRawPointer(this->_outputErrors());
+
+        int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
+
+        real_t ce = thrust::transform_reduce(
+            thrust::make_zip_iterator(thrust::make_tuple(this->_targets().begin(),   
+							 this->_actualOutputs().begin(),   
+							 thrust::counting_iterator<int>(0))),
+            thrust::make_zip_iterator(thrust::make_tuple(this->_targets().begin()+n, 
+							 this->_actualOutputs().begin()+n, 
+							 thrust::counting_iterator<int>(0)+n)),
+            fn,
+            (real_t)0,
+            thrust::plus<real_t>()
+            );
+
+	this->_cacheFusedPass();
+        return ce;
+    }
+
     template <typename TDevice>
     void CePostOutputLayer<TDevice>::computeForwardPass(const int nnState)
     {
@@ -161,6 +220,10 @@ namespace layers {
     template <typename TDevice>
     void CePostOutputLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
         // calculate the errors
         internal::ComputeOutputErrorFn fn;
         fn.layerSize = this->size();
@@ -106,8 +106,10 @@ namespace layers{
     ExternalLoader<TDevice>::ExternalLoader(const helpers::JsonValue &layerChild,
 					    const helpers::JsonValue &weightsSection,
 					    Layer<TDevice>           &precedingLayer,
-					    int                       maxSeqLength)
-	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0, precedingLayer, maxSeqLength)
+					    int                       maxSeqLength,
+					    typename TDevice::real_vector *sharedWeights)
+	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0,
+	                          precedingLayer, maxSeqLength, sharedWeights)
     {
 	if (precedingLayer.type() != "input")
 	    throw std::runtime_error("Externalloader is only implemented after the input layer");
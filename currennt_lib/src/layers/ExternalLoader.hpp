@@ -55,7 +55,8 @@ namespace layers{
 	    const helpers::JsonValue &layerChild,
 	    const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
 	);
 
 	virtual ~ExternalLoader();
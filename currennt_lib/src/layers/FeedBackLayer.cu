@@ -82,6 +82,9 @@ namespace {
 	int    *lookBack;   // lookback step
 	int     lookBackStepNM; // how many steps to look back ?
 	int     crossBoundary;
+
+	int     input1Shift;    // shift of the pointer when preceding layer is reduced in memory
+	int     outputShift;    // shift of the pointer when this layer is reduced in memory
 	// dispatched over Dim * T * Parallel
 	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t)
 	{
@@ -90,7 +93,7 @@ namespace {
 	    int dimIdx       = outputEffIdx % dimOutput;
 
 	    // Idx in the output of this layer
-	    int outputIdx    = timeStep * dimOutput + dimIdx;
+	    int outputIdx    = timeStep * dimOutput + dimIdx - outputShift;
 	    int lookBackTime = 0;
 
 	    if (dimIdx < (dimInput1Valid + lookBackStepNM * dimInput2Valid)){
@@ -121,7 +124,7 @@ namespace {
 		    
 		}else{
 		    //output[outputIdx] = 0;
-		    output[outputIdx] = input1[timeStep * dimInput1Total + dimIdx];
+		    output[outputIdx] = input1[timeStep * dimInput1Total + dimIdx - input1Shift];
 		}
 	    }else{
 		// this is section for aggregating information
@@ -400,9 +403,11 @@ namespace layers{
     FeedBackLayer<TDevice>::FeedBackLayer(const helpers::JsonValue &layerChild,
 					  const helpers::JsonValue &weightsSection,
 					  Layer<TDevice>           &precedingLayer,
-					  int                        maxSeqLength
+					  int                        maxSeqLength,
+					  typename TDevice::real_vector *sharedWeights
 					  )
-	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0, precedingLayer, maxSeqLength)
+	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0,
+	                          precedingLayer, maxSeqLength, sharedWeights)
 	, m_targetDim   (-1)
 	, m_targetLayer (NULL)
     {
@@ -460,7 +465,7 @@ namespace layers{
 	    m_prevDimStart > m_prevDimEnd)
 	    throw std::runtime_error("Error in previousDim and previousDimStart configuration");
 
-	if (this->precedingLayer().getSaveMemoryFlag())
+	if (this->precedingLayer().getSaveMemoryFlag() && this->flagTrainingMode())
 	    throw std::runtime_error("layer before feedback is reduced in mem");  
 
     }
@@ -629,6 +634,8 @@ namespace layers{
 
 	    fn.lookBackStepNM = this->m_lookBack.size();
 	    fn.crossBoundary  = m_crossBoundary;
+	    fn.input1Shift    = 0;
+	    fn.outputShift    = 0;
 	    int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
 	    thrust::for_each(
 		thrust::make_zip_iterator(thrust::make_tuple(this->outputs().begin(),
@@ -703,8 +710,13 @@ namespace layers{
 	int effTimeStepS = timeStep     * this->parallelSequences();
 	int effTimeStepE = (timeStep+1) * this->parallelSequences();
 	int dimension    = 0;
-	thrust::fill(this->outputs().begin() + effTimeStepS * this->size(), 
-		     this->outputs().begin() + effTimeStepE * this->size(), 0.0);
+
+	// shift of the pointers when the layers are reduced in memory
+	int shiftIn      = this->precedingLayer().outputBufPtrBias(effTimeStepS, nnState);
+	int shiftOut     = this->outputBufPtrBias(effTimeStepS, nnState);
+	
+	thrust::fill(this->outputs().begin() + effTimeStepS * this->size() - shiftOut, 
+		     this->outputs().begin() + effTimeStepE * this->size() - shiftOut, 0.0);
 	
 	{{
 	    // The dimension of the concatenated feature (if no softmax exists)
@@ -734,14 +746,16 @@ namespace layers{
 
 	    fn.lookBackStepNM = this->m_lookBack.size();
 	    fn.crossBoundary  = m_crossBoundary;
+	    fn.input1Shift    = shiftIn;
+	    fn.outputShift    = shiftOut;
 	    thrust::for_each(
 	       thrust::make_zip_iterator(
 		 thrust::make_tuple(
-			this->outputs().begin()+ effTimeStepS * this->size(),
+			this->outputs().begin()+ effTimeStepS * this->size() - shiftOut,
 			thrust::counting_iterator<int>(0)+ effTimeStepS * this->size())),
 	       thrust::make_zip_iterator(
 		 thrust::make_tuple(
-			this->outputs().begin()+ effTimeStepE * this->size(),
+			this->outputs().begin()+ effTimeStepE * this->size() - shiftOut,
 			thrust::counting_iterator<int>(0)+ effTimeStepE * this->size())),
 			fn);
 	    // dustbin.txt/Block1226x04
@@ -813,15 +827,17 @@ namespace layers{
 		int_vector       tmpGPU = tmp;
 		fn.lookBack       = helpers::getRawPointer(tmpGPU);
 		fn.lookBackStepNM = m_aggOpt.size();
+		fn.input1Shift    = shiftIn;
+		fn.outputShift    = shiftOut;
 		
 		thrust::for_each(
 	         thrust::make_zip_iterator(
 		  thrust::make_tuple(
-			this->outputs().begin()+ effTimeStepS * this->size(),
+			this->outputs().begin()+ effTimeStepS * this->size() - shiftOut,
 			thrust::counting_iterator<int>(0)+ effTimeStepS * this->size())),
 		 thrust::make_zip_iterator(
 		  thrust::make_tuple(
-			this->outputs().begin()+ effTimeStepE * this->size(),
+			this->outputs().begin()+ effTimeStepE * this->size() - shiftOut,
 			thrust::counting_iterator<int>(0)+ effTimeStepE * this->size())),
 			fn);
 
@@ -858,6 +874,29 @@ namespace layers{
 	}
     }
     
+    template <typename TDevice>
+    void FeedBackLayer<TDevice>::reduceOutputBuffer()
+    {
+	// the aggregation reads the output of this layer across the frames
+	if (m_aggOpt.size())
+	    return;
+	
+	this->resizeOutputBuffer(this->parallelSequences() * this->size());
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+    
+    template <typename TDevice>
+    int FeedBackLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel,
+						 const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    return timeStepTimesParallel * this->size();
+	}else{
+	    return 0;
+	}
+    }
+
     template class FeedBackLayer<Cpu>;
     template class FeedBackLayer<Gpu>;
     
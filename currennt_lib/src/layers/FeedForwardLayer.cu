@@ -55,6 +55,7 @@ namespace {
         real_t bias;
 
         const real_t *biasWeights;
+	const real_t *skipAdd;        // output of the fused skipadd layer (or NULL)
 
         __host__ __device__ real_t operator() (real_t a, const int &outputIdx) const
         {
@@ -67,6 +68,10 @@ namespace {
             // apply the activation function
             real_t b = TActFn::fn(a);
 
+	    // add the output of the skip layer
+	    if (skipAdd)
+		b += skipAdd[outputIdx];
+	    
             // store the activation
             return b;
         }
@@ -289,9 +294,12 @@ namespace layers {
     FeedForwardLayer<TDevice, TActFn>::FeedForwardLayer(const helpers::JsonValue &layerChild, 
 							const helpers::JsonValue &weightsSection, 
 							Layer<TDevice> &precedingLayer,
-							int maxSeqLength)
+							int maxSeqLength,
+							typename TDevice::real_vector *sharedWeights)
         : TrainableLayer<TDevice>(layerChild, weightsSection, 1, weightForBatchNorm(layerChild),
-				  precedingLayer, maxSeqLength)
+				  precedingLayer, maxSeqLength,
+				  sharedWeights)
+	, m_skipAddSource (NULL)
     {
 	
 	// Initialization for batch normalization
@@ -394,6 +402,8 @@ namespace layers {
             fn.bias             = this->bias();
             fn.biasWeights      = (helpers::getRawPointer(this->weights()) + 
 				   this->size() * this->precedingLayer().size());
+	    fn.skipAdd          = (m_skipAddSource ?
+				   helpers::getRawPointer(m_skipAddSource->outputs()) : NULL);
 
             thrust::transform(
                 this->_outputs().begin(),
@@ -596,6 +606,14 @@ namespace layers {
             fn.bias             = this->bias();
             fn.biasWeights      = (helpers::getRawPointer(this->weights()) + 
 				   this->size() * this->precedingLayer().size());
+	    fn.skipAdd          = NULL;
+	    if (m_skipAddSource){
+		// the index of fn starts from 0 for this time step
+		int shiftSkip = m_skipAddSource->outputBufPtrBias(
+					timeStep * this->parallelSequences(), nnState);
+		fn.skipAdd = (helpers::getRawPointer(m_skipAddSource->outputs()) +
+			      effTimeStart * this->size() - shiftSkip);
+	    }
 
             thrust::transform(
 		this->_outputs().begin() + effTimeStart * this->size() - shiftOut,
@@ -629,9 +647,20 @@ namespace layers {
 	    int maxDataNum           = maxFrameNum * this->size();
 	    int transMatrixWeightNum = this->size() * this->precedingLayer().size();
 
+	    // Add 20181018: the errors-only pass leaves the weight updates untouched,
+	    //  the scale/shift gradients go to a scratch buffer
+	    real_vector *gradBuf   = &this->_weightUpdates();
+	    int          gradShift = transMatrixWeightNum;
+	    if (this->flagErrorsOnlyBackward()){
+		if (m_batchNormGrad.size() != this->size() * 2)
+		    m_batchNormGrad.resize(this->size() * 2, 0.0);
+		gradBuf   = &m_batchNormGrad;
+		gradShift = 0;
+	    }
+
 	    thrust::fill(m_oneVector.begin(),            m_oneVector.end(),            1.0);
 	    thrust::fill(m_buff.begin(),                 m_buff.end(),                 0.0);
-	    thrust::fill(this->_weightUpdates().begin(), this->_weightUpdates().end(), 0.0);
+	    thrust::fill(gradBuf->begin(),               gradBuf->end(),               0.0);
 	    
 	    
 	    // Step1. Calculate \deltaE/\delta{\alpha}
@@ -653,8 +682,7 @@ namespace layers {
 	   
 	    helpers::Matrix<TDevice> onevec    (&this->m_oneVector, maxFrameNum, 1);
 	    helpers::Matrix<TDevice> data      (&this->m_buff,      this->size(), maxFrameNum);
-	    helpers::Matrix<TDevice> gradAlpha (&this->_weightUpdates(), this->size(), 1,
-						transMatrixWeightNum);
+	    helpers::Matrix<TDevice> gradAlpha (gradBuf, this->size(), 1, gradShift);
 	   gradAlpha.assignProduct(data, false, onevec, false);
 
 	   // Step2. Calculate \deltaE/\delta{\beta}
@@ -668,8 +696,8 @@ namespace layers {
 					   thrust::counting_iterator<int>(0) + maxDataNum)),
 		fn1);
 	   
-	   helpers::Matrix<TDevice> gradBeta (&this->_weightUpdates(), this->size(),1,
-					      transMatrixWeightNum + this->size());
+	   helpers::Matrix<TDevice> gradBeta (gradBuf, this->size(), 1,
+					      gradShift + this->size());
 	   gradBeta.assignProduct(data, false, onevec, false);
 	   
 
@@ -681,7 +709,7 @@ namespace layers {
 	   fn2.outNormed = helpers::getRawPointer(m_outNormed);
 	   fn2.meanStd   = helpers::getRawPointer(m_stats);
 	   fn2.scale     = helpers::getRawPointer(this->weights())        + transMatrixWeightNum;
-	   fn2.scaleGrad = helpers::getRawPointer(this->_weightUpdates()) + transMatrixWeightNum;
+	   fn2.scaleGrad = helpers::getRawPointer(*gradBuf)               + gradShift;
 	   fn2.batchSize = m_batchSize;
 	   
 	   thrust::for_each(
@@ -744,6 +772,10 @@ namespace layers {
 	    }
 	}}
 
+	// Add 20181018: frozen layer, only the errors are needed
+	if (this->flagErrorsOnlyBackward())
+	    return;
+
 	// compute the input weight updates
 	{{
             helpers::Matrix<TDevice> weightUpdatesMatrix(&this->_weightUpdates(),           
@@ -817,6 +849,20 @@ namespace layers {
 	}
     }
     
+    template <typename TDevice, typename TActFn>
+    bool FeedForwardLayer<TDevice, TActFn>::fuseSkipAddSource(Layer<TDevice> *skipSource)
+    {
+	// only in generation, and not for batch-normalized module
+	// (softmax and paralayer have their own forward computation)
+	if (this->type().compare(0, 12, "feedforward_") != 0 ||
+	    this->flagTrainingMode() || m_batchNorm || m_skipAddSource != NULL ||
+	    skipSource == NULL || skipSource->size() != this->size())
+	    return false;
+	m_skipAddSource = skipSource;
+	printf("\n\tSkip layer %s is added to the output", skipSource->name().c_str());
+	return true;
+    }
+    
     template <typename TDevice, typename TActFn>
     int FeedForwardLayer<TDevice, TActFn>::outputBufPtrBias(const int timeStepTimesParallel,
 							    const int nnState)
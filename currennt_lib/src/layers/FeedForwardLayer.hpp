@@ -54,6 +54,9 @@ namespace layers {
 
 	real_vector m_oneVector;     // all-one vector
 	real_vector m_buff;
+	real_vector m_batchNormGrad; // Add 20181018: scale/shift gradients, errors-only pass
+
+	Layer<TDevice> *m_skipAddSource; // skip layer added to the output (generation only)
 
     public:
         /**
@@ -67,7 +70,8 @@ namespace layers {
             const helpers::JsonValue &layerChild, 
             const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
             );
 
         /**
@@ -107,6 +111,11 @@ namespace layers {
 	virtual void reduceOutputBuffer();
 
 	virtual int outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
+
+	/*
+	 * to fuse the next skipadd layer
+	 */
+	virtual bool fuseSkipAddSource(Layer<TDevice> *skipSource);
 	
     };
 
@@ -63,6 +63,8 @@ namespace layers {
 			 Configuration::instance().trainingMode())
 	, m_weDim(0)
 	, m_flagWeUpdate(false)
+	, m_sharedWeBank(NULL)
+	, m_sharedWeMask(NULL)
     {
 
 	m_weMask.clear();
@@ -133,7 +135,7 @@ namespace layers {
 		// retrieve the embedded vector idx and save m_weIdx
 		weidx = (long unsigned int)(fraction.inputs()[i * fraction.inputPatternSize() + 
 							      m_weIDDim]);
-		if (weidx * m_weDim > m_weBank.size()){
+		if (weidx * m_weDim > _weBank().size()){
 		    printf("Vector idx: %d\t", weidx);
 		    throw std::runtime_error("vector idx larger than weBank size");
 		}
@@ -141,8 +143,8 @@ namespace layers {
 		m_weIdx[i] = weidx;
 		
 		// retrieve the embedded vector from m_weBank
-		thrust::copy(m_weBank.begin()  + weidx     * m_weDim, 
-			     m_weBank.begin()  + (weidx+1) * m_weDim, 
+		thrust::copy(_weBank().begin()  + weidx     * m_weDim, 
+			     _weBank().begin()  + (weidx+1) * m_weDim, 
 			     tempInput.begin() + fraction.inputPatternSize()  - 1);
 
 		// Block#01
@@ -179,7 +181,7 @@ namespace layers {
     // return the reference to m_weBank;
     template <typename TDevice>
     Cpu::real_vector& InputLayer<TDevice>::_weBank(){
-	return m_weBank;
+	return (m_sharedWeBank ? (*m_sharedWeBank) : m_weBank);
     }
     template <typename TDevice>
     Cpu::real_vector& InputLayer<TDevice>::_weIdx(){
@@ -223,6 +225,26 @@ namespace layers {
 	return true;
     }
     
+    template <typename TDevice>
+    bool InputLayer<TDevice>::shareWeBank(InputLayer<TDevice> &sourceLayer)
+    {
+	if (!sourceLayer.flagInputWeUpdate())
+	    throw std::runtime_error("The source input layer has no WE bank");
+	m_weDim        = sourceLayer._weDim();
+	m_weIDDim      = sourceLayer._weIDDim();
+	m_flagWeUpdate = true;
+	m_weIdx        = Cpu::real_vector(sourceLayer._weIdx().size(), -1);
+	this->_setInputWeUpdate(true);
+
+	// the bank is read and updated by all the networks without copy
+	m_sharedWeBank = &sourceLayer._weBank();
+	if (sourceLayer.flagWeMask()){
+	    m_sharedWeMask = &sourceLayer._weMask();
+	    m_weMaskFlag   = true;
+	}
+	return true;
+    }
+    
     template <typename TDevice>
     bool InputLayer<TDevice>::flagInputWeUpdate()
     {
@@ -232,14 +254,14 @@ namespace layers {
     template <typename TDevice>
     bool InputLayer<TDevice>::saveWe(const std::string weFile)
     {
-	if (m_flagWeUpdate && m_weBank.size()>0){
+	if (m_flagWeUpdate && _weBank().size()>0){
 	    std::ofstream ofs(weFile.c_str(), std::ofstream::binary);
 	    if (!ofs.good()){
 		std::cout << "Fail to open " << weFile << std::endl;
 		return false;
 	    }
 	    // we assume it is a CPU vector
-	    std::vector<real_t> tempVec(m_weBank.begin(), m_weBank.end());
+	    std::vector<real_t> tempVec(_weBank().begin(), _weBank().end());
 	    for(int i=0; i<tempVec.size(); i++){
 		ofs.write((char *)&(tempVec[i]), sizeof(real_t));
 	    }
@@ -306,15 +328,15 @@ namespace layers {
     void InputLayer<TDevice>::maskWe()
     {
 	if (m_weMaskFlag)
-	    thrust::transform(m_weBank.begin(),  m_weBank.end(),
-			      m_weMask.begin(),  m_weBank.begin(),
+	    thrust::transform(_weBank().begin(), _weBank().end(),
+			      _weMask().begin(), _weBank().begin(),
 			      thrust::multiplies<real_t>());
     }
 
     template <typename TDevice>
     Cpu::real_vector& InputLayer<TDevice>::_weMask()
     {
-	return m_weMask;
+	return (m_sharedWeMask ? (*m_sharedWeMask) : m_weMask);
     }
 
     template <typename TDevice>
@@ -51,6 +51,10 @@ namespace layers {
 	/* Add 17/01/29 */
 	Cpu::real_vector  m_weMask;
 	bool              m_weMaskFlag;
+
+	/* Add 20181018: WE bank and mask of another input layer (replica of the network) */
+	Cpu::real_vector *m_sharedWeBank;
+	Cpu::real_vector *m_sharedWeMask;
 	
 	/* Add 20160902 Wang: add noise to the WE */
 	// Because input_noise_sigma must be turned off when reading the WE index,
@@ -76,6 +80,9 @@ namespace layers {
 	
 	int  readWeMask(std::vector<real_t>::iterator b);
 
+	/* Add 20181018: use the WE bank of sourceLayer (asynchronous training) */
+	bool shareWeBank(InputLayer<TDevice> &sourceLayer);
+
 	void maskWe();
 	
 	Cpu::real_vector& _weBank();
@@ -209,6 +209,24 @@ namespace layers {
 
     template <typename TDevice>
     real_t KLPostOutputLayer<TDevice>::calculateError()
+    {
+	return this->_calculateKLD(helpers::getRawPointer(m_errorBuf));
+    }
+
+    template <typename TDevice>
+    real_t KLPostOutputLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+	// Add 20181018: the gradients go to the output errors without m_errorBuf
+	real_t kld = this->_calculateKLD(helpers::getRawPointer(this->_outputErrors()));
+	this->_cacheFusedPass();
+	return kld;
+    }
+
+    template <typename TDevice>
+    real_t KLPostOutputLayer<TDevice>::_calculateKLD(real_t *errorBuf)
     {
 		    
 	if(m_dataType == KLDOUTPUTDATATYPE_LINEAR_UNI){
@@ -216,7 +234,7 @@ namespace layers {
 	    fn.layerSize = this->size();
 	    fn.patTypes  = helpers::getRawPointer(this->patTypes());
 	    fn.mvData    = helpers::getRawPointer(this->_mvVector());
-	    fn.errorBuf  = helpers::getRawPointer(m_errorBuf);
+	    fn.errorBuf  = errorBuf;
 	    fn.factor    = m_lrFactor;
 	    
 	    //fn.maxTime   = this->maxSeqLength();
@@ -266,7 +284,7 @@ namespace layers {
 	    fn.layerSize = this->size();
 	    fn.patTypes  = helpers::getRawPointer(this->patTypes());
 	    fn.mvData    = helpers::getRawPointer(this->_mvVector());
-	    fn.errorBuf  = helpers::getRawPointer(m_errorBuf);
+	    fn.errorBuf  = errorBuf;
 	    fn.factor    = m_lrFactor;
 	    
 	    //fn.maxTime   = this->maxSeqLength();
@@ -307,6 +325,10 @@ namespace layers {
     template <typename TDevice>
     void KLPostOutputLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
      // calculate the errors
 	/*internal::ComputeOutputErrorFn fn;
 	  fn.layerSize = this->size();
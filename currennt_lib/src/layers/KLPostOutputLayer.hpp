@@ -49,6 +49,9 @@ namespace layers {
 	real_vector m_errorBuf; 
 	real_t      m_lrFactor;    //
 
+	// Add 20181018: the KLD, the gradients are written to errorBuf
+	real_t      _calculateKLD(real_t *errorBuf);
+
     public:
         /**
          * Constructs the Layer
@@ -77,6 +80,11 @@ namespace layers {
          */
         virtual real_t calculateError();
 
+        /**
+         * @see PostOutputLayer::calculateErrorAndGradients()
+         */
+        virtual real_t calculateErrorAndGradients();
+
         /**
          * @see Layer::computeForwardPass()
          */
@@ -27,6 +27,7 @@
 #include "Layer.hpp"
 #include "../helpers/misFuncs.hpp"
 #include "../helpers/JsonClasses.hpp"
+#include "../Configuration.hpp"
 
 #include <sstream>
 #include <stdexcept>
@@ -108,6 +109,8 @@ namespace layers {
 	
 	// initialize the training epoch counter
 	m_currTrainingEpoch = -1;
+	m_currTrainingFrac  = -1;
+	m_randomSub         = 0;
 
 	// set the flag
 	m_flagTrainingMode  = (flagTrainingMode ? true : false);
@@ -213,6 +216,7 @@ namespace layers {
 	m_curMaxSeqLength = misFuncs::getResoLength(fraction.maxSeqLength(), m_timeResolution, 1);
 	m_curMinSeqLength = misFuncs::getResoLength(fraction.minSeqLength(), m_timeResolution, 1);
 	m_curNumSeqs      = fraction.numSequences();
+	m_randomSub++;
 	    
 	if (m_timeResolution == 1){
 	    m_patTypes    = fraction.patTypes();
@@ -277,6 +281,17 @@ namespace layers {
     void Layer<TDevice>::setCurrTrainingFrac(const int curTrainingFrac)
     {
 	m_currTrainingFrac = curTrainingFrac;
+	m_randomSub        = 0;
+    }
+
+    template <typename TDevice>
+    helpers::philox::stream_t Layer<TDevice>::_randomStream() const
+    {
+	// in training, the stream is fixed by (epoch, frac)
+	// in generation, frac is the index of the generated fraction
+	return helpers::philox::makeStream(Configuration::instance().randomSeed(),
+					   helpers::philox::streamId(this->name()),
+					   m_currTrainingEpoch, m_currTrainingFrac, m_randomSub);
     }
     
     template <typename TDevice>
@@ -381,6 +396,13 @@ namespace layers {
 	// don't shift
 	return 0;
     }
+
+    template <typename TDevice>
+    bool Layer<TDevice>::fuseSkipAddSource(Layer<TDevice> *skipSource)
+    {
+	// default: not supported
+	return false;
+    }
     
     template <typename TDevice>
     void Layer<TDevice>::setSaveMemoryFlag(const bool newFlag)
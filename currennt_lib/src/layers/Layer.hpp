@@ -26,6 +26,7 @@
 #include "../Types.hpp"
 #include "../data_sets/DataSetFraction.hpp"
 #include "../helpers/JsonClassesForward.hpp"
+#include "../helpers/philoxRandom.cuh"
 
 #include <string>
 
@@ -69,6 +70,8 @@ namespace layers {
 	/* Add 16-09-28 Wang: the current training epoch */
 	int               m_currTrainingEpoch; // epoch number 
 	int               m_currTrainingFrac;  // frac number in each epoch
+	/* Add 20181018: number of fractions loaded since the last setCurrTrainingFrac */
+	unsigned int      m_randomSub;
 
 	
 	bool              m_flagTrainingMode;
@@ -81,6 +84,10 @@ namespace layers {
 	
 	/* Add 16-02-22 Wang: for WE updating */
 	bool         _setInputWeUpdate(const bool& flag);
+
+	/* Add 20181018: counter-based random stream of this layer
+	   keyed by (seed, layer name, epoch, fraction, fractions loaded) */
+	helpers::philox::stream_t _randomStream() const;
 	
     public:
 
@@ -285,6 +292,12 @@ namespace layers {
 	const int& getResolution();
 
 	virtual const std::string& getLayerFlag();
+
+	/*
+	 * Add 20171101: fuse the addition of a skipadd layer into the output of this layer
+	 *  return true if the output of skipSource will be added to the output of this layer
+	 */
+	virtual bool fuseSkipAddSource(Layer<TDevice> *skipSource);
     };
 
 } // namespace layers
@@ -32,6 +32,7 @@
 #include "../activation_functions/Logistic.cuh"
 #include "../activation_functions/Tanh.cuh"
 #include "../Configuration.hpp"
+#include "../MacroDefine.hpp"
 
 #include <thrust/transform.h>
 #include <thrust/transform_reduce.h>
@@ -641,50 +642,6 @@ namespace {
         }
     };
 
-    struct SetH2HMatrixLSTM{
-	// Create the H2Hmatrix for each time step
-	// The created matrix is a lower-triangle (block) matrix
-	int    *bandConfig;
-	int     bandNum;
-	real_t *sourceW;
-	real_t *targetW;
-	int     featDim;
-	int     matrixSize;
-	
-	__host__ __device__ void operator() (const int idx) const{
-	    int bandIdx     = idx / matrixSize + 1;
-	    int sourcePos   = idx % matrixSize; 
-	    int rows        = sourcePos % featDim;
-	    int cols        = sourcePos / featDim;
-	    
-	    int colStart    = 0;
-	    int colEnd      = 0;
-	    int tmp         = 0b01;
-	    bool flag       = false;
-	    
-	    // given a point in one of the H2H matrix
-	    // for the matrix bands that are non-zero in this H2H matrix
-	    //     check if this point locates in the band (and in the lower-triangle area)
-	    //           if yes, this point is non-zero, copy the value for it
-	    //           if not
-	    //                diagonal point ? 1.0 : 0.0
-	    for (int band = 0; band<bandNum; band++){
-		if (bandIdx  & (tmp << band)){ // bit operation
-		    colStart = (band > 0)?(bandConfig[2*band-1]):(colStart);
-		    colEnd   = bandConfig[2*band+1];
-		    if (cols >= colStart && cols < colEnd && rows >= colStart){
-			*(targetW + idx) = *(sourceW + sourcePos);
-			flag = true;
-			break;
-		    }
-		}
-	    }
-	    if (flag == false){
-		*(targetW + idx) = (rows==cols) ? (1.0):(0.0);
-	    }
-	}
-    };
-
     struct CreateSkipVecForContextDepedentCLLSTM{	
 	int         bandNum;
 	int         featDim;
@@ -741,7 +698,7 @@ namespace layers {
     // Parse the option of ClockRNN
     // input: options, layer size
     // change: m_crStep
-    // return: number of possible Hidden2Hidden Matrix
+    // return: number of possible band-activation patterns
     int ReadClockLSTMOptions(const std::string options, Cpu::int_vector &m_crStep, const int size)
     {
 	// read in the option
@@ -767,7 +724,7 @@ namespace layers {
         // Parse m_crStep
     // input:  m_crStep (from the function above) and time step
     // change: tmpSkipFlagCR (which dimension should be skipped in forward propagation)
-    // return: which Hidden2Hidden matrix should be used ?
+    // return: bit mask of the bands updated at this time step
     int DimSkipFlagCRLSTM(Cpu::bool_vector &tmpSkipFlagCR, Cpu::int_vector &m_crStep, 
 			  int timestep, int parallelSent)
     {
@@ -800,11 +757,13 @@ namespace layers {
                                   const helpers::JsonValue &weightsSection,
                                   Layer<TDevice> &precedingLayer,
 				  int maxSeqLength,
-                                  bool bidirectional)
+                                  bool bidirectional,
+                                  typename TDevice::real_vector *sharedWeights)
         : TrainableLayer<TDevice>(
 		layerChild, weightsSection, 4,
 		(bidirectional ? 2 : 4) * helpers::safeJsonGetInt(layerChild, "size") + 3,
-		precedingLayer, maxSeqLength)
+		precedingLayer, maxSeqLength,
+		sharedWeights)
         , m_isBidirectional      (bidirectional)
     {
         if (m_isBidirectional && this->size() % 2 != 0)
@@ -823,11 +782,11 @@ namespace layers {
 	    // Clock LSTM enabled
 	    m_clockRNN   = true;
 
-	    // Parse the option, get the number of possible updating schedule
-	    m_numH2Hmat  = ReadClockLSTMOptions(m_crStepStr, m_crStep, els);
-	    
-	    // initialize the ClockRNN Hidden2Hidden matrices
-	    m_h2hClockRNN.resize(els * els * (m_isBidirectional ? 2: 1) * m_numH2Hmat * 4, 0.0);
+	    // Parse the option
+	    // Modify 20181018: the H2H matrices are no longer duplicated for each updating
+	    //  schedule. Each step only computes the sub-blocks of the active bands
+	    //  over the shared weights (see _clockH2HForward and _clockH2HBackward)
+	    ReadClockLSTMOptions(m_crStepStr, m_crStep, els);
 	    
 	    // copy the configuration to device
 	    m_crStepDevice = m_crStep;
@@ -849,7 +808,6 @@ namespace layers {
 	}else{
 	    m_clockRNN = false;
 	    m_crStep.clear();
-	    m_h2hClockRNN.clear();
 	    m_crStepDevice.clear();
 	}
 
@@ -932,6 +890,10 @@ namespace layers {
                 weight_matrices_t *wm  = wmArr [wmArrIdx];
                 real_vector       *wts = wtsArr[wmArrIdx];
 
+		// Modify 20181018: inference replicas have no gradient buffer to wrap
+		if (wts->empty())
+		    continue;
+
                 int numInputWeights      = ls * pls;
                 int numInternalWeights   = ls * els;
                 int inputWeightsStart    = (((fwbwArrIdx == 1) ? (numInputWeights    / 2) : 0));
@@ -998,7 +960,7 @@ namespace layers {
 		    // tmpFlagCR:    a skip flag for each dimenison in a parallel block
 		    Cpu::bool_vector tmpFlagCR(rows * paraN, false);
 		    
-		    // h2hMatrixIdx: which hidden2hidden matrix should be used
+		    // h2hMatrixIdx: (bit mask of the updated bands) - 1
 		    //               h2hMatrixIdx \in [0  2^band_number-1]
 		    int h2hMatrixIdx = DimSkipFlagCRLSTM(tmpFlagCR, m_crStep, timestep, paraN)-1;
 		    
@@ -1021,22 +983,6 @@ namespace layers {
 				 fwbw->skipCR.begin() + tm.skipCRPos);
 		    
 		    tm.h2hIdx    = h2hMatrixIdx;
-
-		    // matrices for forward and backward direction are separated
-		    h2hMatrixIdx = (h2hMatrixIdx * els * els +
-				    ((fwbwArrIdx == 1) ? (m_h2hClockRNN.size()/2) : 0));
-
-		    tm.niH2HWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els,
-							    h2hMatrixIdx);
-		    h2hMatrixIdx = h2hMatrixIdx + els * els * m_numH2Hmat;
-		    tm.igH2HWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els,
-							    h2hMatrixIdx);
-		    h2hMatrixIdx = h2hMatrixIdx + els * els * m_numH2Hmat;
-		    tm.fgH2HWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els,
-							    h2hMatrixIdx);
-		    h2hMatrixIdx = h2hMatrixIdx + els * els * m_numH2Hmat;
-		    tm.ogH2HWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els,
-							    h2hMatrixIdx);
 		}
 		
                 fwbw->timestepMatrices.push_back(tm);
@@ -1159,6 +1105,72 @@ namespace layers {
             return m_fw.ogDeltas;
     }
 
+    // Add 20181018: Clock LSTM hidden-to-hidden link over the shared weights
+    //  Only the units in the bands updated at curStep receive the recurrent input. For band
+    //  [s, e), the input comes from the units [s, els) (the same and the slower bands).
+    //  This is a GEMM over the sub-block W[s:els, s:e] of the internal weights.
+    template <typename TDevice>
+    void LstmLayer<TDevice>::_clockH2HForward(forward_backward_info_t &fwbw, const bool bwDir,
+					      const int curStep, const int preStep)
+    {
+	int ls    = this->size();
+	int pls   = this->precedingLayer().size();
+	int els   = this->size() / (m_isBidirectional ? 2 : 1);
+	int paraN = this->parallelSequences();
+	int bands = fwbw.timestepMatrices[curStep].h2hIdx + 1;
+
+	real_vector *acts[4] = {&fwbw.niActs, &fwbw.igActs, &fwbw.fgActs, &fwbw.ogActs};
+	
+	for (int band = 0; band < m_crStep.size()/2; band++){
+	    if (!(bands & (0b01 << band)))
+		continue;
+	    int s = (band > 0) ? m_crStep[2*band-1] : 0;
+	    int e = m_crStep[2*band+1];
+	    helpers::Matrix<TDevice> preOutputs(&fwbw.tmpOutputs, els - s, paraN,
+						preStep * els * paraN + s, els);
+	    for (int gate = 0; gate < 4; gate++){
+		int wOff = 4 * (ls * (pls + 1)) + gate * ls * els + (bwDir ? els * els : 0);
+		helpers::Matrix<TDevice> h2hBlock(&this->weights(), els - s, e - s,
+						  wOff + s * els + s, els);
+		helpers::Matrix<TDevice> actsBlock(acts[gate], e - s, paraN,
+						   curStep * els * paraN + s, els);
+		actsBlock.addProduct(h2hBlock, true, preOutputs, false);
+	    }
+	}
+    }
+
+    // Add 20181018: the gradient of _clockH2HForward
+    //  The deltas of the units skipped at nextStep are zero, only the active bands are used
+    template <typename TDevice>
+    void LstmLayer<TDevice>::_clockH2HBackward(forward_backward_info_t &fwbw, const bool bwDir,
+					       const int curStep, const int nextStep)
+    {
+	int ls    = this->size();
+	int pls   = this->precedingLayer().size();
+	int els   = this->size() / (m_isBidirectional ? 2 : 1);
+	int paraN = this->parallelSequences();
+	int bands = fwbw.timestepMatrices[nextStep].h2hIdx + 1;
+
+	real_vector *deltas[4] = {&fwbw.niDeltas, &fwbw.igDeltas, &fwbw.fgDeltas, &fwbw.ogDeltas};
+	
+	for (int band = 0; band < m_crStep.size()/2; band++){
+	    if (!(bands & (0b01 << band)))
+		continue;
+	    int s = (band > 0) ? m_crStep[2*band-1] : 0;
+	    int e = m_crStep[2*band+1];
+	    helpers::Matrix<TDevice> curErrors(&fwbw.tmpOutputErrors, els - s, paraN,
+					       curStep * els * paraN + s, els);
+	    for (int gate = 0; gate < 4; gate++){
+		int wOff = 4 * (ls * (pls + 1)) + gate * ls * els + (bwDir ? els * els : 0);
+		helpers::Matrix<TDevice> h2hBlock(&this->weights(), els - s, e - s,
+						  wOff + s * els + s, els);
+		helpers::Matrix<TDevice> deltasBlock(deltas[gate], e - s, paraN,
+						     nextStep * els * paraN + s, els);
+		curErrors.addProduct(h2hBlock, false, deltasBlock, false);
+	    }
+	}
+    }
+
     template <typename TDevice>
     void LstmLayer<TDevice>::loadSequences(const data_sets::DataSetFraction &fraction,
 					   const int nnState)
@@ -1184,6 +1196,9 @@ namespace layers {
 
             int rows = this->size() / (m_isBidirectional ? 2 : 1);
             int cols = this->curMaxSeqLength() * this->parallelSequences();
+	    // in the memory-save mode, only the ring buffer is available
+	    if (this->getSaveMemoryFlag())
+		cols = NN_RECURRENT_RING_BUFFER_LENGTH * this->parallelSequences();
 
             fwbw->niActsMatrix = helpers::Matrix<TDevice>(&fwbw->niActs, rows, cols);
             fwbw->igActsMatrix = helpers::Matrix<TDevice>(&fwbw->igActs, rows, cols);
@@ -1206,10 +1221,6 @@ namespace layers {
 	if (m_clockRNN){
 	    
 	    int rows    = this->size() / (m_isBidirectional ? 2 : 1);
-            int cols    = this->curMaxSeqLength() * this->parallelSequences();
-	    int ls      = this->size();
-	    int pls     = this->precedingLayer().size();
-	    int h2hsize = rows * rows;
 	    
 	    // Read in the context-dependent time clock
 	    if (fraction.auxDataDim()>0){
@@ -1228,43 +1239,11 @@ namespace layers {
 		    m_fw.timestepMatrices[t].h2hIdx = h2hMatrixIdx;
 		    if(m_isBidirectional) {m_bw.timestepMatrices[t].h2hIdx = h2hMatrixIdx;}
 		    
-		    // assign h2hWarp
-		    int offset   = h2hMatrixIdx * rows * rows;
-		    m_fw.timestepMatrices[t].niH2HWrap = 
-			helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-		    
-		    offset       = offset + rows * rows * m_numH2Hmat;
-		    m_fw.timestepMatrices[t].igH2HWrap =
-			helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-		    
-		    offset       = offset + rows * rows * m_numH2Hmat;
-		    m_fw.timestepMatrices[t].fgH2HWrap =
-			helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-		    
-		    offset       = offset + rows * rows * m_numH2Hmat;
-		    m_fw.timestepMatrices[t].ogH2HWrap =
-			helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-
 		    // assign the skipCRNN vector and skipCRPos
 		    m_fw.timestepMatrices[t].skipCRPos = t * rows;
 		    
 		    if(m_isBidirectional) {
 			m_bw.timestepMatrices[t].skipCRPos = m_fw.timestepMatrices[t].skipCRPos;
-			offset       = h2hMatrixIdx * rows * rows + (m_h2hClockRNN.size()/2);
-			m_bw.timestepMatrices[t].niH2HWrap = 
-			    helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-		    
-			offset       = offset + rows * rows * m_numH2Hmat;
-			m_bw.timestepMatrices[t].igH2HWrap =
-			    helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-			
-			offset       = offset + rows * rows * m_numH2Hmat;
-			m_bw.timestepMatrices[t].fgH2HWrap =
-			    helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
-			
-			offset       = offset + rows * rows * m_numH2Hmat;
-			m_bw.timestepMatrices[t].ogH2HWrap =
-			    helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, offset);
 		    }
 		}
 
@@ -1290,52 +1269,7 @@ namespace layers {
 
 
 
-	    // duplicate the matrix for each time step
-	    int internalWeightsStart = 4 * (ls * (pls + 1));
-	    int srcOff = 0;
-	    int tarOff = 0;
-	    internal::SetH2HMatrixLSTM fn;
-	    for (int i = 0; i < 4; i++){
-		if (m_isBidirectional){
-		    fn.bandConfig = helpers::getRawPointer(m_crStepDevice);
-		    fn.bandNum    = m_crStepDevice.size()/2;
-		    fn.featDim    = rows;
-		    fn.matrixSize = h2hsize;
-
-		    srcOff        = internalWeightsStart + i * h2hsize * 2;
-		    tarOff        = i * h2hsize * m_numH2Hmat;
-		    fn.sourceW    = helpers::getRawPointer(this->weights()) + srcOff;
-		    fn.targetW    = helpers::getRawPointer(m_h2hClockRNN)   + tarOff;
-		    thrust::for_each(thrust::counting_iterator<int>(0),
-				     thrust::counting_iterator<int>(0)  + h2hsize * m_numH2Hmat,
-				     fn);
-		    
-		    srcOff        = internalWeightsStart + i * h2hsize * 2 + h2hsize;
-		    tarOff        = i * h2hsize * m_numH2Hmat + 4 * h2hsize * m_numH2Hmat;
-		    fn.sourceW    = helpers::getRawPointer(this->weights()) + srcOff;
-		    fn.targetW    = helpers::getRawPointer(m_h2hClockRNN)   + tarOff;
-		    thrust::for_each(thrust::counting_iterator<int>(0),
-				     thrust::counting_iterator<int>(0)  + h2hsize * m_numH2Hmat,
-				     fn);
-		
-		}else{
-		    fn.bandConfig = helpers::getRawPointer(m_crStepDevice);
-		    fn.bandNum    = m_crStepDevice.size()/2;
-		    fn.featDim    = rows;
-		    fn.matrixSize = h2hsize;
-
-		    srcOff        = internalWeightsStart + i * h2hsize;
-		    tarOff        = i * h2hsize * m_numH2Hmat;
-		    fn.sourceW    = helpers::getRawPointer(this->weights()) + srcOff;
-		    fn.targetW    = helpers::getRawPointer(m_h2hClockRNN)   + tarOff;
-		    thrust::for_each(thrust::counting_iterator<int>(0),
-				     thrust::counting_iterator<int>(0)  + h2hsize * m_numH2Hmat,
-				     fn);
-		}
-	    }
-	
 	    // For debug
-	    // Show all the H2H matrices
 	    if (DEBUG_CLOCKLSTM){
 		
 		Cpu::bool_vector tmpFlagCR = m_fw.skipCR;
@@ -1347,31 +1281,6 @@ namespace layers {
 		    printf("\n");
 		}
 
-		Cpu::real_vector h2hMatrix_debug = m_h2hClockRNN;
-		int biasPos_debug = 0;
-		for (int i = 0; i < m_numH2Hmat; i++){
-		    printf("Forward: Matrix %d\n", i);
-		    for (int x_row = 0; x_row < rows; x_row++){
-			for (int y_col = 0; y_col < rows; y_col++){
-			    printf("%f ", h2hMatrix_debug[biasPos_debug + x_row + y_col*rows]);
-			}
-			printf("\n");
-		    }
-		    biasPos_debug  += h2hsize;
-		}
-		biasPos_debug  = biasPos_debug * 4;
-		if (m_isBidirectional){
-		    for (int i = 0; i < m_numH2Hmat; i++){
-			printf("BackWard: Matrix %d\n", i);
-			for (int x_row = 0; x_row < rows; x_row++){
-			    for (int y_col = 0; y_col < rows; y_col++){
-				printf("%f ", h2hMatrix_debug[biasPos_debug+x_row+y_col*rows]);
-			    }
-			    printf("\n");
-			}
-			biasPos_debug  += h2hsize;
-		    }
-		}
 		// Show matrix index
 		printf("Time-MatrixIdx\n");
 		for (int t = 0; t < this->curMaxSeqLength(); t++){
@@ -1467,18 +1376,7 @@ namespace layers {
                 // collect outputs from previous timestep
                 if (timestep != 0) {
 		    if (m_clockRNN){
-			m_fw.timestepMatrices[timestep].niActs.addProduct(
-			  m_fw.timestepMatrices[timestep].niH2HWrap, true,
-			  m_fw.timestepMatrices[timestep-1].tmpOutputs, false);
-			m_fw.timestepMatrices[timestep].igActs.addProduct(
-			  m_fw.timestepMatrices[timestep].igH2HWrap, true,
-			  m_fw.timestepMatrices[timestep-1].tmpOutputs, false);
-			m_fw.timestepMatrices[timestep].fgActs.addProduct(
-			  m_fw.timestepMatrices[timestep].fgH2HWrap, true,
-			  m_fw.timestepMatrices[timestep-1].tmpOutputs, false);
-			m_fw.timestepMatrices[timestep].ogActs.addProduct(
-			  m_fw.timestepMatrices[timestep].ogH2HWrap, true,
-			  m_fw.timestepMatrices[timestep-1].tmpOutputs, false);
+			this->_clockH2HForward(m_fw, false, timestep, timestep-1);
 		    }else{
 			m_fw.timestepMatrices[timestep].niActs.addProduct(
 			  m_fw.weightMatrices.niInternal, true,
@@ -1534,18 +1432,7 @@ namespace layers {
                     // collect outputs from previous timestep
                     if (timestep != this->curMaxSeqLength()-1) {
 			if (m_clockRNN){
-			    m_bw.timestepMatrices[timestep].niActs.addProduct(
-				m_bw.timestepMatrices[timestep].niH2HWrap,    true,
-				m_bw.timestepMatrices[timestep+1].tmpOutputs, false);
-			    m_bw.timestepMatrices[timestep].igActs.addProduct(
-				m_bw.timestepMatrices[timestep].igH2HWrap,  true,
-				m_bw.timestepMatrices[timestep+1].tmpOutputs, false);
-			    m_bw.timestepMatrices[timestep].fgActs.addProduct(
-				m_bw.timestepMatrices[timestep].fgH2HWrap,  true,
-				m_bw.timestepMatrices[timestep+1].tmpOutputs, false);
-			    m_bw.timestepMatrices[timestep].ogActs.addProduct(
-				m_bw.timestepMatrices[timestep].ogH2HWrap,  true,
-				m_bw.timestepMatrices[timestep+1].tmpOutputs, false);
+			    this->_clockH2HForward(m_bw, true, timestep, timestep+1);
 			}else{
 			    m_bw.timestepMatrices[timestep].niActs.addProduct(
 				m_bw.weightMatrices.niInternal,               true,
@@ -1611,17 +1498,27 @@ namespace layers {
             m_fw.tmpOutputs.swap(this->_outputs());
         }
 
+	// index of the current and previous step in the buffer
+	// (in the memory-save mode, the buffers are used as a ring buffer)
+	int curStep = timeStep;
+	int preStep = timeStep - 1;
+	if (this->getSaveMemoryFlag()){
+	    curStep = timeStep % NN_RECURRENT_RING_BUFFER_LENGTH;
+	    preStep = (timeStep + NN_RECURRENT_RING_BUFFER_LENGTH - 1) %
+		NN_RECURRENT_RING_BUFFER_LENGTH;
+	}
+
         // sum up the activations from the preceding layer for one time step
         {{
 	    // forward states
 	    // m_preLayerOutputsMatrix is assigned to one frame by prePareStepGeneration(timeStep)
-	    m_fw.timestepMatrices[timeStep].niActs.assignProduct(
+	    m_fw.timestepMatrices[curStep].niActs.assignProduct(
 			m_fw.weightMatrices.niInput, true, m_precLayerOutputsMatrix, false);
-	    m_fw.timestepMatrices[timeStep].igActs.assignProduct(
+	    m_fw.timestepMatrices[curStep].igActs.assignProduct(
 			m_fw.weightMatrices.igInput, true, m_precLayerOutputsMatrix, false);
-	    m_fw.timestepMatrices[timeStep].fgActs.assignProduct(
+	    m_fw.timestepMatrices[curStep].fgActs.assignProduct(
 			m_fw.weightMatrices.fgInput, true, m_precLayerOutputsMatrix, false);
-	    m_fw.timestepMatrices[timeStep].ogActs.assignProduct(
+	    m_fw.timestepMatrices[curStep].ogActs.assignProduct(
 			m_fw.weightMatrices.ogInput, true, m_precLayerOutputsMatrix, false);
         }}
 
@@ -1633,9 +1530,10 @@ namespace layers {
             // forward states
             internal::ComputeBlockOutputFn fn;
             fn.effLayerSize       = els;
-            fn.prevOutputDistance = -n;
+            fn.prevOutputDistance = (preStep - curStep) * n;
             fn.bias               = this->bias();
-            fn.patTypes           = helpers::getRawPointer(this->patTypes());
+            fn.patTypes           = (helpers::getRawPointer(this->patTypes()) +
+				     (timeStep - curStep) * this->parallelSequences());
             fn.niBiasWeights      = _rawNiBiasWeights;
             fn.igBiasWeights      = _rawIgBiasWeights;
             fn.fgBiasWeights      = _rawFgBiasWeights;
@@ -1651,49 +1549,38 @@ namespace layers {
 
             if (timeStep != 0) {
 		if (m_clockRNN){
-		    m_fw.timestepMatrices[timeStep].niActs.addProduct(
-			m_fw.timestepMatrices[timeStep].niH2HWrap, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].igActs.addProduct(
-			m_fw.timestepMatrices[timeStep].igH2HWrap, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].fgActs.addProduct(
-			m_fw.timestepMatrices[timeStep].fgH2HWrap, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].ogActs.addProduct(
-			m_fw.timestepMatrices[timeStep].ogH2HWrap, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);		    
+		    this->_clockH2HForward(m_fw, false, curStep, preStep);
 		}else{
-		    m_fw.timestepMatrices[timeStep].niActs.addProduct(
+		    m_fw.timestepMatrices[curStep].niActs.addProduct(
 			m_fw.weightMatrices.niInternal, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].igActs.addProduct(
+			m_fw.timestepMatrices[preStep].tmpOutputs, false);
+		    m_fw.timestepMatrices[curStep].igActs.addProduct(
 			m_fw.weightMatrices.igInternal, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].fgActs.addProduct(
+			m_fw.timestepMatrices[preStep].tmpOutputs, false);
+		    m_fw.timestepMatrices[curStep].fgActs.addProduct(
 			m_fw.weightMatrices.fgInternal, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);
-		    m_fw.timestepMatrices[timeStep].ogActs.addProduct(
+			m_fw.timestepMatrices[preStep].tmpOutputs, false);
+		    m_fw.timestepMatrices[curStep].ogActs.addProduct(
 			m_fw.weightMatrices.ogInternal, true, 
-			m_fw.timestepMatrices[timeStep-1].tmpOutputs, false);		    
+			m_fw.timestepMatrices[preStep].tmpOutputs, false);		    
 		}
 	    }
 	    // for ClockRNN
 	    if (m_clockRNN)
 		fn.skipCRNN  = (helpers::getRawPointer(m_fw.skipCR) + 
-				m_fw.timestepMatrices[timeStep].skipCRPos);
+				m_fw.timestepMatrices[curStep].skipCRPos);
 	    else
 		fn.skipCRNN  = NULL;
 
 	    // compute outputs
 	    thrust::transform(
-		thrust::counting_iterator<int>(n * timeStep),
-		thrust::counting_iterator<int>(n * timeStep) + n,
+		thrust::counting_iterator<int>(n * curStep),
+		thrust::counting_iterator<int>(n * curStep) + n,
 		thrust::make_zip_iterator(
 		   thrust::make_tuple(
 		      thrust::constant_iterator<bool>(!timeStep), 
 		      thrust::constant_iterator<bool>(timeStep >= this->curMinSeqLength()))),
-		m_fw.tmpOutputs.begin() + n*timeStep,
+		m_fw.tmpOutputs.begin() + n*curStep,
 		fn);
             
 	    // bi-directional network is not allowed
@@ -1764,18 +1651,7 @@ namespace layers {
                 if (timestep != this->curMaxSeqLength()-1) {
 
 		    if (m_clockRNN){
-			m_fw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_fw.timestepMatrices[timestep+1].niH2HWrap, false,
-				m_fw.timestepMatrices[timestep+1].niDeltas, false);
-			m_fw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_fw.timestepMatrices[timestep+1].igH2HWrap, false,
-				m_fw.timestepMatrices[timestep+1].igDeltas, false);
-			m_fw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_fw.timestepMatrices[timestep+1].fgH2HWrap, false,
-				m_fw.timestepMatrices[timestep+1].fgDeltas, false);
-			m_fw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_fw.timestepMatrices[timestep+1].ogH2HWrap, false,
-				m_fw.timestepMatrices[timestep+1].ogDeltas, false);
+			this->_clockH2HBackward(m_fw, false, timestep, timestep+1);
 		    }else{
 			m_fw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
 				m_fw.weightMatrices.niInternal, false,
@@ -1840,19 +1716,7 @@ namespace layers {
                     if (timestep != 0) {
 
 			if (m_clockRNN){
-			    m_bw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_bw.timestepMatrices[timestep-1].niH2HWrap, false,
-				m_bw.timestepMatrices[timestep-1].niDeltas, false);
-			    m_bw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_bw.timestepMatrices[timestep-1].igH2HWrap, false,
-				m_bw.timestepMatrices[timestep-1].igDeltas, false);
-			    m_bw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_bw.timestepMatrices[timestep-1].fgH2HWrap, false,
-				m_bw.timestepMatrices[timestep-1].fgDeltas, false);
-			    m_bw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
-				m_bw.timestepMatrices[timestep-1].ogH2HWrap, false,
-				m_bw.timestepMatrices[timestep-1].ogDeltas, false);
-
+			    this->_clockH2HBackward(m_bw, true, timestep, timestep-1);
 			}else{
 			    m_bw.timestepMatrices[timestep].tmpOutputErrors.addProduct(
 				m_bw.weightMatrices.niInternal, false,
@@ -1970,8 +1834,8 @@ namespace layers {
             }
         }}
 
-        // compute the weight updates
-        {{
+        // compute the weight updates (skipped in the errors-only backward pass)
+        if (!this->flagErrorsOnlyBackward()) {{
             internal::ComputeWeightUpdateFn fn;
             fn.layerSize             = this->size();
             fn.effLayerSize          = this->size() / (m_isBidirectional ? 2 : 1);
@@ -2075,6 +1939,59 @@ namespace layers {
     
 
     
+    template <typename TDevice>
+    void LstmLayer<TDevice>::reduceOutputBuffer()
+    {
+	// bi-directional and clock LSTM require the states of all time steps
+	if (m_isBidirectional || m_clockRNN || this->flagTrainingMode())
+	    return;
+
+	int rows    = this->size();
+	int cols    = this->parallelSequences();
+	int bufSize = NN_RECURRENT_RING_BUFFER_LENGTH * rows * cols;
+
+	// m_fw.tmpOutputs is swapped into this->_outputs() out of the forward pass
+	this->resizeOutputBuffer(bufSize);
+	real_vector* bufArr[] = {&m_fw.cellStates, &m_fw.niActs, &m_fw.igActs,
+				 &m_fw.fgActs,     &m_fw.ogActs};
+	for (int bufIdx = 0; bufIdx < 5; bufIdx++){
+	    bufArr[bufIdx]->clear();
+	    bufArr[bufIdx]->shrink_to_fit();
+	    (*bufArr[bufIdx]) = Cpu::real_vector(bufSize, 0.0);
+	}
+
+	// matrices over the ring buffer
+	m_fw.tmpOutputs.swap(this->_outputs());
+	m_fw.timestepMatrices.resize(NN_RECURRENT_RING_BUFFER_LENGTH);
+	for (int timestep = 0; timestep < NN_RECURRENT_RING_BUFFER_LENGTH; ++timestep){
+	    int offset = timestep * rows * cols;
+	    timestep_matrices_t &tm = m_fw.timestepMatrices[timestep];
+	    tm.tmpOutputs = helpers::Matrix<TDevice>(&m_fw.tmpOutputs, rows, cols, offset);
+	    tm.niActs     = helpers::Matrix<TDevice>(&m_fw.niActs,     rows, cols, offset);
+	    tm.igActs     = helpers::Matrix<TDevice>(&m_fw.igActs,     rows, cols, offset);
+	    tm.fgActs     = helpers::Matrix<TDevice>(&m_fw.fgActs,     rows, cols, offset);
+	    tm.ogActs     = helpers::Matrix<TDevice>(&m_fw.ogActs,     rows, cols, offset);
+	}
+	m_fw.tmpOutputs.swap(this->_outputs());
+	
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+
+    template <typename TDevice>
+    int LstmLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel, const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    // shift to the slot of this time step in the ring buffer
+	    int timeStep = timeStepTimesParallel / this->parallelSequences();
+	    return ((timeStep - timeStep % NN_RECURRENT_RING_BUFFER_LENGTH) *
+		    this->parallelSequences() * this->size());
+	}else{
+	    return 0;
+	}
+    }
+
+    
     // explicit template instantiations
     template class LstmLayer<Cpu>;
     template class LstmLayer<Gpu>;
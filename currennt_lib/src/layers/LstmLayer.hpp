@@ -88,12 +88,8 @@ namespace layers {
             helpers::Matrix<TDevice> ogDeltas;
 
 	    // For Clock LSTM
-	    helpers::Matrix<TDevice> niH2HWrap;  // wrapper for h2input gate matrix 
-            helpers::Matrix<TDevice> igH2HWrap;  // ... 
-            helpers::Matrix<TDevice> fgH2HWrap;  // ...
-            helpers::Matrix<TDevice> ogH2HWrap;
             int                      skipCRPos;  // offset to find the skip vector of current step
-	    int                      h2hIdx;     // the index to retrieve the matrix of current step
+	    int                      h2hIdx;     // (bit mask of the updated bands) - 1
         };
 
         struct forward_backward_info_t {
@@ -148,8 +144,12 @@ namespace layers {
 	std::string              m_crStepStr;       //
 	Cpu::int_vector          m_crStep;          // a vector of [start1,end1,...,startN,endN]
 	int_vector               m_crStepDevice;    //
-	real_vector              m_h2hClockRNN;     // for hidden to hidden link
-	int                      m_numH2Hmat;       // number of possible Clock updating schedule
+
+	// For CLLSTM: hidden to hidden link of the active bands
+	void _clockH2HForward(forward_backward_info_t &fwbw, const bool bwDir,
+			      const int curStep, const int preStep);
+	void _clockH2HBackward(forward_backward_info_t &fwbw, const bool bwDir,
+			       const int curStep, const int nextStep);
 
 	
     public:
@@ -166,7 +166,8 @@ namespace layers {
             const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
 	    int                       maxSeqLength,
-            bool                      bidirectional = false
+            bool                      bidirectional = false,
+            typename TDevice::real_vector *sharedWeights = NULL
             );
 
         /**
@@ -297,6 +298,11 @@ namespace layers {
 	// set the hidden state
 	virtual void setHiddenState(const int timeStep, real_vector& writeBuffer);
 
+	// memory save mode for generation (ring buffer over the time steps)
+	virtual void reduceOutputBuffer();
+
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
+
 	
     };
 
@@ -770,19 +770,117 @@ namespace {
 	}
     };
     
+    // Add 20181018: start of the window in banded mode
+    //  The window is anchored on the mass of the mixture: component k covers
+    //  kappa_k +- radius_k, where rho_k(u) >= threshold * max_k alpha_k, i.e.
+    //  radius_k = sqrt((log(alpha_k / max alpha) - log(threshold)) / beta_k).
+    //  Components below threshold * max alpha cover nothing, and the radius is
+    //  clipped to half of the window, so that a wide component does not push the
+    //  window away from the other kappa. If [min(kappa-radius), max(kappa+radius)]
+    //  fits in the window, the window starts at its lower end; otherwise, the window
+    //  starting or ending at the edge of one component that covers the largest sum
+    //  of alpha over the kappa inside it is used
+    struct CharWBandStart
+    {
+	real_t *chaPara;        // char para [alpha, beta, keppa]
+	int    *bandStart;      // output: start position of the window
+	int     mixNum;
+	int     bandWidth;
+	int     curStrLength;
+	real_t  logThreshold;   // log(threshold) < 0
+
+	// radius of component mixIdx, -1 if it is below threshold * maxAlpha
+	__host__ __device__ real_t radiusOf(const int mixIdx, const real_t maxAlpha,
+					    const real_t maxRadius) const
+	{
+	    real_t alpha = chaPara[mixIdx * CPNUM];
+	    real_t beta  = chaPara[mixIdx * CPNUM + 1];
+	    if (alpha <= 0 || maxAlpha <= 0)
+		return -1.0;
+	    real_t logRatio = log(alpha / maxAlpha) - logThreshold;
+	    if (logRatio < 0)
+		return -1.0;
+	    real_t radius = (beta > 0) ? sqrt(logRatio / beta) : maxRadius;
+	    return (radius > maxRadius) ? maxRadius : radius;
+	}
+
+	__host__ __device__ void operator() (const int &idx) const
+	{
+	    real_t maxAlpha = 0.0;
+	    for (int mixIdx = 0; mixIdx < mixNum; mixIdx++)
+		maxAlpha = (chaPara[mixIdx * CPNUM] > maxAlpha) ?
+		    chaPara[mixIdx * CPNUM] : maxAlpha;
+	    
+	    real_t lower     = curStrLength;
+	    real_t upper     = 0.0;
+	    real_t maxRadius = 0.5 * bandWidth;
+	    bool   covered   = false;
+	    for (int mixIdx = 0; mixIdx < mixNum; mixIdx++){
+		real_t radius = radiusOf(mixIdx, maxAlpha, maxRadius);
+		if (radius < 0)
+		    continue;
+		real_t kappa = chaPara[mixIdx * CPNUM + 2];
+		lower   = ((kappa - radius) < lower) ? (kappa - radius) : lower;
+		upper   = ((kappa + radius) > upper) ? (kappa + radius) : upper;
+		covered = true;
+	    }
+	    
+	    int start = 0;
+	    if (covered && floor(upper) - floor(lower) < bandWidth){
+		start = (int)floor(lower);
+		
+	    }else if (covered){
+		real_t bestMass = -1.0;
+		for (int mixIdx = 0; mixIdx < mixNum; mixIdx++){
+		    real_t radius = radiusOf(mixIdx, maxAlpha, maxRadius);
+		    if (radius < 0)
+			continue;
+		    real_t kappa = chaPara[mixIdx * CPNUM + 2];
+		    for (int side = 0; side < 2; side++){
+			int cand = (side == 0) ? (int)floor(kappa - radius) :
+			    ((int)ceil(kappa + radius) - bandWidth + 1);
+			real_t mass = 0.0;
+			for (int k = 0; k < mixNum; k++){
+			    real_t kappaK = chaPara[k * CPNUM + 2];
+			    if (radiusOf(k, maxAlpha, maxRadius) >= 0 &&
+				kappaK >= cand && kappaK < cand + bandWidth)
+				mass += chaPara[k * CPNUM];
+			}
+			if (mass > bestMass){
+			    bestMass = mass;
+			    start    = cand;
+			}
+		    }
+		}
+	    }
+	    
+	    int last  = ((curStrLength - bandWidth) > 0) ? (curStrLength - bandWidth) : 0;
+	    start = (start < 0) ? 0 : start;
+	    start = (start > last) ? last : start;
+	    *bandStart = start;
+	}
+    };
+    
     struct CharWPara2Rho
     {
 	
 	real_t *rhoPtr;         // rho(k,u,t)
 	real_t *chaPara;        // char para [alpha, beta, keppa]
+	int    *bandStart;      // start of the window (NULL: no window)
 	int mixNum;             //
+	int curStrLength;
 	__host__ __device__ void operator() (const int &dataIdx) const
 	{
 	    int mixIdx = (dataIdx % mixNum);
-	    int chaIdx = (dataIdx / mixNum);
+	    int bandIdx = (dataIdx / mixNum);
+	    int chaIdx = bandIdx + ((bandStart == NULL) ? 0 : (*bandStart));
 	    real_t *mixPtr = chaPara + mixIdx * CPNUM;
 	    // Rho
-	    (*(rhoPtr+(mixNum)*chaIdx + mixIdx)) = *(mixPtr)* 
+	    if (chaIdx >= curStrLength){
+		(*(rhoPtr+(mixNum)*bandIdx + mixIdx)) = 0.0;
+		return;
+	    }
+	    (*(rhoPtr+(mixNum)*bandIdx + mixIdx)) = *(mixPtr)* 
 		helpers::safeExp( -1 * (*(mixPtr + 1))      *
 				  ((*(mixPtr + 2))-chaIdx)  *
 				  ((*(mixPtr + 2))-chaIdx));
@@ -790,6 +888,48 @@ namespace {
     
     };
 
+    // Add 20181018: \sum_u phi(u)C_u over the window
+    struct CharWBandFeature
+    {
+	real_t *charMatrix;     // C [charDim, U]
+	real_t *phiPtr;         // phi over the window
+	real_t *featureOut;
+	int    *bandStart;
+	int     bandLength;
+	int     curStrLength;
+	int     charDim;
+	
+	__host__ __device__ void operator() (const int &dimIdx) const
+	{
+	    real_t tmp = 0.0;
+	    int start  = *bandStart;
+	    for (int j = 0; j < bandLength && (start + j) < curStrLength; j++)
+		tmp += charMatrix[(start + j) * charDim + dimIdx] * phiPtr[j];
+	    featureOut[dimIdx] = tmp;
+	}
+    };
+
+    // Add 20181018: \tau_t_u = \sum_i^{chaDim} \delta_ti C_ui over the window
+    struct CharWBandTau
+    {
+	real_t *charMatrix;     // C [charDim, U]
+	real_t *gradients;      // \delta_t [charDim]
+	real_t *tau_t;
+	int    *bandStart;
+	int     curStrLength;
+	int     charDim;
+	
+	__host__ __device__ void operator() (const int &bandIdx) const
+	{
+	    int chaIdx = bandIdx + (*bandStart);
+	    real_t tmp = 0.0;
+	    if (chaIdx < curStrLength)
+		for (int i = 0; i < charDim; i++)
+		    tmp += charMatrix[chaIdx * charDim + i] * gradients[i];
+	    tau_t[bandIdx] = tmp;
+	}
+    };
+
     struct CharWParaFeatureExtract
     {
 	real_t *charMatrix;
@@ -846,11 +986,14 @@ namespace {
 	real_t *rhoPtr;
 	real_t *buffPtr;
 	real_t *chaWPara;
+	int    *bandStart;   // start of the window (NULL: no window)
     	int mixNum;          // 
 	int paraNum;         // default as 3
 	__host__ __device__ void operator() (const int& idx) const
 	{
-	    int chaPos = (idx / (mixNum * paraNum));    // u: position in the string
+	    int bandPos = (idx / (mixNum * paraNum));   // position in rho buffer
+	    int chaPos  = bandPos + ((bandStart == NULL) ? 0 : (*bandStart));
+	                                                // u: position in the string
 	    int bufIdx = (idx % (mixNum * paraNum));    
 	    int mixIdx = (bufIdx / paraNum);            // which mixture ?
 	    int parIdx = (bufIdx % paraNum);            // alpha, beta or kappa?
@@ -859,7 +1002,7 @@ namespace {
 	    switch (parIdx){
 	    case 0:
 		// alpha
-		*(buffPtr + idx) = *(rhoPtr + chaPos * mixNum + mixIdx);
+		*(buffPtr + idx) = *(rhoPtr + bandPos * mixNum + mixIdx);
 		break;
 	    case 1:
 		// beta
@@ -867,7 +1010,7 @@ namespace {
 		*(buffPtr + idx) = -1 * 
 		                   (*(chaWPara + mixIdx * paraNum + 1)) * 
 		                   tmp * tmp *
-		                   (*(rhoPtr   + chaPos * mixNum  + mixIdx));
+		                   (*(rhoPtr   + bandPos * mixNum  + mixIdx));
 		break;
 	    case 2:
 		// kappa
@@ -875,7 +1018,7 @@ namespace {
 		*(buffPtr + idx) = -2 * 
 		                   (*(chaWPara + mixIdx * paraNum + 1)) * 
 		                   tmp *
-		                   (*(rhoPtr   + chaPos * mixNum  + mixIdx));
+		                   (*(rhoPtr   + bandPos * mixNum  + mixIdx));
 		break;
 	    default:
 		break;
@@ -1133,6 +1276,8 @@ namespace layers {
 			  const int chaMaxLength, 
 			  const int seqMaxLength,
 			  const int paraSequence,
+			  const int bandWidth,
+			  const real_t bandThreshold,
 			  real_vector *weight,      
 			  real_vector *output,         
 			  real_vector *outputErrors,
@@ -1151,22 +1296,32 @@ namespace layers {
 	, m_outErrorsLstm (outputErrors)
 	, m_outputsAll    (outputAll)
 	, m_outErrorsAll  (outErrorsAll)
+	, m_bandWidth     (bandWidth)
+	, m_bandThreshold (bandThreshold)
     {
+	if (m_bandWidth > 0 && (m_bandThreshold <= 0 || m_bandThreshold >= 1))
+	    throw std::runtime_error("charW_bandThreshold should be in (0, 1)");
+	
 	// initialize the rhoVector rho[k, u, t]
 	// two rho matrices for forward and backward in BLSTM
+	// in banded mode, u only covers the window of each frame
 	Cpu::real_vector tmp;
-	tmp.resize((blstm ? 2: 1) *m_mixNum * m_chaMaxLength * m_seqMaxLength, 0);
+	tmp.resize((blstm ? 2: 1) *m_mixNum * this->rhoMaxWidth() * m_seqMaxLength, 0);
 	m_rhoVec = tmp;
 	
-	tmp.resize((blstm ? 2: 1) *m_chaMaxLength * m_seqMaxLength, 0);
+	tmp.resize((blstm ? 2: 1) *this->rhoMaxWidth() * m_seqMaxLength, 0);
 	m_phiVec = tmp;
+
+	// start position of the window for each frame
+	Cpu::int_vector tmpInt((blstm ? 2: 1) * m_seqMaxLength, 0);
+	m_bandStart = tmpInt;
 	
 	// initialize the buf for error propatation
 	// [3k, U]^T,  
 	// [rho_1_1_t, \beta_t^1 * (\kappa_t^1-1)^2 * \rho_1_1_t, ...
 	//  rho_1_2_t, \beta_t^1 * (\kappa_t^1-2)^2 * \rho_1_1_2, ...]
 	// 
-	tmp.resize(m_chaMaxLength * CPNUM * m_mixNum);
+	tmp.resize(this->rhoMaxWidth() * CPNUM * m_mixNum);
 	m_rhoErrorBuf = tmp;
 
 	// initialize for simplicity
@@ -1192,7 +1347,7 @@ namespace layers {
 
 	// initialize the error buff
 	// to store the \sum_i=1^{D} feaVecError(t,i)c(u,i)
-	tmp.resize(m_chaMaxLength, 0);
+	tmp.resize(this->rhoMaxWidth(), 0);
 	m_tau_t = tmp;
 
 
@@ -1213,6 +1368,22 @@ namespace layers {
         return m_chaDim;
     }
 
+    template <typename TDevice>
+    int CharW<TDevice>::rhoMaxWidth() const
+    {
+	if (m_bandWidth > 0 && m_bandWidth < m_chaMaxLength)
+	    return m_bandWidth;
+	return m_chaMaxLength;
+    }
+
+    template <typename TDevice>
+    int CharW<TDevice>::rhoCurWidth() const
+    {
+	if (m_bandWidth > 0 && m_bandWidth < m_chaCurLength)
+	    return m_bandWidth;
+	return m_chaCurLength;
+    }
+
     template <typename TDevice>
     CharW<TDevice>::~CharW()
     {
@@ -1387,6 +1558,12 @@ namespace layers {
 			new CharW<TDevice>(m_mixNum, m_chaDim, m_lstmDim,CPNUM,
 					   chaMaxLength, seqMaxLength, 
 					   this->parallelSequences(),
+					   (layerChild->HasMember("charW_band") ?
+					    (*layerChild)["charW_band"].GetInt() : 0),
+					   (layerChild->HasMember("charW_bandThreshold") ?
+					    static_cast<real_t>(
+						(*layerChild)["charW_bandThreshold"].GetDouble()) :
+					    0.0001),
 					   (&this->weights()),
 					   (&this->outputsLstm()),
 					   (&this->outputErrorsLstm()),
@@ -1397,6 +1574,10 @@ namespace layers {
 	// Read in the txt Bank information
 	m_charW -> m_txtBank = internal::readTxtBank(chaDim);
 
+	if (m_charW->m_bandWidth > 0)
+	    printf("\n\tCharW banded window: %d positions, threshold %f",
+		   m_charW->rhoMaxWidth(), m_charW->m_bandThreshold);
+
 	// Initiale Lstm
 	// ------------------------------------
         // set raw pointers
@@ -1479,6 +1660,10 @@ namespace layers {
                 weight_matrices_t *wm  = wmArr [wmArrIdx];
                 real_vector       *wts = wtsArr[wmArrIdx];
 
+		// Modify 20181018: inference replicas have no gradient buffer to wrap
+		if (wts->empty())
+		    continue;
+
                 int nmInW     = ls * pls; // number of input weights
                 int nmInterW  = ls * els; // number of internal weights
                 int inWStart  = ((fwbwArrIdx == 1) ? (nmInW / 2) : 0); // input weight start
@@ -1565,10 +1750,12 @@ namespace layers {
 		tm.outputsCOffset      = offset;
 
 		// link the rho matrix for 
-		rows         = m_charW->m_mixNum * m_charW->m_chaMaxLength;
+		rows         = m_charW->m_mixNum * m_charW->rhoMaxWidth();
 		offset       = rows * (timestep * (blstm ? 2:1) + ((fwbwArrIdx==1) ? 1:0));
 		tm.tmpRho    = helpers::getRawPointer(m_charW->m_rhoVec) + offset;
 		tm.rhoOffset = offset;
+		tm.tmpBandStart = helpers::getRawPointer(m_charW->m_bandStart) +
+		    (timestep * (blstm ? 2:1) + ((fwbwArrIdx==1) ? 1:0));
 
 		fwbw->timestepMatrices.push_back(tm);
             }
@@ -1865,37 +2052,70 @@ namespace layers {
 		}}
 				
 		{{
+		    bool banded  = (m_charW->m_bandWidth > 0);
+		    int  rhoCurW = m_charW->rhoCurWidth();
+		    if (banded){
+			// locate the window around kappa for timestep t
+			internal::CharWBandStart fn3;
+			fn3.chaPara      = m_fw.timestepMatrices[timestep].tmpCharParaPtr;
+			fn3.bandStart    = m_fw.timestepMatrices[timestep].tmpBandStart;
+			fn3.mixNum       = m_mixNum;
+			fn3.bandWidth    = rhoCurW;
+			fn3.curStrLength = m_charW->m_chaCurLength;
+			fn3.logThreshold = std::log(m_charW->m_bandThreshold);
+			thrust::for_each(thrust::counting_iterator<int>(0),
+					 thrust::counting_iterator<int>(0) + 1,
+					 fn3);
+		    }
+		    
 		    // get rho [k, u] for timestep t
 		    internal::CharWPara2Rho fn2;
 		    fn2.rhoPtr  = m_fw.timestepMatrices[timestep].tmpRho;
 		    fn2.chaPara = m_fw.timestepMatrices[timestep].tmpCharParaPtr;
+		    fn2.bandStart = banded ? m_fw.timestepMatrices[timestep].tmpBandStart : NULL;
 		    fn2.mixNum  = m_mixNum;
+		    fn2.curStrLength = m_charW->m_chaCurLength;
 		    thrust::for_each(thrust::counting_iterator<int>(0),
 				     thrust::counting_iterator<int>(0)+
-				     m_mixNum*m_charW->m_chaCurLength,
+				     m_mixNum*rhoCurW,
 				     fn2);
 		    // get phi[u] for timestep t
 		    helpers::Matrix<TDevice> rhoMat(
-			&m_charW->m_rhoVec, m_mixNum, m_charW->m_chaCurLength,
+			&m_charW->m_rhoVec, m_mixNum, rhoCurW,
 			m_fw.timestepMatrices[timestep].rhoOffset);
 		    helpers::Matrix<TDevice> one   (
 			&m_charW->m_tmpOne, m_mixNum, 1, 0);
 		    helpers::Matrix<TDevice> phiMat(
-			&m_charW->m_phiVec,1, m_charW->m_chaCurLength,
+			&m_charW->m_phiVec,1, rhoCurW,
 			m_fw.timestepMatrices[timestep].rhoOffset/m_mixNum);
 		    phiMat.assignProduct(one, true, rhoMat, false);
 			
 		    // extract output from ChaW \sum_u phi(u)Cu
-		    helpers::Matrix<TDevice> strMat(&m_charW->m_strWord, m_chaDim, 
-						    m_charW->m_chaCurLength, 0);
-		    m_fw.timestepMatrices[timestep].tmpOutputsC.assignProduct(strMat,false, 
-									      phiMat, true);
+		    if (banded){
+			internal::CharWBandFeature fn3;
+			fn3.charMatrix   = helpers::getRawPointer(m_charW->m_strWord);
+			fn3.phiPtr       = helpers::getRawPointer(m_charW->m_phiVec) +
+			    m_fw.timestepMatrices[timestep].rhoOffset/m_mixNum;
+			fn3.featureOut   = m_fw.timestepMatrices[timestep].tmpOutputsCPtr;
+			fn3.bandStart    = m_fw.timestepMatrices[timestep].tmpBandStart;
+			fn3.bandLength   = rhoCurW;
+			fn3.curStrLength = m_charW->m_chaCurLength;
+			fn3.charDim      = m_chaDim;
+			thrust::for_each(thrust::counting_iterator<int>(0),
+					 thrust::counting_iterator<int>(0) + m_chaDim,
+					 fn3);
+		    }else{
+			helpers::Matrix<TDevice> strMat(&m_charW->m_strWord, m_chaDim, 
+							m_charW->m_chaCurLength, 0);
+			m_fw.timestepMatrices[timestep].tmpOutputsC.assignProduct(strMat,false, 
+										  phiMat, true);
+		    }
 			
 
 		    // -------- DEBUG ------- //
                     #ifdef DEBUG_LOCAL_LSTMCHARW
 		    printf("\nTime %d\nKappa:", timestep);
-		    int offset1  = m_charW->m_mixNum * m_charW->m_chaMaxLength *
+		    int offset1  = m_charW->m_mixNum * m_charW->rhoMaxWidth() *
 			    (timestep * (m_isBidirectional?2:1));
 		    int offset2  = m_charW->inSize() * (timestep * (m_isBidirectional?2:1));
 		    cpu_real_vector t_rho = m_charW->m_rhoVec;
@@ -1943,7 +2163,7 @@ namespace layers {
 					 fn2
 					 );*/	
 			cpu_real_vector t_charMatrix =  m_charW->m_strWord;
-			int offset1  = m_charW->m_mixNum * m_charW->m_chaMaxLength *
+			int offset1  = m_charW->m_mixNum * m_charW->rhoMaxWidth() *
 			    (timestep * (m_isBidirectional?2:1));
 			cpu_real_vector t_rho        =  m_charW->m_rhoVec;
 			int offset2 =  m_charW->outSize() * timestep * (m_isBidirectional?2:1);
@@ -2047,31 +2267,49 @@ namespace layers {
 		    
 		    
 		    {{
+			bool banded  = (m_charW->m_bandWidth > 0);
+			int  rhoCurW = m_charW->rhoCurWidth();
+			if (banded){
+			    // locate the window around kappa for timestep t
+			    internal::CharWBandStart fn3;
+			    fn3.chaPara      = m_bw.timestepMatrices[timestep].tmpCharParaPtr;
+			    fn3.bandStart    = m_bw.timestepMatrices[timestep].tmpBandStart;
+			    fn3.mixNum       = m_mixNum;
+			    fn3.bandWidth    = rhoCurW;
+			    fn3.curStrLength = m_charW->m_chaCurLength;
+			    fn3.logThreshold = std::log(m_charW->m_bandThreshold);
+			    thrust::for_each(thrust::counting_iterator<int>(0),
+					     thrust::counting_iterator<int>(0) + 1,
+					     fn3);
+			}
+			
 			// get rho [k, u] for timestep t
 			internal::CharWPara2Rho fn2;
 			fn2.rhoPtr  = m_bw.timestepMatrices[timestep].tmpRho;
 			fn2.chaPara = m_bw.timestepMatrices[timestep].tmpCharParaPtr;
+			fn2.bandStart = banded ? m_bw.timestepMatrices[timestep].tmpBandStart:NULL;
 			fn2.mixNum  = m_mixNum;
+			fn2.curStrLength = m_charW->m_chaCurLength;
 			thrust::for_each(thrust::counting_iterator<int>(0),
 					thrust::counting_iterator<int>(0)+
-					 m_mixNum*m_charW->m_chaCurLength,
+					 m_mixNum*rhoCurW,
 					fn2);
 
 			// get phi[u] for timestep t
 			helpers::Matrix<TDevice> rhoMat(
-			    &m_charW->m_rhoVec, m_mixNum, m_charW->m_chaCurLength,
+			    &m_charW->m_rhoVec, m_mixNum, rhoCurW,
 			    m_bw.timestepMatrices[timestep].rhoOffset);
 			helpers::Matrix<TDevice> one   (
 			    &m_charW->m_tmpOne, m_mixNum, 1, 0);
 			helpers::Matrix<TDevice> phiMat(
-			    &m_charW->m_phiVec,1, m_charW->m_chaCurLength,
+			    &m_charW->m_phiVec,1, rhoCurW,
 			    m_bw.timestepMatrices[timestep].rhoOffset/m_mixNum);
 			phiMat.assignProduct(one, true, rhoMat, false);
 		    
 			// -------- DEBUG ------- //
                         #ifdef DEBUG_LOCAL_LSTMCHARW
 			printf("\nTime %d\n", timestep);
-			int offset1  = m_charW->m_mixNum * m_charW->m_chaMaxLength *
+			int offset1  = m_charW->m_mixNum * m_charW->rhoMaxWidth() *
 			    (timestep * (m_isBidirectional?2:1) + 1);
 			int offset2  = m_charW->inSize() * 
 			    (timestep * (m_isBidirectional?2:1) + 1);
@@ -2104,10 +2342,25 @@ namespace layers {
                         #endif
 
 			// extract output from ChaW
-			helpers::Matrix<TDevice> strMat(&m_charW->m_strWordRev, m_chaDim, 
-							m_charW->m_chaCurLength, 0);
-			m_bw.timestepMatrices[timestep].tmpOutputsC.assignProduct(strMat, false, 
-										  phiMat, true);
+			if (banded){
+			    internal::CharWBandFeature fn3;
+			    fn3.charMatrix   = helpers::getRawPointer(m_charW->m_strWordRev);
+			    fn3.phiPtr       = helpers::getRawPointer(m_charW->m_phiVec) +
+				m_bw.timestepMatrices[timestep].rhoOffset/m_mixNum;
+			    fn3.featureOut   = m_bw.timestepMatrices[timestep].tmpOutputsCPtr;
+			    fn3.bandStart    = m_bw.timestepMatrices[timestep].tmpBandStart;
+			    fn3.bandLength   = rhoCurW;
+			    fn3.curStrLength = m_charW->m_chaCurLength;
+			    fn3.charDim      = m_chaDim;
+			    thrust::for_each(thrust::counting_iterator<int>(0),
+					     thrust::counting_iterator<int>(0) + m_chaDim,
+					     fn3);
+			}else{
+			    helpers::Matrix<TDevice> strMat(&m_charW->m_strWordRev, m_chaDim, 
+							    m_charW->m_chaCurLength, 0);
+			    m_bw.timestepMatrices[timestep].tmpOutputsC.assignProduct(
+				strMat, false, phiMat, true);
+			}
 
 
 		    }}
@@ -2131,7 +2384,7 @@ namespace layers {
 					 fn2);*/
 			
 			cpu_real_vector t_charMatrix =  m_charW->m_strWord;
-			int offset1  = m_charW->m_mixNum * m_charW->m_chaMaxLength *
+			int offset1  = m_charW->m_mixNum * m_charW->rhoMaxWidth() *
 			    (timestep * (m_isBidirectional?2:1) + 1);
 			cpu_real_vector t_rho        =  m_charW->m_rhoVec;
 			int offset2 = m_charW->outSize()*(timestep * (m_isBidirectional?2:1)+1);
@@ -2296,15 +2549,29 @@ namespace layers {
 		    // step1.compute errors in CharW from CharW->feaVecErrors to CharW->CharErrors
 		    
 		    bool boundary = (timestep == this->curMaxSeqLength()-1);
+		    bool banded   = (m_charW->m_bandWidth > 0);
+		    int  rhoCurW  = m_charW->rhoCurWidth();
 		    {{
 			// prepare the error buf \tau_t_u = \sum_i^{chaDim} \delta_ti C_ui
-			helpers::Matrix<TDevice> tauMat(&m_charW->m_tau_t, 
-							m_charW->m_chaCurLength, 1, 0);
-			helpers::Matrix<TDevice> strMat(&m_charW->m_strWord,
-							m_chaDim, m_charW->m_chaCurLength, 0);
-			tauMat.assignProduct(strMat, true, 
-					     m_fw.timestepMatrices[timestep].tmpOutputErrorsC,
-					     false);
+			helpers::Matrix<TDevice> tauMat(&m_charW->m_tau_t, rhoCurW, 1, 0);
+			if (banded){
+			    internal::CharWBandTau fn3;
+			    fn3.charMatrix   = helpers::getRawPointer(m_charW->m_strWord);
+			    fn3.gradients    = m_fw.timestepMatrices[timestep].tmpOutputErrorsCPtr;
+			    fn3.tau_t        = helpers::getRawPointer(m_charW->m_tau_t);
+			    fn3.bandStart    = m_fw.timestepMatrices[timestep].tmpBandStart;
+			    fn3.curStrLength = m_charW->m_chaCurLength;
+			    fn3.charDim      = m_chaDim;
+			    thrust::for_each(thrust::counting_iterator<int>(0),
+					     thrust::counting_iterator<int>(0) + rhoCurW,
+					     fn3);
+			}else{
+			    helpers::Matrix<TDevice> strMat(&m_charW->m_strWord,
+							    m_chaDim, m_charW->m_chaCurLength, 0);
+			    tauMat.assignProduct(strMat, true, 
+						 m_fw.timestepMatrices[timestep].tmpOutputErrorsC,
+						 false);
+			}
 
 			// ---- DEBUG ----- //
 			#ifdef DEBUG_LOCAL_LSTMCHARW	
@@ -2330,16 +2597,17 @@ namespace layers {
 			fn4.rhoPtr          = m_fw.timestepMatrices[timestep].tmpRho;
 			fn4.buffPtr         = helpers::getRawPointer(m_charW->m_rhoErrorBuf);
 			fn4.chaWPara        = m_fw.timestepMatrices[timestep].tmpCharParaPtr;
+			fn4.bandStart       = banded ? 
+			    m_fw.timestepMatrices[timestep].tmpBandStart : NULL;
 			fn4.mixNum          = m_mixNum;
 			fn4.paraNum         = CPNUM;
 			thrust::for_each(thrust::counting_iterator<int>(0),
 					 thrust::counting_iterator<int>(0) + 
-					 CPNUM * m_mixNum * m_charW->m_chaCurLength,
+					 CPNUM * m_mixNum * rhoCurW,
 					 fn4);
 			
 			helpers::Matrix<TDevice> errBuf(&m_charW->m_rhoErrorBuf, 
-							m_mixNum * CPNUM, m_charW->m_chaCurLength, 
-							0);
+							m_mixNum * CPNUM, rhoCurW, 0);
 			
 			// get the gradients
 			m_fw.timestepMatrices[timestep].tmpCharParaError.assignProduct(
@@ -2509,32 +2777,49 @@ namespace layers {
 			// step1. compute errors in CharW (from CharW->feaVecErrors to 
 			// CharW->CharErrors)
 			bool boundary = (timestep == 0);
+			bool banded   = (m_charW->m_bandWidth > 0);
+			int  rhoCurW  = m_charW->rhoCurWidth();
 			{{
 				
 			   // prepare the error buf \tau_t_u = \sum_i^{chaDim} \delta_ti C_ui
-			   helpers::Matrix<TDevice> tauMat(&m_charW->m_tau_t, 
-							   m_charW->m_chaCurLength, 1, 0);
-			   helpers::Matrix<TDevice> strMat(&m_charW->m_strWordRev,
-							   m_chaDim, m_charW->m_chaCurLength, 0);
-			   tauMat.assignProduct(strMat, true, 
-						m_bw.timestepMatrices[timestep].tmpOutputErrorsC,
-						false);
+			   helpers::Matrix<TDevice> tauMat(&m_charW->m_tau_t, rhoCurW, 1, 0);
+			   if (banded){
+			       internal::CharWBandTau fn3;
+			       fn3.charMatrix   = helpers::getRawPointer(m_charW->m_strWordRev);
+			       fn3.gradients    = 
+				   m_bw.timestepMatrices[timestep].tmpOutputErrorsCPtr;
+			       fn3.tau_t        = helpers::getRawPointer(m_charW->m_tau_t);
+			       fn3.bandStart    = m_bw.timestepMatrices[timestep].tmpBandStart;
+			       fn3.curStrLength = m_charW->m_chaCurLength;
+			       fn3.charDim      = m_chaDim;
+			       thrust::for_each(thrust::counting_iterator<int>(0),
+						thrust::counting_iterator<int>(0) + rhoCurW,
+						fn3);
+			   }else{
+			       helpers::Matrix<TDevice> strMat(&m_charW->m_strWordRev,
+							       m_chaDim, m_charW->m_chaCurLength, 0);
+			       tauMat.assignProduct(strMat, true, 
+						    m_bw.timestepMatrices[timestep].tmpOutputErrorsC,
+						    false);
+			   }
 			   
 			   // prepare the Rho Error Buffer
 			   internal::PrepareRhoErrorBuf fn4;
 			   fn4.rhoPtr          = m_bw.timestepMatrices[timestep].tmpRho;
 			   fn4.buffPtr         = helpers::getRawPointer(m_charW->m_rhoErrorBuf);
 			   fn4.chaWPara        = m_bw.timestepMatrices[timestep].tmpCharParaPtr;
+			   fn4.bandStart       = banded ? 
+			       m_bw.timestepMatrices[timestep].tmpBandStart : NULL;
 			   fn4.mixNum          = m_mixNum;
 			   fn4.paraNum         = CPNUM;
 			   thrust::for_each(thrust::counting_iterator<int>(0),
 					    thrust::counting_iterator<int>(0) + 
-					    CPNUM * m_mixNum * m_charW->m_chaCurLength,
+					    CPNUM * m_mixNum * rhoCurW,
 					    fn4);
 			   
 			   helpers::Matrix<TDevice> errBuf(&m_charW->m_rhoErrorBuf, 
 							   m_mixNum*CPNUM, 
-							   m_charW->m_chaCurLength, 
+							   rhoCurW, 
 							   0);
 			
 			   // get the gradients
@@ -2801,15 +3086,28 @@ namespace layers {
              The internal part contains all the weights in LstmCharW. 
      */
     template <typename TDevice>
-    void LstmLayerCharW<TDevice>::exportWeights(const helpers::JsonValue &weightsObject, 
-						const helpers::JsonAllocator &allocator) const
+    void LstmLayerCharW<TDevice>::weightArraySizes(int *inputNum, int *biasNum,
+						   int *internalNum) const
     {
-	// 1. calculate the interal weight of LstmCharW
+	// the interal weight of LstmCharW
 	int internalLstm      = (m_isBidirectional?2:4) * this->lstmSize() + 3;
 	int internalLstmCharW = CPNUM * m_mixNum +             // LSTM -> CharW 
 				(m_isBidirectional?2:1) +       
 				m_chaDim * 4;                  // CharW-> LSTM (to gates)
 	int inputWeightsPerBlock = 4;                          //
+
+	*inputNum    = this->lstmSize() * inputWeightsPerBlock * this->precedingLayer().size();
+	*biasNum     = this->lstmSize() * inputWeightsPerBlock;
+	*internalNum = this->lstmSize() * (internalLstm + internalLstmCharW);
+    }
+    
+    template <typename TDevice>
+    void LstmLayerCharW<TDevice>::exportWeights(const helpers::JsonValue &weightsObject, 
+						const helpers::JsonAllocator &allocator) const
+    {
+	// 1. calculate the interal weight of LstmCharW
+	int inputWeightsCount, bWeightsCount, inWeightsCount;
+	this->weightArraySizes(&inputWeightsCount, &bWeightsCount, &inWeightsCount);
 	
         if (!weightsObject->IsObject())
             throw std::runtime_error("The JSON value is not an object");
@@ -2820,19 +3118,16 @@ namespace layers {
 
         // create and fill the weight arrays
         rapidjson::Value inputWeightsArray(rapidjson::kArrayType);
-        int inputWeightsCount=this->lstmSize()*inputWeightsPerBlock*this->precedingLayer().size();
         inputWeightsArray.Reserve(inputWeightsCount, allocator);
         for (int i = 0; i < inputWeightsCount; ++i)
             inputWeightsArray.PushBack(this->weights()[i], allocator);
 
         rapidjson::Value biasWeightsArray(rapidjson::kArrayType);
-        int bWeightsCount = this->lstmSize() * inputWeightsPerBlock;
         biasWeightsArray.Reserve(bWeightsCount, allocator);
         for (int i = 0; i < bWeightsCount; ++i)
             biasWeightsArray.PushBack(this->weights()[inputWeightsCount + i], allocator);
 
         rapidjson::Value inWeightsArray(rapidjson::kArrayType);
-        int inWeightsCount = this->lstmSize() * (internalLstm + internalLstmCharW);
         inWeightsArray.Reserve(inWeightsCount, allocator);
         for (int i = 0; i < inWeightsCount; ++i)
             inWeightsArray.PushBack(this->weights()[inputWeightsCount+bWeightsCount+i], allocator);
@@ -62,6 +62,7 @@ namespace layers {
 
 	real_vector m_tmpOne;            // for simplicity, prepare a vector of [1,1,1,1...1]
 	real_vector m_rhoErrorBuf;       // used in error propatation [3K, U]
+	int_vector  m_bandStart;         // start position of the window for each frame
 	
 	const int m_mixNum;              // mixture number
 	const int m_chaDim;              // the size (dimension) of the inpput char data 
@@ -74,12 +75,18 @@ namespace layers {
 	int       m_seqMaxLength;        // the maximum length of utterance (in frames)
 	int       m_seqCurLength;        // the length of the currennt utterance 
 	int       m_paraSequence;        // the same as preceding layer
+
+	// Add 20181018: banded mode
+	int       m_bandWidth;           // number of positions evaluated per frame (0: all)
+	real_t    m_bandThreshold;       // rho below threshold * max alpha is treated as zero
 	
 	CharW(const int mixNum,  const int chaDim, 
 	      const int lstmDim, const int paraNum,
 	      const int chaMaxLength, 
 	      const int seqMaxLength,
 	      const int paraSequence,
+	      const int bandWidth,
+	      const real_t bandThreshold,
 	      real_vector *weight,      
 	      real_vector *output,         
 	      real_vector *outputErrors,
@@ -107,6 +114,11 @@ namespace layers {
 	int inSize() const;
 	
 	int outSize() const;
+
+	// number of positions stored per frame in m_rhoVec (for allocating memory)
+	int rhoMaxWidth() const;
+	// number of positions evaluated per frame for the current string
+	int rhoCurWidth() const;
 	
     };
 
@@ -187,6 +199,7 @@ namespace layers {
 	    
 	    real_t *tmpRho;
 	    int     rhoOffset;
+	    int    *tmpBandStart;
 
 	    real_t *tmpOutputsCPtr;
 	    real_t *tmpOutputErrorsCPtr;
@@ -409,6 +422,11 @@ namespace layers {
 	 */
 	virtual void exportWeights(const helpers::JsonValue &weightsObject, 
 				   const helpers::JsonAllocator &allocator) const;
+
+	/**
+	 * @see TrainableLayer::weightArraySizes()
+	 */
+	virtual void weightArraySizes(int *inputNum, int *biasNum, int *internalNum) const;
 	
 
     };
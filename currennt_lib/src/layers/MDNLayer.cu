@@ -41,6 +41,7 @@
 #include "../helpers/max.cuh"
 #include "../helpers/safeExp.cuh"
 #include "../helpers/JsonClasses.hpp"
+#include "../helpers/BinaryModel.hpp"
 
 #include "../activation_functions/Tanh.cuh"
 #include "../activation_functions/Logistic.cuh"
@@ -93,6 +94,7 @@ namespace layers {
 				const helpers::JsonValue &weightsSection, 
 				Layer<TDevice> &precedingLayer, int maxSeqLength)
 	: PostOutputLayer<TDevice>(layerChild, precedingLayer, -1, maxSeqLength)
+	, m_mdnParaVecReduced (false)
     {
         const Configuration &config = Configuration::instance();
 
@@ -535,13 +537,16 @@ namespace layers {
 		    throw std::runtime_error(std::string("Weights section for layer '") + 
 					     this->name() + "' is not an object");
 
-		if (!weightsChild.HasMember("input") || !weightsChild["input"].IsArray())
+		if (!weightsChild.HasMember("input") ||
+		    !helpers::binaryModel::isWeightArray(weightsChild["input"]))
 		    throw std::runtime_error(std::string("Missing array 'weights/") + 
 					     this->name() + "/input'");
-		if (!weightsChild.HasMember("bias") || !weightsChild["bias"].IsArray())
+		if (!weightsChild.HasMember("bias") ||
+		    !helpers::binaryModel::isWeightArray(weightsChild["bias"]))
 		    throw std::runtime_error(std::string("Missing array 'weights/") + 
 					     this->name() + "/bias'");
-		if (!weightsChild.HasMember("internal") || !weightsChild["internal"].IsArray())
+		if (!weightsChild.HasMember("internal") ||
+		    !helpers::binaryModel::isWeightArray(weightsChild["internal"]))
 		    throw std::runtime_error(std::string("Missing array 'weights/") + 
 					     this->name() + "/internal'");
         
@@ -549,25 +554,23 @@ namespace layers {
 		const rapidjson::Value &biasWeightsChild     = weightsChild["bias"];
 		const rapidjson::Value &internalWeightsChild = weightsChild["internal"];
 
-		if (inputWeightsChild.Size() != weightsNum)
+		if (helpers::binaryModel::weightArraySize(inputWeightsChild) != weightsNum)
 		    throw std::runtime_error(std::string("Invalid number of weights for layer '") 
 					 + this->name() + "'");
 
-		if (biasWeightsChild.Size() != 0)
+		if (helpers::binaryModel::weightArraySize(biasWeightsChild) != 0)
 		    throw std::runtime_error(std::string("bias part should be void for layer '") 
 					     + this->name() + "'");
 
-		if (internalWeightsChild.Size() != 0)
+		if (helpers::binaryModel::weightArraySize(internalWeightsChild) != 0)
 		    throw std::runtime_error(std::string("internal weights should be void layer'")
 					 + this->name() + "'");
 		
-		weights.reserve(inputWeightsChild.Size() + 
-				biasWeightsChild.Size()  + 
-				internalWeightsChild.Size());
+		weights.reserve(helpers::binaryModel::weightArraySize(inputWeightsChild) + 
+				helpers::binaryModel::weightArraySize(biasWeightsChild)  + 
+				helpers::binaryModel::weightArraySize(internalWeightsChild));
 
-		for (rapidjson::Value::ConstValueIterator it = inputWeightsChild.Begin(); 
-		     it != inputWeightsChild.End(); ++it)
-		    weights.push_back(static_cast<real_t>(it->GetDouble()));
+		helpers::binaryModel::readWeightArray(inputWeightsChild, &weights);
 		
 	    }else {
 		// No other initialization methods implemented yet
@@ -709,7 +712,8 @@ namespace layers {
 	    if (this->_postLayerType() == NN_POSTOUTPUTLAYER_NOTLASTMDN && 
 		nnState != NN_STATE_GAN_NOGAN){
 		mdnUnit->getOutput(timeStep,    0.0001, (this->_targets()));
-		mdnUnit->getParameter(timeStep, helpers::getRawPointer(this->m_mdnParaVec));
+		if (!m_mdnParaVecReduced)
+		    mdnUnit->getParameter(timeStep, helpers::getRawPointer(this->m_mdnParaVec));
 	    }
 	    // this->getOutput(timeStep, 0.0001); // by default, use 0.0001 as the parameter
 	}
@@ -835,34 +839,34 @@ namespace layers {
             if (!weightsChild.IsObject())
                 throw std::runtime_error(std::string("Weights section for layer '") + 
 					 this->name() + "' is not an object");
-            if (!weightsChild.HasMember("input") || !weightsChild["input"].IsArray())
+            if (!weightsChild.HasMember("input") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["input"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/input'");
-            if (!weightsChild.HasMember("bias") || !weightsChild["bias"].IsArray())
+            if (!weightsChild.HasMember("bias") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["bias"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/bias'");
-            if (!weightsChild.HasMember("internal") || !weightsChild["internal"].IsArray())
+            if (!weightsChild.HasMember("internal") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["internal"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/internal'");
 	    const rapidjson::Value &inputWeightsChild    = weightsChild["input"];
             const rapidjson::Value &biasWeightsChild     = weightsChild["bias"];
             const rapidjson::Value &internalWeightsChild = weightsChild["internal"];
 
-            if (inputWeightsChild.Size() != m_trainableNum)
+            if (helpers::binaryModel::weightArraySize(inputWeightsChild) != m_trainableNum)
                 throw std::runtime_error(std::string("Invalid number of input weights for layer '") 
 					 + this->name() + "'");
-            if (biasWeightsChild.Size() != 0)
+            if (helpers::binaryModel::weightArraySize(biasWeightsChild) != 0)
                 throw std::runtime_error(std::string("Invalid number of bias weights for layer '") 
 					 + this->name() + "'");
-            if (internalWeightsChild.Size() != 0)
+            if (helpers::binaryModel::weightArraySize(internalWeightsChild) != 0)
                 throw std::runtime_error(std::string("Invalid number of internal for layer '") 
 					 + this->name() + "'");
 
-            weights.reserve(inputWeightsChild.Size());
-            for (rapidjson::Value::ConstValueIterator it = inputWeightsChild.Begin(); 
-		 it != inputWeightsChild.End(); 
-		 ++it)
-                weights.push_back(static_cast<real_t>(it->GetDouble()));	    
+            weights.reserve(helpers::binaryModel::weightArraySize(inputWeightsChild));
+            helpers::binaryModel::readWeightArray(inputWeightsChild, &weights);	    
 	    m_sharedWeights       = weights;
 	    m_sharedWeightUpdates = weights;
 	    thrust::fill(m_sharedWeightUpdates.begin(), m_sharedWeightUpdates.end(), (real_t)0.0);
@@ -936,8 +940,9 @@ namespace layers {
 		    mdnUnit->setGenMethod(this->m_probBiasVec, timeStep);
 		
 		mdnUnit->getOutput(timeStep, ((para>0)?(para):(0.0001)), (this->_targets()));
-		mdnUnit->getParameter(timeStep,
-				      helpers::getRawPointer(this->m_mdnParaVec));
+		if (!m_mdnParaVecReduced)
+		    mdnUnit->getParameter(timeStep,
+					  helpers::getRawPointer(this->m_mdnParaVec));
 	    }
 	}else{
 	    throw std::runtime_error("Frame-wise EM generation is not implemented");
@@ -1164,6 +1169,36 @@ namespace layers {
 	}
     }
 
+    template <typename TDevice>
+    void MDNLayer<TDevice>::reduceOutputBuffer()
+    {
+	if (this->flagTrainingMode())
+	    return;
+	
+	BOOST_FOREACH (boost::shared_ptr<MDNUnit<TDevice> > &mdnUnit, m_mdnUnits){
+	    mdnUnit->reduceParaBuffer();
+	}
+	
+	// m_mdnParaVec is required when the MDN parameters are generated
+	if (this->_postLayerType() == NN_POSTOUTPUTLAYER_LAST &&
+	    !(m_genPara < 0.0 && m_genPara >= -1.5)){
+	    m_mdnParaVec.clear();
+	    m_mdnParaVec.shrink_to_fit();
+	    m_mdnParaVecReduced = true;
+	}
+	printf("\t[mem saved]");
+    }
+
+    template <typename TDevice>
+    bool MDNLayer<TDevice>::flagStepInputShift()
+    {
+	BOOST_FOREACH (boost::shared_ptr<MDNUnit<TDevice> > &mdnUnit, m_mdnUnits){
+	    if (!mdnUnit->flagStepInputShift())
+		return false;
+	}
+	return true;
+    }
+    
     // export
     template <typename TDevice>
     void MDNLayer<TDevice>::exportLayer(const helpers::JsonValue &layersArray, 
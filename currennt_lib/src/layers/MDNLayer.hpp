@@ -64,6 +64,7 @@ namespace layers {
 	cpu_real_vector m_mdnVec;        // the vector of mdnunit flag
 	cpu_real_vector m_mdnConfigVec;  // vector of the mdn configuration
 	real_vector     m_mdnParaVec;    // vector of parameters of all MDNUnits
+	bool            m_mdnParaVecReduced; // m_mdnParaVec is released in generation
 	
 	
 	// the vector of MDNUnit for computation
@@ -190,6 +191,13 @@ namespace layers {
 	
 	virtual real_vector& feedbackOutputs(const bool flagTrain);
 
+	// Add 20180710: memory reduction in generation
+	// reduce the parameter buffers of MDNUnits
+	virtual void reduceOutputBuffer();
+
+	// whether all MDNUnits only read the current frame of the preceding layer
+	bool         flagStepInputShift();
+	
 	// export
 	virtual void exportLayer(const helpers::JsonValue &layersArray, 
 				 const helpers::JsonAllocator &allocator) const;
@@ -38,6 +38,7 @@
 #include "../helpers/min.cuh"
 #include "../helpers/max.cuh"
 #include "../helpers/safeExp.cuh"
+#include "../helpers/onlineSoftmax.cuh"
 #include "../helpers/JsonClasses.hpp"
 #include "../helpers/misFuncs.hpp"
 #include "../MacroDefine.hpp"
@@ -57,6 +58,8 @@
 #include <thrust/transform.h>
 #include <thrust/random.h>
 #include <thrust/transform_reduce.h>
+#include <thrust/copy.h>
+#include <thrust/remove.h>
 #include <thrust/iterator/constant_iterator.h>
 #include <thrust/iterator/counting_iterator.h>
 
@@ -253,40 +256,6 @@ namespace {
 	}
     };
 
-    struct CalculateExpFn_UVSigmoid
-    {
-	// the first dimension as sigmoid part
-	// Calculate the exponential exp()
-	// Note: specifically for softmax and mixture weight
-	//       exp(x - offset) will be calulated given offset
-	int NNOutputSize;         // see CalculateOffsetFn above 
-	int startD;
-	int endD;
-	const real_t *offset;     // the average of the [max, min]
-	const char *patTypes;
-	const real_t *NNOutput;
-
-	__host__ __device__ real_t operator() (const int &outputIdx) const
-	{
-	    // timeStep: which frame is it?
-	    // dimStep:  which dimension in the NN output side this frame ?
-	    const int timeStep = outputIdx / (endD - startD);
-	    const int dimStep  = (outputIdx % (endD - startD)) + startD;
-	    
-	    if (patTypes[timeStep] == PATTYPE_NONE)
-		return SKIP_MARKER;
-
-	    const real_t *data = NNOutput + (NNOutputSize * timeStep ) + dimStep;
-	    if (dimStep > startD){
-		// normal softmax part
-		return helpers::safeExp(*data - offset[timeStep]);
-	    }else{
-		// sigmoid part
-		return activation_functions::Logistic::fn(*data);
-	    }
-	}
-    };
-
     struct CalculateExpSimpleFnForVar
     {
 	// Calculate the expoential exp()
@@ -361,36 +330,6 @@ namespace {
         }
     };
 
-    struct SumUpOutputsFn_UVSigmoid
-    {
-	// SumUp the value over the data of in a continuous memory space
-	// For example, used in sum_k exp(w_k) for mixture weight normalization
-	// Results, will be saved to the first argument (real_t& )
-	
-        int dimSize;            // sum over this number of dimension
-        const real_t *outputs;  // data
-	const char *patTypes;
-	
-        __host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-        {
-            // unpack the tuple
-            int patIdx = t.get<1>();
-
-	    // point to the start of the continuous memory space
-            const real_t *offOutputs = &outputs[patIdx * dimSize];
-	    // sum up the outputs
-            real_t sum = 0;
-	    if (patTypes[patIdx] == PATTYPE_NONE){
-		t.get<0>() = SKIP_MARKER;
-	    }else{
-		for (int i = 1; i < dimSize; ++i)
-		    sum += offOutputs[i];
-		// store the result
-		t.get<0>() = sum;
-	    }
-        }
-    };
-
     struct NormalizeOutputsFn
     {
 	// Normalize the output using the sum of data
@@ -426,36 +365,186 @@ namespace {
         }
     };
     
-    struct NormalizeOutputsFn_UVSigmoid
+    // Add 20181012: softmax unit for one frame on the CPU
+    //  the loops over the frame are vectorized (helpers/onlineSoftmax.cuh). The
+    //  normalizing sum is returned (SKIP_MARKER for dummy frames)
+    struct ComputeSoftmaxUnitFn
     {
-        int layerSize;
-        const real_t *normFacts; // the data for normalization
+	int NNOutputSize;         // see CalculateOffsetFn above 
+	int startD;
+	int endD;
+	bool uvSigmoid;           // the first dimension as sigmoid
+	
 	const char   *patTypes;
-        __host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-        {
-            // unpack the tuple
-            int outputIdx = t.get<1>();
+	const real_t *NNOutput;
+	real_t       *paraVec;    // probabilities, (endD - startD) per frame
 
-            // calculate the pattern index
-            int patIdx = outputIdx / layerSize;
-	    int dimIdx = outputIdx % layerSize;
+	__host__ __device__ real_t operator() (const int &patIdx) const
+	{
+	    int paraDim = endD - startD;
+	    const real_t *data = NNOutput + NNOutputSize * patIdx + startD;
+	    real_t       *prob = paraVec  + paraDim      * patIdx;
+	    
+	    if (patTypes[patIdx] == PATTYPE_NONE){
+		for (int i = 0; i < paraDim; ++i)
+		    prob[i] = SKIP_MARKER;
+		return SKIP_MARKER;
+	    }
 
-	    if (dimIdx == 0) // skip the sigmoid part
-		return;
+	    int softS = 0;
+	    if (uvSigmoid){
+		// sigmoid part
+		prob[0] = activation_functions::Logistic::fn(data[0]);
+		softS   = 1;
+	    }
 	    
-            // check if we can stop the calculation
-            real_t normFact = normFacts[patIdx];
-            if (patTypes[patIdx] == PATTYPE_NONE)
-                return;
+	    real_t maxValue = helpers::softmaxMax(data + softS, paraDim - softS);
+	    real_t sum      = helpers::softmaxExpSum(data + softS, prob + softS,
+						     paraDim - softS, maxValue);
+	    helpers::softmaxScale(prob + softS, paraDim - softS, sum);
+	    return sum;
+	}
+    };
 
-            // calculate the normalized value
-            real_t x = t.get<0>() / normFact;
+    // Add 20181018: softmax unit on the GPU, one thread per element for the exp
+    //  (and the sigmoid dimension) and for the normalization
+    struct ComputeSoftmaxUnitExpFn
+    {
+	int NNOutputSize;
+	int startD;
+	int endD;
+	bool uvSigmoid;
+	
+	const char   *patTypes;
+	const real_t *NNOutput;
+	const real_t *offset;     // see CalculateOffsetFn
+
+	__host__ __device__ real_t operator() (const int &outputIdx) const
+	{
+	    const int timeStep = outputIdx / (endD - startD);
+	    const int dimStep  = (outputIdx % (endD - startD)) + startD;
 	    
-            // store the result
-            t.get<0>() = x;
+	    if (patTypes[timeStep] == PATTYPE_NONE)
+		return SKIP_MARKER;
+
+	    const real_t *data = NNOutput + (NNOutputSize * timeStep ) + dimStep;
+	    if (uvSigmoid && dimStep == startD)
+		return activation_functions::Logistic::fn(*data);
+	    else
+		return helpers::safeExp(*data - offset[timeStep]);
+	}
+    };
+
+    struct SumUpSoftmaxUnitFn
+    {
+	int dimSize;
+	int softS;                // 1: skip the sigmoid dimension
+	const real_t *outputs;
+	const char   *patTypes;
+	
+        __host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+        {
+            int patIdx = t.get<1>();
+	    if (patTypes[patIdx] == PATTYPE_NONE){
+		t.get<0>() = SKIP_MARKER;
+		return;
+	    }
+            const real_t *offOutputs = &outputs[patIdx * dimSize];
+            real_t sum = 0;
+	    for (int i = softS; i < dimSize; ++i)
+		sum += offOutputs[i];
+	    t.get<0>() = sum;
+        }
+    };
+
+    struct NormalizeSoftmaxUnitFn
+    {
+        int dimSize;
+	int softS;
+        const real_t *normFacts;
+	const char   *patTypes;
+	
+        __host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+        {
+            int patIdx = t.get<1>() / dimSize;
+	    if (patTypes[patIdx] == PATTYPE_NONE || (t.get<1>() % dimSize) < softS)
+		return;
+            t.get<0>() = t.get<0>() / normFacts[patIdx];
         }
     };
 
+    // Add 20181018: softmax unit of np frames, fn points to the first frame
+    //  the normalizing sums are written to offset[ts:ts+np]
+    void softmaxUnitForward(const ComputeSoftmaxUnitFn &fn, Cpu::real_vector &offset,
+			    const int ts, Cpu::real_vector &paraVec, const int ps,
+			    const int np)
+    {
+	thrust::transform(thrust::counting_iterator<int>(0),
+			  thrust::counting_iterator<int>(0) + np,
+			  offset.begin() + ts, fn);
+    }
+
+    void softmaxUnitForward(const ComputeSoftmaxUnitFn &fn, Gpu::real_vector &offset,
+			    const int ts, Gpu::real_vector &paraVec, const int ps,
+			    const int np)
+    {
+	int paraDim = fn.endD - fn.startD;
+	int softS   = (fn.uvSigmoid ? 1 : 0);
+	{{
+	    CalculateOffsetFn fn2;
+	    fn2.NNOutputSize = fn.NNOutputSize;
+	    fn2.startD       = fn.startD + softS;
+	    fn2.endD         = fn.endD;
+	    fn2.patTypes     = fn.patTypes;
+	    fn2.NNoutputs    = fn.NNOutput;
+	    thrust::transform(thrust::counting_iterator<int>(0),
+			      thrust::counting_iterator<int>(0) + np,
+			      offset.begin() + ts, fn2);
+	}}
+	{{
+	    ComputeSoftmaxUnitExpFn fn2;
+	    fn2.NNOutputSize = fn.NNOutputSize;
+	    fn2.startD       = fn.startD;
+	    fn2.endD         = fn.endD;
+	    fn2.uvSigmoid    = fn.uvSigmoid;
+	    fn2.patTypes     = fn.patTypes;
+	    fn2.NNOutput     = fn.NNOutput;
+	    fn2.offset       = helpers::getRawPointer(offset) + ts;
+	    thrust::transform(thrust::counting_iterator<int>(0),
+			      thrust::counting_iterator<int>(0) + np * paraDim,
+			      paraVec.begin() + ps, fn2);
+	}}
+	{{
+	    SumUpSoftmaxUnitFn fn2;
+	    fn2.dimSize  = paraDim;
+	    fn2.softS    = softS;
+	    fn2.outputs  = fn.paraVec;
+	    fn2.patTypes = fn.patTypes;
+	    thrust::for_each(
+	       thrust::make_zip_iterator(
+			thrust::make_tuple(offset.begin() + ts,
+					   thrust::counting_iterator<int>(0))),
+	       thrust::make_zip_iterator(
+			thrust::make_tuple(offset.begin() + ts + np,
+					   thrust::counting_iterator<int>(0) + np)),
+	       fn2);
+	}}
+	{{
+	    NormalizeSoftmaxUnitFn fn2;
+	    fn2.dimSize   = paraDim;
+	    fn2.softS     = softS;
+	    fn2.normFacts = helpers::getRawPointer(offset) + ts;
+	    fn2.patTypes  = fn.patTypes;
+	    thrust::for_each(
+	       thrust::make_zip_iterator(
+			thrust::make_tuple(paraVec.begin() + ps,
+					   thrust::counting_iterator<int>(0))),
+	       thrust::make_zip_iterator(
+			thrust::make_tuple(paraVec.begin() + ps + np * paraDim,
+					   thrust::counting_iterator<int>(0) + np * paraDim)),
+	       fn2);
+	}}
+    }
 
     struct CopyMean
     {
@@ -901,13 +990,13 @@ namespace {
 		hitflag = ((*data) > 0);   // Whether the target is voiced ?
 		if (dimStep == 0){
 		    // this is the sigmoid dimension
-		    errors[pos_error] = (hitflag)?(-1+(*probptr)):(*probptr);
+		    errors[pos_error] = helpers::softmaxCEGrad(*probptr, hitflag);
 		}else{
 		    // this is the softmax dimension
 		    if (hitflag){
 			// hit this dimension ?
 			hitflag = ((((*data) - dimStep)*((*data) - dimStep)) < 0.0001);
-			errors[pos_error] = (hitflag)?(-1+(*probptr)):((*probptr));
+			errors[pos_error] = helpers::softmaxCEGrad(*probptr, hitflag);
 		    }else{
 			// this is an unvoiced frame
 			errors[pos_error] = 0;
@@ -918,7 +1007,7 @@ namespace {
 		hitflag = ((((*data) - dimStep)*((*data) - dimStep)) < 0.0001);
 		// calculate the gradient
 		// note: we assume the target data is a real number that has not been normalized
-		errors[pos_error] = (hitflag)?(-1+(*probptr)):((*probptr));
+		errors[pos_error] = helpers::softmaxCEGrad(*probptr, hitflag);
 		//return (hitflag)?(-1+(*probptr)):((*probptr));
 	    }
 	    return 0.0;
@@ -927,67 +1016,6 @@ namespace {
     };
     
 
-    struct ComputeMixtureDistance
-    {
-	// Calculate the mixture distance \sum_d (x_d-\mu_d)^2/(2*std^2) for mixture model
-	// This function is used in EM-style generation
-	//  and forward anc backward propagation of mixture unit
-
-	int  startDOut;
-	int  layerSizeOut;
-	int  mixture_num;
-	int  featureDim;
-	int  totaltime;
-	bool tieVar;
-
-	const char   *patTypes;
-	const real_t *output;    // targets data
-	const real_t *mdnPara;   // mean value of the mixture
-
-	// from 1 to timesteps * num_mixture
-	__host__ __device__ real_t operator() (const int idx) const
-	{
-	    
-	    int timeStep = idx / mixture_num; //t.get<0>();
-	    int mixIndex = idx % mixture_num; //t.get<1>(); 
-	    
-	    // point to the targets data x
-	    int pos_data = (layerSizeOut * timeStep)+startDOut;
-		
-	    const real_t *data, *mean, *var;
-
-	    if (patTypes[timeStep] == PATTYPE_NONE)
-		return 0;
-	    
-	    // point to the mixture data (mean and variance)
-	    // skip the mixture weight part
-	    int pos =      totaltime * mixture_num;  
-	    // point to the mean
-	    int pos_mean = pos+timeStep*featureDim*mixture_num+mixIndex*featureDim;
-	    
-	    // skip mean && weight
-	    pos =      totaltime * (mixture_num + mixture_num * featureDim); 
-            #ifdef ALTER_TIEVAR
-	    int pos_var  = pos+timeStep*mixture_num;
-            #else
-	    int pos_var  = pos+ (tieVar?
-				 (timeStep * mixture_num + mixIndex) :
-				 (timeStep * mixture_num * featureDim + mixIndex*featureDim));
-            #endif
-	    var  = mdnPara + pos_var;
-	    
-	    // accumulate the distance over dimension
-	    real_t tmp = 0.0;
-	    for (int i = 0; i<featureDim; i++){
-		data = output  + pos_data + i;
-		mean = mdnPara + pos_mean + i;
-		var  = mdnPara + pos_var  + (tieVar?0:i);
-		tmp += (*data-*mean)*(*data-*mean)/((*var)*(*var))/2;
-		
-	    }
-	    return tmp;
-	}
-    };
 
     // Block20170904x04
 
@@ -1008,6 +1036,7 @@ namespace {
 	int trainableBPos;      // b, the b which is predicted by the network
 	int stepBack;           // how many steps to look back ?
 	int paral;
+	int frameBias;          // absolute frame index = timeStep + frameBias
 	
 	real_t   *linearPart;   // w, where w is trainable but shared across time steps
 	real_t   *biasPart;     // b, where b is trainable but shared across time steps
@@ -1031,7 +1060,7 @@ namespace {
 	    if (patTypes[timeStep] == PATTYPE_NONE)
 		return;
 	    
-	    if (timeStep < stepBack * paral){
+	    if (timeStep + frameBias < stepBack * paral){
 		// skip the first time step (for parallel sequences, it skipped the first block)
 		return;
 	    }
@@ -1558,281 +1587,199 @@ namespace {
     // Block 1025x07 Gradient calculation in old methods
     // Block 1025x09 Gradient calculation in old methods
 
-    struct ComputeMixtureError
+    
+
+    // Add 20181018: log(w_i) + log N(x; mu_i, var_i) of one mixture for one frame
+    //  mean and var point to the parameters of this mixture. Floored at lSMALL
+    __host__ __device__ real_t mixtureComponentLogLik(const real_t *data,  const real_t weight,
+						      const real_t *mean,  const real_t *var,
+						      const int featureDim, const bool tieVar)
+    {
+	real_t tmp = log(weight) - featureDim/2*log(2*PI_DEFINITION);
+	real_t dis = 0.0;
+	real_t stdv;
+	if (tieVar){
+	    stdv  = var[0];
+	    tmp  -= featureDim * helpers::safeLog(stdv);
+	    for (int j = 0; j < featureDim; j++)
+		dis += (data[j] - mean[j]) * (data[j] - mean[j]);
+	    dis   = dis / (stdv * stdv) / 2;
+	}else{
+	    for (int j = 0; j < featureDim; j++){
+		stdv  = var[j];
+		tmp  -= helpers::safeLog(stdv);
+		dis  += (data[j] - mean[j]) * (data[j] - mean[j]) / (stdv * stdv) / 2;
+	    }
+	}
+	tmp = tmp - dis;
+	if (tmp < helpers::NumericLimits<real_t>::lSMALL())
+	    tmp = helpers::NumericLimits<real_t>::lSMALL();
+	return tmp;
+    }
+
+    // Add 20181018: log-sum-exp of the mixtures, against the maximum over mixtures
+    __host__ __device__ real_t mixtureLogSumExp(const real_t *logLik, const int mixture_num)
+    {
+	real_t maxLik = helpers::NumericLimits<real_t>::logZero();
+	for (int i = 0; i < mixture_num; i++)
+	    maxLik = (logLik[i] > maxLik) ? logLik[i] : maxLik;
+	real_t tmp = 0.0;
+	for (int i = 0; i < mixture_num; i++)
+	    tmp += helpers::safeExp(logLik[i] - maxLik);
+	return maxLik + log(tmp);
+    }
+    
+    // Add 20181014: likelihood of the mixture model for one frame
+    //  the log-likelihood of every mixture log(w_i) + log N(x; mu_i, var_i) is computed
+    //  once and saved to logLik[i], and the log-sum-exp is taken against the maximum
+    //  over mixtures. The log-sum-exp is returned
+    __host__ __device__ real_t mixtureLogLikelihood(const real_t *data,   const real_t *weight,
+						    const real_t *mean,   const real_t *var,
+						    const int mixture_num, const int featureDim,
+						    const bool tieVar,    real_t *logLik)
+    {
+	for (int i = 0; i < mixture_num; i++)
+	    logLik[i] = mixtureComponentLogLik(data, weight[i], mean + i * featureDim,
+					       var + i * (tieVar ? 1 : featureDim),
+					       featureDim, tieVar);
+	return mixtureLogSumExp(logLik, mixture_num);
+    }
+    
+    // Add 20181014: likelihood of the mixture model
+    //  meanDis[t * mixture_num + i]       = log w_i phi_i
+    // Modify 20181018: one (frame, mixture) per thread, idx = t * mixture_num + i.
+    //  The sum over mixtures is taken by ComputeMixtureLogSumExp
+    struct ComputeMixtureLikelihood
     {
-	// Calculat the -log likelihood for mixture model
-	int   startD;
 	int   startDOut;
 	int   layerSizeOut;
 	int   mixture_num;
 	int   featureDim;
+	int   totalTime;
 	bool  tieVar;
 
-	real_t     *meanDis;  // where is the mixture distancen calculated by the function above
-	                      //  this memory block will save the likelihood 
-	                      //  of each mixture
-	real_t *mdnPara;      // point to the parameter of the mdnPara
-	int totalTime;        // number of time steps * parallel sentence
+	const char   *patTypes;
+	const real_t *target;   // target data
+	const real_t *mdnPara;  // parameter of the mixture model
+	real_t       *meanDis;  // buffer of the log-likelihood
 
-	// from 1 to timesteps
-	__host__ __device__ real_t operator() (const thrust::tuple<const char&, int> &t) const
+	__host__ __device__ void operator() (const int idx) const
 	{
-	    const int timeStep = t.get<1>();
-	    const char patType = t.get<0>();
-	    
-	    if (patType == PATTYPE_NONE)
-		return 0;
-	    
-	    // point to the mixture distance calculated above
-	    real_t tmp         = helpers::NumericLimits<real_t>::logZero();
-	    real_t tmptmp;
-	    real_t *meanDisPtr = meanDis + timeStep * mixture_num;
-	    
-	    // point to the weight
-	    int pos = timeStep*mixture_num;
-	    const real_t *mixtureW = mdnPara + pos; 
-	    
-	    // point to the variance
-	            pos = totalTime * (mixture_num + mixture_num * featureDim);
-	    real_t *var = mdnPara + pos + timeStep * mixture_num * (tieVar?1:featureDim); 
-	    
-	    // calculate over each mixture
-	    for (int i = 0; i<mixture_num; i++){
-		//tmptmp = log(*(mixtureW+i))+(*(meanDisPtr+i))-featureDim/2*log(2*PI_DEFINITION);
-		tmptmp = log(*(mixtureW+i))-(*(meanDisPtr+i))-featureDim/2*log(2*PI_DEFINITION);
-
-                #ifdef ALTER_TIEVAR
-		tmptmp = tmptmp - featureDim*helpers::safeLog(*(var));
-		for (int j = 1; j<mixture_num; j++)
-		    *(var+j) = 0;
-                #else
-		if (tieVar)
-		    tmptmp = tmptmp - featureDim*helpers::safeLog(*(var+i));
-		else
-		    for (int j = 0; j<featureDim; j++)
-			tmptmp = tmptmp - helpers::safeLog(*(var+i*featureDim+j));
-                #endif
-
-		if (tmptmp < helpers::NumericLimits<real_t>::lSMALL())
-		    tmptmp = helpers::NumericLimits<real_t>::lSMALL();
-		
-		//tmptmp = helpers::safeExp(tmptmp);
-		tmp    = helpers::logAdd(tmp, tmptmp);
-		
-		// Save w_i phi_i (likelihood on this mixture)
-		// this likelihood will be used for calculating the posterior 
-		// in backpropagation stage
-		*(meanDisPtr+i) = tmptmp; 
-	    }
-	    // save sum_i^mixture_num w_i phi_i for calculating the posterior
-	    meanDisPtr = meanDis + totalTime * mixture_num + timeStep;
-	    *meanDisPtr= tmp;
+	    const int timeStep = idx / mixture_num;
+	    const int mixIdx   = idx % mixture_num;
+	    if (patTypes[timeStep] == PATTYPE_NONE)
+		return;
 
-	    //return -1*helpers::safeLog(tmp);
-	    return -1*(tmp);
+	    const int varDim = (tieVar ? 1 : featureDim);
+	    meanDis[idx] = mixtureComponentLogLik(
+		target  + layerSizeOut * timeStep + startDOut,
+		mdnPara[timeStep * mixture_num + mixIdx],
+		mdnPara + totalTime * mixture_num + idx * featureDim,
+		mdnPara + totalTime * mixture_num * (1 + featureDim) + idx * varDim,
+		featureDim, tieVar);
 	}
     };
-    
 
-    struct ComputeBPmixtureWeight
+    // Add 20181018: log-sum-exp over the mixtures, one frame per thread
+    //  meanDis[totalTime * mixture_num + t] = log sum_i w_i phi_i
+    //  returns the - log likelihood of the frame
+    struct ComputeMixtureLogSumExp
     {
-	// BP for the mixture weight of mixture unit
-	int mixture_num;
-	int NNOutputSize;
-	int startD;
-	const char *patTypes;
-	const real_t *meanDis; 
-	const real_t *mdnPara; // mean value of the mixture
-	real_t *errors;        // outputerrors (gradient buffer) of preceding layer
-	int totalTime;   //
+	int     mixture_num;
+	int     totalTime;
+	real_t *meanDis;
 
-	// from 1 to timesteps * numMixture 
-	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t) const
+	__host__ __device__ real_t operator() (const thrust::tuple<const char&, int> &t) const
 	{
-	    const int outputIdx = t.get<1>();
-	    const int timeStep = outputIdx / mixture_num;
-	    const int mixtureI = (outputIdx % mixture_num);
-
-	    // to the posterior 
-	    const real_t *postP  = meanDis + timeStep * mixture_num + mixtureI;
-	    const real_t *sumPost= meanDis + totalTime * mixture_num + timeStep;
-
-	    // to the output of MDN (mixture weight)
-	    int pos = timeStep * mixture_num + mixtureI;
-	    const real_t *alpha  = mdnPara + pos;
-
-	    if (patTypes[timeStep] == PATTYPE_NONE){
-		*(errors + pos) = 0.0;
-	    }else{
-		// pointer to the memory array to store the gradient
-		pos = timeStep * NNOutputSize + startD + mixtureI;
-		//*(errors + pos) = (*alpha) - (*postP)/(*sumPost);
-
-		// Note, postP and sumPost is the log likelihood
-		// use helpers::safeExp((*postP)-(*sumPost))
-		*(errors + pos) = (*alpha) - helpers::safeExp((*postP)-(*sumPost));
-	    }
+	    const int timeStep = t.get<1>();
+	    if (t.get<0>() == PATTYPE_NONE)
+		return 0;
+	    real_t tmp = mixtureLogSumExp(meanDis + timeStep * mixture_num, mixture_num);
+	    meanDis[totalTime * mixture_num + timeStep] = tmp;
+	    return -1 * tmp;
 	}
-
     };
 
-
-    struct ComputeBPmixtureMeanVariance
+    // Add 20181014: gradients of the mixture model
+    //  the posterior of each mixture is computed once, and the gradients w.r.t. the
+    //  weight, mean and variance of the mixture are written in the same traversal.
+    //  For tied variance, the gradients over dimensions are summed up in the loop.
+    // Modify 20181018: one (frame, mixture) per thread, idx = t * mixture_num + i
+    struct ComputeBPmixture
     {
-	// BP for the mixture mean and variance of mixture unit
-	// Note: the gradients from each dimension of data for variance are stored localled.
-	//       They are summed up and pushed to the NN output layer in ComputeBPAccumVariance 
-	int layerSize;
-	int startD;
+	int layerSize;          // layer size of the NN output
+	int startD;             // the first dim of this unit in the NN output
 	int startDOut;
 	int layerSizeOut;
 	int mixture_num;
 	int featureDim;
+	int totalTime;
+
+	bool   tieVar;
+	bool   flagUpdateV;
+	real_t varFloor;
 	
-	bool tieVar;
-	bool flagUpdateV;
-	
-	const char *patTypes;
-	const real_t *meanDis; // the mixture lielihookd w_i Phi_i and the sum 
-	const real_t *mdnPara; // mean value of the mixture
-	const real_t *target;  // target data
-	real_t *errors;        // outputerrors (gradient buffer) of preceding layer
-                               //  for mean
-	real_t *varBuff;       // buffer of variance grandients
-                               // 
-	int totalTime;         //
-	real_t  varFloor;
-
-	// from 1 to timesteps * numMixture*(featureDim) 
-	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t) const
+	const char   *patTypes;
+	const real_t *meanDis;  // the mixture likelihood w_i Phi_i and the sum (log domain)
+	const real_t *mdnPara;  // parameter of the mixture model
+	const real_t *target;   // target data
+	real_t       *errors;   // outputerrors (gradient buffer) of preceding layer
+
+	__host__ __device__ void operator() (const int idx) const
 	{
-	    const int outputIdx = t.get<1>();
-	    const int timeStep = outputIdx / (mixture_num * featureDim);
+	    const int timeStep = idx / mixture_num;
+	    const int i        = idx % mixture_num;
+	    const int varDim   = (tieVar ? 1 : featureDim);
 	    
-	    const int tmp = outputIdx % (mixture_num * featureDim);
-	    const int mixtureI = tmp / featureDim;
-	    const int featureI = tmp % featureDim;
+	    // gradient buffers of [weight, mean, variance] of this mixture
+	    real_t *errorw = errors + timeStep * layerSize + startD + i;
+	    real_t *errorm = (errors + timeStep * layerSize + startD + mixture_num +
+			      i * featureDim);
+	    real_t *errorv = (errors + timeStep * layerSize + startD + mixture_num +
+			      mixture_num * featureDim + i * varDim);
 	    
-	    // pointer to the mean gradient buffer
-	    int meanshift  = timeStep * layerSize+startD+mixtureI*featureDim + featureI;
-	    real_t *errorm = errors + meanshift;
-
-	    // pointer to the variance gradient
-            #ifdef ALTER_TIEVAR
-	    //int varshift2   = timeStep*layerSize+startD+mixture_num*featureDim;
-            #else
-	    //int varshift2   = timeStep*layerSize+startD+mixture_num*featureDim + mixtureI;
-            #endif
-	    // If variance is not tied, the gradients can be directly propagated to
-	    // previous layer without BPAccumVariance
-	    int varshift   = (timeStep * (mixture_num * featureDim) + 
-			      mixtureI * featureDim + featureI);
-	    real_t *errorv = (tieVar? 
-			      (varBuff + varshift) : 
-			      (errors + meanshift + mixture_num * featureDim));
-
 	    if (patTypes[timeStep] == PATTYPE_NONE){
-		(*errorm) = 0.0;
-		(*errorv) = 0.0;
+		*errorw = 0.0;
+		for (int j = 0; j < featureDim; j++)
+		    errorm[j] = 0.0;
+		for (int j = 0; j < varDim; j++)
+		    errorv[j] = 0.0;
 		return;
 	    }
-
-	    // pointer to the target data y
-	    const real_t *tardata= target + timeStep * layerSizeOut + startDOut + featureI;
-
-	    // pointer to the mean parameter in MDNUnit
-	    meanshift= totalTime * mixture_num + 
-		       timeStep * mixture_num * featureDim + 
-		       mixtureI * featureDim + 
-		       featureI;
-
-	    // pointer to the variance parameter in MDNUnit
-            #ifdef ALTER_TIEVAR
-	    varshift = totalTime*mixture_num*(1+featureDim) + 
-		       timeStep*mixture_num;
-	    
-            #else
-	    varshift = (totalTime*mixture_num*(1+featureDim) + 
-			(tieVar? 
-			 (timeStep*mixture_num + mixtureI) : 
-			 (featureDim*(timeStep*mixture_num+mixtureI) + featureI)));
-            #endif
-
-	    const real_t *mean  = mdnPara + meanshift;
-	    const real_t *var   = mdnPara + varshift;
-
-	    
-	    // pointer to the posterior P and sum of posterior P
-	    const real_t *postP = meanDis + timeStep * mixture_num + mixtureI;
-	    const real_t *sumPost=meanDis + totalTime* mixture_num + timeStep;
-	    real_t posterior = helpers::safeExp((*postP) - (*sumPost));
-
-	    // calculate and store the gradient of mean
-	    (*errorm)  = posterior*(*mean - *tardata)/(*var)/(*var);
-	    // (*errorv2) += posterior*featureDim - (*errorm)*(*mean - *tardata);
-
-	    // calculate and store the gradient of variance
-	    // Fatal error 
-	    // (*errorv)  = posterior*featureDim - (*errorm)*(*mean - *tardata);
-	    // How could I multiply featureDim here ! For each dimension, it should be 1
-	    
-	    // Fatal error
-	    // a Relu-finction (variance floor) is used in forwardcomputation
-	    // the gradient should also consider the gradient of Relu
-	    // here, just deliver the gradient when var is above the variance floor
-	    if (flagUpdateV && ((*var) < varFloor))
-		(*errorv)  = posterior - (*errorm)*(*mean - *tardata);
-	    else
-		(*errorv)  = 0.0;
-	    
-	}
-
-    };
-    
-    struct ComputeBPAccumVariance
-    {
-	// Accumulate the gradidents from each dimension of data
-	// and push the sum to the NN output layer
-	int layerSize;
-	int startD;
-	int mixture_num;
-	int featureDim;
-
-	const char *patTypes;
-	real_t *errors;        // outputerrors of preceding layer
-	real_t *varBuff;
-
-	// from 1 to timesteps * numMixture*(featureDim) 
-	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t) const
-	{
-	    const int timeStep = t.get<1>();
-	    if (patTypes[timeStep] == PATTYPE_NONE)
-		return;
 	    
-	    // start of the variance part of one frame
-	    int varshiftTar  = timeStep*layerSize+startD+mixture_num*featureDim;
-	    int varshiftSrc  = timeStep*(mixture_num*featureDim);
-	    real_t temp = 0.0;
-
-            #ifdef ALTER_TIEVAR
-	    for (int i = 0; i < mixture_num; i++){
-		for (int j = 0; j < featureDim; j++){
-		    temp += *(varBuff + varshiftSrc + i*featureDim + j);
-		}
-	    }
-	    *(errors+varshiftTar) = temp;
-            #else
-	    for (int i = 0; i < mixture_num; i++){
-		for (int j = 0; j < featureDim; j++){
-		    temp += *(varBuff + varshiftSrc + i*featureDim + j);
+	    const real_t *data   = target  + layerSizeOut * timeStep + startDOut;
+	    const real_t  weight = mdnPara[timeStep * mixture_num + i];
+	    const real_t *mean   = mdnPara + totalTime * mixture_num + idx * featureDim;
+	    const real_t *var    = (mdnPara + totalTime * mixture_num * (1 + featureDim) +
+				    idx * varDim);
+
+	    // Note, postP and sumPost is the log likelihood
+	    real_t posterior = helpers::safeExp(meanDis[idx] -
+						meanDis[totalTime * mixture_num + timeStep]);
+	    *errorw = weight - posterior;
+
+	    real_t stdv, diff, gradm;
+	    real_t gradv = 0.0;
+	    for (int j = 0; j < featureDim; j++){
+		stdv  = var[tieVar ? 0 : j];
+		diff  = mean[j] - data[j];
+		gradm = posterior * diff / stdv / stdv;
+		errorm[j] = gradm;
+
+		// a Relu-function (variance floor) is used in forward computation
+		// the gradient is delivered in the same condition as before
+		if (flagUpdateV && stdv < varFloor){
+		    if (tieVar)
+			gradv += posterior - gradm * diff;
+		    else
+			errorv[j] = posterior - gradm * diff;
+		}else if (!tieVar){
+		    errorv[j] = 0.0;
 		}
-		*(errors+varshiftTar+i) = temp;
-		temp = 0.0;
 	    }
-            #endif
-	    
+	    if (tieVar)
+		*errorv = gradv;
 	}
-
     };
     
     struct ComputeBPAccumForMixtureDynSqr
@@ -2330,67 +2277,97 @@ namespace {
 
     };
     
-    // EM iteration
-    struct initIterEMGen
+    // Add 20181016: one EM iteration for one frame in the active list
+    //  M-step: o_d = sum_i (post_i * mean_i_d / var_i_d^2) / sum_i (post_i / var_i_d^2)
+    //  E-step: the posterior of each mixture given the new o (mixtureLogLikelihood)
+    //  The frame is marked as converged when the change of log-likelihood is
+    //  less than threshold * featureDim
+    struct EMGenStep
     {
-	// 
-	int featureDim;
-	int mixtureNM;
-	int totalTime;
-	int outputSize;
-	int startDOut;
+	int  featureDim;
+	int  mixtureNM;
+	int  totalTime;
+	int  outputSize;
+	int  startDOut;
 	bool tieVar;
+	bool firstIter;          // the initial posterior is not a likelihood
+	real_t threshold;
 
-	real_t *postP;
-	real_t *mdnPara;
-	real_t *targets;
-	const char *patTypes;
+	const int    *activeIdx; // indices of the frames to be updated
+	const real_t *mdnPara;
+	real_t       *postP;     // log w_i phi_i and the log sum (as m_tmpPat)
+	real_t       *targets;
+	int          *convFlag;  // 1: converged
 	
-	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t) const
+	__host__ __device__ void operator() (const int &idx) const
 	{
-	    int idx      = t.get<1>();
-	    int timeStep = idx / (featureDim);
-	    int dimOutput= idx % (featureDim);
+	    int timeStep = activeIdx[idx];
+
+	    const real_t *weight = mdnPara + timeStep * mixtureNM;
+	    const real_t *mean   = mdnPara + totalTime * mixtureNM +
+		                   timeStep  * mixtureNM * featureDim;
+	    const real_t *var    = mdnPara + totalTime * mixtureNM * (1 + featureDim) +
+		                   timeStep  * mixtureNM * (tieVar ? 1 : featureDim);
+	    real_t       *logLik = postP   + timeStep  * mixtureNM;
+	    real_t       *data   = targets + timeStep  * outputSize + startDOut;
+	    real_t        preSum = postP[totalTime * mixtureNM + timeStep];
+
+	    // posterior of each mixture (overwritten by the E-step below)
+	    for (int i = 0; i < mixtureNM; i++)
+		logLik[i] = helpers::safeExp(logLik[i] - preSum);
+	    
+	    // M-step
+	    real_t tmp1, tmp2, stdv;
+	    for (int d = 0; d < featureDim; d++){
+		tmp1 = 0.0;
+		tmp2 = 0.0;
+		for (int i = 0; i < mixtureNM; i++){
+		    stdv  = var[i * (tieVar ? 1 : featureDim) + (tieVar ? 0 : d)];
+		    tmp2 += logLik[i] / (stdv * stdv);
+		    tmp1 += logLik[i] * mean[i * featureDim + d] / (stdv * stdv);
+		}
+		data[d] = tmp1 / tmp2;
+	    }
 
-	    if (patTypes[timeStep] == PATTYPE_NONE)
-		return;
-	    const real_t *m, *v, *p, *q;
-	    /*const real_t *w;
-	      int pos_w    = timeStep*mixtureNM;*/
+	    // E-step
+	    tmp1 = mixtureLogLikelihood(data, weight, mean, var, mixtureNM, featureDim,
+					tieVar, logLik);
+	    postP[totalTime * mixtureNM + timeStep] = tmp1;
 
-	    
-	    /****  FATAL ERROR: remember to shift by dimOutput ****/
-	    // pointer to the Parameter of MDNUnit
-	    int pos_mean = totalTime*mixtureNM + timeStep*featureDim*mixtureNM + dimOutput;
-	    int pos_var  = tieVar ? 
-		(totalTime*(mixtureNM+featureDim*mixtureNM)+timeStep*mixtureNM) :
-		(pos_mean + totalTime*mixtureNM*featureDim);
-	    int pos_postM = timeStep  * mixtureNM;           
-	    int pos_postS = totalTime * mixtureNM + timeStep;
-
-	    real_t tmp1=0.0;
-	    real_t tmp2=0.0;
-	    
+	    tmp2 = (tmp1 > preSum) ? (tmp1 - preSum) : (preSum - tmp1);
+	    convFlag[timeStep] = ((!firstIter) && tmp2 < threshold * featureDim) ? 1 : 0;
+	}
+    };
 
-	    // for each mixture
-	    for(int i = 0; i < mixtureNM; i++){
-		v = mdnPara + pos_var   + (i*(tieVar?1:featureDim));  // pointer to var
-		m = mdnPara + pos_mean  + (i*featureDim);             // pointer to mean
-		p = postP   + pos_postM + i;  // pointer to the likelihood of this mixture
-		q = postP   + pos_postS;      // pointer to the sum of mixture likelihood
-		
-		// poster/var^2
-		tmp2 += helpers::safeExp((*p)-(*q))/((*v)*(*v));
-		// poster*mean/var^2
-		tmp1 += ((*m)*(helpers::safeExp((*p)-(*q))))/((*v)*(*v));
-	    }
-	    
-	    //
-	    // sum_i (poster_i * mean_i /var_i) / sum_i (poster_i /var_i) 
-	    tmp1 = tmp1/tmp2;
-	    // tmp1 = mdnPara[pos_mean+widx*featureDim];
-	    int pos_tar = timeStep * outputSize + startDOut + dimOutput;
-	    *(targets+pos_tar) = tmp1;
+    struct EMGenValidFrame
+    {
+	const char *patTypes;
+	__host__ __device__ bool operator() (const int &timeStep) const
+	{
+	    return patTypes[timeStep] != PATTYPE_NONE;
+	}
+    };
+
+    struct EMGenConverged
+    {
+	const int *convFlag;
+	__host__ __device__ bool operator() (const int &timeStep) const
+	{
+	    return convFlag[timeStep] > 0;
+	}
+    };
+
+    // -log likelihood of one frame after EM
+    struct EMGenLikelihood
+    {
+	int     mixtureNM;
+	int     totalTime;
+	const real_t *postP;
+	__host__ __device__ real_t operator() (const thrust::tuple<const char&, int> &t) const
+	{
+	    if (t.get<0>() == PATTYPE_NONE)
+		return 0;
+	    return -1 * postP[totalTime * mixtureNM + t.get<1>()];
 	}
     };
 
@@ -2558,6 +2535,7 @@ namespace layers {
 	, m_layerSizeTar    (outputSize)
 	, m_trainable       (trainable)
 	, m_feedBackType    (feedBackOpt)
+	, m_paraVecReduced  (false)
     {
 	// initilize the parameter vec
 	int n = m_precedingLayer.patTypes().size();
@@ -2716,6 +2694,61 @@ namespace layers {
     void MDNUnit<TDevice>::setGenMethod(cpu_real_vector &control, const int timeStep)
     {	
     }
+
+    template <typename TDevice>
+    bool MDNUnit<TDevice>::flagStepInputShift()
+    {
+	// default: the time step functions use the absolute position in the buffers
+	return false;
+    }
+    
+    template <typename TDevice>
+    bool MDNUnit<TDevice>::reduceParaBuffer()
+    {
+	// only for the unit whose time step functions support the shifted buffers
+	if (!this->flagStepInputShift() || m_precedingLayer.flagTrainingMode())
+	    return false;
+	
+	m_paraVec.clear();   m_paraVec.shrink_to_fit();
+	m_oneVector.clear(); m_oneVector.shrink_to_fit();
+	m_paraVec = cpu_real_vector(m_precedingLayer.parallelSequences() * m_paraDim, 0.0);
+	m_paraVecReduced = true;
+	return true;
+    }
+
+    template <typename TDevice>
+    int MDNUnit<TDevice>::paraVecBias(const int timeStepTimesParallel)
+    {
+	// shift of the position in m_paraVec when only one frame is kept
+	return (m_paraVecReduced ? (timeStepTimesParallel * m_paraDim) : 0);
+    }
+
+    template <typename TDevice>
+    int MDNUnit<TDevice>::paraVecFrames()
+    {
+	return (m_paraVecReduced ? m_precedingLayer.parallelSequences() :
+		(m_precedingLayer.curMaxSeqLength() * m_precedingLayer.parallelSequences()));
+    }
+
+    template <typename TDevice>
+    int MDNUnit<TDevice>::paraVecFrameBias(const int timeStepTimesParallel)
+    {
+	return (m_paraVecReduced ? timeStepTimesParallel : 0);
+    }
+
+    template <typename TDevice>
+    void MDNUnit<TDevice>::_samplingNoise(cpu_real_vector &noise, const int num, const int sub)
+    {
+	// one stream per unit: layer name and the output dimension of this unit
+	helpers::philox::stream_t s = helpers::philox::makeStream(
+		Configuration::instance().randomSeed(),
+		helpers::philox::streamId(m_precedingLayer.name()) + m_startDimOut,
+		m_precedingLayer.getCurrTrainingEpoch(),
+		m_precedingLayer.getCurrTrainingFrac(), sub);
+	noise.resize(num);
+	for (int i = 0; i < num; ++i)
+	    noise[i] = helpers::philox::normal(s, i);
+    }
 	
     
     /********************************************************
@@ -2839,21 +2872,26 @@ namespace layers {
     template <typename TDevice>
     void MDNUnit_sigmoid<TDevice>::computeForward(const int timeStep)
     {
+	// the pointers are moved to the current frame, so that the output of the
+	// preceding layer and m_paraVec can be reduced in memory
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int n  = this->m_precedingLayer.parallelSequences() * this->m_paraDim;
+	
 	// sigmoid, o_i_g = sigmoid(a_i_g), where a_i_g is the output of the previous hidden layer
 	{{
 		internal::ComputeSigmoid fn;
 		fn.NNOutputSize = this->m_precedingLayer.size();
 		fn.startD       = this->m_startDim;
 		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutput     = helpers::getRawPointer(this->m_precedingLayer.outputs());
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
+		fn.NNoutput     = (helpers::getRawPointer(this->m_precedingLayer.outputs()) +
+				   ts * this->m_precedingLayer.size() -
+				   this->m_precedingLayer.outputBufPtrBias(ts, 0));
 		
-		int is = timeStep * this->m_precedingLayer.parallelSequences() * this->m_paraDim;
-		int ie =       is + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
 		thrust::transform(
-		   thrust::counting_iterator<int>(0) + is,
-		   thrust::counting_iterator<int>(0) + ie,
-		   this->m_paraVec.begin() + is,
+		   thrust::counting_iterator<int>(0),
+		   thrust::counting_iterator<int>(0) + n,
+		   this->m_paraVec.begin() + ts * this->m_paraDim - this->paraVecBias(ts),
 		   fn);
 	}}	    
     }
@@ -2896,6 +2934,10 @@ namespace layers {
     void MDNUnit_sigmoid<TDevice>::getOutput(const int timeStep, 
 					     const real_t para, real_vector &targets)
     {
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int fs = ts * this->m_paraDim - this->paraVecBias(ts);
+	int fe = fs + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
+	
 	// Here, probability p(1) is directly used as output
 	// sampling output
 	{{
@@ -2903,18 +2945,16 @@ namespace layers {
 		fn.NNTargetSize = this->m_layerSizeTar;
 		fn.startDTarget = this->m_startDimOut;
 		fn.endDTarget   = this->m_endDimOut;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNTarget     = helpers::getRawPointer(targets); 
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
+		fn.NNTarget     = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar; 
 
-		int fs = timeStep * this->m_precedingLayer.parallelSequences() * this->m_paraDim;
-		int fe = fs       + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
 		thrust::for_each(
 			 thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fs, 
-						thrust::counting_iterator<int>(0)+fs)),
+						thrust::counting_iterator<int>(0))),
 		         thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fe, 
-						thrust::counting_iterator<int>(0)+fe)),
+						thrust::counting_iterator<int>(0)+(fe-fs))),
 			 fn);
 	}}
     }
@@ -2954,27 +2994,27 @@ namespace layers {
     template <typename TDevice>
     void MDNUnit_sigmoid<TDevice>::getParameter(const int timeStep, real_t *targets)
     {
-	int fs = timeStep * this->m_precedingLayer.parallelSequences() * this->m_paraDim;
-	int fe =       fs + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int fs = ts * this->m_paraDim - this->paraVecBias(ts);
+	int fe = fs + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
 	{{
 		internal::SamplingSigmoid fn;
 		fn.NNTargetSize = this->m_precedingLayer.size();
 		fn.startDTarget = this->m_startDim;  // position in the output parameter vector
 		fn.endDTarget   = this->m_endDim;    // position in the output parameter vector
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNTarget     = targets; 
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
+		fn.NNTarget     = targets + ts * this->m_precedingLayer.size(); 
 		thrust::for_each(
 			 thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fs, 
-						thrust::counting_iterator<int>(0)+fs)),
+						thrust::counting_iterator<int>(0))),
 		         thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fe, 
-						thrust::counting_iterator<int>(0)+fe)),
+						thrust::counting_iterator<int>(0)+(fe-fs))),
 			 fn);
 	}}
     }
 
-	
     template <typename TDevice>
     real_t MDNUnit_sigmoid<TDevice>::calculateError(real_vector &targets)
     {
@@ -3179,37 +3219,46 @@ namespace layers {
 						    const int dimStart, real_vector &targets,
 						    const int timeStep, const int method)
     {
+	// the pointers are moved to the current frame
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	
 	internal::CopyPart fn;
-	fn.target = helpers::getRawPointer(fillBuffer);
+	fn.target = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 	fn.tarDim = bufferDim;
 	fn.tarS   = dimStart;
-	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 	
 	if (this->m_feedBackType == MDNUNIT_FEEDBACK_OPT_0){
-	    fn.source = helpers::getRawPointer(this->m_paraVec);
+	    fn.source = (helpers::getRawPointer(this->m_paraVec) +
+			 ts * this->m_paraDim - this->paraVecBias(ts));
 	    fn.srcDim = this->m_paraDim;
 	    fn.srcS   = 0;
 	    fn.copyDim= this->m_paraDim;	    
 	}else{
-	    fn.source = helpers::getRawPointer(targets);
+	    fn.source = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
 	    fn.srcDim = this->m_layerSizeTar;
 	    fn.srcS   = this->m_startDimOut;
 	    fn.copyDim= (this->m_endDimOut - this->m_startDimOut);
 	}
 	
-	int ts = (timeStep * this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	int te = (ts  +      this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	
+	// m_paraVec (one frame at least) is only used to count the elements 
+	int n = this->m_precedingLayer.parallelSequences() * fn.copyDim;
 	thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + ts, 
-					   thrust::counting_iterator<int>(0) + ts)),
+			thrust::make_tuple(this->m_paraVec.begin(), 
+					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + te, 
-					   thrust::counting_iterator<int>(0) + te)),
+			thrust::make_tuple(this->m_paraVec.begin() + n, 
+					   thrust::counting_iterator<int>(0) + n)),
 		fn);
     }
 
+    template <typename TDevice>
+    bool MDNUnit_sigmoid<TDevice>::flagStepInputShift()
+    {
+	return true;
+    }
+
     template <typename TDevice>
     int MDNUnit_sigmoid<TDevice>::feedBackDim()
     {
@@ -3310,314 +3359,58 @@ namespace layers {
 			     tLayer->weights().begin() +
 			     tLayer->size()* tLayer->precedingLayer().size() + 
 			     this->m_startDim);
-		
-	    }
-	}else{
-	    throw std::runtime_error("MDN previous layer can not be untrainable");
-	}
-    }
-
-
-    template <typename TDevice>
-    void MDNUnit_softmax<TDevice>::computeForward()
-    {
-
-	if (m_uvSigmoid){
-	    // With the first dimension as sigmoid
-	    
-	    // calculate the offset
-	    {{
-		internal::CalculateOffsetFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim + 1;
-		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutputs    = helpers::getRawPointer(this->m_precedingLayer.outputs());
-
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		
-		thrust::transform(thrust::counting_iterator<int>(0),
-				  thrust::counting_iterator<int>(0)+n,
-				  this->m_offset.begin(), fn);
-	    }}	    
-
-	    // calculate the Exp
-	    {{
-		internal::CalculateExpFn_UVSigmoid fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD    = this->m_startDim;
-		fn.endD      = this->m_endDim;
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput  = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		fn.offset    = helpers::getRawPointer(this->m_offset);
-		
-		int n = this->m_precedingLayer.curMaxSeqLength();
-		n = n * this->m_precedingLayer.parallelSequences();
-		n = n * (this->m_paraDim);
-		
-		thrust::transform(
-		   thrust::counting_iterator<int>(0),
-		   thrust::counting_iterator<int>(0)+n,
-		   this->m_paraVec.begin(),
-		   fn);
-	     }}
-
-	    // sum up
-	    {{
-		internal::SumUpOutputsFn_UVSigmoid fn;
-		fn.dimSize  = this->m_paraDim;
-		fn.outputs  = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		// n = n*(this->m_paraDim);
-		
-		thrust::for_each(
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin(),  
-						   thrust::counting_iterator<int>(0))),
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin()+n,  
-						   thrust::counting_iterator<int>(0)+n)),
-		   fn);
-	    }}
-	
-	    // normalize
-	    {{
-		internal::NormalizeOutputsFn_UVSigmoid fn;
-		fn.layerSize = this->m_paraDim;
-		fn.normFacts = helpers::getRawPointer(this->m_offset);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		n = n*this->m_paraDim;
-
-		thrust::for_each(
-		thrust::make_zip_iterator(
-			 thrust::make_tuple(this->m_paraVec.begin(),
-					    thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(
-			 thrust::make_tuple(this->m_paraVec.begin()+n, 
-					    thrust::counting_iterator<int>(0)+n)),
-                fn);
-	    }}
-	    
-	}else{
-	
-	    // calculate the offset 
-	    {{
-		internal::CalculateOffsetFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim;
-		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutputs    = helpers::getRawPointer(this->m_precedingLayer.outputs());
-
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		//n = n*(this->m_paraDim);
-		
-		thrust::transform(
-		   thrust::counting_iterator<int>(0),
-		   thrust::counting_iterator<int>(0)+n,
-		   this->m_offset.begin(),
-		   fn);
-	    }}	    
-
-	    // calculate the Exp
-	    {{
-		internal::CalculateExpFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD    = this->m_startDim;
-		fn.endD      = this->m_endDim;
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput  = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		fn.offset    = helpers::getRawPointer(this->m_offset);
-		
-		int n = this->m_precedingLayer.curMaxSeqLength();
-		n = n * this->m_precedingLayer.parallelSequences();
-		n = n * (this->m_paraDim);
-		
-		thrust::transform(
-		   thrust::counting_iterator<int>(0),
-		   thrust::counting_iterator<int>(0)+n,
-		   this->m_paraVec.begin(),
-		   fn);
-	     }}
-
-	    // sum up
-	    {{
-		internal::SumUpOutputsFn fn;
-		fn.dimSize = this->m_paraDim;
-		fn.outputs = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		// n = n*(this->m_paraDim);
-		
-		thrust::for_each(
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin(),  
-						   thrust::counting_iterator<int>(0))),
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin()+n,  
-						   thrust::counting_iterator<int>(0)+n)),
-		   fn);
-	    }}
-	
-	    // normalize
-	    {{
-		internal::NormalizeOutputsFn fn;
-		fn.layerSize = this->m_paraDim;
-		fn.normFacts = helpers::getRawPointer(this->m_offset);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		n = n*this->m_paraDim;
-
-		thrust::for_each(
-		thrust::make_zip_iterator(
-			 thrust::make_tuple(this->m_paraVec.begin(),
-					    thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(
-			 thrust::make_tuple(this->m_paraVec.begin()+n, 
-					    thrust::counting_iterator<int>(0)+n)),
-                fn);
-	    }}
-	}
-    }
-
-
-    template <typename TDevice>
-    void MDNUnit_softmax<TDevice>::computeForward(const int timeStep)
-    {
-	int ts = timeStep * this->m_precedingLayer.parallelSequences();
-	int te =       ts + this->m_precedingLayer.parallelSequences();
-
-	if (m_uvSigmoid){
-	    
-	    // calculate the offset 
-	    {{
-		internal::CalculateOffsetFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim + 1;
-		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutputs    = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		thrust::transform(thrust::counting_iterator<int>(0) + ts, 
-				  thrust::counting_iterator<int>(0) + te,
-				  this->m_offset.begin() + ts, fn);
-	     }}	    
-	
-	    // calculate the Exp
-	    {{
-		internal::CalculateExpFn_UVSigmoid fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim;
-		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput     = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		fn.offset       = helpers::getRawPointer(this->m_offset);
-		thrust::transform(thrust::counting_iterator<int>(0) + ts * this->m_paraDim,
-				  thrust::counting_iterator<int>(0) + te * this->m_paraDim,
-				  this->m_paraVec.begin()           + ts * this->m_paraDim, fn);
-	    }}
-	
-	    // sum up
-	    {{
-		internal::SumUpOutputsFn_UVSigmoid fn;
-		fn.dimSize = this->m_paraDim;
-		fn.outputs = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		thrust::for_each(
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin() + ts,  
-						   thrust::counting_iterator<int>(0)+ts)),
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin() + te,  
-						   thrust::counting_iterator<int>(0)+te)),
-		   fn);
-	     }}
-
-	    // normalize
-	    {{
-		internal::NormalizeOutputsFn_UVSigmoid fn;
-		fn.layerSize = this->m_paraDim;
-		fn.normFacts = helpers::getRawPointer(this->m_offset);
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		
-		thrust::for_each(
-		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + ts*this->m_paraDim,
-				      thrust::counting_iterator<int>(0)+ts*this->m_paraDim)),
-                thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + te*this->m_paraDim, 
-				      thrust::counting_iterator<int>(0)+te*this->m_paraDim)),
-                fn);
-	    }}
-	    
-	}else{
-	    // calculate the offset 
-	    {{
-		internal::CalculateOffsetFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim;
-		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutputs    = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		thrust::transform(thrust::counting_iterator<int>(0) + ts, 
-				  thrust::counting_iterator<int>(0) + te,
-				  this->m_offset.begin() + ts, fn);
-	     }}	    
-	
-	    // calculate the Exp
-	    {{
-		internal::CalculateExpFn fn;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startD    = this->m_startDim;
-		fn.endD      = this->m_endDim;
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput  = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		fn.offset    = helpers::getRawPointer(this->m_offset);
-		thrust::transform(thrust::counting_iterator<int>(0) + ts * this->m_paraDim,
-				  thrust::counting_iterator<int>(0) + te * this->m_paraDim,
-				  this->m_paraVec.begin()           + ts * this->m_paraDim, fn);
-	    }}
+		
+	    }
+	}else{
+	    throw std::runtime_error("MDN previous layer can not be untrainable");
+	}
+    }
+
+
+    template <typename TDevice>
+    void MDNUnit_softmax<TDevice>::computeForward()
+    {
+	// Add 20181012: softmax (and the sigmoid dimension if m_uvSigmoid)
+	internal::ComputeSoftmaxUnitFn fn;
+	fn.NNOutputSize = this->m_precedingLayer.size();
+	fn.startD       = this->m_startDim;
+	fn.endD         = this->m_endDim;
+	fn.uvSigmoid    = m_uvSigmoid;
+	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	fn.NNOutput     = helpers::getRawPointer(this->m_precedingLayer.outputs());
+	fn.paraVec      = helpers::getRawPointer(this->m_paraVec);
+
+	int n = this->m_precedingLayer.curMaxSeqLength();
+	n = n * this->m_precedingLayer.parallelSequences();
 	
-	    // sum up
-	    {{
-		internal::SumUpOutputsFn fn;
-		fn.dimSize = this->m_paraDim;
-		fn.outputs = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		thrust::for_each(
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin() + ts,  
-						   thrust::counting_iterator<int>(0)+ts)),
-		   thrust::make_zip_iterator(
-				thrust::make_tuple(this->m_offset.begin() + te,  
-						   thrust::counting_iterator<int>(0)+te)),
-		   fn);
-	     }}
+	internal::softmaxUnitForward(fn, this->m_offset, 0, this->m_paraVec, 0, n);
+    }
 
-	    // normalize
-	    {{
-		internal::NormalizeOutputsFn fn;
-		fn.layerSize = this->m_paraDim;
-		fn.normFacts = helpers::getRawPointer(this->m_offset);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		thrust::for_each(
-		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + ts*this->m_paraDim,
-				      thrust::counting_iterator<int>(0)+ts*this->m_paraDim)),
-                thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + te*this->m_paraDim, 
-				      thrust::counting_iterator<int>(0)+te*this->m_paraDim)),
-                fn);
-	    }}
-	}
 
+    template <typename TDevice>
+    void MDNUnit_softmax<TDevice>::computeForward(const int timeStep)
+    {
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int te =       ts + this->m_precedingLayer.parallelSequences();
+
+	// the pointers are moved to the current frame, so that the output of the
+	// preceding layer and m_paraVec can be reduced in memory
+	int np = te - ts;                                        // number of frames
+	int ps = ts * this->m_paraDim - this->paraVecBias(ts);   // position in m_paraVec
+	const char *patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
+	real_t *nnOutput     = (helpers::getRawPointer(this->m_precedingLayer.outputs()) +
+				ts * this->m_precedingLayer.size() -
+				this->m_precedingLayer.outputBufPtrBias(ts, 0));
+
+	internal::ComputeSoftmaxUnitFn fn;
+	fn.NNOutputSize = this->m_precedingLayer.size();
+	fn.startD       = this->m_startDim;
+	fn.endD         = this->m_endDim;
+	fn.uvSigmoid    = m_uvSigmoid;
+	fn.patTypes     = patTypes;
+	fn.NNOutput     = nnOutput;
+	fn.paraVec      = helpers::getRawPointer(this->m_paraVec) + ps;
+	internal::softmaxUnitForward(fn, this->m_offset, ts, this->m_paraVec, ps, np);
     }
 
 
@@ -3710,16 +3503,20 @@ namespace layers {
 	    randomSeed = misFuncs::GetRandomNumber();	    
 	else
 	    randomSeed = 0.0;
-	
+
+	// the pointers are moved to the current frame
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int np = this->m_precedingLayer.parallelSequences();
+	int ps = ts * this->m_paraDim - this->paraVecBias(ts);
 	
 	if (m_uvSigmoid){
 	    {{    
 		internal::SamplingSoftmax_UVSigmoid fn;
 		fn.paradim      = this->m_paraDim;
 		fn.startDOut    = this->m_startDimOut;
-		fn.output       = helpers::getRawPointer(targets);
-		fn.prob         = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.output       = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
+		fn.prob         = helpers::getRawPointer(this->m_paraVec) + ps;
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 		
 		fn.layerSizeOut = this->m_layerSizeTar;
 		fn.threshold    = m_threshold;
@@ -3727,16 +3524,13 @@ namespace layers {
 		fn.randomSeeds  = NULL;
 		fn.randomSeed   = randomSeed;
 		
-		int fs = timeStep * this->m_precedingLayer.parallelSequences();
-		int fe = fs       + this->m_precedingLayer.parallelSequences();
-
 		thrust::for_each(
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin()+fs,
-				      thrust::counting_iterator<int>(0)+fs)),
+		   thrust::make_tuple(this->m_paraVec.begin()+ps,
+				      thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin()+fe,
-				      thrust::counting_iterator<int>(0)+fe)),
+		   thrust::make_tuple(this->m_paraVec.begin()+ps+np,
+				      thrust::counting_iterator<int>(0)+np)),
 		fn);
 	    }}
 	}else{
@@ -3745,26 +3539,23 @@ namespace layers {
 		internal::SamplingSoftmax fn;
 		fn.paradim   = this->m_paraDim;
 		fn.startDOut = this->m_startDimOut;
-		fn.output    = helpers::getRawPointer(targets);
-		fn.prob      = helpers::getRawPointer(this->m_paraVec);
+		fn.output    = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
+		fn.prob      = helpers::getRawPointer(this->m_paraVec) + ps;
 		fn.layerSizeOut = this->m_layerSizeTar;
 		fn.genMethod    = this->m_genMethod;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 
 		fn.randomSeeds  = NULL;
 		fn.randomSeed   = randomSeed;
 
 		
-		int fs = timeStep * this->m_precedingLayer.parallelSequences();
-		int fe = fs       + this->m_precedingLayer.parallelSequences();
-
 		thrust::for_each(
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin()+fs,
-				      thrust::counting_iterator<int>(0)+fs)),
+		   thrust::make_tuple(this->m_paraVec.begin()+ps,
+				      thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin()+fe,
-				      thrust::counting_iterator<int>(0)+fe)),
+		   thrust::make_tuple(this->m_paraVec.begin()+ps+np,
+				      thrust::counting_iterator<int>(0)+np)),
 		fn);
 	    }}
 	}
@@ -3802,8 +3593,9 @@ namespace layers {
     template <typename TDevice>
     void MDNUnit_softmax<TDevice>::getParameter(const int timeStep, real_t *targets)
     {
-	int fs = timeStep * this->m_precedingLayer.parallelSequences() * this->m_paraDim;
-	int fe =       fs + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int fs = ts * this->m_paraDim - this->paraVecBias(ts);
+	int fe = fs + this->m_precedingLayer.parallelSequences() * this->m_paraDim;
 	
 	{{
 		internal::GetParameterSoftmax fn;
@@ -3811,17 +3603,17 @@ namespace layers {
 		fn.paraDim      = this->m_paraDim;
 		fn.startD       = this->m_startDim;
 		fn.endD         = this->m_endDim;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput     = targets;
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
+		fn.NNOutput     = targets + ts * this->m_precedingLayer.size();
 		fn.uvSigmoid    = m_uvSigmoid;
 		
 		thrust::for_each(
 			 thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fs, 
-						thrust::counting_iterator<int>(0)+fs)),
+						thrust::counting_iterator<int>(0))),
 		         thrust::make_zip_iterator(
 			     thrust::make_tuple(this->m_paraVec.begin()+fe, 
-						thrust::counting_iterator<int>(0)+fe)),
+						thrust::counting_iterator<int>(0)+(fe-fs))),
 			 fn);
 	}}
     }
@@ -4017,35 +3809,39 @@ namespace layers {
 	int ts = timeStep * this->m_precedingLayer.parallelSequences();
 	int te = ts + this->m_precedingLayer.parallelSequences();
 
+	// the pointers are moved to the current frame
+	int ps = ts * this->m_paraDim - this->paraVecBias(ts);
+	int n  = (te - ts) * this->m_paraDim;
+
 	// 
 	if (method == NN_FEEDBACK_DROPOUT_1N   || method == NN_FEEDBACK_DROPOUT_ZERO ||
 	    method == NN_FEEDBACK_GROUND_TRUTH || method == NN_FEEDBACK_SC_SOFT){
 	    internal::setSoftVectorSoftmax fn;
-	    fn.target = helpers::getRawPointer(fillBuffer);
+	    fn.target = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 	    fn.tarDim = bufferDim;
 	    fn.tarS   = dimStart;
-	    fn.source = helpers::getRawPointer(this->m_paraVec);
+	    fn.source = helpers::getRawPointer(this->m_paraVec) + ps;
 	    fn.srcDim = this->m_paraDim;
 	    fn.srcS   = 0;
 	    fn.copyDim= this->m_paraDim;
 	    fn.uvSigmoid = m_uvSigmoid;
 	    fn.threshold = 0.5; //m_threshold;
-	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 	    
 	    thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + ts*fn.copyDim, 
-					   thrust::counting_iterator<int>(0)+ts*fn.copyDim)),
+			thrust::make_tuple(this->m_paraVec.begin() + ps, 
+					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + te*fn.copyDim, 
-					   thrust::counting_iterator<int>(0)+te*fn.copyDim)),
+			thrust::make_tuple(this->m_paraVec.begin() + ps + n, 
+					   thrust::counting_iterator<int>(0) + n)),
 		fn);
 
 	    if (method == NN_FEEDBACK_DROPOUT_1N || method == NN_FEEDBACK_DROPOUT_ZERO){
 		// used to 'kill' the feedback data by setting the feedback as uniform vectors
 		// assume the feedback vector has been set in &fillBuffer
 		internal::killOneHotVectorSoftmaxOneTime fn;
-		fn.buffer  = helpers::getRawPointer(fillBuffer);
+		fn.buffer  = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 		fn.bufDim  = bufferDim;
 
 		fn.paraDim = this->m_paraDim;
@@ -4056,34 +3852,34 @@ namespace layers {
 	    
 		thrust::for_each(
 		  thrust::make_zip_iterator(
-		    thrust::make_tuple(this->m_paraVec.begin() + ts*this->m_paraDim, 
-				       thrust::counting_iterator<int>(0) + ts*this->m_paraDim)),
+		    thrust::make_tuple(this->m_paraVec.begin() + ps, 
+				       thrust::counting_iterator<int>(0))),
 		  thrust::make_zip_iterator(
-		    thrust::make_tuple(this->m_paraVec.begin() + te*this->m_paraDim, 
-				       thrust::counting_iterator<int>(0) + te*this->m_paraDim)),
+		    thrust::make_tuple(this->m_paraVec.begin() + ps + n, 
+				       thrust::counting_iterator<int>(0) + n)),
 		  fn);
 	    }
 	    
 	}else if (method == NN_FEEDBACK_SC_MAXONEHOT ||
 		  method == NN_FEEDBACK_SC_RADONEHOT){
 	    internal::setOneHotVectorSoftmax fn;
-	    fn.source = helpers::getRawPointer(targets);
+	    fn.source = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
 	    fn.srcDim = this->m_layerSizeTar;
 	    fn.srcS   = this->m_startDimOut;
-	    fn.buffer = helpers::getRawPointer(fillBuffer);
+	    fn.buffer = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 	    fn.bufDim = bufferDim;
 	    fn.bufS   = dimStart;
 	    fn.paraDim= this->m_paraDim;
 	    fn.uvSigmoid = m_uvSigmoid;
-	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 	    
 	    thrust::for_each(
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + ts * this->m_paraDim, 
-				      thrust::counting_iterator<int>(0)+ ts*this->m_paraDim)),
+		   thrust::make_tuple(this->m_paraVec.begin() + ps, 
+				      thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-		   thrust::make_tuple(this->m_paraVec.begin() + te * this->m_paraDim, 
-				      thrust::counting_iterator<int>(0)+ te*this->m_paraDim)),
+		   thrust::make_tuple(this->m_paraVec.begin() + ps + n, 
+				      thrust::counting_iterator<int>(0) + n)),
 		fn);   
 	}
 
@@ -4142,6 +3938,12 @@ namespace layers {
 	
     }
 
+    template <typename TDevice>
+    bool MDNUnit_softmax<TDevice>::flagStepInputShift()
+    {
+	return true;
+    }
+
     template <typename TDevice>
     void MDNUnit_softmax<TDevice>::setGenMethod(cpu_real_vector &control, const int timeStep)
     {
@@ -4233,12 +4035,6 @@ namespace layers {
 	// intermediate matrix to store the \sum_dim (t-\mu)^2 and sum_mixture \sum_dim (t-\mu)^2
 	m_tmpPat.resize(this->m_precedingLayer.patTypes().size()*(m_numMixture+1), 0.0);
 	    
-	// for BP variance accumulation (only used for tied variance)
-	if (m_tieVar)
-	    m_varBP.resize(this->m_precedingLayer.patTypes().size()*(endDim-startDim)*type, 0.0);
-	else
-	    m_varBP.clear();
-
 	m_mdnVarEpochFix = Configuration::instance().mdnVarUpdateEpoch();
 	
     }
@@ -4551,16 +4347,28 @@ namespace layers {
 	int ts = timeStep * this->m_precedingLayer.parallelSequences();
 	int te =       ts + this->m_precedingLayer.parallelSequences();
 
+	// Modify 20181018: the weight, mean and variance planes of m_paraVec may only
+	//  keep the current frame. The functors work on the frame index in m_paraVec,
+	//  and the other pointers are shifted by the same number of frames
+	int fb     = this->paraVecFrameBias(ts);   // frame shift of m_paraVec
+	int frames = this->paraVecFrames();        // frames in each plane of m_paraVec
+	const char *patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + fb;
+	real_t *nnOutput     = (helpers::getRawPointer(this->m_precedingLayer.outputs()) +
+				fb * this->m_precedingLayer.size() -
+				this->m_precedingLayer.outputBufPtrBias(ts, 0));
+	ts = ts - fb;
+	te = te - fb;
+	
 	{{
 		internal::CalculateOffsetFn fn;
 		fn.NNOutputSize = this->m_precedingLayer.size();
 		fn.startD       = this->m_startDim;
 		fn.endD         = this->m_startDim+this->m_numMixture;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNoutputs    = helpers::getRawPointer(this->m_precedingLayer.outputs());
+		fn.patTypes     = patTypes;
+		fn.NNoutputs    = nnOutput;
 		thrust::transform(thrust::counting_iterator<int>(0) + ts,
 				  thrust::counting_iterator<int>(0) + te,
-				  this->m_offset.begin()            + ts, fn);
+				  this->m_offset.begin()            + ts + fb, fn);
 	}}	    
 
 	// calculate the exp(w_k - offset) 
@@ -4569,9 +4377,9 @@ namespace layers {
 		fn.NNOutputSize = this->m_precedingLayer.size();
 		fn.startD    = this->m_startDim;
 		fn.endD      = this->m_startDim + this->m_numMixture;
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput  = helpers::getRawPointer(this->m_precedingLayer.outputs());
-		fn.offset    = helpers::getRawPointer(this->m_offset);
+		fn.patTypes  = patTypes;
+		fn.NNOutput  = nnOutput;
+		fn.offset    = helpers::getRawPointer(this->m_offset) + fb;
 		thrust::transform(
 		   thrust::counting_iterator<int>(0) + ts * this->m_numMixture,
 		   thrust::counting_iterator<int>(0) + te * this->m_numMixture,
@@ -4583,14 +4391,14 @@ namespace layers {
 		internal::SumUpOutputsFn fn;
 		fn.dimSize   = this->m_numMixture;
 		fn.outputs   = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.patTypes  = patTypes;
 		
 		thrust::for_each(
 		   thrust::make_zip_iterator(
-				 thrust::make_tuple(this->m_offset.begin() + ts,  
+				 thrust::make_tuple(this->m_offset.begin() + ts + fb,  
 						    thrust::counting_iterator<int>(0) + ts)),
 		   thrust::make_zip_iterator(
-				 thrust::make_tuple(this->m_offset.begin() + te,  
+				 thrust::make_tuple(this->m_offset.begin() + te + fb,  
 						    thrust::counting_iterator<int>(0) + te)),
 		   fn);
 	}}
@@ -4599,8 +4407,8 @@ namespace layers {
         {{
 		internal::NormalizeOutputsFn fn;
 		fn.layerSize = this->m_numMixture;
-		fn.normFacts = helpers::getRawPointer(this->m_offset);
-		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.normFacts = helpers::getRawPointer(this->m_offset) + fb;
+		fn.patTypes  = patTypes;
 		thrust::for_each(
 		    thrust::make_zip_iterator(
 			  thrust::make_tuple(
@@ -4621,12 +4429,11 @@ namespace layers {
 		fn.NNOutputSize = this->m_precedingLayer.size();
 		fn.featureDim   = this->m_numMixture*this->m_featureDim;
 		fn.startD       = this->m_startDim + this->m_numMixture;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput     = helpers::getRawPointer(this->m_precedingLayer.outputs());
+		fn.patTypes     = patTypes;
+		fn.NNOutput     = nnOutput;
 		
 		// shift over mixture weight part
-		int shift = (this->m_precedingLayer.curMaxSeqLength() * 
-			     this->m_precedingLayer.parallelSequences() * this->m_numMixture);
+		int shift = frames * this->m_numMixture;
 		int featS = ts * this->m_numMixture * this->m_featureDim;
 		int featE = te * this->m_numMixture * this->m_featureDim;
 		
@@ -4640,9 +4447,6 @@ namespace layers {
 				this->m_paraVec.begin() + shift + featE, 
 				thrust::counting_iterator<int>(0) + featE)),
 		    fn);
-		
-		//Cpu::real_vector tmptempParaVec2 = this->m_paraVec;
-		//printf("\n");
 	}}
 
 	//
@@ -4657,17 +4461,12 @@ namespace layers {
 				   this->m_numMixture * (this->m_tieVar?1:this->m_featureDim));
 		
 		fn.varFloor     = this->m_varFloor;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.NNOutput     = helpers::getRawPointer(this->m_precedingLayer.outputs());
+		fn.patTypes     = patTypes;
+		fn.NNOutput     = nnOutput;
 		fn.flagUpdateV  = flagUpdateVar(this->m_precedingLayer.getCurrTrainingEpoch(),
 						m_mdnVarEpochFix);
 
-		// total time step
-		int timeStep = this->m_precedingLayer.curMaxSeqLength();
-		timeStep     = timeStep*this->m_precedingLayer.parallelSequences();
-		
-		
-		int shift = timeStep * (this->m_numMixture*(this->m_featureDim+1));
+		int shift = frames * (this->m_numMixture*(this->m_featureDim+1));
 		int featS = ts * this->m_numMixture*(this->m_tieVar?1:this->m_featureDim);
 		int featE = te * this->m_numMixture*(this->m_tieVar?1:this->m_featureDim);
 		thrust::transform(
@@ -4687,7 +4486,6 @@ namespace layers {
 
 	int totalTime = this->m_precedingLayer.curMaxSeqLength();
 	totalTime     = totalTime*this->m_precedingLayer.parallelSequences();
-	int time      = totalTime*(this->m_endDimOut - this->m_startDimOut);
 	
 	/*Modify */
 	// initialization of the output 
@@ -4726,169 +4524,76 @@ namespace layers {
 	}}
 
 	
-	real_t outP   = 0.0;     
-	bool finish   = false;
+	// Add 20181016: the EM iteration is conducted per frame. Frames are removed
+	//  from the active list once converged, and the iteration stops when the list
+	//  is empty or config.EMIterNM() is reached
+	if (m_emActive.size() < (size_t)totalTime){
+	    m_emActive.resize(totalTime, 0);
+	    m_emConverged.resize(totalTime, 0);
+	}
+	int numActive = 0;
+	{{
+		internal::EMGenValidFrame fn;
+		fn.patTypes = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		numActive = (thrust::copy_if(thrust::counting_iterator<int>(0),
+					     thrust::counting_iterator<int>(0) + totalTime,
+					     m_emActive.begin(), fn) -
+			     m_emActive.begin());
+	}}
+	int numFrame  = numActive;
+	int numUpdate = 0;
 	int iter      = 0;
-	while(!finish)
-	{   
+	
+	while (numActive > 0 && iter < config.EMIterNM())
+	{
 	    {{
-
-		// initIterEMGen: compute the argmax_o_new \sum_m p(m|o_old) log p(o_new, m)
-		internal::initIterEMGen fn;
+		internal::EMGenStep fn;
 		fn.featureDim   = this->m_featureDim;
 		fn.mixtureNM    = this->m_numMixture;
 		fn.outputSize   = this->m_layerSizeTar;
 		fn.startDOut    = this->m_startDimOut;
 		fn.totalTime    = totalTime;
 		fn.tieVar       = this->m_tieVar;
+		fn.firstIter    = (iter == 0);
+		fn.threshold    = config.EMGenThreshold();
 
-		fn.postP        = helpers::getRawPointer(this->m_tmpPat);
+		fn.activeIdx    = helpers::getRawPointer(m_emActive);
 		fn.mdnPara      = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.postP        = helpers::getRawPointer(this->m_tmpPat);
 		fn.targets      = helpers::getRawPointer(targets);
-		thrust::for_each(
-		  thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin(),
-					   thrust::counting_iterator<int>(0))),
-		  thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin()+time,
-					   thrust::counting_iterator<int>(0)+time)),
-		  fn);
-
-		#ifdef DEBUG_LOCAL
-		Cpu::real_vector mdnPara;
-		Cpu::real_vector postP;
-		Cpu::real_vector tar;
-		mdnPara = this->m_paraVec;
-		postP   = this->m_tmpPat;
-		tar     = targets;
-		for (int idx = 0; idx < time; idx ++){
-		    int timeStep = idx / (fn.featureDim);
-		    int dimOutput= idx % (fn.featureDim);
-
-		    real_t m, v, p, q;
-		    int pos_mean = fn.totalTime * fn.mixtureNM + 
-			timeStep * fn.featureDim * fn.mixtureNM + dimOutput;
-		    int pos_var  = fn.totalTime * (fn.mixtureNM + fn.featureDim * fn.mixtureNM) 
-			+ timeStep * fn.mixtureNM;
-		    if (!this->m_tieVar)
-			pos_var = pos_mean + fn.totalTime * fn.mixtureNM * fn.featureDim;
-
-		    int pos_postM= timeStep * fn.mixtureNM;
-		    int pos_postS= fn.totalTime*fn.mixtureNM + timeStep;
-
-		    real_t tmp1=0.0;
-		    real_t tmp2=0.0;
-		    for(int i = 0; i < fn.mixtureNM; i++){
-			v = mdnPara[pos_var];
-			m = mdnPara[pos_mean];
-			p = postP[pos_postM];
-			q = postP[pos_postS];
-
-			tmp2 += exp(p-q)/((v)*(v));
-			tmp1 += ((m)*(exp(p-q)))/((v)*(v));
-			pos_var  += this->m_tieVar?1:fn.featureDim; 
-			pos_mean += fn.featureDim; 
-			pos_postM+=1;
-		    }
-		    tmp1 = tmp1/tmp2;
-		    printf("Time %d %d %f:\n", timeStep, dimOutput, tmp1);
-		}
-		#endif
-
-
-	    }}
-
-	    // iteration
-	    {{		
-		// calculate the posterior probability using the functions in calculateError
-		internal::ComputeMixtureDistance fn;
-		fn.startDOut    = this->m_startDimOut;
-		fn.mixture_num  = this->m_numMixture;
-		fn.featureDim   = this->m_featureDim;
-		fn.layerSizeOut = this->m_layerSizeTar;
-		fn.tieVar       = this->m_tieVar;
-		
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.output    = helpers::getRawPointer(targets);
-		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
-
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		fn.totaltime = n;
-		n = n*this->m_numMixture;
-		
-		thrust::transform(thrust::counting_iterator<int>(0),
-				  thrust::counting_iterator<int>(0)+n,
-				  this->m_tmpPat.begin(),
-				  fn);		
-
-		#ifdef DEBUG_LOCAL
-		Cpu::real_vector temp_vec1;
-		Cpu::real_vector temp_vec2;
-		Cpu::real_vector temp_vec3;
-		Cpu::real_vector temp_vec4;
-		
-		temp_vec1 = this->m_paraVec;
-		temp_vec2 = targets;
-		temp_vec3 = this->m_tmpPat;
-		temp_vec4  = this->m_precedingLayer.patTypes();
-		printf("MixtureDistance\n");
-		for (int t = 0; t < n; t++){
-		    real_t tmp=0.0;
-		    real_t tmptmp;
-
-		    int timeStep = (t/fn.mixture_num);
-		    int mixIndex = (t%fn.mixture_num);
-		    int pos_data = fn.layerSizeOut * timeStep + fn.startDOut;
-		    int pos_mean = fn.totaltime * fn.mixture_num + 
-			timeStep*fn.featureDim*fn.mixture_num+mixIndex*fn.featureDim;
-		    int pos_var  = fn.totaltime * (fn.mixture_num + 
-						   fn.mixture_num * fn.featureDim) +
-			timeStep*fn.mixture_num + mixIndex;
-		    if (!this->m_tieVar)
-			pos_var  = fn.totaltime * (fn.mixture_num + 
-						   fn.mixture_num * fn.featureDim) +
-			    timeStep*fn.mixture_num*fn.featureDim + mixIndex*fn.featureDim;
-		    for (int i = 0; i<fn.featureDim; i++){
-			tmp += ((temp_vec2[pos_data+i]) - temp_vec1[pos_mean+i]) * 
-			    ((temp_vec2[pos_data+i]) - temp_vec1[pos_mean+i])
-			    /(temp_vec1[pos_var+(this->m_tieVar?0:1)])
-			    /(temp_vec1[pos_var+(this->m_tieVar?0:1)])/2;
-		    }
-		    printf("%f %f %f %f\t", temp_vec1[pos_mean], temp_vec2[pos_data], 
-			   temp_vec1[pos_var], tmp);
-		    if (mixIndex==(fn.mixture_num - 1))
-			printf("\n");
-		}
-		printf("\nEnd\n");
-		#endif
+		fn.convFlag     = helpers::getRawPointer(m_emConverged);
+		thrust::for_each(thrust::counting_iterator<int>(0),
+				 thrust::counting_iterator<int>(0) + numActive,
+				 fn);
 	    }}
-
+	    numUpdate += numActive;
+	    iter++;
+	    
+	    // remove the converged frames
 	    {{
-		internal::ComputeMixtureError fn;
-		fn.startD       = this->m_startDim;
-		fn.startDOut    = this->m_startDimOut;
-		fn.mixture_num  = this->m_numMixture;
-		fn.featureDim   = this->m_featureDim;
-		fn.layerSizeOut = this->m_layerSizeTar;
-		fn.tieVar       = this->m_tieVar;
-		
-		fn.meanDis   = helpers::getRawPointer(this->m_tmpPat);
-		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
+		internal::EMGenConverged fn;
+		fn.convFlag = helpers::getRawPointer(m_emConverged);
+		numActive = (thrust::remove_if(m_emActive.begin(),
+					       m_emActive.begin() + numActive, fn) -
+			     m_emActive.begin());
+	    }}
+	    printf("\t\t EM iteration %d: %d of %d frames not converged\n",
+		   iter, numActive, numFrame);
+	}
 
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
+	{{
+		internal::EMGenLikelihood fn;
+		fn.mixtureNM = this->m_numMixture;
+		fn.totalTime = totalTime;
+		fn.postP     = helpers::getRawPointer(this->m_tmpPat);
 		
-		fn.totalTime = n;
-
-		outP = thrust::transform_reduce(
+		real_t outP = thrust::transform_reduce(
 			     thrust::make_zip_iterator(
 				  thrust::make_tuple(this->m_precedingLayer.patTypes().begin(), 
 						     thrust::counting_iterator<int>(0))),
 			     thrust::make_zip_iterator(
-				  thrust::make_tuple(this->m_precedingLayer.patTypes().begin()+n, 
-						     thrust::counting_iterator<int>(0)+n)),
+				  thrust::make_tuple(this->m_precedingLayer.patTypes().begin()+totalTime, 
+						     thrust::counting_iterator<int>(0)+totalTime)),
 			     fn,
 			     (real_t)0.0,
 			     thrust::plus<real_t>());
@@ -4896,55 +4601,12 @@ namespace layers {
 		if (outP != outP){
 		    printf("\t\t Fail to converge\n");
 		}else{
-		    printf("\t\t Output likelihood/dim (-log): %f\n", outP/n/this->m_featureDim);
-		}
-
-		#ifdef DEBUG_LOCAL
-		
-		Cpu::real_vector tvec1;
-		Cpu::real_vector tvec2;
-		tvec1 = this->m_paraVec;
-		tvec2 = this->m_tmpPat;
-		for (int t = 0; t < n; t++){
-		    real_t tmp=-1e30;
-		    real_t tmptmp;
-		    
-		    int meanPos = t * fn.mixture_num;
-		    int mixPos  = t * fn.mixture_num;
-		    int varPos  = fn.totalTime*(fn.mixture_num+fn.mixture_num*fn.featureDim)+
-			t * fn.mixture_num * (this->m_tieVar?1:fn.featureDim);
-		    
-		    for (int i = 0; i<fn.mixture_num; i++){
-			
-			tmptmp = std::log(tvec1[mixPos+i])-(tvec2[meanPos+i]);
-			tmptmp = tmptmp - fn.featureDim/2*std::log(2*PI_DEFINITION);
-			// change this line according to ALTER_TIEVAR
-			//tmptmp = tmptmp - fn.featureDim*std::log(tvec1[varPos]);
-			if (this->m_tieVar)
-			    tmptmp = tmptmp - fn.featureDim*std::log(tvec1[varPos+i]);
-			else{
-			    for (int j = 0; j<fn.featureDim; j++)
-				tmptmp = tmptmp - std::log(tvec1[varPos+i*fn.featureDim+j]);
-			}
-			    
-			//tmptmp = std::exp(tmptmp);
-			tmp   = internal::logAdd(tmp, tmptmp);
-			printf("%f\t", tmptmp);
-			printf("%f\t", tvec2[t*fn.mixture_num + i]);
-		    }
-		    printf("%f \n", tvec2[fn.totalTime*fn.mixture_num + t]);
-		    printf("%f \n", tmp);
+		    printf("\t\t Output likelihood/dim (-log): %f\n",
+			   outP/totalTime/this->m_featureDim);
 		}
-		
-		#endif
-
-	    }}
-	    iter++;
-	    
-	    if (iter >= config.EMIterNM())
-		finish = true;
-	}
-	
+		printf("\t\t EM iterations: %d, frame updates: %d (%.2f per frame)\n",
+		       iter, numUpdate, (numFrame > 0) ? ((real_t)numUpdate / numFrame) : 0.0);
+	}}
     }
 
     template <typename TDevice>
@@ -4957,19 +4619,9 @@ namespace layers {
 	
 	Cpu::real_vector temp;
 	real_vector temp2;
-	temp.reserve(time);
 	
-	const Configuration &config = Configuration::instance();
-
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed());
-	}
-	
-	boost::random::normal_distribution<real_t> dist(0, 1);
-	for (size_t i = 0; i < time; ++i)
-	    temp.push_back(dist(*gen));
+	// Modify 20181018: no static engine shared by the generation threads
+	this->_samplingNoise(temp, time, 0);
 
 			
 	// copy to GPU
@@ -5042,26 +4694,20 @@ namespace layers {
 
 	int oneTimeStep = (this->m_precedingLayer.parallelSequences()
 			   *(this->m_endDimOut - this->m_startDimOut));
+
+	// Modify 20181018: the frame index in m_paraVec (see computeForward(timeStep))
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int fb = this->paraVecFrameBias(ts);
 	
-	int fs = timeStep * oneTimeStep;
+	int fs = (ts - fb) * (this->m_endDimOut - this->m_startDimOut);
 	int fe = fs       + oneTimeStep;
 	
 
 	Cpu::real_vector temp;
 	real_vector temp2;
-	temp.reserve(oneTimeStep);
-	
-	const Configuration &config = Configuration::instance();
-
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed());
-	}
 	
-	boost::random::normal_distribution<real_t> dist(0, 1);
-	for (size_t i = 0; i < oneTimeStep; ++i)
-	    temp.push_back(dist(*gen));
+	// Modify 20181018: no static engine shared by the generation threads
+	this->_samplingNoise(temp, oneTimeStep, timeStep + 1);
 
 			
 	// copy to GPU
@@ -5072,22 +4718,21 @@ namespace layers {
 		fn.layerSizeOut = this->m_layerSizeTar;
 		fn.startDOut    = this->m_startDimOut;
 		fn.mixtureNum   = this->m_numMixture;
-		fn.totalTime    = (int)(this->m_precedingLayer.curMaxSeqLength() * 
-					this->m_precedingLayer.parallelSequences());
+		fn.totalTime    = this->paraVecFrames();
 		fn.para         = para;
 		fn.paraPtr      = ( (this->m_varScale.size()>0) ?
 				    (helpers::getRawPointer(this->m_varScale)) : NULL );
-		fn.targets      = helpers::getRawPointer(targets);
+		fn.targets      = helpers::getRawPointer(targets) + fb * this->m_layerSizeTar;
 		fn.mdnPara      = helpers::getRawPointer(this->m_paraVec);
 		fn.tieVar       = this->m_tieVar;
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + fb;
 		
 		thrust::for_each(
   			 thrust::make_zip_iterator(
-			     thrust::make_tuple(temp2.begin()+fs, 
+			     thrust::make_tuple(temp2.begin(), 
 						thrust::counting_iterator<int>(0)+fs)),
 		         thrust::make_zip_iterator(
-			     thrust::make_tuple(temp2.begin()+fe, 
+			     thrust::make_tuple(temp2.begin()+oneTimeStep, 
 						thrust::counting_iterator<int>(0)+fe)),
 			 fn);		
 	}}	
@@ -5128,128 +4773,71 @@ namespace layers {
     template <typename TDevice>
     void MDNUnit_mixture<TDevice>::getParameter(const int timeStep, real_t *targets)
     {
-	int fs = timeStep * this->m_precedingLayer.parallelSequences();
-	int fe = fs       + this->m_precedingLayer.parallelSequences();
+	// Modify 20181018: the frame index in m_paraVec (see computeForward(timeStep))
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	int fb = this->paraVecFrameBias(ts);
+	int fs = ts - fb;
+	int fe = fs + this->m_precedingLayer.parallelSequences();
 	{{
 		internal::GetParameterMixture fn;
-		int time = this->m_precedingLayer.curMaxSeqLength();
-		time = time*this->m_precedingLayer.parallelSequences();
-		fn.targets      = targets;
-		fn.featureDim   = this->m_featureDim;
-		fn.NNOutputSize = this->m_precedingLayer.size();
-		fn.startDimIn   = this->m_startDim;
-		fn.mixtureNum   = this->m_numMixture;
-		fn.totalTime    = time;
-		fn.targets      = targets;
-		fn.mdnPara      = helpers::getRawPointer(this->m_paraVec);
-		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.tieVar       = this->m_tieVar;
-		thrust::for_each(
-  		  thrust::make_zip_iterator(
-		       thrust::make_tuple(this->m_paraVec.begin()+fs, 
-					  thrust::counting_iterator<int>(0)+fs)),
-  		  thrust::make_zip_iterator(
-		       thrust::make_tuple(this->m_paraVec.begin() + fe, 
-					  thrust::counting_iterator<int>(0)+fe)),
-		  fn);
-	}}
-    }
-
-
-    template <typename TDevice>
-    real_t MDNUnit_mixture<TDevice>::calculateError(real_vector &targets)
-    {   
-	
-	// step1: calculate the sum_dim (t_n_d - \mu_d_k)^2
-	// and save the result to m_tmpPat[0 : totalTime*mixture_num]
-	{{
-		internal::ComputeMixtureDistance fn;
-		fn.startDOut   = this->m_startDimOut;
-		fn.mixture_num = this->m_numMixture;
-		fn.featureDim  = this->m_featureDim;
-		fn.layerSizeOut= this->m_layerSizeTar;
-		fn.tieVar      = this->m_tieVar;
-
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.output    = helpers::getRawPointer(targets);
-		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
-
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
-		fn.totaltime = n;
-		n = n*this->m_numMixture;
-
-		thrust::transform(thrust::counting_iterator<int>(0),
-				  thrust::counting_iterator<int>(0)+n,
-				  this->m_tmpPat.begin(),
-				  fn);		
-
-                #ifdef DEBUG_LOCAL
-		Cpu::real_vector temp_vec1;
-		Cpu::real_vector temp_vec2;
-		Cpu::real_vector temp_vec3;
-		temp_vec1 = this->m_paraVec;
-		temp_vec2 = targets;
-		temp_vec3 = this->m_tmpPat;
-		printf("MixtureDistance: data, mean, var (one dimension), dis_over_dim\n");
-		for (int t = 0; t < n; t++){
-		    real_t tmp=0.0;
-		    real_t tmptmp;
-
-		    int timeStep = (t/fn.mixture_num);
-		    int mixIndex = (t%fn.mixture_num);
-		    int pos_data = fn.layerSizeOut * timeStep + fn.startDOut;
-		    int pos_mean = fn.totaltime * fn.mixture_num + 
-			timeStep*fn.featureDim*fn.mixture_num+mixIndex*fn.featureDim;
-		    int pos_var  = fn.totaltime * (fn.mixture_num + 
-						   fn.mixture_num * fn.featureDim) +
-			timeStep*fn.mixture_num + mixIndex;
-		    if (!this->m_tieVar){
-			pos_var = fn.totaltime * (fn.mixture_num + 
-						  fn.mixture_num * fn.featureDim) +
-			    (timeStep*fn.mixture_num+mixIndex)*fn.featureDim;
-		    }
-		    for (int i = 0; i<fn.featureDim; i++){
-			tmp += (temp_vec2[pos_data+i] - temp_vec1[pos_mean+i]) * 
-			    (temp_vec2[pos_data+i] - temp_vec1[pos_mean+i])
-			    /(temp_vec1[pos_var + (fn.tieVar?0:i)])
-			    /(temp_vec1[pos_var + (fn.tieVar?0:i)])/2;
-		    }
-		    printf("%03.4f %03.4f %03.4e %03.4e\t", 
-			   temp_vec2[pos_data], temp_vec1[pos_mean], 
-			   temp_vec1[pos_var+mixIndex], tmp);
-		    if (mixIndex==(fn.mixture_num - 1))
-			printf("\n");
-		}
-		printf("\nEnd\n");
-                #endif
-
+		fn.targets      = targets;
+		fn.featureDim   = this->m_featureDim;
+		fn.NNOutputSize = this->m_precedingLayer.size();
+		fn.startDimIn   = this->m_startDim;
+		fn.mixtureNum   = this->m_numMixture;
+		fn.totalTime    = this->paraVecFrames();
+		fn.targets      = targets + fb * this->m_precedingLayer.size();
+		fn.mdnPara      = helpers::getRawPointer(this->m_paraVec);
+		fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + fb;
+		fn.tieVar       = this->m_tieVar;
+		thrust::for_each(
+  		  thrust::make_zip_iterator(
+		       thrust::make_tuple(this->m_paraVec.begin()+fs, 
+					  thrust::counting_iterator<int>(0)+fs)),
+  		  thrust::make_zip_iterator(
+		       thrust::make_tuple(this->m_paraVec.begin() + fe, 
+					  thrust::counting_iterator<int>(0)+fe)),
+		  fn);
 	}}
-	
+    }
+
 
-	// step2: calcualte the - log likelihood
-	//     save w_i p_i to m_tmpPat[0 : totalTime*mixture_num]
-	// and save the sum_i^mixture_num w_i p_i to m_tmpPat[totalTime*mixture_num:end]
+    template <typename TDevice>
+    real_t MDNUnit_mixture<TDevice>::calculateError(real_vector &targets)
+    {   
+	// calculate the - log likelihood
+	//     save log w_i p_i to m_tmpPat[0 : totalTime*mixture_num]
+	// and save log sum_i^mixture_num w_i p_i to m_tmpPat[totalTime*mixture_num:end]
 	//     (for both likelihood calculation and back-propagation)
 	real_t mixError = 0.0;
 	{{
-		internal::ComputeMixtureError fn;
-		fn.startD       = this->m_startDim;
+		int n =this->m_precedingLayer.curMaxSeqLength();
+		n = n*this->m_precedingLayer.parallelSequences();
+
+		// Modify 20181018: log w_i phi_i of each (frame, mixture) in parallel,
+		//  then the log-sum-exp over the mixtures of each frame
+		internal::ComputeMixtureLikelihood fn;
 		fn.startDOut    = this->m_startDimOut;
 		fn.mixture_num  = this->m_numMixture;
 		fn.featureDim   = this->m_featureDim;
 		fn.layerSizeOut = this->m_layerSizeTar;
 		fn.tieVar       = this->m_tieVar;
+		fn.totalTime    = n;
 
-		fn.meanDis   = helpers::getRawPointer(this->m_tmpPat);
+		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+		fn.target    = helpers::getRawPointer(targets);
 		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
-
-		int n =this->m_precedingLayer.curMaxSeqLength();
-		n = n*this->m_precedingLayer.parallelSequences();
+		fn.meanDis   = helpers::getRawPointer(this->m_tmpPat);
 		
-		fn.totalTime = n;
+		thrust::for_each(thrust::counting_iterator<int>(0),
+				 thrust::counting_iterator<int>(0) + n * this->m_numMixture,
+				 fn);
 
-                #ifndef DEBUG_LOCAL
+		internal::ComputeMixtureLogSumExp fn2;
+		fn2.mixture_num = this->m_numMixture;
+		fn2.totalTime   = n;
+		fn2.meanDis     = helpers::getRawPointer(this->m_tmpPat);
+		
 		mixError = thrust::transform_reduce(
 			     thrust::make_zip_iterator(
 				  thrust::make_tuple(this->m_precedingLayer.patTypes().begin(), 
@@ -5257,60 +4845,9 @@ namespace layers {
 			     thrust::make_zip_iterator(
 				  thrust::make_tuple(this->m_precedingLayer.patTypes().begin()+n, 
 						     thrust::counting_iterator<int>(0)+n)),
-			     fn,
+			     fn2,
 			     (real_t)0.0,
 			     thrust::plus<real_t>());
-                #endif
-
-                #ifdef DEBUG_LOCAL
-		Cpu::real_vector tvec1;
-		Cpu::real_vector tvec2;
-		tvec1 = this->m_paraVec;
-		tvec2 = this->m_tmpPat;
-		printf("Calculate Error (each time step): each mixture, sum\n");
-		for (int t = 0; t < n; t++){
-		    real_t tmp=-1e30;
-		    real_t tmptmp;
-		    
-		    int meanPos = t * fn.mixture_num;
-		    int mixPos  = t * fn.mixture_num;
-		    int varPos  = fn.totalTime*(fn.mixture_num+fn.mixture_num*fn.featureDim)+
-			t * fn.mixture_num;
-		    
-		    if (!this->m_tieVar){
-			varPos  = fn.totalTime*(fn.mixture_num+fn.mixture_num*fn.featureDim)+
-			t * fn.mixture_num * fn.featureDim;
-		    
-		    }
-
-		    for (int i = 0; i<fn.mixture_num; i++){
-			
-			tmptmp = std::log(tvec1[mixPos+i])-(tvec2[meanPos+i]);
-			tmptmp = tmptmp - fn.featureDim/2*std::log(2*PI_DEFINITION);
-			if (this->m_tieVar)
-			    tmptmp = tmptmp - fn.featureDim*std::log(tvec1[varPos+i]);
-			else{
-			    for(int j = 0 ; j<fn.featureDim; j++)
-				tmptmp = tmptmp - std::log(tvec1[varPos+i*fn.featureDim+j]);
-			}
-			
-			if (tmptmp!=tmptmp || tmptmp < -0.5e10f){
-			    tmptmp = -0.5e10f;
-			}
-			//tmptmp = std::exp(tmptmp);
-			tmp   = internal::logAdd(tmp, tmptmp);
-			//printf("%f\t", tvec2[t*fn.mixture_num + i]);
-			printf("%f\t", tmptmp);
-			tvec2[t*fn.mixture_num + i] = tmptmp;
-		    }
-		    //printf("%f \n", tvec2[fn.totalTime*fn.mixture_num + t]);
-		    printf("%f \n", tmp);
-		    tvec2[fn.totalTime*fn.mixture_num + t] = tmp;
-		    mixError -= tmp;
-		}
-		printf("Error done\n");
-		this->m_tmpPat = tvec2;
-                #endif
 	}}
 	return mixError;
     }                
@@ -5318,88 +4855,16 @@ namespace layers {
     template <typename TDevice>
     void MDNUnit_mixture<TDevice>::computeBackward(real_vector &targets, const int flag)
     {                          
+	// Note: outputErrors should not be reset here, which will wipe up the
+	//       gradients of the previous MDNUnit.
 	
-	// clean the outputErrors
-	{{
-		// In the original case, each dimension in outputErrors will be assigned new value
-		// Thus, no need to reset outputErrors
-		// However, for updating the variance here, we accumulate the gradients.
-		// Thus, need to reset outputErrors
-		// thrust::fill(this->m_precedingLayer.outputErrors().begin(),
-		//              this->m_precedingLayer.outputErrors().end(),
-		//	        (real_t)0.0);
-		
-		// 
-		// STUPID ERROR !!! Reset outputErrors in each computeBackward will wipe
-		// up the gradients of previous MDNUnit.
-	}}
-	
-
-	// step1: update the mixture weight
-	{{
-		internal::ComputeBPmixtureWeight fn;
-		fn.mixture_num = this->m_numMixture;
-		fn.NNOutputSize= this->m_precedingLayer.size();
-		fn.startD      = this->m_startDim;
-		fn.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		fn.meanDis   = helpers::getRawPointer(this->m_tmpPat);
-		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
-		fn.errors    = helpers::getRawPointer(this->m_precedingLayer.outputErrors());
-		
-
-		int n = this->m_precedingLayer.curMaxSeqLength();
-		n     = n * this->m_precedingLayer.parallelSequences();
-		
-		fn.totalTime = n;
-		n     = n * this->m_numMixture;
-		thrust::for_each(
-			 thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin(), 
-						thrust::counting_iterator<int>(0))),
-		         thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin()+n, 
-						thrust::counting_iterator<int>(0)+n)),	 
-			 fn);
-
-                #ifdef DEBUG_LOCAL
-		printf("Gradient for mixture weight\n");
-		Cpu::real_vector mdnPara = this->m_paraVec;
-		Cpu::real_vector meanDis = this->m_tmpPat;
-		Cpu::real_vector errors  = this->m_precedingLayer.outputErrors();
-		for (int i = 0; i<n; i++){
-		    int outputIdx = i;
-		    const int timeStep = outputIdx / fn.mixture_num;
-		    const int mixtureI = (outputIdx % fn.mixture_num);
-
-		    // to the posterior 
-		    const int postP  = timeStep * fn.mixture_num + mixtureI;
-		    const int sumPost= fn.totalTime * fn.mixture_num + timeStep;
-
-		    // to the output of MDN (mixture weight)
-		    int pos = timeStep * fn.mixture_num + mixtureI;
-		    const real_t sigma  = mdnPara[pos];
-
-		    // Time, gradient
-		    // store the gradients
-		    pos = timeStep * fn.NNOutputSize + fn.startD + mixtureI;
-		    if (mixtureI == fn.mixture_num - 1){
-			printf("(only last dim) %d %f\t", 
-			       timeStep, sigma - std::exp(meanDis[postP]-meanDis[sumPost]));
-			printf("\n");
-		    }
-		}
-		printf("GrafEnd\n");
-                #endif
-
-		
-	}}
-	
-	// step2: update the mixture mean and variance
+	// gradients w.r.t. the mixture weight, mean and variance (one pass over
+	// the (frame, mixture) pairs)
+	// the posterior is given by m_tmpPat, which is filled in calculateError
 	{{
-
-		internal::ComputeBPmixtureMeanVariance fn;
+		internal::ComputeBPmixture fn;
 		fn.layerSize    = this->m_precedingLayer.size();
-		fn.startD       = this->m_startDim + this->m_numMixture;
+		fn.startD       = this->m_startDim;
 		fn.startDOut    = this->m_startDimOut;
 		fn.layerSizeOut = this->m_layerSizeTar;
 		fn.featureDim   = this->m_featureDim;
@@ -5414,128 +4879,15 @@ namespace layers {
 		fn.mdnPara   = helpers::getRawPointer(this->m_paraVec);
 		fn.errors    = helpers::getRawPointer(this->m_precedingLayer.outputErrors());
 		fn.target    = helpers::getRawPointer(targets);
-		fn.varBuff   = helpers::getRawPointer(this->m_varBP);
-
 
-		
 		int n =this->m_precedingLayer.curMaxSeqLength();
 		n = n*this->m_precedingLayer.parallelSequences();
-		
 		fn.totalTime = n;
-		n = n * this->m_numMixture * this->m_featureDim;
- 		thrust::for_each(
-			 thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin(), 
-						thrust::counting_iterator<int>(0))),
-		         thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin()+n, 
-						thrust::counting_iterator<int>(0)+n)),
-			 fn);
-		
-		// For untied case, the gradients have been assigned to individual dimension
-		// no need to merge the gradients for tiedVariance
-		if (this->m_tieVar){
-		    internal::ComputeBPAccumVariance fn2;
-		    fn2.layerSize   = this->m_precedingLayer.size();
-		    fn2.startD      = this->m_startDim + this->m_numMixture;
-		    fn2.featureDim  = this->m_featureDim;
-		    fn2.mixture_num = this->m_numMixture;
-
-		    fn2.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
-		    fn2.errors    = helpers::getRawPointer(this->m_precedingLayer.outputErrors());
-		    fn2.varBuff   = helpers::getRawPointer(this->m_varBP);
-
-		    n =this->m_precedingLayer.curMaxSeqLength();
-		    n = n*this->m_precedingLayer.parallelSequences();		
-		    thrust::for_each(
-			 thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin(), 
-						thrust::counting_iterator<int>(0))),
-		         thrust::make_zip_iterator(
-			     thrust::make_tuple(this->m_paraVec.begin()+n, 
-						thrust::counting_iterator<int>(0)+n)),
-			 
-				     fn2);
-		}
-		
-                #ifdef DEBUG_LOCAL
-		
-		Cpu::real_vector errors = this->m_precedingLayer.outputErrors();
-		Cpu::real_vector mdnPara= this->m_paraVec;
-		Cpu::real_vector meanDis= this->m_tmpPat;
-		Cpu::real_vector target = targets;
-		Cpu::real_vector varBuf = this->m_varBP;
-		Cpu::real_vector errorVBuf;
-		real_t errorm(0.0), errorv(0.0);
-		printf("Gradient for mean and variance of each mixture: time errorm errorv ...\n");
-		n = fn.totalTime * this->m_numMixture * this->m_featureDim;
-		
-		errorVBuf.resize(n, 0.0);
-		for (int i = 0; i<n; i++){
-		    int outputIdx = i;
-		    const int timeStep = outputIdx / (fn.mixture_num * fn.featureDim);
-
-		    const int tmp = outputIdx % (fn.mixture_num * fn.featureDim);
-		    const int mixtureI = tmp / fn.featureDim;
-		    const int featureI = tmp % fn.featureDim;
-	    
-		    // pointer to the mean gradient
-		    int meanshift_error = timeStep*fn.layerSize+fn.startD+
-			mixtureI*fn.featureDim + featureI;
-		    //real_t errorm = errors[meanshift_pos];
-
-		    //real_t errorv = errors[varshift];
-	    
-		    // pointer to the target data y
-		    const real_t tardata= target[timeStep*fn.layerSizeOut+fn.startDOut+featureI];
-
-		    // pointer to the mean
-		    int meanshift= fn.totalTime * fn.mixture_num + 
-			timeStep * fn.mixture_num * fn.featureDim + 
-			mixtureI * fn.featureDim + 
-			featureI;
-		    
-		    int varshift = fn.tieVar?
-			(fn.totalTime * fn.mixture_num * (1 + fn.featureDim) + 
-			 timeStep * fn.mixture_num + mixtureI):
-			(fn.totalTime * fn.mixture_num * (1 + fn.featureDim) + 
-			 (timeStep * fn.mixture_num + mixtureI)*fn.featureDim + featureI);
-	    
-		    const real_t mean  = mdnPara[meanshift];
-		    const real_t var   = mdnPara[varshift];
-
-		    // pointer to the posterior P and sum of posterior P
-		    const real_t postP = meanDis[timeStep * fn.mixture_num + mixtureI];
-		    const real_t sumPost=meanDis[fn.totalTime* fn.mixture_num + timeStep];
-		    real_t posterior = internal::safeExp((postP) - (sumPost));
-		    (errorm) = posterior*(mean - tardata)/(var)/(var);
-		    
-		    (errorv) += posterior - (errorm)*(mean - tardata);
-		    
-		    errorVBuf[i] = posterior - (errorm)*(mean - tardata);
-		    /*if (errorVBuf[i]<-5 || errorVBuf[i]>5)
-		      printf("get");*/
-		    if (mixtureI == 0 && featureI ==0)
-			printf("%d\t", timeStep);
-		    if (featureI==fn.featureDim - 1){
-			printf("%d %3.4f %3.4f \t\t", mixtureI, errorm, errorv); 
-			/*if (errorv > 100 || errorv < -100.0){
-			    printf("get");
-			    for (int j=0; j<fn.featureDim; j++)
-				printf("%3.4f ", errorVBuf[i-j]);
-				}*/
-			errorv = 0;
-			if (mixtureI==(fn.mixture_num - 1)){
-			    printf("\n");
-			}
-		    }
-		}
 		
-		printf("GrafEnd\n");
-                #endif
-
+ 		thrust::for_each(thrust::counting_iterator<int>(0),
+				 thrust::counting_iterator<int>(0) + n * this->m_numMixture,
+				 fn);
 	}}
-
     }
     
     template <typename TDevice>
@@ -5588,37 +4940,40 @@ namespace layers {
 						    const int dimStart, real_vector &targets,
 						    const int timeStep, const int method)
     {
+	// Modify 20181018: the pointers are moved to the current frame, so that
+	//  m_paraVec can be reduced in memory
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	
 	internal::CopyPart fn;
-	fn.target = helpers::getRawPointer(fillBuffer);
+	fn.target = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 	fn.tarDim = bufferDim;
 	fn.tarS   = dimStart;
-	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 	
 	if (this->m_feedBackType == MDNUNIT_FEEDBACK_OPT_0){
 	    // skip the mixture weight part
-	    int shift = (this->m_precedingLayer.curMaxSeqLength() * 
-			 this->m_precedingLayer.parallelSequences() * this->m_numMixture);
-	    fn.source = helpers::getRawPointer(this->m_paraVec) + shift;
+	    int shift = this->paraVecFrames() * this->m_numMixture;
+	    fn.source = (helpers::getRawPointer(this->m_paraVec) + shift +
+			 (ts - this->paraVecFrameBias(ts)) * (this->m_endDimOut - this->m_startDimOut));
 	    fn.srcDim = (this->m_endDimOut - this->m_startDimOut);
 	    fn.srcS   = 0;
 	    fn.copyDim= (this->m_endDimOut - this->m_startDimOut);
 	}else{
-	    fn.source = helpers::getRawPointer(targets);
+	    fn.source = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
 	    fn.srcDim = this->m_layerSizeTar;
 	    fn.srcS   = this->m_startDimOut;
 	    fn.copyDim= (this->m_endDimOut - this->m_startDimOut);
 	}
 	
-	int ts = (timeStep * this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	int te = (ts  +      this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	
+	// m_paraVec (one frame at least) is only used to count the elements 
+	int n = this->m_precedingLayer.parallelSequences() * fn.copyDim;
 	thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + ts, 
-					   thrust::counting_iterator<int>(0) + ts)),
+			thrust::make_tuple(this->m_paraVec.begin(), 
+					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + te, 
-					   thrust::counting_iterator<int>(0) + te)),
+			thrust::make_tuple(this->m_paraVec.begin() + n, 
+					   thrust::counting_iterator<int>(0) + n)),
 		fn);
     }
 
@@ -5628,6 +4983,12 @@ namespace layers {
 	return (this->m_endDimOut - this->m_startDimOut);
     }
 
+    template <typename TDevice>
+    bool MDNUnit_mixture<TDevice>::flagStepInputShift()
+    {
+	return true;
+    }
+
     /********************************************************
      MDNUnit_mixture_dyn Definition
     *******************************************************/
@@ -5966,6 +5327,7 @@ namespace layers {
 			
 			fn2.mdnPara      = helpers::getRawPointer(this->m_paraVec);
 			fn2.stepBack     = stepBack;
+			fn2.frameBias    = 0;
 			
 			fn2.trainableAPos= -1;   // this is useful for mxiture_dynSqr
 			fn2.trainableBPos= -1;   // this is useful for mxiture_dynSqr
@@ -6399,15 +5761,8 @@ namespace layers {
 	Cpu::real_vector tempRandom(datapoint, 0.0);
 	real_vector randomSeedBuff;
 	
-	const Configuration &config = Configuration::instance();
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed());
-	}
-	boost::random::normal_distribution<real_t> dist(0, 1);
-	for (size_t i = 0; i < datapoint; ++i)
-	    tempRandom[i] = (dist(*gen));
+	// Modify 20181018: no static engine shared by the generation threads
+	this->_samplingNoise(tempRandom, datapoint, 0);
 	randomSeedBuff = tempRandom;	
 	
 	
@@ -6459,6 +5814,7 @@ namespace layers {
 			fn2.biasPart = this->m_weightsPtr+this->m_featureDim*this->m_backOrder;    
 			fn2.mdnPara      = helpers::getRawPointer(this->m_paraVec);
 			fn2.stepBack     = stepBack;
+			fn2.frameBias    = 0;
 			
 			fn2.trainableAPos= -1;   // this is not useful for mxiture_dynSqr
 			fn2.trainableBPos= -1;   // this is not useful for mxiture_dynSqr
@@ -6545,84 +5901,70 @@ namespace layers {
 						 const real_t para,real_vector &targets)
     {
 	
-	
-	int time                = this->m_precedingLayer.curMaxSeqLength();
 	int datapointerperFrame = ((this->m_endDimOut - this->m_startDimOut) * 
 				   this->m_precedingLayer.parallelSequences());
-	int datapoint           = time * datapointerperFrame;
-	
-	int fs = timeStep * datapointerperFrame;
-	int fe = fs       + datapointerperFrame;
-
 
 	this->m_paral     = this->m_precedingLayer.parallelSequences();
 	this->m_totalTime = this->m_precedingLayer.curMaxSeqLength() * this->m_paral;
 
+	// Modify 20181018: only the frames of timeStep are processed, and the frame
+	//  index in m_paraVec is shifted as in MDNUnit_mixture::computeForward(timeStep)
+	int ts = timeStep * this->m_paral;
+	int fb = this->paraVecFrameBias(ts);
+	int fs = ts - fb;
+	int fe = fs + this->m_paral;
 	
 	// initialize the random number
-	Cpu::real_vector tempRandom(datapoint, 0.0);
+	Cpu::real_vector tempRandom;
 	real_vector randomSeedBuff;
 	
-	const Configuration &config = Configuration::instance();
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed());
-	}
-	boost::random::normal_distribution<real_t> dist(0, 1);
-	for (size_t i = 0; i < datapointerperFrame; ++i)
-	    tempRandom[i] = (dist(*gen));
+	// Modify 20181018: no static engine shared by the generation threads
+	this->_samplingNoise(tempRandom, datapointerperFrame, timeStep + 1);
 	randomSeedBuff = tempRandom;	
 	
-	
-	// get the MDN parameter 
-	int startPos = 0;
-	int endPos   = 0;
-	for (int i = fs; i < fe; i++)
-	{{
-	    
-	    // Step1. for each time step, change the mean of the distribution
-	    // Note:
-	    //    computeForwardPass() is conducted before getOutput()
-	    //    hence, no need to transform the tanh(alpha) to AR parameter
-	    
-	    if (this->m_dynDirection == MDNUNIT_TYPE_1_DIRECT || 
-		this->m_dynDirection == MDNUNIT_TYPE_1_DIRECB ){
+	// Step1. change the mean of the distribution
+	// Note:
+	//    computeForwardPass() is conducted before getOutput()
+	//    hence, no need to transform the tanh(alpha) to AR parameter
+	if (this->m_dynDirection == MDNUNIT_TYPE_1_DIRECT || 
+	    this->m_dynDirection == MDNUNIT_TYPE_1_DIRECB ){
 		
-		// AR along the time axis
-		for (int stepBack = 1; stepBack <= this->m_backOrder; stepBack++){
+	    // AR along the time axis
+	    for (int stepBack = 1; stepBack <= this->m_backOrder; stepBack++){
 		    
-                    #ifdef MIXTUREDYNDIAGONAL
-		    if (i >= stepBack){    
-			// one step to calculate wo_t1 + b, change the mean value
-			internal::ChangeMeanofMDN fn2;
-			fn2.startDOut    = this->m_startDimOut;
-			fn2.featureDim   = this->m_featureDim;
-			fn2.layerSizeOut = this->m_layerSizeTar;
-			fn2.mixNum       = this->m_numMixture;
-			fn2.totalTime    = this->m_totalTime;
-			fn2.targets      = helpers::getRawPointer(targets);
-			fn2.paral        = this->m_paral;
-			fn2.patTypes  = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+                #ifdef MIXTUREDYNDIAGONAL
+		if (timeStep >= stepBack){    
+		    // one step to calculate wo_t1 + b, change the mean value
+		    internal::ChangeMeanofMDN fn2;
+		    fn2.startDOut    = this->m_startDimOut;
+		    fn2.featureDim   = this->m_featureDim;
+		    fn2.layerSizeOut = this->m_layerSizeTar;
+		    fn2.mixNum       = this->m_numMixture;
+		    fn2.totalTime    = this->paraVecFrames();
+		    fn2.targets      = helpers::getRawPointer(targets) + fb * this->m_layerSizeTar;
+		    fn2.paral        = this->m_paral;
+		    fn2.patTypes     = (helpers::getRawPointer(this->m_precedingLayer.patTypes()) +
+					fb);
 			
-		       if(this->m_tanhReg){
-			    fn2.linearPart= helpers::getRawPointer(this->m_wTransBuff) + 
-				stepBack * this->m_featureDim;
-			}else{
-			    fn2.linearPart= this->m_weightsPtr+(stepBack-1)*this->m_featureDim;
-			}
+		    if(this->m_tanhReg){
+			fn2.linearPart= helpers::getRawPointer(this->m_wTransBuff) + 
+			    stepBack * this->m_featureDim;
+		    }else{
+			fn2.linearPart= this->m_weightsPtr+(stepBack-1)*this->m_featureDim;
+		    }
 
-			fn2.biasPart = this->m_weightsPtr+this->m_featureDim*this->m_backOrder;    
-			fn2.mdnPara      = helpers::getRawPointer(this->m_paraVec);
-			fn2.stepBack     = stepBack;
+		    fn2.biasPart = this->m_weightsPtr+this->m_featureDim*this->m_backOrder;    
+		    fn2.mdnPara      = helpers::getRawPointer(this->m_paraVec);
+		    fn2.stepBack     = stepBack;
+		    fn2.frameBias    = fb;
 			
-			fn2.trainableAPos= -1;   // this is not useful for mxiture_dynSqr
-			fn2.trainableBPos= -1;   // this is not useful for mxiture_dynSqr
+		    fn2.trainableAPos= -1;   // this is not useful for mxiture_dynSqr
+		    fn2.trainableBPos= -1;   // this is not useful for mxiture_dynSqr
 
-			startPos     = i     * this->m_numMixture * this->m_featureDim;
-			endPos       = (i+1) * this->m_numMixture * this->m_featureDim;
+		    int startPos = fs * this->m_numMixture * this->m_featureDim;
+		    int endPos   = fe * this->m_numMixture * this->m_featureDim;
 		    
-			thrust::for_each(
+		    thrust::for_each(
 			  thrust::make_zip_iterator(
 			    thrust::make_tuple(this->m_paraVec.begin() + startPos, 
 					       thrust::counting_iterator<int>(0)+ startPos)),
@@ -6630,35 +5972,36 @@ namespace layers {
 			    thrust::make_tuple(this->m_paraVec.begin() + endPos, 
 					       thrust::counting_iterator<int>(0) + endPos)),
 			  fn2);	
-		    }
-                    #endif
 		}
+                #endif
 	    }
+	}
 	    
-	    // Step2. Sampling
+	// Step2. Sampling
+	{{
 	    internal::SamplingMixture fn;
 	    fn.featureDim   = this->m_featureDim;
 	    fn.layerSizeOut = this->m_layerSizeTar;
 	    fn.startDOut    = this->m_startDimOut;
 	    fn.mixtureNum   = this->m_numMixture;
-	    fn.totalTime    = time * this->m_precedingLayer.parallelSequences();
+	    fn.totalTime    = this->paraVecFrames();
 	    fn.para         = para;
 	    fn.paraPtr      = ( (this->m_varScale.size()>0) ?
 				(helpers::getRawPointer(this->m_varScale)) : NULL );
-	    fn.targets      = helpers::getRawPointer(targets);
+	    fn.targets      = helpers::getRawPointer(targets) + fb * this->m_layerSizeTar;
 	    fn.mdnPara      = helpers::getRawPointer(this->m_paraVec);
 	    fn.tieVar       = this->m_tieVar;
-	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	    fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + fb;
 	    
-	    startPos    = i     * datapointerperFrame;
-	    endPos      = (i+1) * datapointerperFrame;
+	    int startPos    = fs * this->m_featureDim;
 	    thrust::for_each(
 		  thrust::make_zip_iterator(
-			thrust::make_tuple(randomSeedBuff.begin() + startPos, 
+			thrust::make_tuple(randomSeedBuff.begin(), 
 					   thrust::counting_iterator<int>(0)+ startPos)),
 		  thrust::make_zip_iterator(
-			thrust::make_tuple(randomSeedBuff.begin() + endPos, 
-					   thrust::counting_iterator<int>(0)+endPos)),
+			thrust::make_tuple(randomSeedBuff.begin() + datapointerperFrame, 
+					   thrust::counting_iterator<int>(0)+ startPos +
+					   datapointerperFrame)),
 		  fn);
 	}}	
 	
@@ -6768,37 +6111,40 @@ namespace layers {
 							const int timeStep,
 							const int method)
     {
+	// Modify 20181018: the pointers are moved to the current frame, so that
+	//  m_paraVec can be reduced in memory
+	int ts = timeStep * this->m_precedingLayer.parallelSequences();
+	
 	internal::CopyPart fn;
-	fn.target = helpers::getRawPointer(fillBuffer);
+	fn.target = helpers::getRawPointer(fillBuffer) + ts * bufferDim;
 	fn.tarDim = bufferDim;
 	fn.tarS   = dimStart;
-	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes());
+	fn.patTypes     = helpers::getRawPointer(this->m_precedingLayer.patTypes()) + ts;
 	
 	if (this->m_feedBackType == MDNUNIT_FEEDBACK_OPT_0){
 	    // skip the mixture weight part
-	    int shift = (this->m_precedingLayer.curMaxSeqLength() * 
-			 this->m_precedingLayer.parallelSequences() * this->m_numMixture);
-	    fn.source = helpers::getRawPointer(this->m_paraVec) + shift;
+	    int shift = this->paraVecFrames() * this->m_numMixture;
+	    fn.source = (helpers::getRawPointer(this->m_paraVec) + shift +
+			 (ts - this->paraVecFrameBias(ts)) * (this->m_endDimOut - this->m_startDimOut));
 	    fn.srcDim = (this->m_endDimOut - this->m_startDimOut);
 	    fn.srcS   = 0;
 	    fn.copyDim= (this->m_endDimOut - this->m_startDimOut);
 	}else{
-	    fn.source = helpers::getRawPointer(targets);
+	    fn.source = helpers::getRawPointer(targets) + ts * this->m_layerSizeTar;
 	    fn.srcDim = this->m_layerSizeTar;
 	    fn.srcS   = this->m_startDimOut;
 	    fn.copyDim= (this->m_endDimOut - this->m_startDimOut);
 	}
 	
-	int ts = (timeStep * this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	int te = (ts  +      this->m_precedingLayer.parallelSequences()) * fn.copyDim;
-	
+	// m_paraVec (one frame at least) is only used to count the elements 
+	int n = this->m_precedingLayer.parallelSequences() * fn.copyDim;
 	thrust::for_each(
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + ts, 
-					   thrust::counting_iterator<int>(0) + ts)),
+			thrust::make_tuple(this->m_paraVec.begin(), 
+					   thrust::counting_iterator<int>(0))),
 		thrust::make_zip_iterator(
-			thrust::make_tuple(this->m_paraVec.begin() + te, 
-					   thrust::counting_iterator<int>(0) + te)),
+			thrust::make_tuple(this->m_paraVec.begin() + n, 
+					   thrust::counting_iterator<int>(0) + n)),
 		fn);
     }
 
@@ -6808,6 +6154,12 @@ namespace layers {
 	return (this->m_endDimOut - this->m_startDimOut);
     }
 
+    template <typename TDevice>
+    bool MDNUnit_mixture_dyn<TDevice>::flagStepInputShift()
+    {
+	return true;
+    }
+
     
     /************************************************************
      * MDNUnit_mixture_dynSqr 
@@ -7047,6 +6399,7 @@ namespace layers {
 		    fn2.trainableBPos= this->m_b_pos;
 		    fn2.tieVar       = this->m_tieVar;
 		    fn2.stepBack     = stepBack;
+		    fn2.frameBias    = 0;
 		    int n =  totalTime * this->m_numMixture * this->m_featureDim;
 		    thrust::for_each(thrust::counting_iterator<int>(0),
 				     thrust::counting_iterator<int>(0)+n,
@@ -7088,15 +6441,8 @@ namespace layers {
 	Cpu::real_vector tempRandom(datapoint, 0.0);
 	real_vector randomSeedBuff;
 	
-	const Configuration &config = Configuration::instance();
-	static boost::mt19937 *gen = NULL;
-	if (!gen) {
-	    gen = new boost::mt19937;
-	    gen->seed(config.randomSeed());
-	}
-	boost::random::normal_distribution<real_t> dist(0, 1);
-	for (size_t i = 0; i < datapoint; ++i)
-	    tempRandom[i] = (dist(*gen));
+	// Modify 20181018: no static engine shared by the generation threads
+	this->_samplingNoise(tempRandom, datapoint, 0);
 	randomSeedBuff = tempRandom;	
 	
 
@@ -7129,6 +6475,7 @@ namespace layers {
 		    fn2.linearPart   = NULL;
 		    fn2.biasPart     = NULL;
 		    fn2.stepBack     = stepBack;
+		    fn2.frameBias    = 0;
 		    startPos     = i     * this->m_numMixture * this->m_featureDim;
 		    endPos       = (i+1) * this->m_numMixture * this->m_featureDim;
 		    
@@ -7233,6 +6580,12 @@ namespace layers {
     }
 
 
+    template <typename TDevice>
+    bool MDNUnit_mixture_dynSqr<TDevice>::flagStepInputShift()
+    {
+	return false;
+    }
+
     template <typename TDevice>
     void MDNUnit_mixture_dynSqr<TDevice>::initPreOutput(
 		const MDNUnit_mixture_dynSqr<TDevice>::cpu_real_vector &mVec, 
@@ -110,6 +110,12 @@ namespace layers{
 	real_vector m_oneVector;
 
 	const int   m_feedBackType;        // what's been feedback ?
+
+	bool        m_paraVecReduced;      // m_paraVec only keeps the current frame
+
+	// Add 20181018: N(0, 1) noise for sampling, drawn from the counter-based stream
+	//  of (layer, epoch, fraction, sub), so that replicas can sample in parallel
+	void _samplingNoise(cpu_real_vector &noise, const int num, const int sub);
 	
     public:
 	MDNUnit(int startDim,    int endDim,  int startDimOut,                int endDimOut, 
@@ -195,6 +201,24 @@ namespace layers{
 
 
 	virtual void setGenMethod(cpu_real_vector &control, const int timeStep);
+
+	// Add 20180710: memory reduction during generation
+	// whether computeForward/getOutput/getParameter/fillFeedBackData (timeStep)
+	// only access the current frame of the input and m_paraVec
+	virtual bool flagStepInputShift();
+
+	// reduce m_paraVec to one frame (only in generation when flagStepInputShift())
+	bool         reduceParaBuffer();
+
+	// shift of the pointer to m_paraVec
+	int          paraVecBias(const int timeStepTimesParallel);
+
+	// Add 20181018: for the units whose m_paraVec is organized as planes over time
+	// number of frames (times parallel) kept in m_paraVec
+	int          paraVecFrames();
+
+	// shift of the frame index in m_paraVec
+	int          paraVecFrameBias(const int timeStepTimesParallel);
     };
 
 
@@ -257,6 +281,8 @@ namespace layers{
 				      const int method=0);
 
 	virtual int feedBackDim();
+
+	virtual bool flagStepInputShift();
     };
 
     /********************************************************
@@ -336,6 +362,7 @@ namespace layers{
 
 	virtual void setGenMethod(cpu_real_vector &control, const int timeStep);
 
+	virtual bool flagStepInputShift();
     };
 
     /********************************************************
@@ -347,6 +374,7 @@ namespace layers{
     class MDNUnit_mixture : public MDNUnit<TDevice>
     {
 	typedef typename TDevice::real_vector real_vector;
+	typedef typename TDevice::int_vector  int_vector;
 	typedef typename Cpu::real_vector cpu_real_vector;
 	typedef typename TDevice::pattype_vector pattype_vector;
 	
@@ -362,7 +390,9 @@ namespace layers{
 	
 	real_vector m_offset;    // temporary, calculate the offset for mixture weight
 	real_vector m_tmpPat;    // temporary, store the statistics for BP
-	real_vector m_varBP;     // temporary, store the variance gradients for BP
+
+	int_vector  m_emActive;    // EM generation: indices of frames not converged
+	int_vector  m_emConverged; // EM generation: convergence flag of each frame
 
     public:
 	MDNUnit_mixture(int startDim, int endDim, int startDimOut, int endDimOut, 
@@ -406,6 +436,7 @@ namespace layers{
 
 	virtual int  feedBackDim();
 
+	virtual bool flagStepInputShift();
     };    
 
 
@@ -515,6 +546,8 @@ namespace layers{
 				      const int method=0);
 
 	virtual int  feedBackDim();
+
+	virtual bool flagStepInputShift();
     };    
 
 
@@ -568,6 +601,9 @@ namespace layers{
 	virtual bool   flagValid();
 
 	virtual void   initPreOutput(const cpu_real_vector &mVec, const cpu_real_vector &vVec);
+
+	// the frame-wise generation is not implemented for this unit
+	virtual bool   flagStepInputShift();
     };
     
 }
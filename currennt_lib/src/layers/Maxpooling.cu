@@ -180,8 +180,10 @@ namespace layers {
     MaxPoolingLayer<TDevice>::MaxPoolingLayer(const helpers::JsonValue &layerChild,
 					      const helpers::JsonValue &weightsSection,
 					      Layer<TDevice>           &precedingLayer,
-					      int maxSeqLength)
-	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0, precedingLayer, maxSeqLength)
+					      int maxSeqLength,
+					      typename TDevice::real_vector *sharedWeights)
+	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0,
+	                          precedingLayer, maxSeqLength, sharedWeights)
     {
 
 	throw std::runtime_error("Maxpooling is not fully implemented");
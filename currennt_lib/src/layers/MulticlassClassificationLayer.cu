@@ -28,6 +28,9 @@
 #include "../helpers/NumericLimits.cuh"
 #include "../helpers/max.cuh"
 #include "../helpers/getRawPointer.cuh"
+#include "../helpers/onlineSoftmax.cuh"
+#include "../activation_functions/Identity.cuh"
+#include "SoftmaxLayer.hpp"
 
 #include <stdexcept>
 #include <cassert>
@@ -135,6 +138,94 @@ namespace {
         }
     };
 
+    // Add 20181012: gradient of softmax + cross-entropy w.r.t. the softmax input
+    //  written for all the dimensions of one pattern
+    struct ComputeSoftmaxCEErrorFn
+    {
+        int layerSize;
+
+        const real_t *outputs;
+        real_t       *outputErrors;
+
+        __host__ __device__ void operator() (const thrust::tuple<int, int> &t) const
+        {
+            // unpack the tuple
+            int targetClass = t.get<0>();
+            int patIdx      = t.get<1>();
+
+            const real_t *offOutputs      = outputs      + patIdx * layerSize;
+            real_t       *offOutputErrors = outputErrors + patIdx * layerSize;
+
+            // dummy pattern
+            if (targetClass == -1){
+                for (int i = 0; i < layerSize; ++i)
+                    offOutputErrors[i] = 0;
+                return;
+            }
+
+            for (int i = 0; i < layerSize; ++i)
+                offOutputErrors[i] = helpers::softmaxCEGrad(offOutputs[i], i == targetClass);
+        }
+    };
+
+    // Add 20181018: log-probability of the target, correct classification and the
+    //  gradients of one pattern in one pass over its outputs
+    struct ComputeErrorAndOutputErrorFn
+    {
+        int  layerSize;
+	bool fusedSoftmax;   // gradients w.r.t. the softmax input
+
+        const real_t *outputs;
+        real_t       *outputErrors;
+
+        __host__ __device__ thrust::tuple<real_t, int> operator() (const thrust::tuple<int, int> &t) const
+        {
+            // unpack the tuple
+            int targetClass = t.get<0>();
+            int patIdx      = t.get<1>();
+
+            const real_t *offOutputs      = outputs      + patIdx * layerSize;
+            real_t       *offOutputErrors = outputErrors + patIdx * layerSize;
+
+            // dummy pattern
+            if (targetClass == -1){
+                for (int i = 0; i < layerSize; ++i)
+                    offOutputErrors[i] = 0;
+                return thrust::make_tuple((real_t)0, 0);
+            }
+
+            real_t maxProb = 0;
+            int estClass   = 0;
+            for (int i = 0; i < layerSize; ++i) {
+                real_t out = offOutputs[i];
+                if (out > maxProb) {
+                    maxProb  = out;
+                    estClass = i;
+                }
+		if (fusedSoftmax)
+		    offOutputErrors[i] = helpers::softmaxCEGrad(out, i == targetClass);
+		else
+		    offOutputErrors[i] = 0;
+            }
+
+            real_t targetProb = helpers::max(helpers::NumericLimits<real_t>::min(),
+					     offOutputs[targetClass]);
+	    if (!fusedSoftmax)
+		offOutputErrors[targetClass] = - (1/targetProb);
+
+            return thrust::make_tuple(log(targetProb), (int)(targetClass == estClass));
+        }
+    };
+
+    struct SumErrorAndCorrectFn
+    {
+        __host__ __device__ thrust::tuple<real_t, int> operator() (
+		const thrust::tuple<real_t, int> &a, const thrust::tuple<real_t, int> &b) const
+        {
+            return thrust::make_tuple(a.get<0>() + b.get<0>(), a.get<1>() + b.get<1>());
+        }
+    };
+
 } // anonymous namespace
 } // namespace anonymous
 
@@ -151,6 +242,22 @@ namespace layers {
 
         // resize the pattern target classes vector
         m_patTargetClasses.resize(this->patTypes().size());
+
+        // Add 20181012: see fuseSoftmaxGradient()
+        m_fusedSoftmax = false;
+    }
+
+    template <typename TDevice>
+    void MulticlassClassificationLayer<TDevice>::fuseSoftmaxGradient()
+    {
+        // Add 20181012: if the preceding layer is softmax, the gradients of softmax
+        // and cross-entropy are computed together
+        SoftmaxLayer<TDevice, activation_functions::Identity> *softmaxLayer = 
+            dynamic_cast<SoftmaxLayer<TDevice, activation_functions::Identity>*>(
+		&this->precedingLayer());
+        m_fusedSoftmax = (softmaxLayer != NULL);
+        if (m_fusedSoftmax)
+            softmaxLayer->setFusedCrossEntropyGrad(true);
     }
 
     template <typename TDevice>
@@ -161,6 +268,10 @@ namespace layers {
     template <typename TDevice>
     int MulticlassClassificationLayer<TDevice>::countCorrectClassifications()
     {
+	// Add 20181018: counted by calculateErrorAndGradients
+	if (this->_cachedCorrect() >= 0)
+	    return this->_cachedCorrect();
+	
         internal::CountCorrectClassificationsFn fn;
         fn.layerSize = this->size();
         fn.outputs   = helpers::getRawPointer(this->_actualOutputs());
@@ -214,6 +325,33 @@ namespace layers {
         return -error;
     }
 
+    template <typename TDevice>
+    real_t MulticlassClassificationLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+        internal::ComputeErrorAndOutputErrorFn fn;
+        fn.layerSize    = this->size();
+	fn.fusedSoftmax = m_fusedSoftmax;
+        fn.outputs      = helpers::getRawPointer(this->_actualOutputs());
+        fn.outputErrors = helpers::getRawPointer(this->_outputErrors());
+
+        int n = this->curMaxSeqLength() * this->parallelSequences();
+        assert (n * this->size() <= this->_outputErrors().size());
+
+        thrust::tuple<real_t, int> res = thrust::transform_reduce(
+            thrust::make_zip_iterator(thrust::make_tuple(m_patTargetClasses.begin(),   thrust::counting_iterator<int>(0))),
+            thrust::make_zip_iterator(thrust::make_tuple(m_patTargetClasses.begin()+n, thrust::counting_iterator<int>(0)+n)),
+            fn,
+            thrust::make_tuple((real_t)0, 0),
+            internal::SumErrorAndCorrectFn()
+            );
+
+	this->_cacheFusedPass(res.get<1>());
+        return -res.get<0>();
+    }
+
     template <typename TDevice>
     void MulticlassClassificationLayer<TDevice>::computeForwardPass(const int nnState)
     {
@@ -228,8 +366,28 @@ namespace layers {
     template <typename TDevice>
     void MulticlassClassificationLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
         int n = this->curMaxSeqLength() * this->parallelSequences();
 
+        if (m_fusedSoftmax){
+            // errors w.r.t. the input of the preceding softmax layer
+            assert (n * this->size() <= this->_outputErrors().size());
+            internal::ComputeSoftmaxCEErrorFn fn;
+            fn.layerSize    = this->size();
+            fn.outputs      = helpers::getRawPointer(this->_actualOutputs());
+            fn.outputErrors = helpers::getRawPointer(this->_outputErrors());
+
+            thrust::for_each(
+                thrust::make_zip_iterator(thrust::make_tuple(m_patTargetClasses.begin(),   thrust::counting_iterator<int>(0))),
+                thrust::make_zip_iterator(thrust::make_tuple(m_patTargetClasses.begin()+n, thrust::counting_iterator<int>(0)+n)),
+                fn
+                );
+            return;
+        }
+
         // set all errors to zero
         assert (n * this->size() <= this->_outputErrors().size());
         thrust::fill_n(this->_outputErrors().begin(), n * this->size(), (real_t)0);
@@ -40,6 +40,7 @@ namespace layers {
 
     private:
         int_vector m_patTargetClasses;
+        bool       m_fusedSoftmax;     // the preceding layer is a softmax layer
 
     public:
         /**
@@ -65,6 +66,13 @@ namespace layers {
          */
         int countCorrectClassifications();
 
+        /**
+         * Computes the errors w.r.t. the input of the preceding softmax layer
+         * (the softmax layer skips its Jacobian). Only valid if this layer is
+         * the only consumer of the softmax output
+         */
+        void fuseSoftmaxGradient();
+
         /**
          * @see Layer::type()
          */
@@ -80,6 +88,11 @@ namespace layers {
          */
         virtual real_t calculateError();
 
+        /**
+         * @see PostOutputLayer::calculateErrorAndGradients()
+         */
+        virtual real_t calculateErrorAndGradients();
+
         /**
          * @see Layer::computeForwardPass()
          */
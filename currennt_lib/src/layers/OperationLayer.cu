@@ -58,21 +58,19 @@
 
 namespace internal{
     
+    // Modify 20181018: counter-based generator, each element is generated independently
     struct genNoise
     {
 	float a, b;
-	int   seed;
+	helpers::philox::stream_t stream;
 	
-	__host__ __device__
-	genNoise(float _a=-1.f, float _b=1.f, int _seed=123) : a(_a), b(_b), seed(_seed) {};
+	genNoise(float _a, float _b, const helpers::philox::stream_t &_stream)
+	    : a(_a), b(_b), stream(_stream) {};
 
 	__host__ __device__
 	float operator()(const unsigned int n) const
 	{
-	    thrust::default_random_engine rng(seed);
-	    thrust::uniform_real_distribution<float> dist(a, b);
-	    rng.discard(n);
-	    return dist(rng);
+	    return helpers::philox::uniform(stream, n, a, b);
 	}
     };
 
@@ -83,6 +81,7 @@ namespace internal{
 	int preLayerSize;
 	int noiseDim;
 	int noiseRepeat;
+	int preShift;      // shift of the pointer when preceding layer is reduced in memory
 	
 	real_t *preOutput;
 	real_t *noiseData;
@@ -101,7 +100,7 @@ namespace internal{
 		if ((patTypes != NULL && patTypes[timeIdx] == PATTYPE_NONE)){
 		    t.get<0>() = 0.0;
 		}else{
-		    t.get<0>() = preOutput[timeIdx * preLayerSize + dimIdx] * weights[dimIdx];
+		    t.get<0>() = preOutput[timeIdx * preLayerSize + dimIdx - preShift] * weights[dimIdx];
 		}
 	    }else{
 		// repeat the noise across time
@@ -404,8 +403,10 @@ namespace layers{
     OperationLayer<TDevice>::OperationLayer(const helpers::JsonValue &layerChild,
 					    const helpers::JsonValue &weightsSection,
 					    Layer<TDevice>           &precedingLayer,
-					    int                       maxSeqLength)
-	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0, precedingLayer, maxSeqLength)
+					    int                       maxSeqLength,
+					    typename TDevice::real_vector *sharedWeights)
+	: TrainableLayer<TDevice>(layerChild, weightsSection, 0, 0,
+	                          precedingLayer, maxSeqLength, sharedWeights)
 	, m_noiseMag    (1.0)
 	, m_noiseSize   (0)
 	, m_noiseRepeat (0)
@@ -541,7 +542,8 @@ namespace layers{
 		throw std::runtime_error("Layer size is unequal to previous one");
 	}
 
-	if (this->precedingLayer().getSaveMemoryFlag())
+	if (this->precedingLayer().getSaveMemoryFlag() &&
+	    (this->flagTrainingMode() || m_lastShot > 0 || m_changeTimeRes || m_outDupRate > 1))
 	    throw std::runtime_error("layer before operator is reduced in mem");  
 	
     }
@@ -718,7 +720,7 @@ namespace layers{
 				  index_sequence_begin + timeLength * m_noiseSize,
 				  m_noiseInput.begin(),
 				  internal::genNoise(-1.0 * m_noiseMag, m_noiseMag,
-						     (int)(misFuncs::GetRandomNumber()*10000.0)));
+						     this->_randomStream()));
 
 	    }
 	
@@ -728,6 +730,7 @@ namespace layers{
 	    fn.preLayerSize = this->precedingLayer().size();
 	    fn.noiseDim     = m_noiseSize;
 	    fn.noiseRepeat  = m_noiseRepeat;
+	    fn.preShift     = 0;
 	    
 	    fn.weights   = helpers::getRawPointer(m_setZeroVec_D);
 	    fn.preOutput = helpers::getRawPointer(this->precedingLayer().outputs());
@@ -882,7 +885,7 @@ namespace layers{
 				  index_sequence_begin + timeLength * m_noiseSize,
 				  m_noiseInput.begin(),
 				  internal::genNoise(-1.0 * m_noiseMag, m_noiseMag,
-						     (int)(misFuncs::GetRandomNumber()*10000.0)));
+						     this->_randomStream()));
 
 	    }
 	    {
@@ -891,6 +894,8 @@ namespace layers{
 	    fn.preLayerSize = this->precedingLayer().size();
 	    fn.noiseDim     = m_noiseSize;
 	    fn.noiseRepeat  = m_noiseRepeat;
+	    fn.preShift     = this->precedingLayer().outputBufPtrBias(
+				timeStep * this->parallelSequences(), nnState);
 	    
 	    fn.weights   = helpers::getRawPointer(m_setZeroVec_D);
 	    fn.preOutput = helpers::getRawPointer(this->precedingLayer().outputs());
@@ -905,12 +910,14 @@ namespace layers{
 		st = 0;
 		et = timeLength * this->size();
 	    }
+	    // shift of the output pointer when this layer is reduced in memory
+	    int shiftOut = this->outputBufPtrBias(timeStep * this->parallelSequences(), nnState);
 	    thrust::for_each(
                thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin()           + st,
+		  thrust::make_tuple(this->outputs().begin()           + st - shiftOut,
 				     thrust::counting_iterator<int>(0) + st)),
 	       thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin()           + et,
+		  thrust::make_tuple(this->outputs().begin()           + et - shiftOut,
 				     thrust::counting_iterator<int>(0) + et)),
 	       fn);
 	    }
@@ -1044,6 +1051,7 @@ namespace layers{
 	    fn.curLayerSize = this->precedingLayer().size();
 	    fn.preLayerSize = this->size();
 	    fn.noiseDim     = m_noiseSize;
+	    fn.preShift     = 0;
 	    
 	    fn.weights   = helpers::getRawPointer(m_setZeroVec_D);
 	    fn.preOutput = helpers::getRawPointer(this->outputErrors());
@@ -1064,6 +1072,31 @@ namespace layers{
 
     }
 
+    template <typename TDevice>
+    void OperationLayer<TDevice>::reduceOutputBuffer()
+    {
+	// only the normal mode (no last shot, resolution change, duplication) is supported
+	if (this->flagTrainingMode() || m_lastShot > 0 || m_changeTimeRes ||
+	    m_outDupRate > 1 || this->precedingLayer().type() == "vae")
+	    return;
+	
+	this->resizeOutputBuffer(this->parallelSequences() * this->size());
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+    
+    template <typename TDevice>
+    int OperationLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel,
+						  const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    return timeStepTimesParallel * this->size();
+	}else{
+	    return 0;
+	}
+    }
+
+
     template class OperationLayer<Cpu>;
     template class OperationLayer<Gpu>;
     
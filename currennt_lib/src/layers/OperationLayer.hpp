@@ -89,7 +89,8 @@ namespace layers{
 	    const helpers::JsonValue &layerChild,
 	    const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
 	);
 
 	virtual ~OperationLayer();
@@ -111,6 +112,11 @@ namespace layers{
 				 const helpers::JsonAllocator &allocator) const;
 	//
 	virtual void loadSequences(const data_sets::DataSetFraction &fraction, const int nnState);
+
+	// memory save mode for generation
+	virtual void reduceOutputBuffer();
+	
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
     };
     
 }
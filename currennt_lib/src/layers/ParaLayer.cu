@@ -465,8 +465,10 @@ namespace layers {
         const helpers::JsonValue &layerChild, 
         const helpers::JsonValue &weightsSection,
         Layer<TDevice> &precedingLayer,
-	int maxSeqLength)
-        : FeedForwardLayer<TDevice, TActFn>(layerChild, weightsSection, precedingLayer, maxSeqLength)
+	int maxSeqLength,
+	typename TDevice::real_vector *sharedWeights)
+        : FeedForwardLayer<TDevice, TActFn>(layerChild, weightsSection,
+                                            precedingLayer, maxSeqLength, sharedWeights)
     {
 	
 	// Read the configuration file
@@ -156,6 +156,8 @@ namespace layers {
 	, m_postoutputFlag(NN_POSTOUTPUTLAYER_LAST)
 	, m_useExternalOutput(layerChild->HasMember("useExternalOutput") ? 
 			      (*layerChild)["useExternalOutput"].GetInt() : 0)
+	, m_gradientsCached (false)
+	, m_correctCached   (-1)
     {
 	// Modify 0506. For MDN, requireSize = -1, no need to check here
 	// if (this->size() != requiredSize)
@@ -203,6 +205,10 @@ namespace layers {
     void PostOutputLayer<TDevice>::loadSequences(const data_sets::DataSetFraction &fraction,
 						 const int nnState)
     {
+	// the results of the fused pass belong to the previous fraction
+	m_gradientsCached = false;
+	m_correctCached   = -1;
+	
 	if (m_precedingMiddleOutLayer == NULL){
 
 	    Layer<TDevice>::loadSequences(fraction, nnState);
@@ -494,6 +500,41 @@ namespace layers {
 	return m_postoutputFlag;
     }
 
+    template <typename TDevice>
+    real_t PostOutputLayer<TDevice>::calculateErrorAndGradients()
+    {
+	return this->calculateError();
+    }
+
+    template <typename TDevice>
+    bool PostOutputLayer<TDevice>::_flagFusedPass() const
+    {
+	// the GAN/MDN intermediate layers change the gradients in computeBackwardPass
+	return (m_precedingMiddleOutLayer == NULL &&
+		m_postoutputFlag == NN_POSTOUTPUTLAYER_LAST);
+    }
+
+    template <typename TDevice>
+    void PostOutputLayer<TDevice>::_cacheFusedPass(const int correctClassifications)
+    {
+	m_gradientsCached = true;
+	m_correctCached   = correctClassifications;
+    }
+
+    template <typename TDevice>
+    bool PostOutputLayer<TDevice>::_takeCachedGradients()
+    {
+	bool cached = m_gradientsCached;
+	m_gradientsCached = false;
+	return cached;
+    }
+
+    template <typename TDevice>
+    int PostOutputLayer<TDevice>::_cachedCorrect() const
+    {
+	return m_correctCached;
+    }
+
     // explicit template instantiations
     template class PostOutputLayer<Cpu>;
     template class PostOutputLayer<Gpu>;
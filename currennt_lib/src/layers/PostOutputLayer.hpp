@@ -64,6 +64,10 @@ namespace layers {
 	real_vector     m_externalDataMV;
 	std::string     m_externalDataMVStr;
 
+	// Add 20181018 results of the fused error/gradient pass of the current fraction
+	bool            m_gradientsCached;   // outputErrors already hold the gradients
+	int             m_correctCached;     // correct classifications (-1: not computed)
+
     protected:
         real_vector&    _targets();
         real_vector&    _actualOutputs();
@@ -77,6 +81,16 @@ namespace layers {
 	real_vector&     _mvVector();
 	real_vector&     _dataBuffer();
 	const int&       _postLayerType();
+
+	/* Add 20181018 for the fused error and gradient pass */
+	// whether the gradients can be computed together with the error
+	bool             _flagFusedPass() const;
+	// mark the gradients (and the correct classifications) as computed
+	void             _cacheFusedPass(const int correctClassifications = -1);
+	// true if computeBackwardPass can reuse the gradients; the cache is cleared
+	bool             _takeCachedGradients();
+	// the cached correct classifications, -1 if not computed
+	int              _cachedCorrect() const;
 	
     public:
         /**
@@ -120,6 +134,16 @@ namespace layers {
          */
         virtual real_t calculateError() =0;
 
+	/**
+	 * Add 20181018: computes the error and, in the same pass over the outputs,
+	 * the gradients w.r.t. the outputs (and the correct classifications for the
+	 * classification layers). The next computeBackwardPass reuses the gradients.
+	 * Layers without a fused pass only call calculateError()
+	 *
+	 * @return The error
+	 */
+	virtual real_t calculateErrorAndGradients();
+
 	virtual void computeBackwardPass(const int nnState);
 	
 	/**
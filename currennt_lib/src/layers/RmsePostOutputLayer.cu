@@ -96,6 +96,31 @@ namespace {
             return error;
         }
     };
+
+    // Add 20181018: sum of the RMSEs and the gradients of one pattern in one pass
+    struct ComputeRmseAndOutputErrorFn
+    {
+        int layerSize;
+
+        const real_t *actualOutputs;
+        const real_t *targetOutputs;
+        const real_t *rmses;
+	real_t       *outputErrors;
+
+        __host__ __device__ real_t operator() (const int &patIdx) const
+        {
+            // 0 for dummy patterns (as the rmse)
+            real_t rmse = rmses[patIdx];
+
+            const real_t *offActualOutputs = &actualOutputs[patIdx * layerSize];
+            const real_t *offTargetOutputs = &targetOutputs[patIdx * layerSize];
+            real_t       *offOutputErrors  = &outputErrors [patIdx * layerSize];
+            for (int i = 0; i < layerSize; ++i)
+                offOutputErrors[i] = rmse * (offActualOutputs[i] - offTargetOutputs[i]);
+
+            return rmse;
+        }
+    };
     
 } // anonymous namespace
 } // namespace anonymous
@@ -136,6 +161,30 @@ namespace layers {
         return rmse;
     }
 
+    template <typename TDevice>
+    real_t RmsePostOutputLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+	internal::ComputeRmseAndOutputErrorFn fn;
+	fn.layerSize     = this->size();
+	fn.actualOutputs = helpers::getRawPointer(this->_actualOutputs());
+	fn.targetOutputs = helpers::getRawPointer(this->_targets());
+	fn.rmses         = helpers::getRawPointer(m_rmses);
+	fn.outputErrors  = helpers::getRawPointer(this->_outputErrors());
+
+	real_t rmse = thrust::transform_reduce(
+                thrust::counting_iterator<int>(0),
+                thrust::counting_iterator<int>(0) + this->curMaxSeqLength() * this->parallelSequences(),
+		fn,
+		(real_t)0,
+		thrust::plus<real_t>());
+	
+	this->_cacheFusedPass();
+	return rmse;
+    }
+
     template <typename TDevice>
     void RmsePostOutputLayer<TDevice>::computeForwardPass(const int nnState)
     {
@@ -162,6 +211,10 @@ namespace layers {
     template <typename TDevice>
     void RmsePostOutputLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
         // calculate the errors
         internal::ComputeOutputErrorFn fn;
         fn.layerSize = this->size();
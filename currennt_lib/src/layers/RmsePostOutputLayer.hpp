@@ -71,6 +71,11 @@ namespace layers {
          */
         virtual real_t calculateError();
 
+        /**
+         * @see PostOutputLayer::calculateErrorAndGradients()
+         */
+        virtual real_t calculateErrorAndGradients();
+
         /**
          * @see Layer::computeForwardPass()
          */
@@ -37,6 +37,7 @@
 #include "../activation_functions/Logistic.cuh"
 #include "../activation_functions/Tanh.cuh"
 #include "../Configuration.hpp"
+#include "../MacroDefine.hpp"
 
 #include <thrust/transform.h>
 #include <thrust/transform_reduce.h>
@@ -248,47 +249,18 @@ namespace {
 	}
     };
        
-    struct SetH2HMatrix{
-	// Create the H2Hmatrix for each time step
-	// The created matrix is a lower-triangle (block) matrix
-	int    *bandConfig;
-	int     bandNum;
-	real_t *sourceW;
-	real_t *targetW;
-	int     featDim;
-	int     matrixSize;
+    // Add 20181018: for ClockRNN, the units skipped at the next step keep their values,
+    //  their gradients are directly copied to the current step (the 1-diagonal block
+    //  of the duplicated H2H matrix in the old implementation)
+    struct AddSkippedUnitErrorsClockRnn{
+	int           featDim;
+	const bool   *skipCRNN;     // skip flag of the next step
+	const real_t *nextDeltas;   // unitDeltas of the next step
+	real_t       *curErrors;    // outputErrors of the current step
 	
-	__host__ __device__ void operator() (const int idx) const{
-	    int bandIdx     = idx / matrixSize + 1;
-	    int sourcePos   = idx % matrixSize; 
-	    int rows        = sourcePos % featDim;
-	    int cols        = sourcePos / featDim;
-	    
-	    int colStart    = 0;
-	    int colEnd      = 0;
-	    int tmp         = 0b01;
-	    bool flag       = false;
-	    
-	    // given a point in one of the H2H matrix
-	    // for the matrix bands that are non-zero in this H2H matrix
-	    //     check if this point locates in the band (and in the lower-triangle area)
-	    //           if yes, this point is non-zero, copy the value for it
-	    //           if not
-	    //                diagonal point ? 1.0 : 0.0
-	    for (int band = 0; band<bandNum; band++){
-		if (bandIdx  & (tmp << band)){ // bit operation
-		    colStart = (band > 0)?(bandConfig[2*band-1]):(colStart);
-		    colEnd   = bandConfig[2*band+1];
-		    if (cols >= colStart && cols < colEnd && rows >= colStart){
-			*(targetW + idx) = *(sourceW + sourcePos);
-			flag = true;
-			break;
-		    }
-		}
-	    }
-	    if (flag == false){
-		*(targetW + idx) = (rows==cols) ? (1.0):(0.0);
-	    }
+	__host__ __device__ void operator() (const int idx) const {
+	    if (skipCRNN[idx % featDim])
+		curErrors[idx] += nextDeltas[idx];
 	}
     };
 
@@ -373,7 +345,7 @@ namespace layers {
     // Parse the option of ClockRNN
     // input: options, layer size
     // change: m_crStep
-    // return: number of possible Hidden2Hidden Matrix
+    // return: number of possible band-activation patterns
     int ReadClockRNNOptions(const std::string options, Cpu::int_vector &m_crStep, const int size)
     {
 	// read in the option
@@ -398,7 +370,7 @@ namespace layers {
     // Parse m_crStep
     // input:  m_crStep (from the function above) and time step
     //         tmpSkipFlagCR (which dimension should be skipped in forward propagation)
-    // return: which Hidden2Hidden matrix should be used ?
+    // return: bit mask of the bands updated at this time step
     int DimSkipFlagCR(Cpu::bool_vector &tmpSkipFlagCR, Cpu::int_vector &m_crStep, 
 		      int timestep, int parallelSent)
     {
@@ -450,11 +422,13 @@ namespace layers {
 				const helpers::JsonValue &weightsSection,
 				Layer<TDevice>           &precedingLayer,
 				int                       maxSeqLength,
-				bool                      bidirectional)
+				bool                      bidirectional,
+				typename TDevice::real_vector *sharedWeights)
         : TrainableLayer<TDevice>(layerChild, weightsSection, 
 				  1, 
 				  helpers::safeJsonGetInt(layerChild, "size")/(bidirectional?2:1),
-				  precedingLayer, maxSeqLength)
+				  precedingLayer, maxSeqLength,
+				  sharedWeights)
         , m_isBidirectional      (bidirectional)
     {
         if (m_isBidirectional && this->size() % 2 != 0)
@@ -473,12 +447,10 @@ namespace layers {
 	
 	if (m_crStepStr.size()>0){
 	    m_clockRNN     = true;
-	    Cpu::int_vector temp;
-	    // how many possible Hidden2Hidden matrices will be 
-	    m_numH2Hmat    = ReadClockRNNOptions(m_crStepStr, m_crStep, els);
-	    
-	    // initialize the ClockRNN Hidden2Hidden matrices
-	    m_h2hClockRNN.resize(els * els * (m_isBidirectional ? 2: 1) * (m_numH2Hmat), 0.0);
+	    // Modify 20181018: the H2H matrices are no longer duplicated for each updating
+	    //  schedule. Each step only computes the sub-blocks of the active bands
+	    //  over the shared weights (see _clockH2HForward and _clockH2HBackward)
+	    ReadClockRNNOptions(m_crStepStr, m_crStep, els);
 	    
 	    // copy the configuration to device
 	    m_crStepDevice = m_crStep;
@@ -500,7 +472,6 @@ namespace layers {
 	}else{
 	    m_clockRNN     = false;
 	    m_crStep.clear();
-	    m_h2hClockRNN.clear();
 	    m_crStepDevice.clear();
 	}
 
@@ -546,36 +517,40 @@ namespace layers {
 	    // wrap the InputToHidden
 	    m_fw.weightMatrices.InputToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        pls, els, 0);
-	    m_fw.weightUpdateMatrices.InputToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, 0);
 	    m_bw.weightMatrices.InputToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        pls, els, numInputWeights/2);
-	    m_bw.weightUpdateMatrices.InputToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, numInputWeights/2);
 	    
 	    // wrap the HiddenToHidden
 	    int numInputAndBiasF = ls * (pls + 1);
 	    int numInputAndBiasB = ls * (pls + 1) + numInternalWeights/2;
 	    m_fw.weightMatrices.HiddenToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        els, els, numInputAndBiasF);
-	    m_fw.weightUpdateMatrices.HiddenToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasF);
 	    m_bw.weightMatrices.HiddenToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        els, els, numInputAndBiasB);
-	    m_bw.weightUpdateMatrices.HiddenToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasB);
 	    
 	    // wrap the matrix for bias
-	    numInputAndBiasF = ls * pls;
-	    numInputAndBiasB = ls * pls + ls/2;
+	    int numBiasF = ls * pls;
+	    int numBiasB = ls * pls + ls/2;
 	    m_fw.weightMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numInputAndBiasF);
-	    m_fw.weightUpdateMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numInputAndBiasF);
+		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numBiasF);
 	    m_bw.weightMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numInputAndBiasB);
-	    m_bw.weightUpdateMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numInputAndBiasB);
+		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numBiasB);
+
+	    // Modify 20181018: inference replicas have no gradient buffer to wrap
+	    if (!this->_weightUpdates().empty()) {
+		m_fw.weightUpdateMatrices.InputToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, 0);
+		m_bw.weightUpdateMatrices.InputToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, numInputWeights/2);
+		m_fw.weightUpdateMatrices.HiddenToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasF);
+		m_bw.weightUpdateMatrices.HiddenToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasB);
+		m_fw.weightUpdateMatrices.BiasWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numBiasF);
+		m_bw.weightUpdateMatrices.BiasWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numBiasB);
+	    }
 	    	    
 	    // wrap the weights for each time step
 	    for (int timestep = 0; timestep < this->maxSeqLength(); ++timestep) {
@@ -622,7 +597,7 @@ namespace layers {
 		    Cpu::bool_vector tmpFlagCR(rows * paralNum, false);
 
 		    //
-		    // h2hMatrixIdx: in each time step, which hidden2hidden matrix should be used
+		    // h2hMatrixIdx: in each time step, (bit mask of the updated bands) - 1
 		    //               [0  2^band_number-1]
 		    int h2hMatrixIdx = DimSkipFlagCR(tmpFlagCR, m_crStep, timestep, paralNum)-1;
 		    
@@ -649,12 +624,6 @@ namespace layers {
 		    
 		    fm.h2hIdx    = h2hMatrixIdx;
 		    bm.h2hIdx    = h2hMatrixIdx;
-		    
-		    // wrap the temporary hidden to hidden matrix for ClockRNN
-		    h2hMatrixIdx = h2hMatrixIdx * els * els;
-		    fm.h2hWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els, h2hMatrixIdx);
-		    h2hMatrixIdx = h2hMatrixIdx + m_h2hClockRNN.size()/2;
-		    bm.h2hWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els, h2hMatrixIdx);
 
 		}else{
 		    //fm.skipCR.clear();
@@ -682,22 +651,26 @@ namespace layers {
 	    // wrap the InputToHidden
 	    m_fw.weightMatrices.InputToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        pls, els, 0);
-	    m_fw.weightUpdateMatrices.InputToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, 0);
 	    
 	    // wrap the HiddenToHidden
 	    int numInputAndBiasF = ls * (pls + 1);
 	    m_fw.weightMatrices.HiddenToHiddenWrap = 
 		helpers::Matrix<TDevice>(&this->weights(),        els, els, numInputAndBiasF);
-	    m_fw.weightUpdateMatrices.HiddenToHiddenWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasF);
 	    
 	    // wrap the matrix for bias
-	    numInputAndBiasF     = ls * pls;
+	    int numBiasF         = ls * pls;
 	    m_fw.weightMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numInputAndBiasF);
-	    m_fw.weightUpdateMatrices.BiasWrap = 
-		helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numInputAndBiasF);
+		helpers::Matrix<TDevice>(&this->weights(),        els, 1, numBiasF);
+
+	    // Modify 20181018: inference replicas have no gradient buffer to wrap
+	    if (!this->_weightUpdates().empty()) {
+		m_fw.weightUpdateMatrices.InputToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), pls, els, 0);
+		m_fw.weightUpdateMatrices.HiddenToHiddenWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, els, numInputAndBiasF);
+		m_fw.weightUpdateMatrices.BiasWrap = 
+		    helpers::Matrix<TDevice>(&this->_weightUpdates(), els, 1, numBiasF);
+	    }
 	    
 	    // wrap the weights for each time step
 	    for (int timestep = 0; timestep < this->maxSeqLength(); ++timestep) {
@@ -739,10 +712,6 @@ namespace layers {
 				 m_fw.skipCR.begin() + fm.skipCRPos);
 		    fm.h2hIdx    = h2hMatrixIdx;
 		    
-		    // wrap the temporary hidden to hidden matrix for ClockRNN
-		    h2hMatrixIdx = els * els * h2hMatrixIdx;
-		    fm.h2hWrap = helpers::Matrix<TDevice>(&m_h2hClockRNN, els, els, h2hMatrixIdx);
-		    
 		}else{
 		    //fm.skipCR.clear();
 		}
@@ -777,6 +746,74 @@ namespace layers {
         return m_isBidirectional;
     }
 
+    // Add 20181018: ClockRNN hidden-to-hidden link over the shared weights
+    //  Only the units in the bands updated at curStep receive W*h. For band [s, e), the input
+    //  comes from the units [s, els) (the same and the slower bands), which is a GEMM over the
+    //  sub-block W[s:els, s:e] of the H2H weights. The skipped units don't read unitActsBuf.
+    template <typename TDevice>
+    void RnnLayer<TDevice>::_clockH2HForward(forward_backward_info_t &fwbw, const bool bwDir,
+					     const int curStep, const int preStep)
+    {
+	int ls    = this->size();
+	int pls   = this->precedingLayer().size();
+	int els   = this->size() / (m_isBidirectional ? 2 : 1);
+	int paraN = this->parallelSequences();
+	int bands = fwbw.timestepMatrices[curStep].h2hIdx + 1;
+	int wOff  = ls * (pls + 1) + (bwDir ? els * els : 0);
+	
+	for (int band = 0; band < m_crStep.size()/2; band++){
+	    if (!(bands & (0b01 << band)))
+		continue;
+	    int s = (band > 0) ? m_crStep[2*band-1] : 0;
+	    int e = m_crStep[2*band+1];
+	    helpers::Matrix<TDevice> h2hBlock(&this->weights(), els - s, e - s,
+					      wOff + s * els + s, els);
+	    helpers::Matrix<TDevice> preOutputs(&fwbw.tmpOutputs, els - s, paraN,
+						preStep * els * paraN + s, els);
+	    helpers::Matrix<TDevice> actsBuf(&fwbw.unitActsBuf, e - s, paraN,
+					     curStep * els * paraN + s, els);
+	    actsBuf.assignProduct(h2hBlock, true, preOutputs, false);
+	}
+    }
+
+    // Add 20181018: the gradient of _clockH2HForward
+    template <typename TDevice>
+    void RnnLayer<TDevice>::_clockH2HBackward(forward_backward_info_t &fwbw, const bool bwDir,
+					      const int curStep, const int nextStep)
+    {
+	int ls    = this->size();
+	int pls   = this->precedingLayer().size();
+	int els   = this->size() / (m_isBidirectional ? 2 : 1);
+	int paraN = this->parallelSequences();
+	int bands = fwbw.timestepMatrices[nextStep].h2hIdx + 1;
+	int wOff  = ls * (pls + 1) + (bwDir ? els * els : 0);
+	
+	for (int band = 0; band < m_crStep.size()/2; band++){
+	    if (!(bands & (0b01 << band)))
+		continue;
+	    int s = (band > 0) ? m_crStep[2*band-1] : 0;
+	    int e = m_crStep[2*band+1];
+	    helpers::Matrix<TDevice> h2hBlock(&this->weights(), els - s, e - s,
+					      wOff + s * els + s, els);
+	    helpers::Matrix<TDevice> nextDeltas(&fwbw.unitDeltas, e - s, paraN,
+						nextStep * els * paraN + s, els);
+	    helpers::Matrix<TDevice> curErrors(&fwbw.tmpOutputErrors, els - s, paraN,
+					       curStep * els * paraN + s, els);
+	    curErrors.addProduct(h2hBlock, false, nextDeltas, false);
+	}
+
+	// the skipped units
+	internal::AddSkippedUnitErrorsClockRnn fn;
+	fn.featDim    = els;
+	fn.skipCRNN   = (helpers::getRawPointer(fwbw.skipCR) +
+			 fwbw.timestepMatrices[nextStep].skipCRPos);
+	fn.nextDeltas = helpers::getRawPointer(fwbw.unitDeltas) + nextStep * els * paraN;
+	fn.curErrors  = helpers::getRawPointer(fwbw.tmpOutputErrors) + curStep * els * paraN;
+	thrust::for_each(thrust::counting_iterator<int>(0),
+			 thrust::counting_iterator<int>(0) + els * paraN,
+			 fn);
+    }
+
     template <typename TDevice>
     void RnnLayer<TDevice>::loadSequences(const data_sets::DataSetFraction &fraction,
 					  const int nnState)
@@ -808,16 +845,19 @@ namespace layers {
 		m_bw.unitDeltasWrapA = helpers::Matrix<TDevice>(&m_bw.unitDeltas, rows, cols);
 	    }
 	}else{
-	    m_fw.unitActsWrapA   = helpers::Matrix<TDevice>(&m_fw.unitActs,   rows, cols);
+	    // memory save mode: only the ring buffer is allocated
+	    if (this->getSaveMemoryFlag())
+		m_fw.unitActsWrapA = helpers::Matrix<TDevice>(
+			&m_fw.unitActs, rows,
+			NN_RECURRENT_RING_BUFFER_LENGTH * this->parallelSequences());
+	    else
+		m_fw.unitActsWrapA = helpers::Matrix<TDevice>(&m_fw.unitActs, rows, cols);
 	    if (this->flagTrainingMode())
 		m_fw.unitDeltasWrapA = helpers::Matrix<TDevice>(&m_fw.unitDeltas, rows, cols);
 	}
 	
-	// Copy the Hidden2Hidden Matrix to each possible Hidden2Hidden Matrix format
+	// Prepare the clock schedule
 	if (m_clockRNN){
-	    int ls      = this->size();
-	    int pls     = this->precedingLayer().size();
-	    int h2hsize = rows * rows;
 	    
 	    // Read in the context-dependent time clock
 	    if (fraction.auxDataDim()>0){
@@ -848,15 +888,6 @@ namespace layers {
 		    m_fw.timestepMatrices[t].h2hIdx = h2hMatrixIdx;
 		    if(m_isBidirectional) {m_bw.timestepMatrices[t].h2hIdx = h2hMatrixIdx;}
 		    
-		    // assign h2hWarp
-		    h2hMatrixIdx = h2hMatrixIdx * rows * rows;
-		    m_fw.timestepMatrices[t].h2hWrap = 
-			helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, h2hMatrixIdx);
-		    
-		    h2hMatrixIdx = h2hMatrixIdx + m_h2hClockRNN.size()/2;
-		    if(m_isBidirectional) {m_bw.timestepMatrices[t].h2hWrap = 
-			    helpers::Matrix<TDevice>(&m_h2hClockRNN, rows, rows, h2hMatrixIdx);}
-		    
 		    // assign the skipCRNN vector and skipCRPos
 		    m_fw.timestepMatrices[t].skipCRPos = t * rows;
 		    if(m_isBidirectional) {m_bw.timestepMatrices[t].skipCRPos = 
@@ -908,37 +939,7 @@ namespace layers {
 				 fn);
 	    }
 	    
-	    internal::SetH2HMatrix fn;
-	    if (m_isBidirectional){
-		fn.bandConfig = helpers::getRawPointer(m_crStepDevice);
-		fn.bandNum    = m_crStepDevice.size()/2;
-		fn.featDim    = rows;
-		fn.matrixSize = h2hsize;
-		
-		fn.sourceW    = helpers::getRawPointer(this->weights()) + ls * (pls + 1);
-		fn.targetW    = helpers::getRawPointer(m_h2hClockRNN);
-		thrust::for_each(thrust::counting_iterator<int>(0),
-				 thrust::counting_iterator<int>(0)      + h2hsize * m_numH2Hmat,
-				 fn);
-		
-		fn.sourceW    = helpers::getRawPointer(this->weights()) + ls * (pls + 1) + h2hsize;
-		fn.targetW    = helpers::getRawPointer(m_h2hClockRNN)   + h2hsize * m_numH2Hmat;
-		thrust::for_each(thrust::counting_iterator<int>(0),
-				 thrust::counting_iterator<int>(0)      + h2hsize * m_numH2Hmat,
-				 fn);
-	    }else{
-		fn.bandConfig = helpers::getRawPointer(m_crStepDevice);
-		fn.bandNum    = m_crStepDevice.size()/2;
-		fn.featDim    = rows;
-		fn.matrixSize = h2hsize;
-		fn.sourceW = helpers::getRawPointer(this->weights())    + ls * (pls + 1);
-		fn.targetW = helpers::getRawPointer(m_h2hClockRNN);
-		thrust::for_each(thrust::counting_iterator<int>(0),
-				 thrust::counting_iterator<int>(0)      + h2hsize * m_numH2Hmat,
-				 fn);
-	    }
 	    // For debug
-	    // Show all the H2H matrices
 	    if (DEBUG_CLOCKRNN){
 		
 		Cpu::bool_vector tmpFlagCR = m_fw.skipCR;
@@ -950,30 +951,6 @@ namespace layers {
 		    printf("\n");
 		}
 
-		Cpu::real_vector h2hMatrix_debug = m_h2hClockRNN;
-		int biasPos_debug = 0;
-		for (int i = 0; i < m_numH2Hmat; i++){
-		    printf("Forward: Matrix %d\n", i);
-		    for (int x_row = 0; x_row < rows; x_row++){
-			for (int y_col = 0; y_col < rows; y_col++){
-			    printf("%f ", h2hMatrix_debug[biasPos_debug + x_row + y_col*rows]);
-			}
-			printf("\n");
-		    }
-		    biasPos_debug  += h2hsize;
-		}
-		if (m_isBidirectional){
-		    for (int i = 0; i < m_numH2Hmat; i++){
-			printf("BackWard: Matrix %d\n", i);
-			for (int x_row = 0; x_row < rows; x_row++){
-			    for (int y_col = 0; y_col < rows; y_col++){
-				printf("%f ", h2hMatrix_debug[biasPos_debug+x_row+y_col*rows]);
-			    }
-			    printf("\n");
-			}
-			biasPos_debug  += h2hsize;
-		    }
-		}
 		// Show matrix index
 		printf("Time-MatrixIdx\n");
 		if (fraction.auxDataDim()>0){
@@ -1000,9 +977,11 @@ namespace layers {
 		 this->precedingLayer().outputBufPtrBias(timeStep * this->parallelSequences(), 0)));
 	
 	int rows = this->size() / (m_isBidirectional ? 2 : 1);
+	int curStep = (this->getSaveMemoryFlag() ?
+		       (timeStep % NN_RECURRENT_RING_BUFFER_LENGTH) : timeStep);
 	m_fw.unitActsWrapA   = helpers::Matrix<TDevice>(
 		&m_fw.unitActs, rows, this->parallelSequences(),
-		timeStep * this->parallelSequences() * rows);
+		curStep * this->parallelSequences() * rows);
     }
 
     template <typename TDevice>
@@ -1048,9 +1027,7 @@ namespace layers {
 		if (timestep != 0) {
 		    // Add W*H_t-1 to output
 		    if (m_clockRNN){
-			m_fw.timestepMatrices[timestep].unitActsBufWrapT.assignProduct(
-			      m_fw.timestepMatrices[timestep].h2hWrap,           true, 
-			      m_fw.timestepMatrices[timestep-1].tmpOutputsWrapT, false);
+			this->_clockH2HForward(m_fw, false, timestep, timestep-1);
 		    }else{
 			m_fw.timestepMatrices[timestep].unitActsBufWrapT.assignProduct(
 			      m_fw.weightMatrices.HiddenToHiddenWrap,            true, 
@@ -1088,9 +1065,7 @@ namespace layers {
 		    if (timestep != this->curMaxSeqLength()-1) {
 			// Add W*H_t+1 to output
 			if (m_clockRNN){
-			    m_bw.timestepMatrices[timestep].unitActsBufWrapT.assignProduct(
-				m_bw.timestepMatrices[timestep].h2hWrap, true, 
-				m_bw.timestepMatrices[timestep+1].tmpOutputsWrapT, false);
+			    this->_clockH2HForward(m_bw, true, timestep, timestep+1);
 			}else{
 			    m_bw.timestepMatrices[timestep].unitActsBufWrapT.assignProduct(
 				m_bw.weightMatrices.HiddenToHiddenWrap, true, 
@@ -1191,13 +1166,23 @@ namespace layers {
 	    // shift to the data of the next time step
 	    // (one time step may contain multiple parallel utterances)
             int n   = this->parallelSequences() * els;             
+
+	    // in memory save mode, the buffers are rings over the time steps
+	    int curStep = timeStep;
+	    int preStep = timeStep - 1;
+	    if (this->getSaveMemoryFlag()){
+		curStep = timeStep % NN_RECURRENT_RING_BUFFER_LENGTH;
+		preStep = (timeStep + NN_RECURRENT_RING_BUFFER_LENGTH - 1) %
+		    NN_RECURRENT_RING_BUFFER_LENGTH;
+	    }
 	    
 	    // forward states
             internal::ComputeBlockOutputFn fn;
             fn.effLayerSize       = els;
-            fn.prevOutputDistance = -n;
+            fn.prevOutputDistance = (preStep - curStep) * n;
             fn.bias               = this->bias();
-            fn.patTypes           = helpers::getRawPointer(this->patTypes());
+            fn.patTypes           = (helpers::getRawPointer(this->patTypes()) +
+				     (timeStep - curStep) * this->parallelSequences());
             fn.biasWeights        = _rawBiasWeights;
             fn.unitActs           = helpers::getRawPointer(m_fw.unitActs);
 	    fn.unitActsBuf        = helpers::getRawPointer(m_fw.unitActsBuf);
@@ -1207,31 +1192,29 @@ namespace layers {
 	    if (timeStep != 0) {
 		// Add W*H_t-1 to output
 		if (m_clockRNN){
-		    m_fw.timestepMatrices[timeStep].unitActsBufWrapT.assignProduct(
-			 m_fw.timestepMatrices[timeStep].h2hWrap,           true, 
-			 m_fw.timestepMatrices[timeStep-1].tmpOutputsWrapT, false);
+		    this->_clockH2HForward(m_fw, false, curStep, preStep);
 		}else{
-		    m_fw.timestepMatrices[timeStep].unitActsBufWrapT.assignProduct(
+		    m_fw.timestepMatrices[curStep].unitActsBufWrapT.assignProduct(
 			 m_fw.weightMatrices.HiddenToHiddenWrap,            true, 
-			 m_fw.timestepMatrices[timeStep-1].tmpOutputsWrapT, false);
+			 m_fw.timestepMatrices[preStep].tmpOutputsWrapT, false);
 		}
 	    }
 
 	    // for ClockRNN
 	    if (m_clockRNN)
 		fn.skipCRNN  = (helpers::getRawPointer(m_fw.skipCR) + 
-				m_fw.timestepMatrices[timeStep].skipCRPos);
+				m_fw.timestepMatrices[curStep].skipCRPos);
 	    else
 		fn.skipCRNN  = NULL;
 		
 	    thrust::transform(
-		  thrust::counting_iterator<int>(n*timeStep),
-		  thrust::counting_iterator<int>(n*timeStep) + n,
+		  thrust::counting_iterator<int>(n*curStep),
+		  thrust::counting_iterator<int>(n*curStep) + n,
 		  thrust::make_zip_iterator(
 		    thrust::make_tuple(
 		      thrust::constant_iterator<bool>(!timeStep), 
 		      thrust::constant_iterator<bool>(timeStep >= this->curMinSeqLength()))),
-		  m_fw.tmpOutputs.begin() + n*timeStep,
+		  m_fw.tmpOutputs.begin() + n*curStep,
 		  fn
 		);
 	}}
@@ -1366,11 +1349,9 @@ namespace layers {
 			    
 					     }}*/
 			// step2. get the errors
-			m_fw.timestepMatrices[timestep].tmpOutputErrorsWrapT.addProduct(
-				m_fw.timestepMatrices[timestep+1].h2hWrap, false, 
-				m_fw.timestepMatrices[timestep+1].unitDeltasWrapT, false);
-			// Note: h2hWrap contains 1-diagonal block, which copies the gradient
-			//       from the next step to this step.
+			this->_clockH2HBackward(m_fw, false, timestep, timestep+1);
+			// Note: the gradients of the units skipped in the next step are
+			//       copied from the next step to this step.
 			//       Together with step3 below, the gradient w.r.t hidden, input and
 			//       bias can be correctly set
 			
@@ -1452,9 +1433,7 @@ namespace layers {
 			    
 			    }}*/
 			    // step2. get the errors
-			    m_bw.timestepMatrices[timestep].tmpOutputErrorsWrapT.addProduct(
-				m_bw.timestepMatrices[timestep-1].h2hWrap, false, 
-				m_bw.timestepMatrices[timestep-1].unitDeltasWrapT, false);
+			    this->_clockH2HBackward(m_bw, true, timestep, timestep-1);
 
 			    // step3. set the gradient of the next step to zero
 			    /*{{
@@ -1545,7 +1524,8 @@ namespace layers {
         }}
 
 	// step3. update the weight and bias of this layer
-	{{
+	//        (skipped in the errors-only backward pass)
+	if (!this->flagErrorsOnlyBackward()) {{
 
 	    int rows = this->size() / (m_isBidirectional ? 2 : 1);
 	    int cols = (this->curMaxSeqLength()-1) * this->parallelSequences();
@@ -1634,6 +1614,55 @@ namespace layers {
 							  m_iterUpdate,        allocator);
     }
     
+    template <typename TDevice>
+    void RnnLayer<TDevice>::reduceOutputBuffer()
+    {
+	// only the unidirectional RNN in generation mode
+	if (m_isBidirectional || m_clockRNN || this->flagTrainingMode())
+	    return;
+
+	int rows    = this->size();
+	int cols    = this->parallelSequences();
+	int bufSize = NN_RECURRENT_RING_BUFFER_LENGTH * rows * cols;
+
+	this->resizeOutputBuffer(bufSize);
+	
+	m_fw.unitActs.clear();    m_fw.unitActs.shrink_to_fit();
+	m_fw.unitActsBuf.clear(); m_fw.unitActsBuf.shrink_to_fit();
+	m_fw.unitDeltas.clear();  m_fw.unitDeltas.shrink_to_fit();
+	m_fw.unitActs    = Cpu::real_vector(bufSize, 0.0);
+	m_fw.unitActsBuf = Cpu::real_vector(bufSize, 0.0);
+
+	// re-wrap the buffers of each time step
+	m_fw.tmpOutputs.swap(this->_outputs());
+	m_fw.timestepMatrices.resize(NN_RECURRENT_RING_BUFFER_LENGTH);
+	for (int timestep = 0; timestep < NN_RECURRENT_RING_BUFFER_LENGTH; ++timestep) {
+	    int offset = timestep * rows * cols;
+	    m_fw.timestepMatrices[timestep].tmpOutputsWrapT = 
+		helpers::Matrix<TDevice>(&m_fw.tmpOutputs,  rows, cols, offset);
+	    m_fw.timestepMatrices[timestep].unitActsWrapT = 
+		helpers::Matrix<TDevice>(&m_fw.unitActs,    rows, cols, offset);
+	    m_fw.timestepMatrices[timestep].unitActsBufWrapT = 
+		helpers::Matrix<TDevice>(&m_fw.unitActsBuf, rows, cols, offset);
+	}
+	m_fw.tmpOutputs.swap(this->_outputs());
+
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+
+    template <typename TDevice>
+    int RnnLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel, const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    int timeStep = timeStepTimesParallel / this->parallelSequences();
+	    return (timeStep - timeStep % NN_RECURRENT_RING_BUFFER_LENGTH) *
+		this->parallelSequences() * this->size();
+	}else{
+	    return 0;
+	}
+    }
+    
     // explicit template instantiations
     template class RnnLayer<Cpu>;
     template class RnnLayer<Gpu>;
@@ -61,8 +61,7 @@ namespace layers{
      *      [0 this->_outputs().size()-1]: (size * (parallel*maxLength))
      *    ~ a vector mask for ClockRNN
      *      [0 this->size() * parallel]: size * parallel 
-     *    ~ matrix mask for ClockRNN
-     *      same as the weights from preceding layer (triangle matrix)
+     *    ~ ClockRNN uses the (block triangle) sub-blocks of the recurrent link directly
      ************************************************************************/
 
     template <typename TDevice>
@@ -90,10 +89,9 @@ namespace layers{
 	    helpers::Matrix<TDevice> unitActsBufWrapT;     // 
 	    
 	    // For ClockRNN
-	    helpers::Matrix<TDevice> h2hWrap;        // a simple wrapper for clock RNN in BP
 	    // bool_vector              skipCR;      // whether a dimension should be skippped
 	    int                      skipCRPos;      // where should I found the skipCR ?
-	    int                      h2hIdx;         //
+	    int                      h2hIdx;         // (bit mask of the updated bands) - 1
 	    int_vector               m_crS;                // 
 	    int_vector               m_crE;                //
 	    real_t *                 unitDeltaP;
@@ -144,9 +142,6 @@ namespace layers{
 	std::string              m_crStepStr;       
 	Cpu::int_vector          m_crStep;          // a vector of [start1,end1,...,end1,endN]
 	int_vector               m_crStepDevice;    //
-	real_vector              m_h2hClockRNN;     // duplicated H2H matrices for each possible
-	                                            // updating schedule
-	int                      m_numH2Hmat;       // number of possible updating schedule
 
 	int                      m_iterUpdate;      //
 
@@ -155,6 +150,12 @@ namespace layers{
 	// is trainable or not
 	// helpers::Matrix<TDevice> m_precLayerOutputsErrorWrapA;
 
+	// For ClockRNN: hidden to hidden link of the active bands
+	void _clockH2HForward(forward_backward_info_t &fwbw, const bool bwDir,
+			      const int curStep, const int preStep);
+	void _clockH2HBackward(forward_backward_info_t &fwbw, const bool bwDir,
+			       const int curStep, const int nextStep);
+
     public:
         /**
          * Constructs the Layer
@@ -169,7 +170,8 @@ namespace layers{
             const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
 	    int                        maxSeqLength,
-            bool                      bidirectional = false
+            bool                      bidirectional = false,
+            typename TDevice::real_vector *sharedWeights = NULL
             );
 
         /**
@@ -221,6 +223,11 @@ namespace layers{
          */
         virtual void computeForwardPass(const int timeStep, const int nnState);
 
+	// memory save mode for generation (ring buffer over the time steps)
+	virtual void reduceOutputBuffer();
+
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
+
     };
 
 } // namespace layers
@@ -49,21 +49,19 @@ namespace internal{
 namespace{
 
     // Generating noise
+    // Modify 20181018: counter-based generator, each element is generated independently
     struct tempPrg
     {
 	float a, b;
-	int   seed;
+	helpers::philox::stream_t stream;
 	
-	__host__ __device__
-	tempPrg(float _a=-1.f, float _b=1.f, int _seed=123) : a(_a), b(_b), seed(_seed) {};
+	tempPrg(float _a, float _b, const helpers::philox::stream_t &_stream)
+	    : a(_a), b(_b), stream(_stream) {};
 
 	__host__ __device__
 	float operator()(const unsigned int n) const
 	{
-	    thrust::default_random_engine rng(seed);
-	    thrust::uniform_real_distribution<float> dist(a, b);
-	    rng.discard(n);
-	    return dist(rng);
+	    return helpers::philox::uniform(stream, n, a, b);
 	}
     };
 
@@ -79,11 +77,14 @@ namespace layers{
 					const helpers::JsonValue &layerChild,
 					const helpers::JsonValue &weightsSection,
 					std::vector<Layer<TDevice>*> &precedingLayers,
-					int maxSeqLength)
+					int maxSeqLength,
+					typename TDevice::real_vector *sharedWeights)
 	// use preLayers[0] as fake preceding layers
-	: SkipLayer<TDevice>(layerChild, weightsSection, precedingLayers, maxSeqLength, false)
+	: SkipLayer<TDevice>(layerChild, weightsSection,
+	                     precedingLayers, maxSeqLength, false, sharedWeights)
 	, m_noiseRatio      (-1.0)
 	, m_flagSkipInit    (true)
+	, m_fusedLayer      (false)
     {
 	// Initial check
 	if (precedingLayers.size() < 1)
@@ -168,11 +169,38 @@ namespace layers{
     template <typename TDevice>
     typename SkipAddLayer<TDevice>::real_vector& SkipAddLayer<TDevice>::outputs()
     {
-	if (m_virtualLayer)
+	if (m_virtualLayer || m_fusedLayer)
 	    return this->precedingLayer().outputs();
 	else
 	    return this->_outputs();
     }
+
+    template <typename TDevice>
+    bool SkipAddLayer<TDevice>::fuseIntoPrecedingLayer()
+    {
+	// only for skipadd (one skip layer + the preceding layer) in generation
+	if (this->flagTrainingMode() || m_virtualLayer || m_flagSkipInit ||
+	    m_noiseRatio > 0 || m_preLayers.size() != 2)
+	    return false;
+
+	Layer<TDevice> *producer   = &this->precedingLayer();
+	Layer<TDevice> *skipSource = NULL;
+	if (m_preLayers[1] == producer && m_preLayers[0] != producer)
+	    skipSource = m_preLayers[0];
+	else if (m_preLayers[0] == producer && m_preLayers[1] != producer)
+	    skipSource = m_preLayers[1];
+	else
+	    return false;
+
+	// the preceding layer adds the skip layer when writing its output
+	if (!producer->fuseSkipAddSource(skipSource))
+	    return false;
+	
+	m_fusedLayer = true;
+	this->clearOutputBuffer();
+	printf("\n\tFused into %s", producer->name().c_str());
+	return true;
+    }
     
     // NN forward
     template <typename TDevice>
@@ -194,7 +222,7 @@ namespace layers{
 	}
 
 	// processing
-	if (m_virtualLayer){
+	if (m_virtualLayer || m_fusedLayer){
 	    // if virtual Layer, no need to do anything
 	    return;
 	}else{
@@ -206,8 +234,7 @@ namespace layers{
 		    (index_sequence_begin +
 		     this->curMaxSeqLength() * this->parallelSequences() * this->size()),
 		    this->outputs().begin(),
-		    internal::tempPrg(-1.0 * m_noiseRatio, m_noiseRatio,
-				      (int)(misFuncs::GetRandomNumber() * 10000.0)));
+		    internal::tempPrg(-1.0 * m_noiseRatio, m_noiseRatio, this->_randomStream()));
 	    }else{
 		thrust::fill(this->outputs().begin(), 
 			     (this->outputs().begin() + 
@@ -240,7 +267,7 @@ namespace layers{
 	int shiftIn  = 0; // value to assigned layer
 	int shiftOut = this->outputBufPtrBias(timeStep * this->parallelSequences(), nnState);
 	
-	if (m_virtualLayer){
+	if (m_virtualLayer || m_fusedLayer){
 	    // virtual layer, no need to do anything
 	    return;
 	}else{
@@ -364,7 +391,7 @@ namespace layers{
     template <typename TDevice>
     void SkipAddLayer<TDevice>::reduceOutputBuffer()
     {
-	if (m_virtualLayer){
+	if (m_virtualLayer || m_fusedLayer){
 	    // this->clearOutputBuffer() // this has been done
 	}else{
 	    this->resizeOutputBuffer(this->parallelSequences() * this->size());
@@ -376,7 +403,7 @@ namespace layers{
     template <typename TDevice>
     int SkipAddLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel, const int nnState)
     {
-	if (m_virtualLayer){
+	if (m_virtualLayer || m_fusedLayer){
 	    return this->precedingLayer().outputBufPtrBias(timeStepTimesParallel, nnState);
 	}else if (this->getSaveMemoryFlag()){
 	    return timeStepTimesParallel * this->size();
@@ -55,6 +55,7 @@ namespace layers {
 
 	bool                         m_flagSkipInit; // this layer SkipInit or SkipAdd
 	bool                         m_virtualLayer;
+	bool                         m_fusedLayer;   // addition is done by the preceding layer
 	real_t                       m_noiseRatio;
 	std::string                  m_previousSkipStr;
     public:
@@ -64,7 +65,8 @@ namespace layers {
 		     const helpers::JsonValue &layerChild,
 		     const helpers::JsonValue &weightsSection,
 		     std::vector<Layer<TDevice>*> &precedingLayers,
-		     int maxSeqLength
+		     int maxSeqLength,
+		     typename TDevice::real_vector *sharedWeights = NULL
 		     );
 
 	// Destructor
@@ -100,6 +102,9 @@ namespace layers {
 	virtual void reduceOutputBuffer();
 
 	virtual int outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
+
+	// fuse the addition into the output of the preceding layer (generation only)
+	bool fuseIntoPrecedingLayer();
 	
     };
 
@@ -97,9 +97,11 @@ namespace layers{
 					const helpers::JsonValue &layerChild,
 					const helpers::JsonValue &weightsSection,
 					std::vector<Layer<TDevice>*> &precedingLayers,
-					int maxSeqLength)
+					int maxSeqLength,
+					typename TDevice::real_vector *sharedWeights)
 	// use preLayers[0] as fake preceding layers
-	: SkipLayer<TDevice>(layerChild, weightsSection, precedingLayers, maxSeqLength, false)
+	: SkipLayer<TDevice>(layerChild, weightsSection,
+	                     precedingLayers, maxSeqLength, false, sharedWeights)
     {
 	// initialization
 	m_preLayers.clear();
@@ -261,40 +263,45 @@ namespace layers{
 	int effTimeS = timeStep     * this->parallelSequences();
 	int effTimeE = (timeStep+1) * this->parallelSequences();
 
+	// shift of the output pointer when this layer is reduced in memory
+	int shiftOut = this->outputBufPtrBias(effTimeS, nnState);
+	int shiftIn  = 0;
+	
 	// initialization without noise
-	thrust::fill(this->outputs().begin() + effTimeS * this->size(), 
-		     this->outputs().begin() + effTimeE * this->size(), 
+	thrust::fill(this->outputs().begin() + effTimeS * this->size() - shiftOut, 
+		     this->outputs().begin() + effTimeE * this->size() - shiftOut, 
 		     0.0);
 
 	{{
+	    // the pointers are moved to the current frame, so that the preceding layers
+	    // and this layer can be reduced in memory
 	    internal::CopyPartSkipCat fn;
-	    fn.target   = helpers::getRawPointer(this->outputs());
+	    fn.target   = (helpers::getRawPointer(this->outputs()) +
+			   effTimeS * this->size() - shiftOut);
 	    fn.tarDim   = this->size();
-	    fn.patTypes = helpers::getRawPointer(this->precedingLayer().patTypes());
+	    fn.patTypes = helpers::getRawPointer(this->precedingLayer().patTypes()) + effTimeS;
 	    fn.accumulate = false;
-	    int n = this->precedingLayer().curMaxSeqLength();
- 	    n = n * this->precedingLayer().parallelSequences() * fn.copyDim ;
 
 	    int cnt = 0;
 	    BOOST_FOREACH (Layer<TDevice> *layer, m_preLayers) {
 		
-		if (layer->getSaveMemoryFlag())
-		    throw std::runtime_error("SkipCat is not ready for reduced memory input");
-
+		shiftIn    = layer->outputBufPtrBias(effTimeS, nnState);
 		fn.tarS    = m_preSkipDimAccu[cnt/2];
-		fn.source  = helpers::getRawPointer(layer->outputs());
+		fn.source  = (helpers::getRawPointer(layer->outputs()) +
+			      effTimeS * layer->size() - shiftIn);
 		fn.srcDim  = layer->size();
 		fn.srcS    = m_preSkipDim[cnt];
 		fn.copyDim = m_preSkipDim[cnt+1] - m_preSkipDim[cnt];
+		int n      = this->parallelSequences() * fn.copyDim;
 		thrust::for_each(
 		   thrust::make_zip_iterator(
 			thrust::make_tuple(
-				this->outputs().begin()           + effTimeS * fn.copyDim, 
-				thrust::counting_iterator<int>(0) + effTimeS * fn.copyDim)),
+				this->outputs().begin(), 
+				thrust::counting_iterator<int>(0))),
 		   thrust::make_zip_iterator(
 			thrust::make_tuple(
-				this->outputs().begin()           + effTimeE * fn.copyDim, 
-				thrust::counting_iterator<int>(0) + effTimeE * fn.copyDim)),
+				this->outputs().begin()           + n, 
+				thrust::counting_iterator<int>(0) + n)),
 		fn);
 		cnt += 2;
 	    }
@@ -402,6 +409,25 @@ namespace layers{
     }
     */
 
+    template <typename TDevice>
+    void SkipCatLayer<TDevice>::reduceOutputBuffer()
+    {
+	this->resizeOutputBuffer(this->parallelSequences() * this->size());
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+
+    template <typename TDevice>
+    int SkipCatLayer<TDevice>::outputBufPtrBias(const int timeStepTimesParallel, const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    return timeStepTimesParallel * this->size();
+	}else{
+	    return 0;
+	}
+    }
+    
+
     template class SkipCatLayer<Cpu>;
     template class SkipCatLayer<Gpu>;
     
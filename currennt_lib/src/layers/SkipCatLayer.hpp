@@ -64,7 +64,8 @@ namespace layers {
 		     const helpers::JsonValue &layerChild,
 		     const helpers::JsonValue &weightsSection,
 		     std::vector<Layer<TDevice>*> &precedingLayers,
-		     int maxSeqLength);
+		     int maxSeqLength,
+		     typename TDevice::real_vector *sharedWeights = NULL);
 
 	// Destructor
 	virtual ~SkipCatLayer();
@@ -94,6 +95,11 @@ namespace layers {
 	virtual void exportLayer(const helpers::JsonValue &layersArray,
 				 const helpers::JsonAllocator &allocator) const;
 
+	// memory save mode for generation
+	virtual void reduceOutputBuffer();
+
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
+
     };
 
 }
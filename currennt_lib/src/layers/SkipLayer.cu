@@ -38,10 +38,12 @@ namespace layers{
 				  const helpers::JsonValue &weightsSection,
 				  std::vector<Layer<TDevice>*> precedingLayers,
 				  int maxSeqLength,
-				  bool trainable)
+				  bool trainable,
+				  typename TDevice::real_vector *sharedWeights)
 	// use preLayers[0] as fake preceding layers
 	: TrainableLayer<TDevice>(layerChild, weightsSection,
-				  (trainable ? 1 : 0), 0, *(precedingLayers.back()), maxSeqLength)
+				  (trainable ? 1 : 0), 0, *(precedingLayers.back()), maxSeqLength,
+				  sharedWeights)
     {
 	if (this->flagTrainingMode())
 	    m_outputErrorsFromSkipLayer = Cpu::real_vector(this->outputs().size(), (real_t)0.0);
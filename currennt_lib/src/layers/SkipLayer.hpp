@@ -66,7 +66,8 @@ namespace layers {
 		  const helpers::JsonValue &weightsSection,
 		  std::vector<Layer<TDevice>*> precedingLayers,
 		  int maxSeqLength,
-		  bool trainable);
+		  bool trainable,
+		  typename TDevice::real_vector *sharedWeights = NULL);
 
 	// Destructor
 	virtual ~SkipLayer();
@@ -191,9 +191,11 @@ namespace layers{
 					const helpers::JsonValue &layerChild,
 					const helpers::JsonValue &weightsSection,
 					std::vector<Layer<TDevice>*> &precedingLayers,
-					int maxSeqLength)
+					int maxSeqLength,
+					typename TDevice::real_vector *sharedWeights)
 	// use preLayers[0] as fake preceding layers
-	: SkipLayer<TDevice>(layerChild, weightsSection, precedingLayers, maxSeqLength, true)
+	: SkipLayer<TDevice>(layerChild, weightsSection,
+	                     precedingLayers, maxSeqLength, true, sharedWeights)
     {
 	// currently, only two previous layers are allowed: one from previous skiplayer, and another
 	//  from normal feed-forward layer
@@ -326,12 +328,15 @@ namespace layers{
     void SkipParaLayer<TDevice, TActFn>::computeForwardPass(const int timeStep, const int nnState)
     {
 
-	if (this->precedingLayer().getSaveMemoryFlag() || this->preSkipLayer()->getSaveMemoryFlag())
-	    throw std::runtime_error("SkipPara layer is not ready for reduced memory input");
-	
 	int effTimeS = timeStep     * this->parallelSequences();
 	int effTimeE = (timeStep+1) * this->parallelSequences();
 
+	// shift of the pointers when the layers are reduced in memory
+	// (the gate output is reduced together with the output of this layer)
+	int shiftOut  = this->outputBufPtrBias(effTimeS, nnState);
+	int shiftPre  = this->precedingLayer().outputBufPtrBias(effTimeS, nnState);
+	int shiftSkip = this->preSkipLayer()->outputBufPtrBias(effTimeS, nnState);
+
 	// Do the Forward Pass
 	// calculate the gate output (in the same way as feed-forward layer, but on the gate unit)
 	// step1: linear transform
@@ -344,11 +349,11 @@ namespace layers{
 	    helpers::Matrix<TDevice> plOutputsMatrix(&this->preSkipLayer()->outputs(),
 						     this->preSkipLayer()->size(), 
 						     this->parallelSequences(),
-						     effTimeS * this->precedingLayer().size());
+						     effTimeS * this->preSkipLayer()->size() - shiftSkip);
 	    helpers::Matrix<TDevice> outputsMatrix  (&this->gateOutput(),            
 						     this->size(),                
 						     this->parallelSequences(),
-						     effTimeS * this->size());
+						     effTimeS * this->size() - shiftOut);
 	    
 	    outputsMatrix.assignProduct(weightMatrix, true, plOutputsMatrix, false);
 	}}
@@ -363,10 +368,10 @@ namespace layers{
 				    this->size()*this->preSkipLayer()->size());
 		
 		thrust::transform(
-			this->gateOutput().begin() + effTimeS * this->size(),
-			this->gateOutput().begin() + effTimeE * this->size(),
+			this->gateOutput().begin() + effTimeS * this->size() - shiftOut,
+			this->gateOutput().begin() + effTimeE * this->size() - shiftOut,
 			thrust::counting_iterator<int>(0),
-			this->gateOutput().begin() + effTimeS * this->size(),
+			this->gateOutput().begin() + effTimeS * this->size() - shiftOut,
 			fn);
 	}}
 	
@@ -378,16 +383,16 @@ namespace layers{
 		thrust::for_each(
 		      thrust::make_zip_iterator(
 			thrust::make_tuple(
-			    this->precedingLayer().outputs().begin() + effTimeS * this->size(),   
-			    this->gateOutput().begin()               + effTimeS * this->size(),
-			    this->preSkipLayer()->outputs().begin()  + effTimeS * this->size(),    
-			    this->_outputs().begin()                 + effTimeS * this->size())),
+			    this->precedingLayer().outputs().begin() + effTimeS*this->size() - shiftPre,
+			    this->gateOutput().begin()               + effTimeS*this->size() - shiftOut,
+			    this->preSkipLayer()->outputs().begin()  + effTimeS*this->size() - shiftSkip,
+			    this->_outputs().begin()                 + effTimeS*this->size() - shiftOut)),
 		      thrust::make_zip_iterator(
 			thrust::make_tuple(
-			    this->precedingLayer().outputs().begin() + effTimeE * this->size(), 
-			    this->gateOutput().begin()               + effTimeE * this->size(),
-			    this->preSkipLayer()->outputs().begin()  + effTimeE * this->size(),  
-			    this->_outputs().begin()                 + effTimeE * this->size())),
+			    this->precedingLayer().outputs().begin() + effTimeE*this->size() - shiftPre,
+			    this->gateOutput().begin()               + effTimeE*this->size() - shiftOut,
+			    this->preSkipLayer()->outputs().begin()  + effTimeE*this->size() - shiftSkip,
+			    this->_outputs().begin()                 + effTimeE*this->size() - shiftOut)),
 		      fn);
 	}}
 	// done.
@@ -566,6 +571,29 @@ namespace layers{
         return s;
     }
 
+    template <typename TDevice, typename TActFn>
+    void SkipParaLayer<TDevice, TActFn>::reduceOutputBuffer()
+    {
+	this->resizeOutputBuffer(this->parallelSequences() * this->size());
+	m_gateOutput.clear(); m_gateOutput.shrink_to_fit();
+	m_gateErrors.clear(); m_gateErrors.shrink_to_fit();
+	m_gateOutput = Cpu::real_vector(this->parallelSequences() * this->size(), 0.0);
+	this->setSaveMemoryFlag(true);
+	printf("\t[mem saved]");
+    }
+
+    template <typename TDevice, typename TActFn>
+    int SkipParaLayer<TDevice, TActFn>::outputBufPtrBias(const int timeStepTimesParallel,
+							 const int nnState)
+    {
+	if (this->getSaveMemoryFlag()){
+	    return timeStepTimesParallel * this->size();
+	}else{
+	    return 0;
+	}
+    }
+    
+
     template class SkipParaLayer<Cpu, activation_functions::Tanh>;
     template class SkipParaLayer<Gpu, activation_functions::Tanh>;
     template class SkipParaLayer<Cpu, activation_functions::Logistic>;
@@ -75,7 +75,8 @@ namespace layers {
 		     const helpers::JsonValue &layerChild,
 		     const helpers::JsonValue &weightsSection,
 		     std::vector<Layer<TDevice>*> &precedingLayers,
-		     int maxSeqLength
+		     int maxSeqLength,
+		     typename TDevice::real_vector *sharedWeights = NULL
 		     );
 
 	// Destructor
@@ -105,6 +106,11 @@ namespace layers {
 	
 	// 
 	real_vector& gateErrors();
+
+	// memory save mode for generation
+	virtual void reduceOutputBuffer();
+
+	virtual int  outputBufPtrBias(const int timeStepTimesParallel, const int nnState);
 	
     };
 
@@ -29,6 +29,7 @@
 #include "../helpers/min.cuh"
 #include "../helpers/max.cuh"
 #include "../helpers/safeExp.cuh"
+#include "../helpers/onlineSoftmax.cuh"
 #include "../activation_functions/Identity.cuh"
 
 #include <thrust/transform.h>
@@ -43,41 +44,81 @@
 namespace internal {
 namespace {
 
-    struct CalculateOffsetFn
+    // Add 20181012: softmax of one pattern on the CPU, computed in place
+    //  the loops over the pattern are vectorized (helpers/onlineSoftmax.cuh)
+    struct ComputeSoftmaxFn
     {
         int layerSize;
 
-        const real_t *outputs;
+        real_t *outputs;
 
         const char *patTypes;
 
         __host__ __device__ real_t operator() (const int &patIdx) const
         {
-            // check if the pattern belongs to a sequence;
-            // if not we return a certain number to avoid 
-            // looking up patTypes for future calculations
+            // check if the pattern belongs to a sequence
             if (patTypes[patIdx] == PATTYPE_NONE)
                 return SKIP_MARKER;
 
-            // search for the min and max output
-            real_t max = helpers::NumericLimits<real_t>::min();
-            real_t min = helpers::NumericLimits<real_t>::max();
+            real_t *offOutputs = &outputs[patIdx * layerSize];
 
-            const real_t *offOutputs = &outputs[patIdx * layerSize];
+            real_t maxValue = helpers::softmaxMax(offOutputs, layerSize);
+            real_t sum      = helpers::softmaxExpSum(offOutputs, offOutputs, layerSize, maxValue);
+            helpers::softmaxScale(offOutputs, layerSize, sum);
 
-            for (int i = 0; i < layerSize; ++i) {
-                real_t x = offOutputs[i];
-                min = helpers::min(min, x);
-                max = helpers::max(max, x);
-            }
+            return sum;
+        }
+    };
 
-            // calculate the offset
-            real_t offset = (real_t)0.5 * (min + max);
+    // Add 20181012: errors of one pattern on the CPU, computed in place
+    //  e_i = y_i * (e_i - sum_k y_k * e_k)
+    struct ComputeSoftmaxErrorsFn
+    {
+        int layerSize;
+
+        const real_t *outputs;
+        real_t       *outputErrors;
+
+        const char *patTypes;
+
+        __host__ __device__ real_t operator() (const int &patIdx) const
+        {
+            if (patTypes[patIdx] == PATTYPE_NONE)
+                return SKIP_MARKER;
+
+            const real_t *offOutputs      = &outputs     [patIdx * layerSize];
+            real_t       *offOutputErrors = &outputErrors[patIdx * layerSize];
+
+            real_t offset = helpers::softmaxJacobianOffset(offOutputs, offOutputErrors,
+                                                           layerSize);
+            for (int i = 0; i < layerSize; ++i)
+                offOutputErrors[i] = offOutputs[i] * (offOutputErrors[i] - offset);
 
             return offset;
         }
     };
 
+    // GPU: the maximum of each pattern is the offset of the exp
+    struct CalculateOffsetFn
+    {
+        int layerSize;
+
+        const real_t *outputs;
+
+        const char *patTypes;
+
+        __host__ __device__ real_t operator() (const int &patIdx) const
+        {
+            // check if the pattern belongs to a sequence;
+            // if not we return a certain number to avoid 
+            // looking up patTypes for future calculations
+            if (patTypes[patIdx] == PATTYPE_NONE)
+                return SKIP_MARKER;
+
+            return helpers::softmaxMax(&outputs[patIdx * layerSize], layerSize);
+        }
+    };
+
     struct CalculateExpFn
     {
         int layerSize;
@@ -219,6 +260,104 @@ namespace {
         }
     };
 
+    // Add 20181018: softmax of patNum patterns in place
+    //  CPU: one call per pattern, GPU: one thread per element for the exp and the
+    //  normalization (the maximum and the sum are computed per pattern)
+    void softmaxForward(Cpu::real_vector &outputs, Cpu::real_vector &patTmp,
+                        const char *patTypes, const int layerSize, const int patNum)
+    {
+        internal::ComputeSoftmaxFn fn;
+        fn.layerSize = layerSize;
+        fn.outputs   = helpers::getRawPointer(outputs);
+        fn.patTypes  = patTypes;
+        thrust::transform(thrust::counting_iterator<int>(0),
+                          thrust::counting_iterator<int>(0) + patNum,
+                          patTmp.begin(), fn);
+    }
+
+    void softmaxForward(Gpu::real_vector &outputs, Gpu::real_vector &patTmp,
+                        const char *patTypes, const int layerSize, const int patNum)
+    {
+        int n = patNum * layerSize;
+        {{
+            internal::CalculateOffsetFn fn;
+            fn.layerSize = layerSize;
+            fn.outputs   = helpers::getRawPointer(outputs);
+            fn.patTypes  = patTypes;
+            thrust::transform(thrust::counting_iterator<int>(0),
+                              thrust::counting_iterator<int>(0) + patNum,
+                              patTmp.begin(), fn);
+        }}
+        {{
+            internal::CalculateExpFn fn;
+            fn.layerSize = layerSize;
+            fn.offsets   = helpers::getRawPointer(patTmp);
+            thrust::for_each(
+                thrust::make_zip_iterator(thrust::make_tuple(outputs.begin(),   thrust::counting_iterator<int>(0))),
+                thrust::make_zip_iterator(thrust::make_tuple(outputs.begin()+n, thrust::counting_iterator<int>(0)+n)),
+                fn);
+        }}
+        {{
+            internal::SumUpOutputsFn fn;
+            fn.layerSize = layerSize;
+            fn.outputs   = helpers::getRawPointer(outputs);
+            thrust::for_each(
+                thrust::make_zip_iterator(thrust::make_tuple(patTmp.begin(),        thrust::counting_iterator<int>(0))),
+                thrust::make_zip_iterator(thrust::make_tuple(patTmp.begin()+patNum, thrust::counting_iterator<int>(0)+patNum)),
+                fn);
+        }}
+        {{
+            internal::NormalizeOutputsFn fn;
+            fn.layerSize = layerSize;
+            fn.normFacts = helpers::getRawPointer(patTmp);
+            thrust::for_each(
+                thrust::make_zip_iterator(thrust::make_tuple(outputs.begin(),   thrust::counting_iterator<int>(0))),
+                thrust::make_zip_iterator(thrust::make_tuple(outputs.begin()+n, thrust::counting_iterator<int>(0)+n)),
+                fn);
+        }}
+    }
+
+    // Add 20181018: errors w.r.t. the softmax input, in place
+    void softmaxBackward(Cpu::real_vector &outputs, Cpu::real_vector &outputErrors,
+                         Cpu::real_vector &patTmp, const char *patTypes,
+                         const int layerSize, const int patNum)
+    {
+        internal::ComputeSoftmaxErrorsFn fn;
+        fn.layerSize    = layerSize;
+        fn.outputs      = helpers::getRawPointer(outputs);
+        fn.outputErrors = helpers::getRawPointer(outputErrors);
+        fn.patTypes     = patTypes;
+        thrust::transform(thrust::counting_iterator<int>(0),
+                          thrust::counting_iterator<int>(0) + patNum,
+                          patTmp.begin(), fn);
+    }
+
+    void softmaxBackward(Gpu::real_vector &outputs, Gpu::real_vector &outputErrors,
+                         Gpu::real_vector &patTmp, const char *patTypes,
+                         const int layerSize, const int patNum)
+    {
+        int n = patNum * layerSize;
+        {{
+            internal::CalculateErrorOffsetFn fn;
+            fn.layerSize    = layerSize;
+            fn.outputs      = helpers::getRawPointer(outputs);
+            fn.outputErrors = helpers::getRawPointer(outputErrors);
+            fn.patTypes     = patTypes;
+            thrust::transform(thrust::counting_iterator<int>(0),
+                              thrust::counting_iterator<int>(0) + patNum,
+                              patTmp.begin(), fn);
+        }}
+        {{
+            internal::CalculateErrorsFn fn;
+            fn.layerSize    = layerSize;
+            fn.errorOffsets = helpers::getRawPointer(patTmp);
+            thrust::for_each(
+                thrust::make_zip_iterator(thrust::make_tuple(outputErrors.begin(),   outputs.begin(),   thrust::counting_iterator<int>(0))),
+                thrust::make_zip_iterator(thrust::make_tuple(outputErrors.begin()+n, outputs.begin()+n, thrust::counting_iterator<int>(0)+n)),
+                fn);
+        }}
+    }
+
 } // anonymous namespace
 } // namespace internal
 
@@ -230,12 +369,15 @@ namespace layers {
         const helpers::JsonValue &layerChild, 
         const helpers::JsonValue &weightsSection,
         Layer<TDevice> &precedingLayer,
-	int maxSeqLength)
+	int maxSeqLength,
+	typename TDevice::real_vector *sharedWeights)
         : FeedForwardLayer<TDevice, TFfActFn>(layerChild, weightsSection,
-					      precedingLayer, maxSeqLength)
+					      precedingLayer, maxSeqLength,
+					      sharedWeights)
     {
         // resize the vector for temporary values
         m_patTmp.resize(this->patTypes().size());
+        m_fusedCEGrad = false;
     }
 
     template <typename TDevice, typename TFfActFn>
@@ -256,65 +398,10 @@ namespace layers {
         // compute the forward pass of the feedforward layer
         FeedForwardLayer<TDevice, TFfActFn>::computeForwardPass(nnState);
 
-        // calculate the offset to center the activations for safer exponentiation
-        {{
-            internal::CalculateOffsetFn fn;
-            fn.layerSize = this->size();
-            fn.outputs   = helpers::getRawPointer(this->_outputs());
-            fn.patTypes  = helpers::getRawPointer(this->patTypes());
-
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + this->curMaxSeqLength() * this->parallelSequences(),
-                m_patTmp.begin(),
-                fn
-                );
-        }}
-
-        // calculate the exponent
-        {{
-            internal::CalculateExpFn fn;
-            fn.layerSize = this->size();
-            fn.offsets   = helpers::getRawPointer(m_patTmp);
-
-            int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
-
-            thrust::for_each(
-                thrust::make_zip_iterator(thrust::make_tuple(this->_outputs().begin(),   thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(thrust::make_tuple(this->_outputs().begin()+n, thrust::counting_iterator<int>(0)+n)),
-                fn
-                );
-        }}
-
-        // sum up all outputs for each pattern
-        {{
-            internal::SumUpOutputsFn fn;
-            fn.layerSize = this->size();
-            fn.outputs   = helpers::getRawPointer(this->_outputs());
-
-            int n = this->curMaxSeqLength() * this->parallelSequences();
-
-            thrust::for_each(
-                thrust::make_zip_iterator(thrust::make_tuple(m_patTmp.begin(),   thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(thrust::make_tuple(m_patTmp.begin()+n, thrust::counting_iterator<int>(0)+n)),
-                fn
-                );
-        }}
-
-        // normalize the outputs
-        {{
-            internal::NormalizeOutputsFn fn;
-            fn.layerSize = this->size();
-            fn.normFacts = helpers::getRawPointer(m_patTmp);
-
-            int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
-
-            thrust::for_each(
-                thrust::make_zip_iterator(thrust::make_tuple(this->_outputs().begin(),   thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(thrust::make_tuple(this->_outputs().begin()+n, thrust::counting_iterator<int>(0)+n)),
-                fn
-                );
-        }}
+        // softmax of each pattern
+        internal::softmaxForward(this->_outputs(), m_patTmp,
+                                 helpers::getRawPointer(this->patTypes()), this->size(),
+                                 this->curMaxSeqLength() * this->parallelSequences());
     }
 
     template <typename TDevice, typename TFfActFn>
@@ -325,42 +412,25 @@ namespace layers {
     template <typename TDevice, typename TFfActFn>
     void SoftmaxLayer<TDevice, TFfActFn>::computeBackwardPass(const int nnState)
     {
-        // calculate the error offset for each pattern
-        {{
-            internal::CalculateErrorOffsetFn fn;
-            fn.layerSize    = this->size();
-            fn.outputs      = helpers::getRawPointer(this->_outputs());
-            fn.outputErrors = helpers::getRawPointer(this->outputErrors());
-            fn.patTypes     = helpers::getRawPointer(this->patTypes());
-
-            thrust::transform(
-                thrust::counting_iterator<int>(0),
-                thrust::counting_iterator<int>(0) + this->curMaxSeqLength() * this->parallelSequences(),
-                m_patTmp.begin(),
-                fn
-                );
-        }}
-
-        // calculate the errors
-        {{
-            internal::CalculateErrorsFn fn;
-            fn.layerSize    = this->size();
-            fn.errorOffsets = helpers::getRawPointer(m_patTmp);
-
-            int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
-
-            thrust::for_each(
-                thrust::make_zip_iterator(thrust::make_tuple(this->outputErrors().begin(),   this->_outputs().begin(),   thrust::counting_iterator<int>(0))),
-                thrust::make_zip_iterator(thrust::make_tuple(this->outputErrors().begin()+n, this->_outputs().begin()+n, thrust::counting_iterator<int>(0)+n)),
-                fn
-                );
-        }}
+        // when the post output layer gives the errors of softmax + cross-entropy, 
+        // the errors are already w.r.t. the input of the softmax function
+        if (!m_fusedCEGrad)
+            internal::softmaxBackward(this->_outputs(), this->outputErrors(), m_patTmp,
+                                      helpers::getRawPointer(this->patTypes()), this->size(),
+                                      this->curMaxSeqLength() * this->parallelSequences());
 
         // compute the backward pass of the feedforward layer
         FeedForwardLayer<TDevice, TFfActFn>::computeBackwardPass(nnState);
     }
 
 
+    template <typename TDevice, typename TFfActFn>
+    void SoftmaxLayer<TDevice, TFfActFn>::setFusedCrossEntropyGrad(const bool flag)
+    {
+        m_fusedCEGrad = flag;
+    }
+
+
     // explicit template instantiations
     template class SoftmaxLayer<Cpu, activation_functions::Identity>;
     template class SoftmaxLayer<Gpu, activation_functions::Identity>;
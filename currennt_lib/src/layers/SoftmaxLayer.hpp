@@ -42,6 +42,7 @@ namespace layers {
 
     private:
         real_vector m_patTmp;
+        bool        m_fusedCEGrad;   // errors are given w.r.t. the softmax input
 
     public:
         /**
@@ -55,7 +56,8 @@ namespace layers {
             const helpers::JsonValue &layerChild, 
             const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
             );
 
         /**
@@ -82,6 +84,14 @@ namespace layers {
          * @see Layer::computeBackwardPass()
          */
         virtual void computeBackwardPass(const int nnState);
+
+        /**
+         * Add 20181012: the errors of this layer are set by the post output layer
+         * as the gradients of softmax + cross-entropy (w.r.t. the softmax input)
+         *
+         * @param flag True if the softmax Jacobian shall be skipped in backward pass
+         */
+        void setFusedCrossEntropyGrad(const bool flag);
     };
 
 } // namespace layers
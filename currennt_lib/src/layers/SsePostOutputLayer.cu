@@ -134,6 +134,37 @@ namespace {
     	            return error;
     	            }
     	};
+
+    // Add 20181018: the squared error and the gradient in one pass
+    //  the gradient is written to outputErrors; weights is NULL without MSE weights
+    struct ComputeSseAndOutputErrorFn
+    {
+        int layerSize;
+	const real_t *weights;
+        const char *patTypes;
+	real_t     *outputErrors;
+
+        __host__ __device__ real_t operator() (const thrust::tuple<real_t, real_t, int> &values) const
+        {
+            // unpack the tuple
+            real_t target = values.get<0>();
+            real_t output = values.get<1>();
+            int outputIdx = values.get<2>();
+
+            // dummy pattern
+            int patIdx = outputIdx / layerSize;
+            if (patTypes[patIdx] == PATTYPE_NONE){
+		outputErrors[outputIdx] = 0;
+                return 0;
+	    }
+
+            real_t diff = output - target;
+	    if (weights)
+		diff = diff * weights[outputIdx % layerSize];
+	    outputErrors[outputIdx] = diff;
+            return (diff * diff);
+        }
+    };
     
 } // anonymous namespace
 } // namespace anonymous
@@ -208,6 +239,38 @@ namespace layers {
 	}
     }
 
+    template <typename TDevice>
+    real_t SsePostOutputLayer<TDevice>::calculateErrorAndGradients()
+    {
+	if (!this->_flagFusedPass())
+	    return this->calculateError();
+	
+	internal::ComputeSseAndOutputErrorFn fn;
+	fn.layerSize    = this->size();
+	fn.patTypes     = helpers::getRawPointer(this->patTypes());
+	fn.weights      = (this->flagMseWeight() ?
+			   helpers::getRawPointer(this->_mseWeight()) : NULL);
+	fn.outputErrors = helpers::getRawPointer(this->_outputErrors());
+
+	int n = this->curMaxSeqLength() * this->parallelSequences() * this->size();
+
+	real_t mse = (real_t)0.5 * thrust::transform_reduce(
+                thrust::make_zip_iterator(
+			thrust::make_tuple(this->_targets().begin(),
+					   this->_actualOutputs().begin(),
+					   thrust::counting_iterator<int>(0))),
+		thrust::make_zip_iterator(
+			thrust::make_tuple(this->_targets().begin()+n,
+					   this->_actualOutputs().begin()+n,
+					   thrust::counting_iterator<int>(0)+n)),
+		fn,
+		(real_t)0,
+		thrust::plus<real_t>());
+	
+	this->_cacheFusedPass();
+	return mse;
+    }
+
     template <typename TDevice>
     void SsePostOutputLayer<TDevice>::computeForwardPass(const int nnState)
     {
@@ -222,6 +285,10 @@ namespace layers {
     template <typename TDevice>
     void SsePostOutputLayer<TDevice>::computeBackwardPass(const int nnState)
     {
+	// Add 20181018: already computed by calculateErrorAndGradients
+	if (this->_takeCachedGradients())
+	    return;
+	
      // calculate the errors
 	if(this->flagMseWeight())
 	{
@@ -27,6 +27,7 @@
 #include "TrainableLayer.hpp"
 #include "../helpers/getRawPointer.cuh"
 #include "../helpers/JsonClasses.hpp"
+#include "../helpers/BinaryModel.hpp"
 #include "../Configuration.hpp"
 
 #include <stdexcept>
@@ -65,6 +66,27 @@ namespace internal {
 
 namespace layers {
 
+    template <typename TDevice>
+    bool TrainableLayer<TDevice>::flagSharedWeights() const
+    {
+	return m_sharedWeights != NULL;
+    }
+
+    template <typename TDevice>
+    void TrainableLayer<TDevice>::setErrorsOnlyBackward(const bool flag)
+    {
+	// the weight updates are not touched by the errors-only backward pass
+	if (flag && !m_errorsOnly)
+	    this->cleanGradidents();
+	m_errorsOnly = flag;
+    }
+
+    template <typename TDevice>
+    const bool& TrainableLayer<TDevice>::flagErrorsOnlyBackward() const
+    {
+	return m_errorsOnly;
+    }
+
     template <typename TDevice>
     typename TrainableLayer<TDevice>::real_vector& TrainableLayer<TDevice>::_weightUpdates()
     {
@@ -83,7 +105,8 @@ namespace layers {
                                             int inputWeightsPerBlock, 
 					    int internalWeightsPerBlock, 
 					    Layer<TDevice> &precedingLayer,
-					    int maxSeqLength)
+					    int maxSeqLength,
+					    typename TDevice::real_vector *sharedWeights)
         : Layer<TDevice>           (layerChild,
 				    precedingLayer.parallelSequences(), 
 				    maxSeqLength,
@@ -97,6 +120,8 @@ namespace layers {
 			       static_cast<real_t>((*layerChild)["learningRate"].GetDouble()) : -1)
 	, m_weightNum (-1)
 	, m_optOpt    (0)
+	, m_sharedWeights (sharedWeights)
+	, m_errorsOnly    (false)
     {
         // std::cout << "Creating layer " << this->name() << std::endl;
         // check if the bias value exists
@@ -114,7 +139,17 @@ namespace layers {
 	if (m_learningRate > -0.5)
 	    printf("\n\tlearning rate = %f", m_learningRate);
 	
-        if (weightsSection.isValid() && weightsSection->HasMember(this->name().c_str())) {
+	if (m_sharedWeights != NULL){
+	    // Add 20171101: this is a replica, use the weights of the master network
+	    int tmpWeightSize = this->size() * 
+		(inputWeightsPerBlock * (m_precedingLayer.size() + 1) + internalWeightsPerBlock);
+	    if (m_sharedWeights->size() != tmpWeightSize)
+		throw std::runtime_error(std::string("Shared weights mismatch for layer ")
+					 + this->name());
+	    printf("\n\tTrainable layer: share weight");
+	    weights.resize(tmpWeightSize, 0.0);
+	    
+	}else if (weightsSection.isValid() && weightsSection->HasMember(this->name().c_str())) {
 	    printf("\n\tTrainable layer: re-read weight");
             if (!weightsSection->HasMember(this->name().c_str()))
                 throw std::runtime_error(std::string("Missing weights section for layer '") + 
@@ -124,22 +159,30 @@ namespace layers {
                 throw std::runtime_error(std::string("Weights section for layer '") + 
 					 this->name() + "' is not an object");
 
-            if (!weightsChild.HasMember("input") || !weightsChild["input"].IsArray())
+            if (!weightsChild.HasMember("input") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["input"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/input'");
-            if (!weightsChild.HasMember("bias") || !weightsChild["bias"].IsArray())
+            if (!weightsChild.HasMember("bias") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["bias"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/bias'");
-            if (!weightsChild.HasMember("internal") || !weightsChild["internal"].IsArray())
+            if (!weightsChild.HasMember("internal") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["internal"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/internal'");
         
             const rapidjson::Value &inputWeightsChild    = weightsChild["input"];
             const rapidjson::Value &biasWeightsChild     = weightsChild["bias"];
             const rapidjson::Value &internalWeightsChild = weightsChild["internal"];
+	    
+	    // the weight array may be a JSON array or a blob in the binary model
+	    size_t inputWeightsNum    = helpers::binaryModel::weightArraySize(inputWeightsChild);
+	    size_t biasWeightsNum     = helpers::binaryModel::weightArraySize(biasWeightsChild);
+	    size_t internalWeightsNum = helpers::binaryModel::weightArraySize(internalWeightsChild);
 
-            if (inputWeightsChild.Size() != (this->size() * inputWeightsPerBlock *
-					     m_precedingLayer.size())){
+            if (inputWeightsNum != (this->size() * inputWeightsPerBlock *
+				    m_precedingLayer.size())){
 		if (inputWeightsPerBlock == 0){
 		    printf("\n\tWARNING: the network file has no input weight for layer %s. ",
 			   this->name().c_str());
@@ -149,7 +192,7 @@ namespace layers {
 					     + this->name());
 		}
 	    }
-            if (biasWeightsChild.Size() != this->size() * inputWeightsPerBlock){
+            if (biasWeightsNum != this->size() * inputWeightsPerBlock){
 		if (inputWeightsPerBlock == 0){
 		    printf("\n\tWARNING: the network file has no input weight for layer %s. ",
 			   this->name().c_str());
@@ -159,23 +202,15 @@ namespace layers {
 					     + this->name() + "'");
 		}
 	    }
-            if (internalWeightsChild.Size() != this->size() * internalWeightsPerBlock)
+            if (internalWeightsNum != this->size() * internalWeightsPerBlock)
                 throw std::runtime_error(std::string("Invalid number of internal weight for layer'")
 					 + this->name() + "'");
 
-            weights.reserve(inputWeightsChild.Size() + 
-			    biasWeightsChild.Size()  + 
-			    internalWeightsChild.Size());
-
-            for (rapidjson::Value::ConstValueIterator it = inputWeightsChild.Begin(); 
-		 it != inputWeightsChild.End(); ++it)
-                weights.push_back(static_cast<real_t>(it->GetDouble()));
-            for (rapidjson::Value::ConstValueIterator it = biasWeightsChild.Begin(); 
-		 it != biasWeightsChild.End(); ++it)
-                weights.push_back(static_cast<real_t>(it->GetDouble()));
-            for (rapidjson::Value::ConstValueIterator it = internalWeightsChild.Begin(); 
-		 it != internalWeightsChild.End(); ++it)
-                weights.push_back(static_cast<real_t>(it->GetDouble()));
+            weights.reserve(inputWeightsNum + biasWeightsNum + internalWeightsNum);
+
+            helpers::binaryModel::readWeightArray(inputWeightsChild, &weights);
+            helpers::binaryModel::readWeightArray(biasWeightsChild, &weights);
+            helpers::binaryModel::readWeightArray(internalWeightsChild, &weights);
         }
         // create random weights if no weights are given in the network file
         else {
@@ -215,15 +250,22 @@ namespace layers {
             }
         }
 
-        m_weights       = weights;
+	m_weightNum     = weights.size(); 
+	m_weightMaskFlag= false;
+	
+	// Modify 20181018: an inference replica only needs the shared weights,
+	//  no gradients or weight mask are allocated
+	if (m_sharedWeights != NULL && !config.trainingMode())
+	    return;
+	
+	if (m_sharedWeights == NULL)
+	    m_weights   = weights;
         m_weightUpdates = weights;
 	
 	// Add 04013 Wang: for weight Mask
 	for (size_t i = 0; i < weights.size(); ++i)
 	    weights[i] = 1.0;
 	m_weightMask    = weights;          // make it the same length as weights matrix 
-	m_weightNum     = weights.size(); 
-	m_weightMaskFlag= false;
 
     }
 
@@ -266,13 +308,13 @@ namespace layers {
     template <typename TDevice>
     typename TrainableLayer<TDevice>::real_vector& TrainableLayer<TDevice>::weights()
     {
-        return m_weights;
+        return (m_sharedWeights ? (*m_sharedWeights) : m_weights);
     }
 
     template <typename TDevice>
     const typename TrainableLayer<TDevice>::real_vector& TrainableLayer<TDevice>::weights() const
     {
-        return m_weights;
+        return (m_sharedWeights ? (*m_sharedWeights) : m_weights);
     }
     
     template <typename TDevice>
@@ -365,27 +407,28 @@ namespace layers {
             throw std::runtime_error("The JSON value is not an object");
 
         // do nothing if we don't have any weights
-        if (m_weights.empty())
+        if (weights().empty())
             return;
+	Cpu::real_vector weightsVec = weights();
+
+	int inputWeightsCount, biasWeightsCount, internalWeightsCount;
+	this->weightArraySizes(&inputWeightsCount, &biasWeightsCount, &internalWeightsCount);
 
         // create and fill the weight arrays
         rapidjson::Value inputWeightsArray(rapidjson::kArrayType);
-        int inputWeightsCount = this->size() * m_inputWeightsPerBlock * m_precedingLayer.size();
         inputWeightsArray.Reserve(inputWeightsCount, allocator);
         for (int i = 0; i < inputWeightsCount; ++i)
-            inputWeightsArray.PushBack(m_weights[i], allocator);
+            inputWeightsArray.PushBack(weightsVec[i], allocator);
 
         rapidjson::Value biasWeightsArray(rapidjson::kArrayType);
-        int biasWeightsCount = this->size() * m_inputWeightsPerBlock;
         biasWeightsArray.Reserve(biasWeightsCount, allocator);
         for (int i = 0; i < biasWeightsCount; ++i)
-            biasWeightsArray.PushBack(m_weights[inputWeightsCount + i], allocator);
+            biasWeightsArray.PushBack(weightsVec[inputWeightsCount + i], allocator);
 
         rapidjson::Value internalWeightsArray(rapidjson::kArrayType);
-        int internalWeightsCount = this->size() * m_internalWeightsPerBlock;
         internalWeightsArray.Reserve(internalWeightsCount, allocator);
         for (int i = 0; i < internalWeightsCount; ++i)
-            internalWeightsArray.PushBack(m_weights[inputWeightsCount + biasWeightsCount + i],
+            internalWeightsArray.PushBack(weightsVec[inputWeightsCount + biasWeightsCount + i],
 					  allocator);
 
         // create and fill the weights subsection
@@ -398,6 +441,15 @@ namespace layers {
         weightsObject->AddMember(this->name().c_str(), weightsSection, allocator);
     }
 
+    template <typename TDevice>
+    void TrainableLayer<TDevice>::weightArraySizes(int *inputNum, int *biasNum,
+						   int *internalNum) const
+    {
+	*inputNum    = this->size() * m_inputWeightsPerBlock * m_precedingLayer.size();
+	*biasNum     = this->size() * m_inputWeightsPerBlock;
+	*internalNum = this->size() * m_internalWeightsPerBlock;
+    }
+
     template <typename TDevice>
     void TrainableLayer<TDevice>::exportLayer(const helpers::JsonValue &layersArray, 
 					      const helpers::JsonAllocator &allocator) const
@@ -464,49 +516,44 @@ namespace layers {
             if (!weightsChild.IsObject())
                 throw std::runtime_error(std::string("Weights section for layer '") + 
 					 this->name() + "' is not an object");
-            if (!weightsChild.HasMember("input") || !weightsChild["input"].IsArray())
+            if (!weightsChild.HasMember("input") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["input"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/input'");
-            if (!weightsChild.HasMember("bias") || !weightsChild["bias"].IsArray())
+            if (!weightsChild.HasMember("bias") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["bias"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/bias'");
-            if (!weightsChild.HasMember("internal") || !weightsChild["internal"].IsArray())
+            if (!weightsChild.HasMember("internal") ||
+		!helpers::binaryModel::isWeightArray(weightsChild["internal"]))
                 throw std::runtime_error(std::string("Missing array 'weights/") + 
 					 this->name() + "/internal'");
 	    const rapidjson::Value &inputWeightsChild    = weightsChild["input"];
             const rapidjson::Value &biasWeightsChild     = weightsChild["bias"];
             const rapidjson::Value &internalWeightsChild = weightsChild["internal"];
+	    size_t inputWeightsNum    = helpers::binaryModel::weightArraySize(inputWeightsChild);
+	    size_t biasWeightsNum     = helpers::binaryModel::weightArraySize(biasWeightsChild);
+	    size_t internalWeightsNum = helpers::binaryModel::weightArraySize(internalWeightsChild);
 	    
 	    // three kinds of possibility to read the weights
 	    if (readCtrFlag==1){
 		// the number of parameter should match exactly
-		if (inputWeightsChild.Size() != layerSize * 
+		if (inputWeightsNum != layerSize * 
 		    m_inputWeightsPerBlock * m_precedingLayer.size())
 		    throw std::runtime_error(std::string("Invalid number of input weights: '") 
 					     + this->name() + "'");
-		if (biasWeightsChild.Size() != layerSize * m_inputWeightsPerBlock)
+		if (biasWeightsNum != layerSize * m_inputWeightsPerBlock)
 		    throw std::runtime_error(std::string("Invalid number of bias weights: '") 
 					     + this->name() + "'");
-		if (internalWeightsChild.Size() != layerSize * m_internalWeightsPerBlock)
+		if (internalWeightsNum != layerSize * m_internalWeightsPerBlock)
 		    throw std::runtime_error(std::string("Invalid number of internal '") 
 					     + this->name() + "'");
 
-		weights.reserve(inputWeightsChild.Size() + 
-				biasWeightsChild.Size() + 
-				internalWeightsChild.Size());
-
-		for (rapidjson::Value::ConstValueIterator it = inputWeightsChild.Begin(); 
-		     it != inputWeightsChild.End(); 
-		     ++it)
-		    weights.push_back(static_cast<real_t>(it->GetDouble()));
-		for (rapidjson::Value::ConstValueIterator it = biasWeightsChild.Begin(); 
-		     it != biasWeightsChild.End(); 
-		     ++it)
-		    weights.push_back(static_cast<real_t>(it->GetDouble()));
-		for (rapidjson::Value::ConstValueIterator it = internalWeightsChild.Begin(); 
-		     it != internalWeightsChild.End(); 
-		     ++it)
-		    weights.push_back(static_cast<real_t>(it->GetDouble()));
+		weights.reserve(inputWeightsNum + biasWeightsNum + internalWeightsNum);
+
+		helpers::binaryModel::readWeightArray(inputWeightsChild, &weights);
+		helpers::binaryModel::readWeightArray(biasWeightsChild, &weights);
+		helpers::binaryModel::readWeightArray(internalWeightsChild, &weights);
 		
 	    }else if (readCtrFlag == 2 || readCtrFlag == 3){
 		
@@ -518,10 +565,10 @@ namespace layers {
 		     m_internalWeightsPerBlock);
 		
 		int preTrainedNRow     = ((readCtrFlag == 2) ? 
-					  (inputWeightsChild.Size() / this->size()) : 
+					  (inputWeightsNum / this->size()) : 
 					  (m_precedingLayer.size()));
 
-		if (inputWeightsChild.Size() > tempThisWeightSize)
+		if (inputWeightsNum > tempThisWeightSize)
 		    throw std::runtime_error(std::string("not support larger pre-trained layer"));
 		
 		// space for this layer, the remaining parameter are 0.0
@@ -529,19 +576,11 @@ namespace layers {
 		
 		// space for the pretrained matrix
 		Cpu::real_vector preTrainedWeights;
-		preTrainedWeights.reserve(inputWeightsChild.Size() + 
-					  biasWeightsChild.Size() + 
-					  internalWeightsChild.Size());
+		preTrainedWeights.reserve(inputWeightsNum + biasWeightsNum + internalWeightsNum);
 		
 		
-		for (rapidjson::Value::ConstValueIterator it = inputWeightsChild.Begin(); 
-		     it != inputWeightsChild.End(); 
-		     ++it)
-		    preTrainedWeights.push_back(static_cast<real_t>(it->GetDouble()));
-		for (rapidjson::Value::ConstValueIterator it = biasWeightsChild.Begin(); 
-		     it != biasWeightsChild.End(); 
-		     ++it)
-		    preTrainedWeights.push_back(static_cast<real_t>(it->GetDouble()));
+		helpers::binaryModel::readWeightArray(inputWeightsChild, &preTrainedWeights);
+		helpers::binaryModel::readWeightArray(biasWeightsChild, &preTrainedWeights);
 		
 		// copy the weight part
 		{{
@@ -553,7 +592,7 @@ namespace layers {
 			fn.sourceW = helpers::getRawPointer(preTrainedWeights);
 			fn.targetW = helpers::getRawPointer(weights);
 
-			int n = inputWeightsChild.Size();
+			int n = inputWeightsNum;
 			//thrust::counting_iterator<int> first(0);
 			//thrust::counting_iterator<int> last = first + n;
 			//thrust::for_each(first, last, fn);
@@ -568,7 +607,7 @@ namespace layers {
 		}}
 		
 		// copy the bias part
-		thrust::copy(preTrainedWeights.begin() + inputWeightsChild.Size(),
+		thrust::copy(preTrainedWeights.begin() + inputWeightsNum,
 			     preTrainedWeights.end(),
 			     weights.begin() + this->size() * m_precedingLayer.size());
 		
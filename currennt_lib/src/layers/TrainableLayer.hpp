@@ -58,6 +58,12 @@ namespace layers {
 	unsigned     m_optOpt;             // Note: this is used for Average Gradient
 	                                   // but now, it is used as a controller to fix the
 	                                   // the weight of one layer (by setting gradients to 0)
+
+	// Add 20171101: weights owned by another network (inference replicas)
+	real_vector *m_sharedWeights;      // if not NULL, weights() returns *m_sharedWeights
+
+	// Add 20181018: propagate the errors without computing the weight updates
+	bool         m_errorsOnly;
 	
     protected:
         real_vector&    _weightUpdates();
@@ -72,6 +78,8 @@ namespace layers {
          * @param inputWeightsPerBlock    The number of input weights per block
          * @param internalWeightsPerBlock The number of internal weights per block
          * @param precedingLayer          The layer preceding this one
+         * @param sharedWeights           Weights of the layer in the master network
+         *                                (inference replicas, read-only), or NULL
          */
         TrainableLayer(
             const helpers::JsonValue &layerChild,
@@ -79,7 +87,8 @@ namespace layers {
             int                       inputWeightsPerBlock, 
             int                       internalWeightsPerBlock,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
             );
 
         /**
@@ -177,6 +186,12 @@ namespace layers {
         virtual void exportWeights(const helpers::JsonValue &weightsObject,
 				   const helpers::JsonAllocator &allocator) const;
 
+	/**
+	 * Add 20181018: numbers of weights in the "input", "bias" and "internal" arrays
+	 * written by exportWeights (consecutive parts of weights())
+	 */
+	virtual void weightArraySizes(int *inputNum, int *biasNum, int *internalNum) const;
+
         /**
          * @see Layer::exportLayer()
          */
@@ -205,6 +220,20 @@ namespace layers {
 	virtual void cleanGradidents();	
 	const unsigned& optOpt() const;
 
+	/**
+	 * Whether the weights of this layer are owned by another layer
+	 */
+	bool flagSharedWeights() const;
+
+	/**
+	 * Add 20181018: errors-only backward pass for a frozen layer.
+	 * computeBackwardPass still propagates the errors to the preceding layer
+	 * but skips the weight updates, which are set to zero
+	 */
+	void setErrorsOnlyBackward(const bool flag);
+
+	const bool& flagErrorsOnlyBackward() const;
+
 	
     };
 
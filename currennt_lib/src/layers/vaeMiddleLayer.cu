@@ -132,21 +132,19 @@ namespace {
     };
 
     
+    // Modify 20181018: counter-based generator, each element is generated independently
     struct genNoise
     {
 	float a, b;
-	int   seed;
+	helpers::philox::stream_t stream;
 	
-	__host__ __device__
-	genNoise(float _a=0.f, float _b=1.f, int _seed=123) : a(_a), b(_b), seed(_seed) {};
+	genNoise(float _a, float _b, const helpers::philox::stream_t &_stream)
+	    : a(_a), b(_b), stream(_stream) {};
 
 	__host__ __device__
 	float operator()(const unsigned int n) const
 	{
-	    thrust::default_random_engine rng(seed);
-	    thrust::normal_distribution<float> dist(a, b);
-	    rng.discard(n);
-	    return dist(rng);
+	    return helpers::philox::normal(stream, n, a, b);
 	}
     };
 
@@ -447,8 +445,7 @@ namespace layers{
 	thrust::transform(index_sequence_begin,
 			  index_sequence_begin + timeLength * this->size(),
 			  m_noiseInput.begin(),
-			  internal::genNoise(m_noiseMean, m_noiseStd,
-					     (int)(misFuncs::GetRandomNumber()*10000.0)));
+			  internal::genNoise(m_noiseMean, m_noiseStd, this->_randomStream()));
 	if (m_noiseRepeat){
 	    internal::noiseRepeat fn;
 	    fn.noiseDim = this->size();
@@ -530,8 +527,7 @@ namespace layers{
 	    thrust::transform(index_sequence_begin,
 			      index_sequence_begin + timeLength * this->size(),
 			      m_noiseInput.begin(),
-			      internal::genNoise(m_noiseMean, m_noiseStd,
-						 (int)(misFuncs::GetRandomNumber()*10000.0)));
+			      internal::genNoise(m_noiseMean, m_noiseStd, this->_randomStream()));
 
 	    if (m_noiseRepeat){
 		internal::noiseRepeat fn;
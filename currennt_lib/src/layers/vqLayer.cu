@@ -31,6 +31,7 @@
 #include "../helpers/Matrix.hpp"
 #include "../helpers/JsonClasses.hpp"
 #include "../helpers/misFuncs.hpp"
+#include "../MacroDefine.hpp"
 
 #include <thrust/transform.h>
 #include <thrust/transform_reduce.h>
@@ -39,55 +40,45 @@
 #include <thrust/iterator/counting_iterator.h>
 #include <thrust/fill.h>
 #include <thrust/random.h>
+#include <thrust/sort.h>
+#include <thrust/sequence.h>
+#include <thrust/binary_search.h>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_real_distribution.hpp>
 #include <boost/foreach.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/algorithm/string.hpp>
 #include <vector>
+#include <algorithm>
 
 
 namespace internal{
 
-    struct computeDisMatrix
+    struct SquaredNorm
     {
 	int featureDim;
-	int codeBookSize;
-	real_t *inputData;
-	real_t *codeData;
-	
-	const char *patTypes;
-	
+	real_t *data;
+
+	// for 0 : number of vectors
 	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
 	{
-	    int index = t.get<1>();
-	    int timeIdx = index / codeBookSize;
-	    int codeIdx = index % codeBookSize;
-	    
-	    real_t distance = 0.0;
-
-	    if (patTypes[timeIdx] == PATTYPE_NONE)
-		t.get<0>() = distance;
-	    else{
-		for (int i = 0; i < featureDim; i++){
-		    distance += ((codeData[codeIdx * featureDim + i] -
-				  inputData[timeIdx * featureDim + i]) *
-				 (codeData[codeIdx * featureDim + i] -
-				  inputData[timeIdx * featureDim + i]));
-		}
-		t.get<0>() = distance;
-	    }   
+	    real_t norm = 0.0;
+	    for (int i = 0; i < featureDim; i++)
+		norm += data[t.get<1>() * featureDim + i] * data[t.get<1>() * featureDim + i];
+	    t.get<0>() = norm;
 	}
     };
-
+    
     struct getBestIndex
     {
+	// ||x - c||^2 = ||x||^2 - 2 x^T c + ||c||^2, where ||x||^2 is ignored
 	int codeBookSize;
-	real_t *disMatrix;
+	real_t *product;       // x^T c of the frames in the current block
+	real_t *codeNorm;      // ||c||^2
 	
 	const char *patTypes;
 
-	// for 0 : T 
+	// for 0 : number of frames in the block 
 	__host__ __device__ void operator() (const thrust::tuple<int&, int> &t) const
 	{
 	    int timeIdx = t.get<1>();
@@ -97,11 +88,13 @@ namespace internal{
 		if (codeBookSize == 1)
 		    t.get<0>() = -1;
 		else{
-		    real_t tempMin = disMatrix[timeIdx * codeBookSize];
-		    real_t tempId  = 0; 
+		    real_t tempMin = codeNorm[0] - 2.0 * product[timeIdx * codeBookSize];
+		    real_t tempDis = 0.0;
+		    int    tempId  = 0; 
 		    for (int i = 1; i < codeBookSize; i++){
-			if (disMatrix[timeIdx * codeBookSize + i] < tempMin){
-			    tempMin = disMatrix[timeIdx * codeBookSize + i];
+			tempDis = codeNorm[i] - 2.0 * product[timeIdx * codeBookSize + i];
+			if (tempDis < tempMin){
+			    tempMin = tempDis;
 			    tempId  = i;
 			}
 		    }
@@ -111,6 +104,73 @@ namespace internal{
 	}
     };
 
+    struct getBestIndexCoarseToFine
+    {
+	// search the codes in the coarseProbe nearest cells
+	int featureDim;
+	int coarseNum;
+	int coarseProbe;
+	
+	real_t *product;       // x^T center of the frames in the current block
+	real_t *coarseNorm;    // ||center||^2
+	real_t *inputData;
+	real_t *codeData;
+	real_t *codeNorm;
+	int    *codeList;
+	int    *cellStart;
+	
+	const char *patTypes;
+
+	// for 0 : number of frames in the block 
+	__host__ __device__ void operator() (const thrust::tuple<int&, int> &t) const
+	{
+	    int timeIdx = t.get<1>();
+	    if (patTypes[timeIdx] == PATTYPE_NONE){
+		t.get<0>() = -1;
+		return;
+	    }
+
+	    real_t preCellDis = 0.0;
+	    int    preCell    = -1;
+	    real_t bestDis    = 0.0;
+	    int    bestCode   = -1;
+	    for (int p = 0; p < coarseProbe; p++){
+		// the next nearest cell (ordered by the distance, then the index)
+		int    cell    = -1;
+		real_t cellDis = 0.0;
+		for (int c = 0; c < coarseNum; c++){
+		    real_t tempDis = coarseNorm[c] - 2.0 * product[timeIdx * coarseNum + c];
+		    if (preCell >= 0 &&
+			(tempDis < preCellDis || (tempDis == preCellDis && c <= preCell)))
+			continue;
+		    if (cell < 0 || tempDis < cellDis){
+			cell    = c;
+			cellDis = tempDis;
+		    }
+		}
+		if (cell < 0)
+		    break;
+		preCell    = cell;
+		preCellDis = cellDis;
+
+		// search the codes in this cell
+		for (int j = cellStart[cell]; j < cellStart[cell + 1]; j++){
+		    int    codeIdx = codeList[j];
+		    real_t tempDis = 0.0;
+		    for (int i = 0; i < featureDim; i++)
+			tempDis += (inputData[timeIdx * featureDim + i] *
+				    codeData[codeIdx * featureDim + i]);
+		    tempDis = codeNorm[codeIdx] - 2.0 * tempDis;
+		    if (bestCode < 0 || tempDis < bestDis ||
+			(tempDis == bestDis && codeIdx < bestCode)){
+			bestCode = codeIdx;
+			bestDis  = tempDis;
+		    }
+		}
+	    }
+	    t.get<0>() = bestCode;
+	}
+    };
 
     struct LoadVq
     {
@@ -165,16 +225,12 @@ namespace internal{
     struct GradientForCodeBook
     {
 	int featureDim;
-	int codeBookSize;
-	real_t  beta;
 	
 	real_t *inputData;
 	real_t *codeData;
-	real_t *preLayerGrad;
-	int *index;
-
-	int timeLength;
-	const char *patTypes;
+	int    *sortedFrame;   // frames sorted by the selected code
+	int    *codeStart;     // range of the frames that select each code
+	int    *codeEnd;
 
 	// for codeBookSize * featureDim
 	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
@@ -185,18 +241,10 @@ namespace internal{
 
 	    real_t sumInput = 0.0;
 	    real_t cnt = 0.0;
-	    for (int i = 0; i<timeLength; i++){
-		if (patTypes[i] == PATTYPE_NONE)
-		    break;
-		if (index[i] == codeIdx){
-		    cnt += 1.0;
-		    // Methods1/2: Moving average of the input latent codes
-		    sumInput += (inputData[i * featureDim + featIdx] - sumInput)/cnt;
-		    
-		    // Propagate to the previous layer
-		    preLayerGrad[i * featureDim + featIdx] +=
-			beta * (inputData[i * featureDim + featIdx] - codeData[t.get<1>()]);
-		}
+	    for (int j = codeStart[codeIdx]; j < codeEnd[codeIdx]; j++){
+		cnt += 1.0;
+		// Methods1/2: Moving average of the input latent codes
+		sumInput += (inputData[sortedFrame[j] * featureDim + featIdx] - sumInput)/cnt;
 	    }
 	    // Method1: average the gradients over time
 	    // t.get<0>() = codeData[t.get<1>()] - sumInput;
@@ -206,6 +254,30 @@ namespace internal{
 	}
     };
 
+    struct GradientForInput
+    {
+	int featureDim;
+	real_t  beta;
+	
+	real_t *inputData;
+	real_t *codeData;
+	int *index;
+
+	const char *patTypes;
+
+	// for 0 : T * featureDim
+	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+	{
+	    int timeIdx = t.get<1>() / featureDim;
+	    int featIdx = t.get<1>() % featureDim;
+	    if (patTypes[timeIdx] == PATTYPE_NONE || index[timeIdx] < 0)
+		return;
+	    // Propagate to the previous layer
+	    t.get<0>() += beta * (inputData[t.get<1>()] -
+				  codeData[index[timeIdx] * featureDim + featIdx]);
+	}
+    };
+
 }
 
 
@@ -216,11 +288,13 @@ namespace layers{
     vqLayer<TDevice>::vqLayer(const helpers::JsonValue &layerChild,
 			      const helpers::JsonValue &weightsSection,
 			      Layer<TDevice> &precedingLayer,
-			      int maxSeqLength)
+			      int maxSeqLength,
+			      typename TDevice::real_vector *sharedWeights)
 	: TrainableLayer<TDevice>(layerChild, weightsSection, 0,
 				  (layerChild->HasMember("vqCodeBookSize") ? 
 				   ((*layerChild)["vqCodeBookSize"].GetInt()) : 0),
-				  precedingLayer, maxSeqLength)
+				  precedingLayer, maxSeqLength,
+				  sharedWeights)
 	, m_vqCodeBookSize ((layerChild->HasMember("vqCodeBookSize") ? 
 			     ((*layerChild)["vqCodeBookSize"].GetInt()) : 0))
     {
@@ -231,16 +305,44 @@ namespace layers{
 	if (m_vqCodeBookSize < 1)
 	    throw std::runtime_error("vqLayer vqCodeBookSize is not an positive integer");
 
-	// Initialize the distance matrix
-	cpu_real_vector temp(this->parallelSequences() * maxSeqLength * m_vqCodeBookSize, 0.0);
+	// Initialize the buffer of code-input products
+	// the nearest code is searched for a block of frames each time
+	int blockLength = std::max(1, NN_VQLAYER_PRODUCT_BUFFER_SIZE / m_vqCodeBookSize);
+	blockLength     = std::min(blockLength, this->parallelSequences() * maxSeqLength);
+	cpu_real_vector temp(blockLength * m_vqCodeBookSize, 0.0);
 	m_disMatrix = temp;
 
 	cpu_int_vector temp2(this->parallelSequences() * maxSeqLength, 0);
 	m_selectedIdx = temp2;
 
+	temp.resize(m_vqCodeBookSize, 0.0);
+	m_codeNorm    = temp;
+	
+	if (this->flagTrainingMode()){
+	    m_sortedIdx   = temp2;
+	    m_sortedFrame = temp2;
+	    temp2.resize(m_vqCodeBookSize, 0);
+	    m_codeStart   = temp2;
+	    m_codeEnd     = temp2;
+	}
+	
 	m_betaPara    = (layerChild->HasMember("beta") ? 
 			 ((*layerChild)["beta"].GetDouble()) : 0.25);
-	
+
+	// coarse-to-fine search for large code books
+	m_coarseNum   = (layerChild->HasMember("vqCoarseNum") ? 
+			 ((*layerChild)["vqCoarseNum"].GetInt()) : 0);
+	m_coarseProbe = (layerChild->HasMember("vqCoarseProbe") ? 
+			 ((*layerChild)["vqCoarseProbe"].GetInt()) : 1);
+	m_coarseReady = false;
+	if (m_coarseNum > 0){
+	    if (m_coarseNum < 2 || m_coarseNum >= m_vqCodeBookSize)
+		throw std::runtime_error("vqCoarseNum should be in [2, vqCodeBookSize)");
+	    if (m_coarseProbe < 1 || m_coarseProbe > m_coarseNum)
+		throw std::runtime_error("vqCoarseProbe should be in [1, vqCoarseNum]");
+	    printf("\n\tvqLayer coarse-to-fine search: %d cells, %d probe(s)",
+		   m_coarseNum, m_coarseProbe);
+	}
     }	
 
     // Destructor
@@ -277,39 +379,71 @@ namespace layers{
     {
 	
 	{{
-	    // step1. compute the distance matrix
-	    internal::computeDisMatrix fn1;
-	    fn1.featureDim   = this->size();
-	    fn1.codeBookSize = this->m_vqCodeBookSize;
-	    fn1.inputData    = helpers::getRawPointer(this->precedingLayer().outputs());
-	    fn1.codeData     = helpers::getRawPointer(this->weights());
-	    fn1.patTypes     = helpers::getRawPointer(this->patTypes());
+	    // step1. compute ||c||^2 for all the codes
+	    this->__computeCodeNorm();
 
-	    int n = this->curMaxSeqLength() * this->parallelSequences() * this->m_vqCodeBookSize;
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(this->m_disMatrix.begin(),
-				     thrust::counting_iterator<int>(0))),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(this->m_disMatrix.begin()         + n,
-				     thrust::counting_iterator<int>(0) + n)),
-	       fn1);
+	    // the coarse-to-fine search is only used in inference
+	    bool coarseSearch = (m_coarseNum > 0 && !this->flagTrainingMode());
+	    if (coarseSearch && !m_coarseReady)
+		this->__buildCoarseIndex();
 	    
-	    // step2. search for the best index
-	    internal::getBestIndex fn2;
-	    fn2.codeBookSize = this->m_vqCodeBookSize;
-	    fn2.disMatrix    = helpers::getRawPointer(this->m_disMatrix);
-	    fn2.patTypes     = helpers::getRawPointer(this->patTypes());
-
-	    int m = this->curMaxSeqLength() * this->parallelSequences();
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(this->m_selectedIdx.begin(),
-				     thrust::counting_iterator<int>(0))),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(this->m_selectedIdx.begin()       + m,
-				     thrust::counting_iterator<int>(0) + m)),
-	       fn2);	
+	    // step2. search for the best index, block by block
+	    // x^T c is computed by matrix multiplication, and the best index is searched
+	    // for each frame without storing the distance matrix of all frames
+	    int timeLength  = this->curMaxSeqLength() * this->parallelSequences();
+	    int productDim  = (coarseSearch ? m_coarseNum : m_vqCodeBookSize);
+	    int blockLength = this->m_disMatrix.size() / m_vqCodeBookSize;
+	    
+	    for (int blockS = 0; blockS < timeLength; blockS += blockLength){
+		int frameNum = std::min(blockLength, timeLength - blockS);
+		
+		helpers::Matrix<TDevice> codeMatrix(coarseSearch ?
+						    (&this->m_coarseCenter) : (&this->weights()),
+						    this->size(), productDim);
+		helpers::Matrix<TDevice> inputMatrix(&this->precedingLayer().outputs(),
+						     this->size(), frameNum,
+						     blockS * this->size());
+		helpers::Matrix<TDevice> productMatrix(&this->m_disMatrix, productDim, frameNum);
+		productMatrix.assignProduct(codeMatrix, true, inputMatrix, false);
+
+		if (coarseSearch){
+		    internal::getBestIndexCoarseToFine fn2;
+		    fn2.featureDim   = this->size();
+		    fn2.coarseNum    = m_coarseNum;
+		    fn2.coarseProbe  = m_coarseProbe;
+		    fn2.product      = helpers::getRawPointer(this->m_disMatrix);
+		    fn2.coarseNorm   = helpers::getRawPointer(this->m_coarseNorm);
+		    fn2.inputData    = (helpers::getRawPointer(this->precedingLayer().outputs()) +
+					blockS * this->size());
+		    fn2.codeData     = helpers::getRawPointer(this->weights());
+		    fn2.codeNorm     = helpers::getRawPointer(this->m_codeNorm);
+		    fn2.codeList     = helpers::getRawPointer(this->m_coarseList);
+		    fn2.cellStart    = helpers::getRawPointer(this->m_coarseStart);
+		    fn2.patTypes     = helpers::getRawPointer(this->patTypes()) + blockS;
+		    thrust::for_each(
+		      thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_selectedIdx.begin() + blockS,
+					   thrust::counting_iterator<int>(0))),
+		      thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_selectedIdx.begin() + blockS + frameNum,
+					   thrust::counting_iterator<int>(0) + frameNum)),
+		      fn2);
+		}else{
+		    internal::getBestIndex fn2;
+		    fn2.codeBookSize = this->m_vqCodeBookSize;
+		    fn2.product      = helpers::getRawPointer(this->m_disMatrix);
+		    fn2.codeNorm     = helpers::getRawPointer(this->m_codeNorm);
+		    fn2.patTypes     = helpers::getRawPointer(this->patTypes()) + blockS;
+		    thrust::for_each(
+		      thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_selectedIdx.begin() + blockS,
+					   thrust::counting_iterator<int>(0))),
+		      thrust::make_zip_iterator(
+			thrust::make_tuple(this->m_selectedIdx.begin() + blockS + frameNum,
+					   thrust::counting_iterator<int>(0) + frameNum)),
+		      fn2);
+		}
+	    }
         }}
 
 	// step4. optional, calculate the error
@@ -420,20 +554,56 @@ namespace layers{
 		     this->outputErrors().begin() + timeLength * this->size(),
 		     this->precedingLayer().outputErrors().begin());
 	
+	// Propagate the commitment loss to the previous layer
+	{{
+	    internal::GradientForInput fn2;
+	    fn2.featureDim   = this->size();
+	    fn2.beta         = m_betaPara;
+	    fn2.inputData    = helpers::getRawPointer(this->precedingLayer().outputs());
+	    fn2.codeData     = helpers::getRawPointer(this->weights());
+	    fn2.index        = helpers::getRawPointer(this->m_selectedIdx);
+	    fn2.patTypes     = helpers::getRawPointer(this->patTypes());
+
+	    int n = timeLength * this->size();
+	    thrust::for_each(
+               thrust::make_zip_iterator(
+		  thrust::make_tuple(this->precedingLayer().outputErrors().begin(),
+				     thrust::counting_iterator<int>(0))),
+	       thrust::make_zip_iterator(
+		  thrust::make_tuple(this->precedingLayer().outputErrors().begin() + n,
+				     thrust::counting_iterator<int>(0) + n)),
+	       fn2);
+	}}
+	
+	// Group the frames by the selected code
+	{{
+	    thrust::copy(this->m_selectedIdx.begin(), this->m_selectedIdx.begin() + timeLength,
+			 this->m_sortedIdx.begin());
+	    thrust::sequence(this->m_sortedFrame.begin(),
+			     this->m_sortedFrame.begin() + timeLength);
+	    thrust::stable_sort_by_key(this->m_sortedIdx.begin(),
+				       this->m_sortedIdx.begin() + timeLength,
+				       this->m_sortedFrame.begin());
+	    // frames with index -1 (void frames) are placed before the first code
+	    thrust::lower_bound(this->m_sortedIdx.begin(), this->m_sortedIdx.begin() + timeLength,
+				thrust::counting_iterator<int>(0),
+				thrust::counting_iterator<int>(0) + this->m_vqCodeBookSize,
+				this->m_codeStart.begin());
+	    thrust::upper_bound(this->m_sortedIdx.begin(), this->m_sortedIdx.begin() + timeLength,
+				thrust::counting_iterator<int>(0),
+				thrust::counting_iterator<int>(0) + this->m_vqCodeBookSize,
+				this->m_codeEnd.begin());
+	}}
+	
 	// Update the codeBook
 	{{
 	    internal::GradientForCodeBook fn1;
 	    fn1.featureDim   = this->size();
-	    fn1.codeBookSize = this->m_vqCodeBookSize;
-	    
 	    fn1.codeData     = helpers::getRawPointer(this->weights());
 	    fn1.inputData    = helpers::getRawPointer(this->precedingLayer().outputs());
-	    fn1.preLayerGrad = helpers::getRawPointer(this->precedingLayer().outputErrors());
-	    fn1.beta         = m_betaPara;
-	    fn1.index        = helpers::getRawPointer(this->m_selectedIdx);
-	    
-	    fn1.timeLength   = timeLength;
-	    fn1.patTypes     = helpers::getRawPointer(this->patTypes());
+	    fn1.sortedFrame  = helpers::getRawPointer(this->m_sortedFrame);
+	    fn1.codeStart    = helpers::getRawPointer(this->m_codeStart);
+	    fn1.codeEnd      = helpers::getRawPointer(this->m_codeEnd);
 	    
 	    int n = this->size() * this->m_vqCodeBookSize;
 	    thrust::for_each(
@@ -447,6 +617,92 @@ namespace layers{
 
 	}}
     }
+
+    template <typename TDevice>
+    void vqLayer<TDevice>::__computeCodeNorm()
+    {
+	internal::SquaredNorm fn;
+	fn.featureDim = this->size();
+	fn.data       = helpers::getRawPointer(this->weights());
+	thrust::for_each(
+	  thrust::make_zip_iterator(
+		thrust::make_tuple(this->m_codeNorm.begin(),
+				   thrust::counting_iterator<int>(0))),
+	  thrust::make_zip_iterator(
+		thrust::make_tuple(this->m_codeNorm.begin()          + m_vqCodeBookSize,
+				   thrust::counting_iterator<int>(0) + m_vqCodeBookSize)),
+	  fn);
+    }
+
+    template <typename TDevice>
+    void vqLayer<TDevice>::__buildCoarseIndex()
+    {
+	// k-means over the codes (on the host, only once in inference)
+	int featDim = this->size();
+	int codeNum = m_vqCodeBookSize;
+	int cellNum = m_coarseNum;
+	
+	cpu_real_vector codes   = this->weights();
+	cpu_real_vector centers(cellNum * featDim, 0.0);
+	cpu_real_vector cellCnt(cellNum, 0.0);
+	cpu_int_vector  assign(codeNum, 0);
+
+	// initialize with codes evenly spaced in the code book
+	for (int c = 0; c < cellNum; c++)
+	    for (int i = 0; i < featDim; i++)
+		centers[c * featDim + i] = codes[(c * (codeNum / cellNum)) * featDim + i];
+
+	for (int iter = 0; iter < NN_VQLAYER_COARSE_KMEANS_ITER; iter++){
+	    // assignment
+	    for (int k = 0; k < codeNum; k++){
+		real_t bestDis = 0.0;
+		for (int c = 0; c < cellNum; c++){
+		    real_t tempDis = 0.0;
+		    for (int i = 0; i < featDim; i++)
+			tempDis += ((codes[k * featDim + i] - centers[c * featDim + i]) *
+				    (codes[k * featDim + i] - centers[c * featDim + i]));
+		    if (c == 0 || tempDis < bestDis){
+			bestDis   = tempDis;
+			assign[k] = c;
+		    }
+		}
+	    }
+	    // update (an empty cell keeps its center)
+	    thrust::fill(cellCnt.begin(), cellCnt.end(), 0.0);
+	    for (int k = 0; k < codeNum; k++)
+		cellCnt[assign[k]] += 1.0;
+	    for (int c = 0; c < cellNum; c++)
+		if (cellCnt[c] > 0)
+		    for (int i = 0; i < featDim; i++)
+			centers[c * featDim + i] = 0.0;
+	    for (int k = 0; k < codeNum; k++)
+		for (int i = 0; i < featDim; i++)
+		    centers[assign[k] * featDim + i] += (codes[k * featDim + i] /
+							 cellCnt[assign[k]]);
+	}
+
+	// list of codes in each cell
+	cpu_int_vector cellStart(cellNum + 1, 0);
+	cpu_int_vector codeList(codeNum, 0);
+	for (int k = 0; k < codeNum; k++)
+	    cellStart[assign[k] + 1] += 1;
+	for (int c = 0; c < cellNum; c++)
+	    cellStart[c + 1] += cellStart[c];
+	cpu_int_vector cellPos = cellStart;
+	for (int k = 0; k < codeNum; k++)
+	    codeList[cellPos[assign[k]]++] = k;
+
+	cpu_real_vector centerNorm(cellNum, 0.0);
+	for (int c = 0; c < cellNum; c++)
+	    for (int i = 0; i < featDim; i++)
+		centerNorm[c] += centers[c * featDim + i] * centers[c * featDim + i];
+	
+	m_coarseCenter = centers;
+	m_coarseNorm   = centerNorm;
+	m_coarseList   = codeList;
+	m_coarseStart  = cellStart;
+	m_coarseReady  = true;
+    }
 	    
     template <typename TDevice>
     const std::string& vqLayer<TDevice>::type() const
@@ -464,6 +720,12 @@ namespace layers{
 							  m_vqCodeBookSize, allocator);
 	(*layersArray)[layersArray->Size() - 1].AddMember("beta",
 							  m_betaPara, allocator);
+	if (m_coarseNum > 0){
+	    (*layersArray)[layersArray->Size() - 1].AddMember("vqCoarseNum",
+							      m_coarseNum, allocator);
+	    (*layersArray)[layersArray->Size() - 1].AddMember("vqCoarseProbe",
+							      m_coarseProbe, allocator);
+	}
 	
     }
 
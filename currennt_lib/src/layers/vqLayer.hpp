@@ -47,16 +47,37 @@ namespace layers{
     public:
 
 	const int    m_vqCodeBookSize;   // size of the code book
-	real_vector  m_disMatrix;        // distance matrix
+	real_vector  m_disMatrix;        // code-input products of one block of frames
 	int_vector   m_selectedIdx;
 	real_t       m_betaPara;
 	real_t       m_codeError;
+
+	// Add 20180713: nearest code search and gradients
+	real_vector  m_codeNorm;         // ||c||^2 of each code
+	int_vector   m_sortedIdx;        // selected indices sorted in ascending order
+	int_vector   m_sortedFrame;      // frame indices sorted by the selected indices
+	int_vector   m_codeStart;        // m_sortedFrame[m_codeStart[k]:m_codeEnd[k]] selects k
+	int_vector   m_codeEnd;
+
+	// coarse-to-fine search index (only used in inference)
+	int          m_coarseNum;        // number of coarse cells
+	int          m_coarseProbe;      // number of cells to be searched
+	bool         m_coarseReady;      // whether the index has been built
+	real_vector  m_coarseCenter;     // centers of the cells (featureDim * m_coarseNum)
+	real_vector  m_coarseNorm;       // ||center||^2
+	int_vector   m_coarseList;       // code indices sorted by cell
+	int_vector   m_coarseStart;      // m_coarseList[m_coarseStart[c]:m_coarseStart[c+1]]
+	
+	void __computeCodeNorm();
+	
+	void __buildCoarseIndex();
 	
 	vqLayer(
 	    const helpers::JsonValue &layerChild,
 	    const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
 	);
 
 	virtual ~vqLayer();
@@ -31,6 +31,7 @@
 #include "../helpers/Matrix.hpp"
 #include "../helpers/JsonClasses.hpp"
 #include "../helpers/misFuncs.hpp"
+#include "../helpers/gatedActivation.cuh"
 #include "../activation_functions/Logistic.cuh"
 #include "../activation_functions/Tanh.cuh"
 #include "../MacroDefine.hpp"
@@ -60,76 +61,126 @@
 namespace internal{
 namespace {
     
-    struct tanhSigMerge
+    struct GatedActivation
     {
-	
-	int         shiftBuf;
+	// Add 20180712: fused forward of the gated activation
+	//  a_tanh = conv_tanh + tanh(W_tanh * context), a_sig = conv_sig + tanh(W_sig * context)
+	//  output = tanh(a_tanh) * sigmoid(a_sig)
+	// the pre-activations are stored only when coreBuf != NULL (training)
 	int         outputSize;
-	real_t     *coreBuf;
+	int         paralNum;
+	int         maxFeatureLength;
+
+	const real_t *fromConv;     // output of the preceding layer
+	const real_t *projData;     // projected context (NULL if no context)
+	const real_t *frameIndex;   // index of context frame for each time step
+	real_t     *coreBuf;        // pre-activations
+	real_t     *contextTanh;    // tanh(W * context)
+	real_t     *outputs;        // output of the first time step (per time step only)
 	const char *patTypes;
-	
-	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
-	{
-	    int dimIdx    = t.get<1>() % outputSize;
-	    int timeIdx   = t.get<1>() / outputSize;
 
+	// num channels from dimIdx of time step timeIdx
+	__host__ __device__ void step(const int timeIdx, const int dimIdx, const int num,
+				      real_t *out) const
+	{
+	    int idxTanh = timeIdx * 2 * outputSize + dimIdx;
+	    
 	    if (patTypes[timeIdx] == PATTYPE_NONE){
-		t.get<0>() = 0.0;
-	    }else{
-		int idx = timeIdx * 2 * outputSize + dimIdx - shiftBuf;
-		t.get<0>() = (activation_functions::Tanh::fn(coreBuf[idx]) *
-			      activation_functions::Logistic::fn(coreBuf[idx + outputSize]));
+		for (int i = 0; i < num; ++i)
+		    out[i] = 0.0;
+		helpers::gatedZero(num, outputSize,
+				   (coreBuf     ? (coreBuf     + idxTanh) : NULL),
+				   (contextTanh ? (contextTanh + idxTanh) : NULL));
+		return;
 	    }
+
+	    const real_t *proj = NULL;
+	    if (projData && frameIndex[timeIdx] < maxFeatureLength)
+		proj = (projData + dimIdx +
+			((int)frameIndex[timeIdx] * paralNum + timeIdx % paralNum) * 2 * outputSize);
+	    
+	    helpers::gatedForward(num, outputSize, fromConv + idxTanh, proj,
+				  (coreBuf     ? (coreBuf     + idxTanh) : NULL),
+				  (contextTanh ? (contextTanh + idxTanh) : NULL),
+				  out);
+	}
+
+	// GPU: one element
+	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+	{
+	    step(t.get<1>() / outputSize, t.get<1>() % outputSize, 1, &(t.get<0>()));
+	}
+
+	// CPU: one time step
+	__host__ __device__ void operator() (const int &timeIdx) const
+	{
+	    step(timeIdx, 0, outputSize, outputs + timeIdx * outputSize);
 	}
     };
 
-    struct tanhSigMergeGradient
+    struct GatedActivationGradient
     {
-
+	// Add 20180712: fused backward of the gated activation
+	// gradients w.r.t the conv outputs are written to preErrors,
+	// gradients w.r.t W * context overwrite contextTanh (if contextTanh != NULL)
 	int         outputSize;
 	real_t     *coreBuf;
-	real_t     *errors;
+	real_t     *preErrors;
+	real_t     *contextTanh;
+	const real_t *errors;       // errors of the first time step (per time step only)
 	const char *patTypes;
+
+	__host__ __device__ void step(const int timeIdx, const int dimIdx, const int num,
+				      const real_t *err) const
+	{
+	    int idxTanh = timeIdx * 2 * outputSize + dimIdx;
+	    
+	    if (patTypes[timeIdx] == PATTYPE_NONE)
+		helpers::gatedZero(num, outputSize, preErrors + idxTanh,
+				   (contextTanh ? (contextTanh + idxTanh) : NULL));
+	    else
+		helpers::gatedBackward(num, outputSize, coreBuf + idxTanh, err,
+				       preErrors + idxTanh,
+				       (contextTanh ? (contextTanh + idxTanh) : NULL));
+	}
 	
-	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
+	// GPU: one element
+	__host__ __device__ void operator() (const thrust::tuple<const real_t&, int> &t) const
 	{
-	    int dimIdx    = t.get<1>() % outputSize;
-	    int timeIdx   = t.get<1>() / outputSize;
+	    step(t.get<1>() / outputSize, t.get<1>() % outputSize, 1, &(t.get<0>()));
+	}
 
-	    if (patTypes[timeIdx] == PATTYPE_NONE){
-		t.get<0>() = 0.0;
-	    }else{
-		
-		if (dimIdx < (outputSize/2)){
-		    int idx = timeIdx * outputSize + dimIdx;
-		    /* Fatal Errors: Tanh::derive(y), y should be the output of tanh(x)
-		       Here, we need to use the function 1-Tanh(x) * Tanh(x)
-		     */
-		    /*
-		    t.get<0>() = (activation_functions::Tanh::deriv(coreBuf[idx]) *
-				  activation_functions::Logistic::fn(coreBuf[idx + outputSize/2]) *
-				  errors[timeIdx * outputSize / 2 + dimIdx]);*/
-		    real_t tmp = activation_functions::Tanh::fn(coreBuf[idx]);
-		    t.get<0>() = (((real_t)1.0 - tmp * tmp) *
-				  activation_functions::Logistic::fn(coreBuf[idx + outputSize/2]) *
-				  errors[timeIdx * outputSize / 2 + dimIdx]);
-		    
-		}else{
-		    int idx = timeIdx * outputSize + dimIdx;
-		    /*
-		    t.get<0>() = (activation_functions::Tanh::fn(coreBuf[idx - outputSize/2]) *
-				  activation_functions::Logistic::deriv(coreBuf[idx]) *
-				  errors[timeIdx * outputSize /2 + dimIdx - outputSize / 2]);*/
-		    real_t tmp = activation_functions::Logistic::fn(coreBuf[idx]);
-		    t.get<0>() = (activation_functions::Tanh::fn(coreBuf[idx - outputSize/2]) *
-				  (tmp * ((real_t)1.0 - tmp)) *
-				  errors[timeIdx * outputSize /2 + dimIdx - outputSize / 2]);
-		}
-		
-	    }
+	// CPU: one time step
+	__host__ __device__ void operator() (const int &timeIdx) const
+	{
+	    step(timeIdx, 0, outputSize, errors + timeIdx * outputSize);
 	}
     };
 
+    // Add 20181018: the gated activation of timeNum time steps, first one at buf[start]
+    //  GPU: one thread per element. CPU: one call per time step, so that the loop
+    //  over the channels is contiguous and can be vectorized by the compiler
+    template <typename TFn>
+    void gatedForEach(Gpu::real_vector &buf, const int start, const int timeNum,
+		      const int size, const TFn &fn)
+    {
+	int n = timeNum * size;
+	thrust::for_each(
+	    thrust::make_zip_iterator(
+		thrust::make_tuple(buf.begin() + start, thrust::counting_iterator<int>(0))),
+	    thrust::make_zip_iterator(
+		thrust::make_tuple(buf.begin() + start + n, thrust::counting_iterator<int>(0) + n)),
+	    fn);
+    }
+
+    template <typename TFn>
+    void gatedForEach(Cpu::real_vector &buf, const int start, const int timeNum,
+		      const int size, const TFn &fn)
+    {
+	thrust::for_each(thrust::counting_iterator<int>(0),
+			 thrust::counting_iterator<int>(0) + timeNum, fn);
+    }
+
     struct loadLinguisticFeature
     {
 	int  featureDim;
@@ -167,45 +218,27 @@ namespace {
 	}
     };
 
-    struct AddLinguisticFeature
+    struct NormLinguisticFeature
     {
-	int     featureDim;
-	real_t *contextTanh;
-	const real_t *fromConv;
-	const char   *patTypes;
-
-	int     shiftConv;
-	int     shiftOut;
+	// normalize the linguistic features at the native resolution
+	int  featureDim;
+	
+	const real_t *sourceData;
+	const real_t *contextMV;
 	
 	__host__ __device__ void operator() (const thrust::tuple<real_t&, int> &t) const
 	{
 	    int dimIdx  = t.get<1>() % featureDim;
-	    int timeIdx = t.get<1>() / featureDim;
-	    int fromConvIdx = t.get<1>() - shiftConv;
-	    
-	    if (patTypes[timeIdx] == PATTYPE_NONE){
-		t.get<0>() = 0.0;
-		if (contextTanh != NULL) contextTanh[t.get<1>()] = 0.0;
+	    if (contextMV){
+		t.get<0>() = ((sourceData[t.get<1>()] - contextMV[dimIdx])/
+			      ((contextMV[dimIdx + featureDim]<1e-5f)?
+			       (1.0):
+			       (contextMV[dimIdx + featureDim])));
 	    }else{
-		if (contextTanh != NULL){
-		    contextTanh[t.get<1>()] = activation_functions::Tanh::fn(t.get<0>());
-		    t.get<0>() = fromConv[fromConvIdx] + contextTanh[t.get<1>()];
-		}else{
-		    t.get<0>() = fromConv[fromConvIdx] + activation_functions::Tanh::fn(t.get<0>());
-		}
+		t.get<0>() = sourceData[t.get<1>()];
 	    }
 	}
     };
-    
-    struct AddLinguisticFeatureGrad
-    {
-        
-        __host__ __device__ void operator() (const thrust::tuple<real_t&, const real_t&> &t) const
-        {
-            real_t delta = activation_functions::Tanh::deriv(t.get<0>()) * t.get<1>();
-            t.get<0>() = delta;
-        }
-    };
 
     struct SumGradientsForExternalInut
     {
@@ -280,11 +313,13 @@ namespace layers{
     WavNetCore<TDevice>::WavNetCore(const helpers::JsonValue &layerChild,
 				    const helpers::JsonValue &weightsSection,
 				    Layer<TDevice>           &precedingLayer,
-				    int maxSeqLength)
+				    int maxSeqLength,
+				    typename TDevice::real_vector *sharedWeights)
 	: TrainableLayer<TDevice>(layerChild, weightsSection, 0,
 				  ((layerChild->HasMember("contextDim")) ? 
 				   ((*layerChild)["contextDim"].GetInt()) : (0)) * 2,
-				  precedingLayer, maxSeqLength)
+				  precedingLayer, maxSeqLength,
+				  sharedWeights)
 	, m_exInputLayer         (NULL)
     {
 	m_contextDim   = ((layerChild->HasMember("contextDim")) ? 
@@ -301,13 +336,15 @@ namespace layers{
 	printf("\n\tWavNet core operation: context [%d] dim\n", m_contextDim);
 	
 	// allocate memory for linguistic_features + input_features
+	// (the pre-activations are only required for back-propagation)
 	cpu_real_vector tmp(this->maxSeqLength()*this->parallelSequences()*this->size()*2, 0.0);
-	m_coreBuf        = tmp;
-	
-	if (this->flagTrainingMode())
+	if (this->flagTrainingMode()){
+	    m_coreBuf        = tmp;
 	    m_contextTanhBuf = tmp;
-	else
+	}else{
+	    m_coreBuf.clear();
 	    m_contextTanhBuf.clear();
+	}
 	
 	m_contextBuf.clear();
 	if (m_contextMVStr.size() && m_contextDim > 0){
@@ -350,8 +387,31 @@ namespace layers{
 		thrust::copy(m_exInputLayer->outputs().begin(), m_exInputLayer->outputs().end(),
 			     m_contextRawBuf.begin() + dataPos);
 
+	    // Normalize the data at the native resolution
+	    // (it is projected once for each wavnetc layer)
+	    if (m_contextCurMaxLength > 0){
+		internal::NormLinguisticFeature fn0;
+		fn0.featureDim = m_contextDim;
+		fn0.sourceData = helpers::getRawPointer(m_contextRawBuf) + dataPos;
+		fn0.contextMV  = ((m_contextMV.size() == m_contextDim * 2)?
+				  helpers::getRawPointer(m_contextMV) : NULL);
+		
+		int n = m_contextCurMaxLength * this->parallelSequences() * m_contextDim;
+		if (m_contextNatBuf.size() < n)
+		    m_contextNatBuf.resize(n, 0.0);
+		thrust::for_each(
+			thrust::make_zip_iterator(
+				thrust::make_tuple(m_contextNatBuf.begin(),
+						   thrust::counting_iterator<int>(0))),
+			thrust::make_zip_iterator(
+				thrust::make_tuple(m_contextNatBuf.begin()           + n,
+						   thrust::counting_iterator<int>(0) + n)),
+			fn0);
+	    }
+	    
 	    // Load the data to contextBuf
-	    {{	
+	    // (the context at the sample level is only required to compute the gradients)
+	    if (this->flagTrainingMode()){{	
 		internal::loadLinguisticFeature fn1;
 		fn1.featureDim = m_contextDim;
 		fn1.paralNum   = this->parallelSequences();
@@ -377,6 +437,25 @@ namespace layers{
 	    return;
 	}
     }
+
+    template <typename TDevice>
+    void WavNetCore<TDevice>::__projectContext()
+    {
+	// project the context at the native resolution by the weights of this layer
+	WavNetCore<TDevice> *iniLayer = (m_iniWavCoreC ? this : m_iniWavCPtr);
+	int natLength = iniLayer->m_contextCurMaxLength * this->parallelSequences();
+	if (natLength <= 0)
+	    return;
+	if (m_contextProjBuf.size() < natLength * this->size() * 2)
+	    m_contextProjBuf.resize(natLength * this->size() * 2, 0.0);
+	
+	helpers::Matrix<TDevice> weightsMatrix(&this->weights(), m_contextDim, 2*this->size());
+	helpers::Matrix<TDevice> plOutputsMatrix(&iniLayer->m_contextNatBuf,
+						 m_contextDim, natLength);
+	helpers::Matrix<TDevice> outputsMatrix(&this->m_contextProjBuf,
+					       this->size()*2, natLength);
+	outputsMatrix.assignProduct(weightsMatrix, true, plOutputsMatrix, false);
+    }
     
     template <typename TDevice>
     void WavNetCore<TDevice>::loadSequences(const data_sets::DataSetFraction &fraction,
@@ -438,7 +517,10 @@ namespace layers{
 		// Allocate the external data buffer, and index buffer
 		cpu_real_vector tmp(this->maxSeqLength() * this->parallelSequences() * m_contextDim,
 				    0.0);
-		m_contextBuf    = tmp;
+		if (this->flagTrainingMode())
+		    m_contextBuf = tmp;
+		else
+		    m_contextBuf.clear();
 		tmp.resize(this->maxSeqLength()*this->parallelSequences()*(m_contextDim+1), 0.0);
 		m_contextRawBuf = tmp;
 		
@@ -487,61 +569,31 @@ namespace layers{
 	__loadContextBuff();
 	
 	
-	// Step1. transform the linguistic context
-	if (m_contextDim == 0){
-	    thrust::fill(m_coreBuf.begin(), m_coreBuf.end(), 0.0);
-	}else{
-	    helpers::Matrix<TDevice> weightsMatrix(&this->weights(), m_contextDim, 2*this->size());
-	    helpers::Matrix<TDevice> plOutputsMatrix(&(m_iniWavCoreC?(this->m_contextBuf):
-						       (m_iniWavCPtr->m_contextBuf)), 
-						     m_contextDim, timeLength);
-	    helpers::Matrix<TDevice> outputsMatrix(&this->m_coreBuf, this->size()*2, timeLength);
-	    outputsMatrix.assignProduct(weightsMatrix, true, plOutputsMatrix, false);
-	}
-	
-	// Step2. sum input
-	/*thrust::transform(this->precedingLayer().outputs().begin(),
-			  this->precedingLayer().outputs().begin() + timeLength * this->size() * 2,
-			  m_coreBuf.begin(), m_coreBuf.begin(), thrust::plus<real_t>());*/
-	// Step2. convOutput + tanh(Linguistic)
-	{
-	    internal::AddLinguisticFeature fn2;
-	    fn2.featureDim  = this->size() * 2;
-	    fn2.patTypes    = helpers::getRawPointer(this->patTypes());
-	    fn2.fromConv    = helpers::getRawPointer(this->precedingLayer().outputs());
-	    fn2.contextTanh = (this->flagTrainingMode()?
-			       (helpers::getRawPointer(m_contextTanhBuf)) : NULL);
-
-	    fn2.shiftConv   = 0;
-	    fn2.shiftOut    = 0;
-	    
-	    int n = timeLength * this->size() * 2;
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(m_coreBuf.begin(),
-				     thrust::counting_iterator<int>(0))),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(m_coreBuf.begin()                 + n,
-				     thrust::counting_iterator<int>(0) + n)),
-	       fn2);
-	}
+	// Step1. project the linguistic context
+	// Add 20180712: each frame of the context is projected once
+	if (m_contextDim > 0)
+	    __projectContext();
 
-	// Step3. transform as output tanh(x1) * sig(x2)
+	// Step2. conv output + tanh(context), tanh(x1) * sig(x2) in one pass
 	{
-	    internal::tanhSigMerge fn1;
-	    fn1.outputSize = this->size();
-	    fn1.coreBuf    = helpers::getRawPointer(m_coreBuf);
-	    fn1.patTypes   = helpers::getRawPointer(this->patTypes());
-	    fn1.shiftBuf   = 0;
-	    int n = timeLength * this->size();
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin(),
-				     thrust::counting_iterator<int>(0))),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin()           + n,
-				     thrust::counting_iterator<int>(0) + n)),
-	       fn1);
+	    WavNetCore<TDevice> *iniLayer = (m_iniWavCoreC ? this : m_iniWavCPtr);
+	    internal::GatedActivation fn1;
+	    fn1.outputSize       = this->size();
+	    fn1.paralNum         = this->parallelSequences();
+	    fn1.maxFeatureLength = ((m_contextDim > 0) ? iniLayer->m_contextCurMaxLength : 0);
+	    fn1.fromConv         = helpers::getRawPointer(this->precedingLayer().outputs());
+	    fn1.projData         = ((m_contextDim > 0) ?
+				    helpers::getRawPointer(m_contextProjBuf) : NULL);
+	    fn1.frameIndex       = ((m_contextDim > 0) ?
+				    helpers::getRawPointer(iniLayer->m_contextRawBuf) : NULL);
+	    fn1.coreBuf          = (this->flagTrainingMode() ?
+				    helpers::getRawPointer(m_coreBuf) : NULL);
+	    fn1.contextTanh      = ((this->flagTrainingMode() && m_contextDim > 0) ?
+				    helpers::getRawPointer(m_contextTanhBuf) : NULL);
+	    fn1.outputs          = helpers::getRawPointer(this->outputs());
+	    fn1.patTypes         = helpers::getRawPointer(this->patTypes());
+
+	    internal::gatedForEach(this->outputs(), 0, timeLength, this->size(), fn1);
 	}
     }
     
@@ -552,78 +604,40 @@ namespace layers{
 	int shiftPre    = this->precedingLayer().outputBufPtrBias(effTimeStep, nnState);
 	int shiftCur    = this->outputBufPtrBias(effTimeStep, nnState);
 
-	// Load the data to contextBuf
-	if (timeStep == 0) __loadContextBuff();
-	
-	if (m_contextDim == 0){
-	    thrust::fill(m_coreBuf.begin() + (effTimeStep * this->size() - shiftCur) * 2,
-			 m_coreBuf.begin() +((effTimeStep * this->size() - shiftCur) * 2 + 
-					     + this->size() * 2 * this->parallelSequences()),
-			 0.0);
-	}else{
-	    // Step1. transform the linguistic context
-	    helpers::Matrix<TDevice> weightsMatrix(&this->weights(), m_contextDim, 2*this->size());
-	
-	    helpers::Matrix<TDevice> plOutputsMatrix(&(m_iniWavCoreC?(this->m_contextBuf):
-						       (m_iniWavCPtr->m_contextBuf)), m_contextDim,
-						     this->parallelSequences(),
-						     effTimeStep * m_contextDim);
-	    helpers::Matrix<TDevice> outputsMatrix(&this->m_coreBuf, this->size() * 2,
-						   this->parallelSequences(),
-						   (effTimeStep * this->size() - shiftCur) * 2);
-	
-	    outputsMatrix.assignProduct(weightsMatrix, true, plOutputsMatrix, false);
-	}
-	
-	// Step2. sum input
-	/*thrust::transform(this->precedingLayer().outputs().begin()+effTimeStep*this->size()*2,
-			  this->precedingLayer().outputs().begin() +
-			  (effTimeStep + this->parallelSequences()) * this->size() * 2,
-			  m_coreBuf.begin() + effTimeStep * this->size() * 2,
-			  m_coreBuf.begin() + effTimeStep * this->size() * 2,
-			  thrust::plus<real_t>());*/
-	{
-	    internal::AddLinguisticFeature fn2;
-	    fn2.featureDim  = this->size() * 2;
-	    fn2.patTypes    = helpers::getRawPointer(this->patTypes());
-	    fn2.fromConv    = helpers::getRawPointer(this->precedingLayer().outputs());
-	    fn2.contextTanh = (this->flagTrainingMode()?
-			       (helpers::getRawPointer(m_contextTanhBuf)):NULL);
-
-	    fn2.shiftConv   = shiftPre;
-	    fn2.shiftOut    = shiftCur * 2;
-	    
-	    int st = effTimeStep * this->size() * 2;
-	    int et = (effTimeStep + this->parallelSequences()) * this->size() * 2;
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(m_coreBuf.begin() + (st - shiftCur * 2) ,
-				     thrust::counting_iterator<int>(0) + st)),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(m_coreBuf.begin() + (et - shiftCur * 2),
-				     thrust::counting_iterator<int>(0) + et)),
-	       fn2);
+	// Load the data to contextBuf, and project the context
+	if (timeStep == 0){
+	    __loadContextBuff();
+	    if (m_contextDim > 0)
+		__projectContext();
 	}
 
-
-	// Step3. transform as output tanh(x1) * sig(x2)
+	// conv output + tanh(context), tanh(x1) * sig(x2) in one pass
+	// (pointers are moved to the current time step)
 	{
-	    internal::tanhSigMerge fn1;
-	    fn1.outputSize = this->size();
-	    fn1.coreBuf    = helpers::getRawPointer(m_coreBuf);
-	    fn1.patTypes   = helpers::getRawPointer(this->patTypes());
-	    fn1.shiftBuf   = shiftCur * 2;
-		
-	    int st = effTimeStep * this->size();
-	    int et = (effTimeStep + this->parallelSequences()) * this->size();
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin() + st - shiftCur,
-				     thrust::counting_iterator<int>(0) + st)),
-	       thrust::make_zip_iterator(
-		  thrust::make_tuple(this->outputs().begin() + et - shiftCur,
-				     thrust::counting_iterator<int>(0) + et)),
-	       fn1);
+	    WavNetCore<TDevice> *iniLayer = (m_iniWavCoreC ? this : m_iniWavCPtr);
+	    internal::GatedActivation fn1;
+	    fn1.outputSize       = this->size();
+	    fn1.paralNum         = this->parallelSequences();
+	    fn1.maxFeatureLength = ((m_contextDim > 0) ? iniLayer->m_contextCurMaxLength : 0);
+	    fn1.fromConv         = (helpers::getRawPointer(this->precedingLayer().outputs()) +
+				    effTimeStep * this->size() * 2 - shiftPre);
+	    fn1.projData         = ((m_contextDim > 0) ?
+				    helpers::getRawPointer(m_contextProjBuf) : NULL);
+	    fn1.frameIndex       = ((m_contextDim > 0) ?
+				    (helpers::getRawPointer(iniLayer->m_contextRawBuf) +
+				     effTimeStep) : NULL);
+	    fn1.coreBuf          = (this->flagTrainingMode() ?
+				    (helpers::getRawPointer(m_coreBuf) +
+				     effTimeStep * this->size() * 2) : NULL);
+	    fn1.contextTanh      = ((this->flagTrainingMode() && m_contextDim > 0) ?
+				    (helpers::getRawPointer(m_contextTanhBuf) +
+				     effTimeStep * this->size() * 2) : NULL);
+	    fn1.outputs          = (helpers::getRawPointer(this->outputs()) +
+				    effTimeStep * this->size() - shiftCur);
+	    fn1.patTypes         = helpers::getRawPointer(this->patTypes()) + effTimeStep;
+
+	    internal::gatedForEach(this->outputs(), effTimeStep * this->size() - shiftCur,
+				   this->parallelSequences(), this->size(), fn1);
 	}
     }
 
@@ -632,41 +646,21 @@ namespace layers{
     {	
 	int timeLength = this->curMaxSeqLength() * this->parallelSequences();
 	
+	// gradients of the gated activation and the context in one pass
 	{
-	    internal::tanhSigMergeGradient fn1;
-	    fn1.outputSize = this->size() * 2;
-	    fn1.coreBuf    = helpers::getRawPointer(m_coreBuf);
-	    fn1.errors     = helpers::getRawPointer(this->outputErrors());
-	    fn1.patTypes   = helpers::getRawPointer(this->patTypes());
-	    
-	    int n = timeLength * this->size() * 2;
-	    thrust::for_each(
-               thrust::make_zip_iterator(
-		thrust::make_tuple(this->precedingLayer().outputErrors().begin(),
-				     thrust::counting_iterator<int>(0))),
-	       thrust::make_zip_iterator(
-		thrust::make_tuple(this->precedingLayer().outputErrors().begin() + n,
-				     thrust::counting_iterator<int>(0) + n)),
-	       fn1);
+	    internal::GatedActivationGradient fn1;
+	    fn1.outputSize  = this->size();
+	    fn1.coreBuf     = helpers::getRawPointer(m_coreBuf);
+	    fn1.preErrors   = helpers::getRawPointer(this->precedingLayer().outputErrors());
+	    fn1.contextTanh = ((m_contextDim > 0) ? helpers::getRawPointer(m_contextTanhBuf) : NULL);
+	    fn1.errors      = helpers::getRawPointer(this->outputErrors());
+	    fn1.patTypes    = helpers::getRawPointer(this->patTypes());
+
+	    internal::gatedForEach(this->outputErrors(), 0, timeLength, this->size(), fn1);
 	}
 	
 	if (m_contextDim == 0)
 	    return;
-	
-	{
-	    internal::AddLinguisticFeatureGrad fn;
-
-            int n = timeLength * this->size() * 2;
-            thrust::for_each(
-             thrust::make_zip_iterator(
-	      thrust::make_tuple(m_contextTanhBuf.begin(),
-				 this->precedingLayer().outputErrors().begin())),
-	     thrust::make_zip_iterator(
-	      thrust::make_tuple(m_contextTanhBuf.begin() + n,
-				 this->precedingLayer().outputErrors().begin() + n)),
-                fn);
-
-	}
 
 	// Gradients to the transformation matrix
 	helpers::Matrix<TDevice> weightUpdatesMatrix(&this->_weightUpdates(),
@@ -733,7 +727,7 @@ namespace layers{
     {
 	//Layer<TDevice>::reduceOutputBuffer();
 	this->resizeOutputBuffer(this->parallelSequences() * this->size());
-	m_coreBuf.resize(this->parallelSequences() * this->size() * 2, 0.0);
+	m_coreBuf.clear();
 	m_coreBuf.shrink_to_fit();
 	this->setSaveMemoryFlag(true);
 	printf("\t[mem saved]");
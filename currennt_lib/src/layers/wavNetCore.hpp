@@ -56,6 +56,10 @@ namespace layers{
 	real_vector    m_contextMV;
 	std::string    m_contextMVStr;
 	int            m_contextCurMaxLength;
+
+	// Add 20180712: conditioning cache
+	real_vector    m_contextNatBuf;  // normalized context at its native resolution
+	real_vector    m_contextProjBuf; // context projected by this layer (native resolution)
 	
 	TrainableLayer<TDevice> *m_exInputLayer;
 	
@@ -63,13 +67,16 @@ namespace layers{
 	WavNetCore<TDevice>     *m_iniWavCPtr;
 
 	void __loadContextBuff();
+
+	void __projectContext();
 	
     public:
 	WavNetCore(
 	    const helpers::JsonValue &layerChild,
 	    const helpers::JsonValue &weightsSection,
             Layer<TDevice>           &precedingLayer,
-	    int                       maxSeqLength
+	    int                       maxSeqLength,
+	    typename TDevice::real_vector *sharedWeights = NULL
 	);
 
 	virtual ~WavNetCore();
@@ -27,20 +27,89 @@
 #include "../layers/MulticlassClassificationLayer.hpp"
 #include "../Configuration.hpp"
 #include "../helpers/JsonClasses.hpp"
+#include "../helpers/ParallelRun.hpp"
+#include "../helpers/AllReduce.hpp"
+#include "../helpers/fusedForEach.cuh"
+#include "../helpers/getRawPointer.cuh"
+#include "../helpers/BinaryModel.hpp"
+#include "../helpers/Checkpoint.hpp"
 #include "../MacroDefine.hpp"
 
 #include <limits>
+#include <ctime>
 
 #include <thrust/transform.h>
 #include <thrust/fill.h>
 
 
+namespace internal {
+namespace {
+
+    // gradients of the idx-th layer of the network (NULL if not trainable)
+    template <typename TDevice>
+    const typename TDevice::real_vector* layerWeightUpdates(NeuralNetwork<TDevice> &nn,
+							    const size_t idx)
+    {
+	layers::TrainableLayer<TDevice> *layer = 
+	    dynamic_cast<layers::TrainableLayer<TDevice>*>(nn.layers()[idx].get());
+	if (layer)
+	    return &(layer->weightUpdates());
+	
+	layers::MDNLayer<TDevice> *mdnlayer = 
+	    dynamic_cast<layers::MDNLayer<TDevice>*>(nn.layers()[idx].get());
+	if (mdnlayer && mdnlayer->flagTrainable())
+	    return &(mdnlayer->weightUpdates());
+	
+	return NULL;
+    }
+
+    // Add 20181018: copy (or accumulate) the gradients of all the layers into the arena
+    struct GatherGradientsFn
+    {
+	int            seg;             // see helpers::fused::forEach
+	const int     *segStart;
+	int            segNum;
+	real_t *const *gradients;
+	bool           accumulate;
+	
+	__host__ __device__ void operator() (const thrust::tuple<real_t&, const int&> &t) const
+	{
+	    int    s    = (seg >= 0 ? seg : 
+			   helpers::fused::findSegment(segStart, segNum, t.get<1>()));
+	    real_t grad = gradients[s][t.get<1>() - segStart[s]];
+	    t.get<0>()  = (accumulate ? (t.get<0>() + grad) : grad);
+	}
+    };
+    
+}
+}
+
 namespace optimizers {
 
     template <typename TDevice>
     void Optimizer<TDevice>::_processDataSet(data_sets::DataSet &ds,  bool calcWeightUpdates,
 					       real_t &error, real_t &classError, real_t &secError)
     {
+	// Add 20181018: distributed training, start from the same weights
+	if (calcWeightUpdates && helpers::allReduce::distributed())
+	    _distBroadcastWeights();
+
+	// Add 20181018: pointers to the weights of the layers for the fused kernels
+	if (calcWeightUpdates)
+	    _buildSegments();
+	
+	// Add 20181018: data-parallel training
+	if (!m_replicas.empty()){
+	    // the mid-epoch autosave is only continued by the single-network path
+	    if (calcWeightUpdates)
+		m_midEpoch.fracCnt = 0;
+	    if (calcWeightUpdates && Configuration::instance().asyncTraining())
+		_processDataSetAsync(ds, error, classError, secError);
+	    else
+		_processDataSetParallel(ds, calcWeightUpdates, error, classError, secError);
+	    return;
+	}
+	
         // process all data set fractions
         error       = 0;
 	secError    = 0;
@@ -61,6 +130,19 @@ namespace optimizers {
 	real_t uttCnt        = 0;                              // utterance counter
 	real_t errorTemp1    = 0.0;
 	real_t errorTemp2    = 0.0;
+
+	// Add 20181018: continue the epoch of the mid-epoch autosave
+	//  the data loader has been restored to the next fraction
+	if (calcWeightUpdates && m_midEpoch.fracCnt > 0){
+	    fracCnt       = m_midEpoch.fracCnt;
+	    uttCnt        = m_midEpoch.uttCnt;
+	    error         = m_midEpoch.error;
+	    secError      = m_midEpoch.secError;
+	    classError    = m_midEpoch.classError;
+	    firstFraction = false;
+	    printf("Continue epoch %d from fraction %d\n", m_curEpoch, fracCnt);
+	}
+	
         while ((frac = ds.getNextFraction())) {
 	    
 	    // get the number of frames for SGD
@@ -79,7 +161,9 @@ namespace optimizers {
 	    m_neuralNetwork.restoreTarget(*frac);
 
 	    // calculate the errors
-            errorTemp1 = (m_neuralNetwork.calculateError(true)/ds.totalSequences());
+            // Modify 20181018: the gradients of the output are computed together
+            errorTemp1 = (m_neuralNetwork.calculateError(true, calcWeightUpdates)/
+			  ds.totalSequences());
 	    errorTemp2 = (m_neuralNetwork.calculateError(false)/ds.totalSequences());
 	    
 	    if (Configuration::instance().verboseLevel() == OP_VERBOSE_LEVEL_1){
@@ -132,67 +216,38 @@ namespace optimizers {
 		m_neuralNetwork.cleanGradientsForDiscriminator();
 		
 		// accumulate the statistics for parameter updating
-                for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
-		    
-                    layers::TrainableLayer<TDevice> *layer = 
-			dynamic_cast<layers::TrainableLayer<TDevice>*>(
-				m_neuralNetwork.layers()[i].get());
-		    layers::MDNLayer<TDevice> *mdnlayer = 
-			dynamic_cast<layers::MDNLayer<TDevice>*>(
+		// Modify 20181018: one pass over the gradient arena for all the layers
+		//  if batch mode (not stochastic) and not the first fraction, 
+		//  accumulating the updates.
+		//  Hybrid online/batch in one process: the gradients are used once, and
+		//  the update reads them from the layers without the copy
+		m_gradsInLayers = (Configuration::instance().hybridOnlineBatch() &&
+				   !helpers::allReduce::distributed());
+		if (!m_gradsInLayers)
+		    _gatherWeightUpdates(!firstFraction &&
+					 !Configuration::instance().hybridOnlineBatch());
+
+		// restore old weights before update in case of weight noise
+		if (Configuration::instance().weightNoiseSigma() > 0.0) {
+		    for (size_t i = 1; i < m_neuralNetwork.layers().size()-1; ++i) {
+			layers::TrainableLayer<TDevice> *layer = 
+			    dynamic_cast<layers::TrainableLayer<TDevice>*>(
 				m_neuralNetwork.layers()[i].get());
-		    
-		    // Modify 0703: PostLayer can be trainable too
-		    if (!layer && !(mdnlayer && mdnlayer->flagTrainable())){
-			continue;
-		    }
-		    
-		    if (layer){
-			// if batch mode (not stochastic) and not the first fraction, 
-			// accumulating the updates
-			if (!firstFraction && !Configuration::instance().hybridOnlineBatch())
-			    thrust::transform(layer->weightUpdates().begin(), 
-					      layer->weightUpdates().end(), 
-					      m_curWeightUpdates[i].begin(), 
-					      m_curWeightUpdates[i].begin(), 
-					      thrust::plus<real_t>());
-			else
-			    thrust::copy(layer->weightUpdates().begin(), 
-					 layer->weightUpdates().end(), 
-					 m_curWeightUpdates[i].begin());
-						
-			// restore old weights before update in case of weight noise
-			if (Configuration::instance().weightNoiseSigma() > 0.0)
+			if (layer)
 			    thrust::copy(origWeights[i].begin(), 
 					 origWeights[i].end(), 
 					 layer->weights().begin());
-			
-		    }else if(mdnlayer && mdnlayer->flagTrainable()){
-			
-			// if batch mode (not stochastic) and not the first fraction, 
-			// accumulating the updates
-			if (!firstFraction && !Configuration::instance().hybridOnlineBatch())
-			    thrust::transform(mdnlayer->weightUpdates().begin(), 
-					      mdnlayer->weightUpdates().end(), 
-					      m_curWeightUpdates[i].begin(), 
-					      m_curWeightUpdates[i].begin(), 
-					      thrust::plus<real_t>());
-			else
-			    thrust::copy(mdnlayer->weightUpdates().begin(), 
-					 mdnlayer->weightUpdates().end(), 
-					 m_curWeightUpdates[i].begin());
-
-			// ???
-			// restore old weights before update in case of weight noise
-			// if (Configuration::instance().weightNoiseSigma() > 0.0)
-			//    thrust::copy(origWeights[i].begin(), origWeights[i].end(), 
-			//		 mdnlayer->weights().begin());
 		    }
-		    
-                }
+		}
 
                 // update weights for hybrid online/batch learning
-                if (Configuration::instance().hybridOnlineBatch())
+                if (Configuration::instance().hybridOnlineBatch()){
+		    // Add 20181018: sum the gradients over the processes
+		    if (helpers::allReduce::distributed())
+			_distSumWeightUpdates(frameNum, true);
                     _updateWeights(frameNum);
+		    m_gradsInLayers = false;
+		}
 		
 		/* Add 16-02-22 Wang: for WE updating */
 		if (Configuration::instance().hybridOnlineBatch() && 
@@ -205,8 +260,20 @@ namespace optimizers {
 	    //std::cerr << uttCnt << "/" << uttNum <<std::endl;
 	    uttCnt += frac->numSequences();
 	    fracCnt+= 1;
+
+	    // Add 20181018: mid-epoch autosave
+	    if (calcWeightUpdates)
+		_midEpochCheckpoint(fracCnt, uttCnt, error, secError, classError);
         }
+	
+	// Add 20181018: the epoch is done (or blowed)
+	if (calcWeightUpdates)
+	    m_midEpoch.fracCnt = 0;
 
+	// Add 20181018: distributed training
+	if (helpers::allReduce::distributed())
+	    _distFinishDataSet(ds, calcWeightUpdates, firstFraction, error, classError, secError);
+	
         // update weights for batch learning
         if (calcWeightUpdates && !Configuration::instance().hybridOnlineBatch())
             _updateWeights(1);
@@ -221,6 +288,487 @@ namespace optimizers {
         return;
     }
 
+    template <typename TDevice>
+    void Optimizer<TDevice>::_midEpochCheckpoint(const int fracCnt, const real_t uttCnt,
+						 const real_t error, const real_t secError,
+						 const real_t classError)
+    {
+	m_midEpoch.fracCnt    = fracCnt;
+	m_midEpoch.uttCnt     = uttCnt;
+	m_midEpoch.error      = error;
+	m_midEpoch.secError   = secError;
+	m_midEpoch.classError = classError;
+
+	// in batch mode, the gradients of the epoch are not in the autosave
+	if (m_ckptFn == NULL || (m_ckptInterval <= 0 && m_ckptFractions <= 0) ||
+	    !Configuration::instance().hybridOnlineBatch())
+	    return;
+	
+	long now = (long)time(NULL);
+	if (!(m_ckptInterval  > 0 && now - m_ckptTime >= m_ckptInterval) &&
+	    !(m_ckptFractions > 0 && fracCnt % m_ckptFractions == 0))
+	    return;
+	m_ckptFn(m_ckptData);
+	m_ckptTime = (long)time(NULL);
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_processFractionTask(void *task, const int netIdx)
+    {
+	parallel_task_t *t = static_cast<parallel_task_t*>(task);
+	NeuralNetwork<TDevice>      &nn   = *(t->networks[netIdx]);
+	data_sets::DataSetFraction  &frac = *(t->fractions[netIdx]);
+	frac_result_t               &res  = t->results[netIdx];
+	int fracIdx = t->firstFracIdx + netIdx;
+
+	// the same steps as _processDataSet, on the netIdx-th network
+	nn.notifyCurrentFrac(fracIdx);
+	nn.updateNNState(t->curEpoch, fracIdx);
+	nn.loadSequences(frac);
+	nn.computeForwardPass(frac.maxSeqLength(), (t->curEpoch-1));
+	nn.restoreTarget(frac);
+
+	res.error    = nn.calculateError(true, t->calcWeightUpdates) / t->normFactor;
+	res.secError = nn.calculateError(false) / t->normFactor;
+	res.correct  = 0;
+	if (dynamic_cast<layers::BinaryClassificationLayer<TDevice>*>(&nn.postOutputLayer()))
+	    res.correct += (real_t)static_cast<layers::BinaryClassificationLayer<TDevice>&>(
+			nn.postOutputLayer()).countCorrectClassifications();
+	if (dynamic_cast<layers::MulticlassClassificationLayer<TDevice>*>(&nn.postOutputLayer()))
+	    res.correct += (real_t)static_cast<layers::MulticlassClassificationLayer<TDevice>&>(
+			nn.postOutputLayer()).countCorrectClassifications();
+
+	if (t->calcWeightUpdates && !t->deferBackward){
+	    nn.computeBackwardPass();
+	    nn.cleanGradientsForDiscriminator();
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_backwardFractionTask(void *task, const int netIdx)
+    {
+	parallel_task_t *t = static_cast<parallel_task_t*>(task);
+	t->networks[netIdx]->computeBackwardPass();
+	t->networks[netIdx]->cleanGradientsForDiscriminator();
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_reduceWeightUpdates(const int netNum, const bool accumulate)
+    {
+	std::vector<const real_vector*> grads(netNum);
+	
+	for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    
+	    grads[0] = internal::layerWeightUpdates(m_neuralNetwork, i);
+	    if (grads[0] == NULL)
+		continue;
+	    for (int k = 1; k < netNum; k++)
+		grads[k] = internal::layerWeightUpdates(*m_replicas[k-1], i);
+
+	    // fixed-order tree reduction
+	    //  level 1: buf[p] = grads[2p] + grads[2p+1]
+	    //  level n: buf[p] = buf[p] + buf[p + 2^(n-2)]
+	    // the order of summation only depends on netNum
+	    int n = grads[0]->size();
+	    const real_vector *result = grads[0];
+	    if (netNum > 1){
+		int bufNum = (netNum + 1) / 2;
+		real_vector &buf = m_reduceBuf[i];
+		if ((int)buf.size() < bufNum * n)
+		    buf.resize(bufNum * n);
+		
+		for (int p = 0; p < bufNum; p++){
+		    if (2 * p + 1 < netNum)
+			thrust::transform(grads[2*p]->begin(),   grads[2*p]->end(),
+					  grads[2*p+1]->begin(), buf.begin() + p * n,
+					  thrust::plus<real_t>());
+		    else
+			thrust::copy(grads[2*p]->begin(), grads[2*p]->end(),
+				     buf.begin() + p * n);
+		}
+		for (int stride = 1; stride < bufNum; stride *= 2){
+		    for (int p = 0; p + stride < bufNum; p += 2 * stride)
+			thrust::transform(buf.begin() + p * n, buf.begin() + (p + 1) * n,
+					  buf.begin() + (p + stride) * n, buf.begin() + p * n,
+					  thrust::plus<real_t>());
+		}
+		result = &buf;
+	    }
+
+	    // same as _processDataSet: accumulate (batch mode) or copy
+	    typename real_vector::iterator arenaIt = m_curWeightUpdates.begin() + m_segOffset[i];
+	    if (accumulate)
+		thrust::transform(result->begin(), result->begin() + n,
+				  arenaIt, arenaIt, thrust::plus<real_t>());
+	    else
+		thrust::copy(result->begin(), result->begin() + n, arenaIt);
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_syncReplicas()
+    {
+	// trainable layers share the weights. Only the trainable MDN layer has its own copy
+	for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    layers::MDNLayer<TDevice> *mdnlayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    if (!(mdnlayer && mdnlayer->flagTrainable()))
+		continue;
+	    for (size_t k = 0; k < m_replicas.size(); k++){
+		layers::MDNLayer<TDevice> *repLayer = 
+		    dynamic_cast<layers::MDNLayer<TDevice>*>(m_replicas[k]->layers()[i].get());
+		thrust::copy(mdnlayer->weights().begin(), mdnlayer->weights().end(),
+			     repLayer->weights().begin());
+	    }
+	}
+    }
+    
+    template <typename TDevice>
+    void Optimizer<TDevice>::_processDataSetParallel(data_sets::DataSet &ds,
+						       bool calcWeightUpdates,
+						       real_t &error, real_t &classError,
+						       real_t &secError)
+    {
+        error       = 0;
+	secError    = 0;
+        classError  = (real_t) ds.totalTimesteps();
+	
+	m_neuralNetwork.maskWeight();
+	m_neuralNetwork.notifyCurrentEpoch(m_curEpoch);
+	for (size_t k = 0; k < m_replicas.size(); k++)
+	    m_replicas[k]->notifyCurrentEpoch(m_curEpoch);
+
+	parallel_task_t task;
+	task.networks.push_back(&m_neuralNetwork);
+	task.networks.insert(task.networks.end(), m_replicas.begin(), m_replicas.end());
+	int netNum = (int)task.networks.size();
+	task.fractions.resize(netNum, NULL);
+	task.results.resize(netNum);
+	task.curEpoch          = m_curEpoch;
+	task.calcWeightUpdates = calcWeightUpdates;
+	task.normFactor        = (real_t)ds.totalSequences();
+
+	// with weight noise, the noise is added between the forward and backward passes
+	//  (as _processDataSet does), which run as two parallel steps
+	const bool weightNoise = (calcWeightUpdates &&
+				  Configuration::instance().weightNoiseSigma() > 0);
+	task.deferBackward     = weightNoise;
+	
+	std::vector<boost::shared_ptr<data_sets::DataSetFraction> > fracs(netNum);
+	bool   firstFraction = true;
+	bool   dataEnd       = false;
+	int    fracCnt       = 0;
+	int    frameNum      = -1;
+	real_t uttCnt        = 0;
+	
+	while (!dataEnd){
+	    
+	    // take netNum consecutive fractions, one for each network
+	    int fracNum = 0;
+	    while (fracNum < netNum){
+		fracs[fracNum] = ds.getNextFraction();
+		if (!fracs[fracNum]){
+		    dataEnd = true;
+		    break;
+		}
+		task.fractions[fracNum] = fracs[fracNum].get();
+		fracNum++;
+	    }
+	    if (fracNum == 0)
+		break;
+
+	    // number of frames for SGD
+	    if (Configuration::instance().hybridOnlineBatch()){
+		frameNum = 0;
+		for (int k = 0; k < fracNum; k++)
+		    frameNum += fracs[k]->fracTimeLength();
+	    }
+	    
+	    _syncReplicas();
+
+	    // forward (and backward without weight noise) in parallel
+	    task.firstFracIdx = fracCnt;
+	    helpers::runParallel(&Optimizer<TDevice>::_processFractionTask, &task, fracNum);
+
+	    if (weightNoise) {
+		// weight noise (the weights are shared by all the networks)
+		std::vector<Cpu::real_vector> origWeights(m_neuralNetwork.layers().size());
+		for (size_t i = 1; i < m_neuralNetwork.layers().size()-1; ++i) {
+		    layers::TrainableLayer<TDevice> *layer = 
+			dynamic_cast<layers::TrainableLayer<TDevice>*>(
+				m_neuralNetwork.layers()[i].get());
+		    if (layer) {
+			origWeights[i] = layer->weights();
+			layer->injectWeightNoise(Configuration::instance().weightNoiseSigma());
+		    }
+		}
+		
+		helpers::runParallel(&Optimizer<TDevice>::_backwardFractionTask, &task, fracNum);
+
+		// restore old weights
+		for (size_t i = 1; i < m_neuralNetwork.layers().size()-1; ++i) {
+		    layers::TrainableLayer<TDevice> *layer = 
+			dynamic_cast<layers::TrainableLayer<TDevice>*>(
+				m_neuralNetwork.layers()[i].get());
+		    if (layer)
+			thrust::copy(origWeights[i].begin(), origWeights[i].end(),
+				     layer->weights().begin());
+		}
+	    }
+
+	    // collect the errors in the order of fractions
+	    for (int k = 0; k < fracNum; k++){
+		if (Configuration::instance().verboseLevel() == OP_VERBOSE_LEVEL_1){
+		    std::cerr << uttCnt << ", " << task.results[k].error * ds.totalSequences();
+		    std::cerr << ", " << task.results[k].secError * ds.totalSequences();
+		    std::cerr << std::endl;
+		}
+		error      += task.results[k].error;
+		secError   += task.results[k].secError;
+		classError -= task.results[k].correct;
+		uttCnt     += fracs[k]->numSequences();
+	    }
+	    
+	    if (error != error || secError != secError){
+		printf("NaN detected. Tune the learning rate please.\n");
+		this->m_blowed = true;
+		break;
+	    }else{
+		this->m_blowed = false;
+	    }
+	    
+	    if (calcWeightUpdates){
+		_reduceWeightUpdates(fracNum,
+				     !firstFraction && !Configuration::instance().hybridOnlineBatch());
+		if (Configuration::instance().hybridOnlineBatch()){
+		    if (helpers::allReduce::distributed())
+			_distSumWeightUpdates(frameNum, true);
+		    _updateWeights(frameNum);
+		}
+	    }
+	    
+	    firstFraction = false;
+	    fracCnt      += fracNum;
+	}
+
+	if (helpers::allReduce::distributed())
+	    _distFinishDataSet(ds, calcWeightUpdates, firstFraction, error, classError, secError);
+	
+        if (calcWeightUpdates && !Configuration::instance().hybridOnlineBatch())
+            _updateWeights(1);
+	
+        classError /= (real_t)ds.totalTimesteps();
+	return;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_processAsyncTask(void *task, const int netIdx)
+    {
+	async_task_t *t = static_cast<async_task_t*>(task);
+	NeuralNetwork<TDevice>  &nn  = *(t->networks[netIdx]);
+	frac_result_t           &res = t->results[netIdx];
+	res.error    = 0;
+	res.secError = 0;
+	res.correct  = 0;
+	
+	boost::shared_ptr<data_sets::DataSetFraction> frac;
+	try{
+	    while (true){
+		// take the next fraction. The ticket is the index of the fraction
+		int fracIdx = -1;
+		t->tickets->lock();
+		if (!t->tickets->aborted() && (frac = t->dataSet->getNextFraction()))
+		    fracIdx = t->tickets->take();
+		t->tickets->unlock();
+		if (fracIdx < 0)
+		    break;
+		
+		// wait until the weights are not too stale
+		if (!t->tickets->wait(fracIdx))
+		    break;
+		
+		nn.notifyCurrentFrac(fracIdx);
+		nn.updateNNState(t->curEpoch, fracIdx);
+		nn.loadSequences(*frac);
+		nn.computeForwardPass(frac->maxSeqLength(), (t->curEpoch-1));
+		nn.restoreTarget(*frac);
+
+		real_t error    = nn.calculateError(true, true) / t->normFactor;
+		real_t secError = nn.calculateError(false) / t->normFactor;
+		if (Configuration::instance().verboseLevel() == OP_VERBOSE_LEVEL_1){
+		    t->tickets->lock();
+		    std::cerr << fracIdx << ", " << error * t->normFactor;
+		    std::cerr << ", " << secError * t->normFactor << std::endl;
+		    t->tickets->unlock();
+		}
+		if (error != error || secError != secError){
+		    // stop all the threads
+		    t->tickets->lock();
+		    t->blowed = true;
+		    t->tickets->unlock();
+		    t->tickets->abort();
+		    break;
+		}
+		res.error    += error;
+		res.secError += secError;
+		if (dynamic_cast<layers::BinaryClassificationLayer<TDevice>*>(
+			&nn.postOutputLayer()))
+		    res.correct += (real_t)static_cast<layers::BinaryClassificationLayer<TDevice>&>(
+				nn.postOutputLayer()).countCorrectClassifications();
+		if (dynamic_cast<layers::MulticlassClassificationLayer<TDevice>*>(
+			&nn.postOutputLayer()))
+		    res.correct += (real_t)static_cast<layers::MulticlassClassificationLayer<TDevice>&>(
+				nn.postOutputLayer()).countCorrectClassifications();
+		
+		nn.computeBackwardPass();
+		nn.cleanGradientsForDiscriminator();
+
+		// update the shared parameters without locks
+		t->optimizer->_updateWeightsAsync(nn, frac->fracTimeLength());
+		if (nn.inputLayer().inputWeUpdate())
+		    t->optimizer->_updateWeInputAsync(nn, frac->fracTimeLength());
+		
+		t->tickets->release(fracIdx);
+	    }
+	}catch (...){
+	    // don't leave the other threads waiting for this ticket
+	    t->tickets->abort();
+	    throw;
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_processDataSetAsync(data_sets::DataSet &ds,
+						    real_t &error, real_t &classError,
+						    real_t &secError)
+    {
+	// the trainable MDN layer has one copy of weights for each network
+	for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    layers::MDNLayer<TDevice> *mdnlayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    if (mdnlayer && mdnlayer->flagTrainable())
+		throw std::runtime_error("async_training does not support trainable MDN layer");
+	}
+	
+        error       = 0;
+	secError    = 0;
+        classError  = (real_t) ds.totalTimesteps();
+	
+	m_neuralNetwork.maskWeight();
+	m_neuralNetwork.notifyCurrentEpoch(m_curEpoch);
+	for (size_t k = 0; k < m_replicas.size(); k++)
+	    m_replicas[k]->notifyCurrentEpoch(m_curEpoch);
+
+	helpers::AsyncTickets tickets(Configuration::instance().asyncStaleness());
+	
+	async_task_t task;
+	task.optimizer  = this;
+	task.networks.push_back(&m_neuralNetwork);
+	task.networks.insert(task.networks.end(), m_replicas.begin(), m_replicas.end());
+	task.results.resize(task.networks.size());
+	task.dataSet    = &ds;
+	task.tickets    = &tickets;
+	task.curEpoch   = m_curEpoch;
+	task.normFactor = (real_t)ds.totalSequences();
+	task.blowed     = false;
+
+	helpers::runParallel(&Optimizer<TDevice>::_processAsyncTask, &task,
+			     (int)task.networks.size());
+
+	for (size_t k = 0; k < task.results.size(); k++){
+	    error      += task.results[k].error;
+	    secError   += task.results[k].secError;
+	    classError -= task.results[k].correct;
+	}
+	
+	if (task.blowed || error != error || secError != secError){
+	    printf("NaN detected. Tune the learning rate please.\n");
+	    this->m_blowed = true;
+	}else{
+	    this->m_blowed = false;
+	}
+	
+        classError /= (real_t)ds.totalTimesteps();
+	return;
+    }
+
+    template <typename TDevice>
+    bool Optimizer<TDevice>::_distSumWeightUpdates(int &frameNum, const bool active)
+    {
+	// [gradient arena, frameNum, active]
+	size_t total = m_curWeightUpdates.size();
+	m_distBuf.resize(total + 2);
+
+	if (active)
+	    thrust::copy(m_curWeightUpdates.begin(), m_curWeightUpdates.end(), m_distBuf.begin());
+	else
+	    thrust::fill(m_distBuf.begin(), m_distBuf.begin() + total, 0.0);
+	m_distBuf[total]     = (active ? (real_t)frameNum : 0.0);
+	m_distBuf[total + 1] = (active ? 1.0 : 0.0);
+	
+	helpers::allReduce::sum(&m_distBuf[0], m_distBuf.size());
+
+	thrust::copy(m_distBuf.begin(), m_distBuf.begin() + total, m_curWeightUpdates.begin());
+	frameNum = (int)m_distBuf[total];
+	return m_distBuf[total + 1] > 0.5;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_distBroadcastWeights()
+    {
+	// weights of rank 0 to all the processes
+	for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    real_vector *weights = NULL;
+	    layers::TrainableLayer<TDevice> *layer = 
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    layers::MDNLayer<TDevice> *mdnlayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    if (layer)
+		weights = &layer->weights();
+	    else if (mdnlayer && mdnlayer->flagTrainable())
+		weights = &mdnlayer->weights();
+	    if (weights == NULL || weights->empty())
+		continue;
+	    
+	    m_distBuf = *weights;
+	    helpers::allReduce::broadcast(&m_distBuf[0], m_distBuf.size());
+	    thrust::copy(m_distBuf.begin(), m_distBuf.end(), weights->begin());
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_distFinishDataSet(data_sets::DataSet &ds, bool calcWeightUpdates,
+						 const bool firstFraction,
+						 real_t &error, real_t &classError,
+						 real_t &secError)
+    {
+	if (calcWeightUpdates){
+	    int frameNum = 0;
+	    if (Configuration::instance().hybridOnlineBatch()){
+		// this process has no more fractions.
+		// Join the updates of the other processes until all of them are done
+		while (_distSumWeightUpdates(frameNum, false))
+		    _updateWeights(frameNum);
+	    }else{
+		// batch mode: sum the gradients of the whole data set
+		_distSumWeightUpdates(frameNum, !firstFraction);
+	    }
+	}
+
+	// errors of the whole data set
+	Cpu::real_vector errors(3);
+	errors[0] = error;
+	errors[1] = secError;
+	errors[2] = (real_t)ds.totalTimesteps() - classError;  // correct classifications
+	helpers::allReduce::sum(&errors[0], errors.size());
+	error      = errors[0];
+	secError   = errors[1];
+	classError = (real_t)ds.totalTimesteps() - errors[2];
+
+	// all the processes agree on NaN
+	this->m_blowed = (error != error || secError != secError);
+    }
+
     template <typename TDevice>
     void Optimizer<TDevice>::_exportWeights(const helpers::JsonDocument &jsonDoc, 
 					    const char *arrayName, 
@@ -257,17 +805,17 @@ namespace optimizers {
         int i = 0;
         for (rapidjson::Value::ConstValueIterator it = (*jsonDoc)[arrayName].Begin(); 
 	     it != (*jsonDoc)[arrayName].End(); ++it) {
-            if (!it->IsArray())
+	    // Modify 20181018: JSON array or blob reference of the binary checkpoint
+            if (!helpers::binaryModel::isWeightArray(*it))
                 throw std::runtime_error(std::string("Object in '") + 
 					 arrayName + "' is not an array");
-            if (it->Size() != (rapidjson::SizeType)(*weights)[i].size())
+            if (helpers::binaryModel::weightArraySize(*it) != (*weights)[i].size())
                 throw std::runtime_error(std::string("Subarray in '") + 
 					 arrayName + "' has a wrong size");
 
             Cpu::real_vector w;
-            w.reserve(it->Size());
-            for (rapidjson::Value::ConstValueIterator it2 = it->Begin(); it2 != it->End(); ++it2)
-                w.push_back((real_t)it2->GetDouble());
+            w.reserve((*weights)[i].size());
+	    helpers::binaryModel::readWeightArray(*it, &w);
 
             (*weights)[i] = w;
 
@@ -275,48 +823,211 @@ namespace optimizers {
         }
     }
 
+    template <typename TDevice>
+    void Optimizer<TDevice>::_exportWeights(helpers::checkpoint::Checkpoint *ckpt,
+					    const char *arrayName, 
+					    const std::vector<real_vector> &weights)
+    {
+	rapidjson::Document &jsonDoc = ckpt->header();
+        rapidjson::Value weightsArray(rapidjson::kArrayType);
+        weightsArray.Reserve((rapidjson::SizeType)weights.size(), jsonDoc.GetAllocator());
+
+        for (size_t i = 0; i < weights.size(); ++i) {
+	    uint64_t offset;
+	    real_t  *blob = ckpt->addBlob(weights[i].size(), &offset);
+	    thrust::copy(weights[i].begin(), weights[i].end(), blob);
+	    
+            rapidjson::Value blobRef;
+	    ckpt->blobReference(offset, weights[i].size(), &blobRef);
+            weightsArray.PushBack(blobRef, jsonDoc.GetAllocator());
+        }
+        jsonDoc.AddMember(arrayName, weightsArray, jsonDoc.GetAllocator());
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_exportArena(helpers::checkpoint::Checkpoint *ckpt,
+					  const char *arrayName, const real_vector &arena,
+					  const int factor) const
+    {
+	// one blob for the arena, the per-layer references point to the segments
+	rapidjson::Document &jsonDoc = ckpt->header();
+	uint64_t offset;
+	real_t  *blob = ckpt->addBlob(arena.size(), &offset);
+	thrust::copy(arena.begin(), arena.end(), blob);
+	
+        rapidjson::Value weightsArray(rapidjson::kArrayType);
+        weightsArray.Reserve((rapidjson::SizeType)m_segOffset.size(), jsonDoc.GetAllocator());
+	for (size_t i = 0; i < m_segOffset.size(); ++i) {
+            rapidjson::Value blobRef;
+	    if (m_segOffset[i] < 0)
+		ckpt->blobReference(offset, 0, &blobRef);
+	    else
+		ckpt->blobReference(offset + m_segOffset[i] * factor * sizeof(real_t),
+				    m_bestWeights[i].size() * factor, &blobRef);
+            weightsArray.PushBack(blobRef, jsonDoc.GetAllocator());
+	}
+        jsonDoc.AddMember(arrayName, weightsArray, jsonDoc.GetAllocator());
+    }
+
     template <typename TDevice>
     void Optimizer<TDevice>::_storeWeights()
     {
-        for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	_saveWeights(m_neuralNetwork, m_bestWeights);
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_restoreWeights()
+    {
+	_loadWeights(m_bestWeights, m_neuralNetwork);
+	// Add 20181018: the pending snapshot is not the weights of the network any more
+	m_snapshotEpoch = 0;
+    }
+
+    // Modify 20181018: _storeWeights and _restoreWeights for any network and buffer
+    template <typename TDevice>
+    void Optimizer<TDevice>::_saveWeights(NeuralNetwork<TDevice> &nn,
+					  std::vector<real_vector> &weights)
+    {
+	if (weights.size() < nn.layers().size())
+	    weights.resize(nn.layers().size());
+	
+        for (size_t i = 1; i < nn.layers().size(); ++i) {
             layers::TrainableLayer<TDevice> *layer = 
-		dynamic_cast<layers::TrainableLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
-            if (layer) 
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(nn.layers()[i].get());
+            if (layer){
+		if (weights[i].size() != layer->weights().size())
+		    weights[i].resize(layer->weights().size());
             	thrust::copy(layer->weights().begin(), 
 			     layer->weights().end(), 
-			     m_bestWeights[i].begin());
-	    else{
+			     weights[i].begin());
+	    }else{
 		layers::MDNLayer<TDevice> *mdnlayer = 
-		    dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
-		if (mdnlayer && mdnlayer->flagTrainable())
+		    dynamic_cast<layers::MDNLayer<TDevice>*>(nn.layers()[i].get());
+		if (mdnlayer && mdnlayer->flagTrainable()){
+		    if (weights[i].size() != mdnlayer->weights().size())
+			weights[i].resize(mdnlayer->weights().size());
 		    thrust::copy(mdnlayer->weights().begin(), 
 				 mdnlayer->weights().end(), 
-				 m_bestWeights[i].begin());
+				 weights[i].begin());
+		}
 	    }
         }
     }
 
     template <typename TDevice>
-    void Optimizer<TDevice>::_restoreWeights()
+    void Optimizer<TDevice>::_loadWeights(const std::vector<real_vector> &weights,
+					  NeuralNetwork<TDevice> &nn)
     {
-        for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+        for (size_t i = 1; i < nn.layers().size(); ++i) {
 	    layers::TrainableLayer<TDevice> *layer = 
-		dynamic_cast<layers::TrainableLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(nn.layers()[i].get());
             if (layer)
-            	thrust::copy(m_bestWeights[i].begin(), 
-			     m_bestWeights[i].end(), 
+            	thrust::copy(weights[i].begin(), 
+			     weights[i].end(), 
 			     layer->weights().begin());
 	    else{
 		layers::MDNLayer<TDevice> *mdnlayer = 
-		    dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+		    dynamic_cast<layers::MDNLayer<TDevice>*>(nn.layers()[i].get());
 		if (mdnlayer && mdnlayer->flagTrainable())
-		    thrust::copy(m_bestWeights[i].begin(), 
-				 m_bestWeights[i].end(), 
+		    thrust::copy(weights[i].begin(), 
+				 weights[i].end(), 
 				 mdnlayer->weights().begin());
 	    }
         }
     }
 
+    template <typename TDevice>
+    void Optimizer<TDevice>::_evaluateDataSet(NeuralNetwork<TDevice> &nn,
+					      data_sets::DataSet &ds, const int epoch,
+					      real_t &error, real_t &classError,
+					      real_t &secError)
+    {
+	// forward-only pass of _processDataSet on another network
+        error       = 0;
+	secError    = 0;
+        classError  = (real_t) ds.totalTimesteps();
+	
+	nn.notifyCurrentEpoch(epoch);
+	
+	parallel_task_t task;
+	task.networks.push_back(&nn);
+	task.fractions.resize(1, NULL);
+	task.results.resize(1);
+	task.firstFracIdx      = 0;
+	task.curEpoch          = epoch;
+	task.calcWeightUpdates = false;
+	task.deferBackward     = false;
+	task.normFactor        = (real_t)ds.totalSequences();
+
+	boost::shared_ptr<data_sets::DataSetFraction> frac;
+        while ((frac = ds.getNextFraction())) {
+	    task.fractions[0] = frac.get();
+	    _processFractionTask(&task, 0);
+	    error      += task.results[0].error;
+	    secError   += task.results[0].secError;
+	    classError -= task.results[0].correct;
+	    task.firstFracIdx++;
+	}
+	
+        classError /= (real_t)ds.totalTimesteps();
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_evaluateSnapshot(overlap_task_t *task)
+    {
+	_loadWeights(m_snapshotWeights, *m_evalNetwork);
+	
+	if (!m_validationSet.empty() && m_snapshotEpoch % m_validateEvery == 0)
+	    _evaluateDataSet(*m_evalNetwork, m_validationSet, m_snapshotEpoch,
+			     task->valError, task->valClassError, task->valSecError);
+	if (!m_testSet.empty() && m_snapshotEpoch % m_testEvery == 0)
+	    _evaluateDataSet(*m_evalNetwork, m_testSet, m_snapshotEpoch,
+			     task->testError, task->testClassError, task->testSecError);
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_resolveSnapshot(const overlap_task_t &task)
+    {
+	// same as train(), but the best weights are those of the snapshot
+	if (!m_validationSet.empty() && m_snapshotEpoch % m_validateEvery == 0){
+	    m_curValidationError         = task.valError;
+	    m_curValidationClassError    = task.valClassError;
+	    m_curValidationSecError      = task.valSecError;
+	    m_curValidationErrorPerFrame = (m_curValidationError * 
+					    m_validationSet.totalSequences() / 
+					    m_validationSet.totalTimesteps());
+	    if (m_curValidationError < m_lowestValidationError) {
+		m_lowestValidationError  = m_curValidationError;
+		m_epochsSinceLowestError = 0;
+		_saveWeights(*m_evalNetwork, m_bestWeights);
+	    }else{
+		m_epochsSinceLowestError += m_validateEvery;
+	    }
+	}
+	if (!m_testSet.empty() && m_snapshotEpoch % m_testEvery == 0){
+	    m_curTestError               = task.testError;
+	    m_curTestClassError          = task.testClassError;
+	    m_curTestSecError            = task.testSecError;
+	    m_curTestErrorPerFrame       = (m_curTestError * 
+					    m_testSet.totalSequences() /
+					    m_testSet.totalTimesteps());
+	}
+	m_evaluatedEpoch = m_snapshotEpoch;
+	m_snapshotEpoch  = 0;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_overlapTask(void *task, const int taskIdx)
+    {
+	overlap_task_t     *t   = static_cast<overlap_task_t*>(task);
+	Optimizer<TDevice> *opt = t->optimizer;
+	if (taskIdx == 0)
+	    opt->_processDataSet(opt->m_trainingSet, true, opt->m_curTrainingError,
+				 opt->m_curTrainingClassError, opt->m_curTrainingSecError);
+	else
+	    opt->_evaluateSnapshot(t);
+    }
+
     template <typename TDevice>
     NeuralNetwork<TDevice>& Optimizer<TDevice>::_neuralNetwork()
     {
@@ -324,17 +1035,176 @@ namespace optimizers {
     }
 
     template <typename TDevice>
-    std::vector<typename Optimizer<TDevice>::real_vector>& Optimizer<TDevice>::_curWeightUpdates()
+    typename Optimizer<TDevice>::real_vector& Optimizer<TDevice>::_curWeightUpdates()
     {
         return m_curWeightUpdates;
     }
     
     template <typename TDevice>
-    std::vector<typename Optimizer<TDevice>::real_vector>& Optimizer<TDevice>::_weightStats()
+    typename Optimizer<TDevice>::real_vector& Optimizer<TDevice>::_weightStats()
     {
         return m_weightStats;
     }
 
+    template <typename TDevice>
+    const typename Optimizer<TDevice>::param_segments_t& Optimizer<TDevice>::_segments() const
+    {
+        return m_segments;
+    }
+
+    template <typename TDevice>
+    bool Optimizer<TDevice>::_gradientsInLayers() const
+    {
+        return m_gradsInLayers;
+    }
+
+    template <typename TDevice>
+    const std::vector<int>& Optimizer<TDevice>::_segOffset() const
+    {
+        return m_segOffset;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_buildSegments()
+    {
+	// the tables are prepared on the host, then copied to the device
+	Cpu::int_vector      start;
+	Cpu::int_vector      adaptIdx;
+	Cpu::real_vector     learningRate;
+	Cpu::real_ptr_vector weights;
+	Cpu::real_ptr_vector gradients;
+	Cpu::real_ptr_vector weightMask;
+	int adaptNum = 0;
+	
+	for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    if (m_segOffset[i] < 0)
+		continue;
+	    
+	    layers::TrainableLayer<TDevice> *layer = 
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    layers::MDNLayer<TDevice> *mdnlayer = 
+		dynamic_cast<layers::MDNLayer<TDevice>*>(m_neuralNetwork.layers()[i].get());
+	    
+	    start.push_back(m_segOffset[i]);
+	    if (layer){
+		if (layer->weights().size() != m_bestWeights[i].size() ||
+		    layer->weightUpdates().size() != m_bestWeights[i].size())
+		    throw std::runtime_error(std::string("Weight size changed: ") + layer->name());
+		// AdaGrad/Adam only for the trainable hidden layers (same as before)
+		adaptIdx.push_back(adaptNum++);
+		learningRate.push_back(layer->learningRate() > -0.5 ? // In fact, >= 0.0
+				       layer->learningRate() : -1.0);
+		weights.push_back(helpers::getRawPointer(layer->weights()));
+		gradients.push_back(const_cast<real_t*>(
+				helpers::getRawPointer(layer->weightUpdates())));
+		weightMask.push_back(layer->flagUseWeightMask() ?
+				     const_cast<real_t*>(
+					helpers::getRawPointer(layer->weightMask())) : NULL);
+		
+	    }else if (mdnlayer && mdnlayer->flagTrainable()){
+		if (mdnlayer->weights().size() != m_bestWeights[i].size() ||
+		    mdnlayer->weightUpdates().size() != m_bestWeights[i].size())
+		    throw std::runtime_error(std::string("Weight size changed: ") +
+					     mdnlayer->name());
+		adaptIdx.push_back(-1);
+		learningRate.push_back(-1.0);
+		weights.push_back(helpers::getRawPointer(mdnlayer->weights()));
+		gradients.push_back(helpers::getRawPointer(mdnlayer->weightUpdates()));
+		weightMask.push_back(NULL);
+		
+	    }else{
+		throw std::runtime_error("Impossible Error");
+	    }
+	}
+	
+	// the offsets are fixed after the constructor: copy the segment tables once
+	if (m_segments.start.empty() && !m_curWeightUpdates.empty()){
+	    m_segments.num      = (int)start.size();
+	    m_segments.adaptNum = adaptNum;
+	    m_segments.total    = (int)m_curWeightUpdates.size();
+	    start.push_back(m_segments.total);
+	    m_segments.start    = start;
+	    m_segments.adaptIdx = adaptIdx;
+	}
+
+	// the pointers only change when a layer reallocates its vectors:
+	// copy the tables to the device only in that case
+	Cpu::real_ptr_vector ptrs(weights);
+	ptrs.insert(ptrs.end(), gradients.begin(),  gradients.end());
+	ptrs.insert(ptrs.end(), weightMask.begin(), weightMask.end());
+	bool changed = (ptrs.size() != m_segPtrs.size());
+	for (size_t j = 0; !changed && j < ptrs.size(); j++)
+	    changed = (ptrs[j] != m_segPtrs[j]);
+	if (!changed)
+	    return;
+	m_segPtrs = ptrs;
+	
+	m_segments.learningRate = learningRate;
+	m_segments.weights      = weights;
+	m_segments.gradients    = gradients;
+	m_segments.weightMask   = weightMask;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_gatherWeightUpdates(const bool accumulate)
+    {
+	internal::GatherGradientsFn fn;
+	fn.seg        = -1;
+	fn.segStart   = helpers::getRawPointer(m_segments.start);
+	fn.segNum     = m_segments.num;
+	fn.gradients  = helpers::getRawPointer(m_segments.gradients);
+	fn.accumulate = accumulate;
+	helpers::fused::forEach(m_curWeightUpdates, fn.segStart, fn.segNum, m_segments.total,
+				fn, Configuration::instance().trainingThreads());
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_initWeightStats()
+    {
+	if (m_optOption == OPTIMIZATION_ADAGRAD || 
+	    m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD){
+	    // buffer for AdaGrad
+	    m_weightStats = real_vector(m_curWeightUpdates.size(), OP_ADAGRADFACTOR);
+	}else if(m_optOption == OPTIMIZATION_ADAM){
+	    // buffer for Adam: [m, v] of each weight
+	    m_weightStats = real_vector(m_curWeightUpdates.size() * 2, 0.0);
+	}else{
+	    m_weightStats.clear();
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_splitArena(const real_vector &arena, const int factor,
+					 std::vector<real_vector> &layerVecs) const
+    {
+	layerVecs.clear();
+	layerVecs.resize(m_segOffset.size());
+	for (size_t i = 0; i < m_segOffset.size(); ++i) {
+	    if (m_segOffset[i] < 0)
+		continue;
+	    layerVecs[i].resize(m_bestWeights[i].size() * factor);
+	    thrust::copy(arena.begin() + m_segOffset[i] * factor,
+			 arena.begin() + m_segOffset[i] * factor + layerVecs[i].size(),
+			 layerVecs[i].begin());
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::_mergeArena(const std::vector<real_vector> &layerVecs,
+					 const int factor, real_vector &arena) const
+    {
+	if (layerVecs.size() != m_segOffset.size())
+	    throw std::runtime_error("Optimizer vectors do not match the network");
+	for (size_t i = 0; i < m_segOffset.size(); ++i) {
+	    if (m_segOffset[i] < 0)
+		continue;
+	    if (layerVecs[i].size() != m_bestWeights[i].size() * factor)
+		throw std::runtime_error("Optimizer vectors do not match the network");
+	    thrust::copy(layerVecs[i].begin(), layerVecs[i].end(),
+			 arena.begin() + m_segOffset[i] * factor);
+	}
+    }
+
     template <typename TDevice>
     Optimizer<TDevice>::Optimizer(
 	NeuralNetwork<TDevice> &neuralNetwork, data_sets::DataSet &trainingSet, 
@@ -367,7 +1237,22 @@ namespace optimizers {
         , m_curTestErrorPerFrame      (0)
 	, m_blowed                    (false)
 	, m_optOption                 (optOption)
+	, m_gradsInLayers             (false)
+	, m_ckptInterval              (0)
+	, m_ckptFractions             (0)
+	, m_ckptFn                    (NULL)
+	, m_ckptData                  (NULL)
+	, m_ckptTime                  (0)
+	, m_evalNetwork               (NULL)
+	, m_snapshotEpoch             (0)
+	, m_evaluatedEpoch            (0)
     {
+	m_midEpoch.fracCnt    = 0;
+	m_midEpoch.uttCnt     = 0;
+	m_midEpoch.error      = 0;
+	m_midEpoch.secError   = 0;
+	m_midEpoch.classError = 0;
+	
         // initialize the best weights vectors
         m_bestWeights.resize(m_neuralNetwork.layers().size());
         for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
@@ -382,19 +1267,23 @@ namespace optimizers {
         }
 
         // initialize the current weight updates vectors
-        m_curWeightUpdates = m_bestWeights;
+	// Modify 20181018: one arena, layer i starts from m_segOffset[i]
+	m_segOffset.assign(m_neuralNetwork.layers().size(), -1);
+	int arenaSize = 0;
+        for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+	    if (m_bestWeights[i].empty())
+		continue;
+	    m_segOffset[i] = arenaSize;
+	    arenaSize     += (int)m_bestWeights[i].size();
+	}
+        m_curWeightUpdates = real_vector(arenaSize, 0.0);
+	_buildSegments();
 	
 	// statistics buffer for learning
+	_initWeightStats();
 	if (m_optOption>0){
 	    if (m_optOption == OPTIMIZATION_ADAGRAD || 
 		m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD){
-		
-		// initialize the buffer for AdaGrad
-		m_weightStats = m_bestWeights;
-		for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
-		    thrust::fill(m_weightStats[i].begin(), m_weightStats[i].end(),
-				 OP_ADAGRADFACTOR);
-		}
 		if (m_optOption == OPTIMIZATION_ADAGRAD){
 		    printf("\n Optimization Techinique: AdaGrad\n");
 		}else{
@@ -403,18 +1292,9 @@ namespace optimizers {
 		}
 		
 	    }else if(m_optOption == OPTIMIZATION_ADAM){
-		// initialize the buffer for Adam
-		m_weightStats = m_bestWeights;
-		for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
-		    m_weightStats[i].resize(m_bestWeights[i].size() * 2, 0.0);
-		    thrust::fill(m_weightStats[i].begin(), m_weightStats[i].end(), 0.0);
-		}
 		printf("\n Optimization Techinique: Adam\n");
 	    }else if(m_optOption == OPTIMIZATION_AVEGRAD){
-		m_weightStats.clear();
 		printf("\n Optimization: average gradient over each data fraction\n");
-	    }else{
-		m_weightStats.clear();
 	    }
 	}else{
 	    printf("\nOptimization: plain SGD \n");
@@ -536,8 +1416,21 @@ namespace optimizers {
 		std::cerr << "Training set\nFractionNum, error, secError" << std::endl;
 	    
 	    // processing the data
-            _processDataSet(m_trainingSet, true,
-			    m_curTrainingError, m_curTrainingClassError, m_curTrainingSecError);
+	    // Add 20181018: overlapped validation, the snapshot of the last epoch is
+	    //  evaluated in another thread while this epoch is trained
+	    overlap_task_t overlapTask;
+	    overlapTask.optimizer = this;
+	    m_evaluatedEpoch      = 0;
+	    if (m_evalNetwork && m_snapshotEpoch > 0){
+		helpers::runParallel(&Optimizer<TDevice>::_overlapTask, &overlapTask, 2);
+		if (!this->m_blowed)
+		    _resolveSnapshot(overlapTask);
+		m_snapshotEpoch = 0;
+	    }else{
+		_processDataSet(m_trainingSet, true,
+				m_curTrainingError, m_curTrainingClassError,
+				m_curTrainingSecError);
+	    }
 	    
 	    // Add 0511
 	    if (this->m_blowed) {
@@ -562,8 +1455,29 @@ namespace optimizers {
 	    //m_trainingSet.totalSequences() /
 	    //				  m_trainingSet.totalTimesteps());
 	    
+	    // Add 20181018: overlapped validation, snapshot the weights of this epoch
+	    //  The snapshot is evaluated now if this is the last epoch, or if its validation
+	    //  error may trigger the no-best check below
+	    if (m_evalNetwork){
+		if ((!m_validationSet.empty() && m_curEpoch % m_validateEvery == 0) ||
+		    (!m_testSet.empty()       && m_curEpoch % m_testEvery     == 0)){
+		    _saveWeights(m_neuralNetwork, m_snapshotWeights);
+		    m_snapshotEpoch = m_curEpoch;
+		    if ((m_maxEpochs >= 0 && m_curEpoch >= m_maxEpochs) ||
+			(!m_validationSet.empty() && m_curEpoch % m_validateEvery == 0 &&
+			 m_epochsSinceLowestError + m_validateEvery >= m_maxEpochsNoBest)){
+			_evaluateSnapshot(&overlapTask);
+			_resolveSnapshot(overlapTask);
+		    }
+		}
+		if (m_validationSet.empty()) {
+		    m_epochsSinceLowestError = 0;
+		    _storeWeights();
+		}
+	    }
+	    
             // calculate the validation error and store the weights if we a new lowest error
-            if (!m_validationSet.empty() && m_curEpoch % m_validateEvery == 0) {
+            else if (!m_validationSet.empty() && m_curEpoch % m_validateEvery == 0) {
 		if (Configuration::instance().verboseLevel() == OP_VERBOSE_LEVEL_1)
 		    std::cerr << "Validation set\nFractionNum, error, secError" << std::endl;
 		
@@ -595,7 +1509,7 @@ namespace optimizers {
             }
 
             // calculate the test error
-            if (!m_testSet.empty() && m_curEpoch % m_testEvery == 0){
+            if (!m_evalNetwork && !m_testSet.empty() && m_curEpoch % m_testEvery == 0){
                 _processDataSet(m_testSet, false,
 				m_curTestError, m_curTestClassError, m_curTestSecError);
 		m_curTestErrorPerFrame = (m_curTestError * 
@@ -606,6 +1520,8 @@ namespace optimizers {
 		//			  m_testSet.totalTimesteps());
 
 	    }
+	    if (!m_evalNetwork)
+		m_evaluatedEpoch = m_curEpoch;
 	    
 	    	    
 	    // Check status
@@ -653,12 +1569,15 @@ namespace optimizers {
     }
 
     template <typename TDevice>
-    void Optimizer<TDevice>::exportState(const helpers::JsonDocument &jsonDoc) const
+    void Optimizer<TDevice>::_exportStatus(const helpers::JsonDocument &jsonDoc) const
     {
         jsonDoc->AddMember("optimizer_finished",                   
 			   m_finished,                jsonDoc->GetAllocator());
+	// Modify 20181018: inside the epoch, the epoch in progress is trained again
+	//  from the fraction in optimizer_mid_epoch_*
         jsonDoc->AddMember("optimizer_cur_epoch",                  
-			   m_curEpoch,                jsonDoc->GetAllocator());
+			   (midEpoch() ? m_curEpoch - 1 : m_curEpoch),
+			   jsonDoc->GetAllocator());
         jsonDoc->AddMember("optimizer_epochs_since_lowest_error",  
 			   m_epochsSinceLowestError,  jsonDoc->GetAllocator());
         jsonDoc->AddMember("optimizer_lowest_validation_error",    
@@ -680,12 +1599,50 @@ namespace optimizers {
 	jsonDoc->AddMember("optimizer_status",       
 			   m_optOption,               jsonDoc->GetAllocator());
 
+	// Add 20181018: accumulators of the epoch in progress
+	if (midEpoch()){
+	    jsonDoc->AddMember("optimizer_mid_epoch_frac_cnt",
+			       m_midEpoch.fracCnt,    jsonDoc->GetAllocator());
+	    jsonDoc->AddMember("optimizer_mid_epoch_utt_cnt",
+			       m_midEpoch.uttCnt,     jsonDoc->GetAllocator());
+	    jsonDoc->AddMember("optimizer_mid_epoch_error",
+			       m_midEpoch.error,      jsonDoc->GetAllocator());
+	    jsonDoc->AddMember("optimizer_mid_epoch_sec_error",
+			       m_midEpoch.secError,   jsonDoc->GetAllocator());
+	    jsonDoc->AddMember("optimizer_mid_epoch_class_error",
+			       m_midEpoch.classError, jsonDoc->GetAllocator());
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::exportState(const helpers::JsonDocument &jsonDoc) const
+    {
+	_exportStatus(jsonDoc);
+	
         _exportWeights(jsonDoc, "optimizer_best_weights", m_bestWeights);
 	
 	if (m_optOption == OPTIMIZATION_ADAGRAD || 
 	    m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD ||
 	    m_optOption == OPTIMIZATION_ADAM){
-	    _exportWeights(jsonDoc, "optimizer_status_vector",   m_weightStats);
+	    std::vector<real_vector> weightStats;
+	    _splitArena(m_weightStats, (m_optOption == OPTIMIZATION_ADAM ? 2 : 1), weightStats);
+	    _exportWeights(jsonDoc, "optimizer_status_vector",   weightStats);
+	}
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::exportCheckpoint(helpers::checkpoint::Checkpoint *ckpt) const
+    {
+	// same members as exportState, importState reads both
+	_exportStatus(&ckpt->header());
+	
+        _exportWeights(ckpt, "optimizer_best_weights", m_bestWeights);
+	
+	if (m_optOption == OPTIMIZATION_ADAGRAD || 
+	    m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD ||
+	    m_optOption == OPTIMIZATION_ADAM){
+	    _exportArena(ckpt, "optimizer_status_vector", m_weightStats,
+			 (m_optOption == OPTIMIZATION_ADAM ? 2 : 1));
 	}
     }
 
@@ -717,14 +1674,36 @@ namespace optimizers {
 	m_optOption               =
 	    helpers::checkedJsonGet<int   >(*jsonDoc, "optimizer_status");
 
+	// Add 20181018: continue the epoch of the mid-epoch autosave
+	m_midEpoch.fracCnt = 0;
+	if (jsonDoc->HasMember("optimizer_mid_epoch_frac_cnt")){
+	    m_midEpoch.fracCnt    =
+		helpers::checkedJsonGet<int   >(*jsonDoc, "optimizer_mid_epoch_frac_cnt");
+	    m_midEpoch.uttCnt     =
+		helpers::checkedJsonGet<real_t>(*jsonDoc, "optimizer_mid_epoch_utt_cnt");
+	    m_midEpoch.error      =
+		helpers::checkedJsonGet<real_t>(*jsonDoc, "optimizer_mid_epoch_error");
+	    m_midEpoch.secError   =
+		helpers::checkedJsonGet<real_t>(*jsonDoc, "optimizer_mid_epoch_sec_error");
+	    m_midEpoch.classError =
+		helpers::checkedJsonGet<real_t>(*jsonDoc, "optimizer_mid_epoch_class_error");
+	}
+
 	// Read the optimizer_best_weights to m_bestWeights
         _importWeights(jsonDoc, "optimizer_best_weights", &m_bestWeights);
 
 	// If AdaGrad is used, read the optimizer_status_vector to m_weightStats
 	if (m_optOption == OPTIMIZATION_ADAGRAD || 
 	    m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD ||
-	    m_optOption == OPTIMIZATION_ADAM)
-	    _importWeights(jsonDoc, "optimizer_status_vector",   &m_weightStats);
+	    m_optOption == OPTIMIZATION_ADAM){
+	    // the per-layer vectors in the file, the arena in the memory
+	    int factor = (m_optOption == OPTIMIZATION_ADAM ? 2 : 1);
+	    std::vector<real_vector> weightStats;
+	    _initWeightStats();
+	    _splitArena(m_weightStats, factor, weightStats);
+	    _importWeights(jsonDoc, "optimizer_status_vector",   &weightStats);
+	    _mergeArena(weightStats, factor, m_weightStats);
+	}
 	
     }
     
@@ -753,6 +1732,31 @@ namespace optimizers {
     {
 	return m_optStatus;
     }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::setReplicas(const std::vector<NeuralNetwork<TDevice>*> &replicas)
+    {
+	for (size_t k = 0; k < replicas.size(); k++){
+	    if (replicas[k]->layers().size() != m_neuralNetwork.layers().size())
+		throw std::runtime_error("Replica network differs from the source network");
+	    for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
+		layers::TrainableLayer<TDevice> *layer = 
+		    dynamic_cast<layers::TrainableLayer<TDevice>*>(
+			replicas[k]->layers()[i].get());
+		if (layer && !layer->flagSharedWeights())
+		    throw std::runtime_error(std::string("Replica does not share weights: ") +
+					     layer->name());
+	    }
+	}
+	// WE bank is only shared in asynchronous training (see InputLayer::shareWeBank)
+	if (!replicas.empty() && m_neuralNetwork.inputLayer().inputWeUpdate() &&
+	    !Configuration::instance().asyncTraining())
+	    throw std::runtime_error("Data-parallel training does not support WE updating");
+	
+	m_replicas = replicas;
+	m_reduceBuf.clear();
+	m_reduceBuf.resize(m_neuralNetwork.layers().size());
+    }
     
     // reiniti optimizer
     template <typename TDevice>
@@ -769,6 +1773,9 @@ namespace optimizers {
         m_curTrainingClassError     =(0);
         m_curTestClassError         =(0);
 	m_blowed                    =(false);
+	m_midEpoch.fracCnt          =(0);
+	m_snapshotEpoch             =(0);
+	m_evaluatedEpoch            =(0);
 
         m_bestWeights.resize(m_neuralNetwork.layers().size());
         for (size_t i = 1; i < m_neuralNetwork.layers().size()-1; ++i) {
@@ -779,35 +1786,43 @@ namespace optimizers {
 	    // ??? for MDNLayer
         }
 
-		// statistics buffer for learning
-	if (m_optOption>0){
-	    if (m_optOption == OPTIMIZATION_ADAGRAD || 
-		m_optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD){
-		// initialize the buffer for AdaGrad
-		m_weightStats = m_bestWeights;
-		for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
-		    thrust::fill(m_weightStats[i].begin(),
-				 m_weightStats[i].end(),
-				 OP_ADAGRADFACTOR);
-		}		
-	    }else if(m_optOption == OPTIMIZATION_ADAM){
-		// initialize the buffer for Adam
-		m_weightStats = m_bestWeights;
-		for (size_t i = 1; i < m_neuralNetwork.layers().size(); ++i) {
-		    m_weightStats[i].resize(m_bestWeights[i].size() * 2, 0.0);
-		    thrust::fill(m_weightStats[i].begin(),
-				 m_weightStats[i].end(),
-				 0.0);
-		}		
-	    }else if(m_optOption == OPTIMIZATION_AVEGRAD){
-		m_weightStats.clear();
-	    }else{
-		m_weightStats.clear();
-	    }
-	}
+	// statistics buffer for learning
+	_initWeightStats();
 	
         // initialize the current weight updates vectors
-        m_curWeightUpdates = m_bestWeights;
+	thrust::fill(m_curWeightUpdates.begin(), m_curWeightUpdates.end(), 0.0);
+    }
+    
+    template <typename TDevice>
+    void Optimizer<TDevice>::setMidEpochCheckpoint(const int interval, const int fractions,
+						   checkpoint_fn_t fn, void *userData)
+    {
+	m_ckptInterval  = interval;
+	m_ckptFractions = fractions;
+	m_ckptFn       = fn;
+	m_ckptData     = userData;
+	m_ckptTime     = (long)time(NULL);
+    }
+
+    template <typename TDevice>
+    bool Optimizer<TDevice>::midEpoch() const
+    {
+	return m_midEpoch.fracCnt > 0;
+    }
+
+    template <typename TDevice>
+    void Optimizer<TDevice>::setEvalNetwork(NeuralNetwork<TDevice> *evalNetwork)
+    {
+	if (evalNetwork && evalNetwork->layers().size() != m_neuralNetwork.layers().size())
+	    throw std::runtime_error("Evaluation network differs from the source network");
+	m_evalNetwork   = evalNetwork;
+	m_snapshotEpoch = 0;
+    }
+
+    template <typename TDevice>
+    int Optimizer<TDevice>::evaluatedEpoch() const
+    {
+	return m_evaluatedEpoch;
     }
     
     // explicit template instantiations
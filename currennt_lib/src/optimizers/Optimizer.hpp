@@ -25,8 +25,10 @@
 
 #include "../NeuralNetwork.hpp"
 #include "../data_sets/DataSet.hpp"
+#include "../helpers/ParallelRun.hpp"
 #include "../MacroDefine.hpp"
 
+namespace helpers { namespace checkpoint { class Checkpoint; } }
 
 namespace optimizers {
 
@@ -38,8 +40,35 @@ namespace optimizers {
     template <typename TDevice>
     class Optimizer
     {
-        typedef typename TDevice::real_vector real_vector;
+        typedef typename TDevice::real_vector     real_vector;
+        typedef typename TDevice::int_vector      int_vector;
+        typedef typename TDevice::real_ptr_vector real_ptr_vector;
 
+    public:
+	// Add 20181018: callback writing the mid-epoch autosave
+	typedef void (*checkpoint_fn_t)(void *userData);
+
+    protected:
+	/**
+	 * Add 20181018: flat parameter arenas
+	 *  The gradients of all the trainable layers are stored in one vector (arena), and
+	 *  so are the momentum and the AdaGrad/Adam statistics (Adam: 2 values per weight).
+	 *  Each trainable layer is a segment of the arena. The weights stay in the layers,
+	 *  and the fused kernels reach them by the pointer tables below
+	 */
+	struct param_segments_t {
+	    int             num;          // number of segments
+	    int             adaptNum;     // number of segments that use AdaGrad/Adam
+	    int             total;        // total number of parameters
+	    int_vector      start;        // start of each segment in the arena (num + 1)
+	    int_vector      adaptIdx;     // index among the segments that use AdaGrad/Adam,
+	                                  // -1 for the trainable MDN layer
+	    real_vector     learningRate; // learning rate of the layer, -1 (global one)
+	    real_ptr_vector weights;      // weights of the layer
+	    real_ptr_vector gradients;    // gradients of the layer
+	    real_ptr_vector weightMask;   // weight mask of the layer, NULL if not used
+	};
+	
     private:
         NeuralNetwork<TDevice> &m_neuralNetwork;
         data_sets::DataSet     &m_trainingSet;
@@ -77,13 +106,93 @@ namespace optimizers {
         real_t m_curTestErrorPerFrame;
 
 	
-        std::vector<real_vector> m_curWeightUpdates;
+        real_vector              m_curWeightUpdates;  // arena of the gradients
         std::vector<real_vector> m_bestWeights;
 	
 	// Add 1024 for AdaGrad
 	unsigned                 m_optOption;
-	std::vector<real_vector> m_weightStats;              
+	real_vector              m_weightStats;       // arena of the statistics
 	std::string              m_optStatus;
+
+	// Add 20181018: flat parameter arenas
+	std::vector<int>         m_segOffset;         // offset of layer i in the arena, or -1
+	param_segments_t         m_segments;
+	bool                     m_gradsInLayers;     // gradients were not gathered into
+	                                              // the arena, see _processDataSet()
+	Cpu::real_ptr_vector     m_segPtrs;           // host copy of the pointer tables
+
+	// Add 20181018: data-parallel training
+	//  m_replicas share the weights of m_neuralNetwork (see NeuralNetwork())
+	std::vector<NeuralNetwork<TDevice>*> m_replicas;
+	std::vector<real_vector>             m_reduceBuf;  // buffer for gradient reduction
+
+	// Add 20181018: distributed training
+	Cpu::real_vector                     m_distBuf;    // buffer for the sum over processes
+
+	// Add 20181018: mid-epoch autosave
+	//  the accumulators of the training epoch in progress (fracCnt is 0 at the
+	//  boundary of epochs). Restored by importState to continue the epoch
+	struct mid_epoch_t {
+	    int    fracCnt;                                // fractions done in the epoch
+	    real_t uttCnt;
+	    real_t error;
+	    real_t secError;
+	    real_t classError;
+	};
+	mid_epoch_t                          m_midEpoch;
+	int                                  m_ckptInterval; // seconds, 0: disabled
+	int                                  m_ckptFractions;// fractions, 0: disabled
+	checkpoint_fn_t                      m_ckptFn;
+	void                                *m_ckptData;
+	long                                 m_ckptTime;     // time of the last autosave
+
+	// Add 20181018: overlapped validation
+	//  the weights of epoch m_snapshotEpoch are evaluated on m_evalNetwork while the
+	//  next epoch is trained. m_evaluatedEpoch is the epoch whose errors are resolved
+	//  by the last train() (0: none)
+	NeuralNetwork<TDevice>              *m_evalNetwork;
+	std::vector<real_vector>             m_snapshotWeights;
+	int                                  m_snapshotEpoch;
+	int                                  m_evaluatedEpoch;
+
+	// result of one fraction processed by one network
+	struct frac_result_t {
+	    real_t error;
+	    real_t secError;
+	    real_t correct;                                // correct classifications
+	};
+	
+	// fractions processed by the networks in parallel
+	struct parallel_task_t {
+	    std::vector<NeuralNetwork<TDevice>*>     networks;   // [master, replicas]
+	    std::vector<data_sets::DataSetFraction*> fractions;
+	    std::vector<frac_result_t>               results;
+	    int    firstFracIdx;
+	    int    curEpoch;
+	    bool   calcWeightUpdates;
+	    bool   deferBackward;      // the backward pass is run by _backwardFractionTask
+	    real_t normFactor;
+	};
+
+	// Add 20181018: overlapped validation, 0: training, 1: evaluation of the snapshot
+	//  the errors are copied into the optimizer after both tasks are done
+	struct overlap_task_t {
+	    Optimizer<TDevice>                  *optimizer;
+	    real_t valError,  valClassError,  valSecError;
+	    real_t testError, testClassError, testSecError;
+	};
+	
+	// Add 20181018: asynchronous training, each network takes fractions by itself
+	struct async_task_t {
+	    Optimizer<TDevice>                  *optimizer;
+	    std::vector<NeuralNetwork<TDevice>*> networks;   // [master, replicas]
+	    std::vector<frac_result_t>           results;    // sum over the fractions
+	    data_sets::DataSet                  *dataSet;
+	    helpers::AsyncTickets               *tickets;
+	    int    curEpoch;
+	    real_t normFactor;
+	    bool   blowed;
+	};
 	
     private:
         void   _processDataSet(data_sets::DataSet &ds, bool calcWeightUpdates,
@@ -91,25 +200,95 @@ namespace optimizers {
         void   _storeWeights();
         void   _restoreWeights();
 
+	// Add 20181018: copy the weights between a network and a buffer
+	static void _saveWeights(NeuralNetwork<TDevice> &nn, std::vector<real_vector> &weights);
+	static void _loadWeights(const std::vector<real_vector> &weights,
+				 NeuralNetwork<TDevice> &nn);
+
+	// Add 20181018: overlapped validation
+	void   _evaluateDataSet(NeuralNetwork<TDevice> &nn, data_sets::DataSet &ds,
+				const int epoch,
+				real_t &error, real_t &classError, real_t &secError);
+	void   _evaluateSnapshot(overlap_task_t *task);
+	void   _resolveSnapshot(const overlap_task_t &task);
+	static void _overlapTask(void *task, const int taskIdx);
+
+	// Add 20181018: flat parameter arenas
+	void   _buildSegments();
+	void   _initWeightStats();
+	void   _gatherWeightUpdates(const bool accumulate);
+
+	// Add 20181018: data-parallel training
+	void   _processDataSetParallel(data_sets::DataSet &ds, bool calcWeightUpdates,
+				       real_t &error, real_t &classError, real_t &secError);
+	void   _reduceWeightUpdates(const int netNum, const bool accumulate);
+	void   _syncReplicas();
+	static void _processFractionTask(void *task, const int netIdx);
+
+	// backward pass of a fraction processed with deferBackward
+	static void _backwardFractionTask(void *task, const int netIdx);
+
+	// Add 20181018: asynchronous (Hogwild) training
+	void   _processDataSetAsync(data_sets::DataSet &ds,
+				    real_t &error, real_t &classError, real_t &secError);
+	static void _processAsyncTask(void *task, const int netIdx);
+
+	// Add 20181018: distributed training
+	bool   _distSumWeightUpdates(int &frameNum, const bool active);
+	void   _distBroadcastWeights();
+	void   _midEpochCheckpoint(const int fracCnt, const real_t uttCnt, const real_t error,
+				   const real_t secError, const real_t classError);
+	void   _distFinishDataSet(data_sets::DataSet &ds, bool calcWeightUpdates,
+				  const bool firstFraction,
+				  real_t &error, real_t &classError, real_t &secError);
+
     protected:
         static void _exportWeights(const helpers::JsonDocument &jsonDoc, 
 				   const char *arrayName, const std::vector<real_vector> &weights);
         static void _importWeights(const helpers::JsonDocument &jsonDoc, 
 				   const char *arrayName, std::vector<real_vector> *weights);
+
+	// Add 20181018: binary checkpoint (the vectors are blob references)
+        static void _exportWeights(helpers::checkpoint::Checkpoint *ckpt,
+				   const char *arrayName, const std::vector<real_vector> &weights);
+	void _exportArena(helpers::checkpoint::Checkpoint *ckpt, const char *arrayName,
+			  const real_vector &arena, const int factor) const;
+	// the scalar state (epoch, errors ...)
+	void _exportStatus(const helpers::JsonDocument &jsonDoc) const;
 	
         NeuralNetwork<TDevice>&   _neuralNetwork();
-        std::vector<real_vector>& _curWeightUpdates();
+        real_vector&              _curWeightUpdates();
 	
 	// Add 16-11-02: Add fracLength, as the number of frames
         virtual void              _updateWeights(int fracLength) =0;
 	
 	/* Add 16-02-22 Wang: for WE updating */
 	virtual void              _updateWeInput(int fracLength) =0;
+
+	/* Add 20181018: asynchronous training
+	   update the shared weights (and WE bank) using the gradients of network nn.
+	   Called by several threads at the same time without locks */
+	virtual void              _updateWeightsAsync(NeuralNetwork<TDevice> &nn,
+						      int fracLength) =0;
+	virtual void              _updateWeInputAsync(NeuralNetwork<TDevice> &nn,
+						      int fracLength) =0;
 	
 	
 	// Add 10-24 for AdaGrad
 	const unsigned& _optOption() const;
-	std::vector<real_vector>& _weightStats();
+	real_vector&    _weightStats();
+
+	// Add 20181018: flat parameter arenas
+	const param_segments_t& _segments() const;
+	bool                    _gradientsInLayers() const;
+	const std::vector<int>& _segOffset() const;
+	
+	// split an arena into per-layer vectors (factor: values per weight) and back.
+	// The per-layer form is the one saved in the .autosave
+	void _splitArena(const real_vector &arena, const int factor,
+			 std::vector<real_vector> &layerVecs) const;
+	void _mergeArena(const std::vector<real_vector> &layerVecs, const int factor,
+			 real_vector &arena) const;
 	
     public:
         /**
@@ -232,6 +411,14 @@ namespace optimizers {
          * @param jsonDoc The JSON document
          */
         virtual void exportState(const helpers::JsonDocument &jsonDoc) const;
+
+	/**
+	 * Add 20181018: writes the current state to the binary checkpoint
+	 *  The state can be restored by importState
+	 *
+	 * @param ckpt The staging buffer of the checkpoint
+	 */
+	virtual void exportCheckpoint(helpers::checkpoint::Checkpoint *ckpt) const;
 	
 	virtual void adjustLR() =0;
 	
@@ -268,6 +455,53 @@ namespace optimizers {
 
        	
 	const std::string& optStatus() const;
+
+	/**
+	 * Add 20181018: set the replicas for data-parallel training
+	 * The replicas must share the weights of the trainable layers of the network
+	 *
+	 * @param replicas  the replicas of the neural network
+	 */
+	void setReplicas(const std::vector<NeuralNetwork<TDevice>*> &replicas);
+
+	/**
+	 * Add 20181018: write autosaves inside the training epoch
+	 *  fn is called after the weight update of a fraction when interval seconds
+	 *  passed since the last call, or every fractions fractions of the epoch.
+	 *  Only the single-network path with hybrid_online_batch calls it
+	 *
+	 * @param interval  seconds between the autosaves, 0 to disable
+	 * @param fractions fractions between the autosaves, 0 to disable
+	 * @param fn        the callback writing the autosave
+	 * @param userData  the argument of fn
+	 */
+	void setMidEpochCheckpoint(const int interval, const int fractions,
+				   checkpoint_fn_t fn, void *userData);
+
+	/**
+	 * Add 20181018: returns true if the training epoch is in progress
+	 *  currentEpoch() is the epoch in progress, and the state exported now
+	 *  continues that epoch from the next fraction
+	 */
+	bool midEpoch() const;
+
+	/**
+	 * Add 20181018: overlapped validation
+	 *  The validation and test errors of an epoch are computed on evalNetwork in a
+	 *  background thread while the next epoch is trained. evalNetwork must have the
+	 *  same structure as the network and its own weights (not a replica)
+	 *
+	 * @param evalNetwork  the network for evaluation, NULL to disable
+	 */
+	void setEvalNetwork(NeuralNetwork<TDevice> *evalNetwork);
+
+	/**
+	 * Add 20181018: the epoch whose validation and test errors were computed by the
+	 *  last train(). It is currentEpoch() without overlapped validation, and usually
+	 *  currentEpoch()-1 with it (0 if no errors were computed). With overlapped
+	 *  validation, the network for evaluation holds the weights of this epoch
+	 */
+	int evaluatedEpoch() const;
     };
 
 } // namespace optimizers
@@ -30,6 +30,10 @@
 #include "../layers/InputLayer.hpp"
 #include "../layers/Layer.hpp"
 #include "../helpers/getRawPointer.cuh"
+#include "../helpers/fusedForEach.cuh"
+#include "../helpers/JsonClasses.hpp"
+#include "../helpers/Checkpoint.hpp"
+#include "../Configuration.hpp"
 #include "../rapidjson/document.h"
 
 #include <thrust/transform.h>
@@ -107,70 +111,82 @@ namespace {
         }
     };
         
-    struct AdaGradAccumulate
+    // Add 20181018: one optimizer step for all the trainable layers
+    //  The same computation as the per-layer passes before (AdaGrad/Adam/average
+    //  gradient, then UpdateWeightFn or UpdateWeightFn_withMask), with the learning
+    //  rate and the weight mask of the segment that the element belongs to
+    struct FusedUpdateFn
     {
-	real_t fracLength; 
-	const real_t *weightMask;
-        __host__ __device__ void operator() (const thrust::tuple<real_t&, real_t&, const int&> &t) const
-        {
-	    if (weightMask && weightMask[t.get<2>()] < 1.0)
-		return;
-	    real_t aveGradient = t.get<0>() / fracLength;
-	    t.get<1>() = t.get<1>() + (aveGradient * aveGradient);
-        }
-    };
-
-    struct AdaGradAccumulateUpdate
-    {
-	real_t fracLength;
-	const real_t *weightMask;
-        __host__ __device__ void operator() (const thrust::tuple<real_t&, real_t&, const int&> &t) const
-        {
-	    if (weightMask && weightMask[t.get<2>()] < 1.0)
-		return;
-	    real_t aveGradient = t.get<0>() / fracLength;
-	    t.get<1>() = t.get<1>() + (aveGradient * aveGradient);
-            t.get<0>() = aveGradient / sqrt(t.get<1>());
-        }
-    };
-
-    struct AdamAccumulateUpdate
-    {
-	real_t  fracLength;
-	real_t  beta1Accum;
-	real_t  beta2Accum;
-	real_t *mvBuffer;
-	const real_t *weightMask;
+	int            optOption;
+	real_t         fracLength;
+	real_t         learningRate;    // global learning rate
+	real_t         momentum;
+
+	int            seg;             // see helpers::fused::forEach
+	const int     *segStart;        // start of each segment (segNum + 1)
+	int            segNum;
+	const int     *adaptIdx;
+	const real_t  *adamCorr;        // Adam, 1/(1-beta1^t), 1/(1-beta2^t) of each segment
+	const real_t  *segLearningRate;
+	real_t *const *weights;
+	real_t *const *weightMask;
+	real_t *const *gradients;       // gradients of the layers, NULL: read the arena
+	real_t        *weightDeltas;
+	real_t        *weightStats;
 	
         __host__ __device__ void operator() (const thrust::tuple<real_t&, const int&> &t) const
         {
-	    //
-	    if (weightMask && weightMask[t.get<1>()] < 1.0)
-		return;
-
-	    // Average gradient over the sequence
-	    real_t aveGradient = t.get<0>() / fracLength;
-	    // m_t = m_t_1 * beta1 + (1-beta1)*gradient;
-    	    // v_t = v_t_1 * beta1 + (1-beta1)*gradient*gradient;
-	    mvBuffer[2 * t.get<1>()]   = (mvBuffer[2 * t.get<1>()]   * OP_ADAMBETA1 +
-					  aveGradient * (1 - OP_ADAMBETA1));
-	    mvBuffer[2 * t.get<1>()+1] = (mvBuffer[2 * t.get<1>()+1] * OP_ADAMBETA2 +
-					  aveGradient * aveGradient * (1 - OP_ADAMBETA2));
-	    real_t tmpM = mvBuffer[2 * t.get<1>()]   / (1 - beta1Accum);
-	    real_t tmpV = mvBuffer[2 * t.get<1>()+1] / (1 - beta2Accum);
-	    
-            t.get<0>() = tmpM / (sqrt(tmpV) + OP_ADAMEPSILON);
+	    int idx = t.get<1>();
+	    int s   = (seg >= 0 ? seg : helpers::fused::findSegment(segStart, segNum, idx));
+	    int pos = idx - segStart[s];
+	    const real_t *mask = weightMask[s];
+	    real_t grad = (gradients ? gradients[s][pos] : t.get<0>());
+
+	    // Adjust the gradient (only for trainble hidden layer, not MDN layer)
+	    if (adaptIdx[s] >= 0){
+		if (optOption == OPTIMIZATION_AVEGRAD){
+		    // average gradient over mini-batch
+		    grad = grad / fracLength;
+		    
+		}else if (mask && mask[pos] < 1.0){
+		    // masked weight, no statistics
+		    
+		}else if (optOption == OPTIMIZATION_ADAGRAD){
+		    real_t aveGradient = grad / fracLength;
+		    weightStats[idx] = weightStats[idx] + aveGradient * aveGradient;
+		    grad = aveGradient / sqrt(weightStats[idx]);
+		    
+		}else if (optOption == OPTIMIZATION_ADAM){
+		    real_t aveGradient = grad / fracLength;
+		    // m_t = m_t_1 * beta1 + (1-beta1)*gradient;
+		    // v_t = v_t_1 * beta1 + (1-beta1)*gradient*gradient;
+		    weightStats[2 * idx]   = (weightStats[2 * idx]   * OP_ADAMBETA1 +
+					      aveGradient * (1 - OP_ADAMBETA1));
+		    weightStats[2 * idx+1] = (weightStats[2 * idx+1] * OP_ADAMBETA2 +
+					      aveGradient * aveGradient * (1 - OP_ADAMBETA2));
+		    real_t tmpM = weightStats[2 * idx]   * adamCorr[2 * s];
+		    real_t tmpV = weightStats[2 * idx+1] * adamCorr[2 * s + 1];
+		    grad = tmpM / (sqrt(tmpV) + OP_ADAMEPSILON);
+		    
+		}else if (optOption == OPTIMIZATION_STOCHASTIC_ADAGRAD){
+		    // AdaGrad, but just accumulate the gradients
+		    real_t aveGradient = grad / fracLength;
+		    weightStats[idx] = weightStats[idx] + aveGradient * aveGradient;
+		}
+		if (!gradients)
+		    t.get<0>() = grad;
+	    }
+
+	    // calculate and store the weight delta
+	    real_t lr = (segLearningRate[s] > -0.5 ? segLearningRate[s] : learningRate);
+            real_t delta = momentum * weightDeltas[idx] - lr * grad;
+            weightDeltas[idx] = delta;
+
+	    // calculate the new weight
+	    real_t *weight = weights[s] + pos;
+	    *weight = (mask ? ((*weight + delta) * mask[pos]) : (*weight + delta));
         }
     };
-    
-    struct divideOpe { 
-	const real_t a; 
-	divideOpe(real_t _a) : a(_a) {} 
-	__host__ __device__ float operator()(const real_t& x) const 
-	{ 
-	    return x/a; 
-	} 
-    }; 
 
 } // anonymous namespace
 } // namespace internal
@@ -182,6 +198,16 @@ namespace optimizers {
     // add the SGD optimizer for we
     template <typename TDevice>
     void SteepestDescentOptimizer<TDevice>::_updateWeInput(int fracLength)
+    {
+	_updateWeInputAsync(this->_neuralNetwork(), fracLength);
+    }
+
+    // Add 20181018: the WE of network nn. 
+    //  In asynchronous training, the replicas share the WE bank of the master network,
+    //  and the vectors are updated without locks
+    template <typename TDevice>
+    void SteepestDescentOptimizer<TDevice>::_updateWeInputAsync(NeuralNetwork<TDevice> &nn,
+								 int fracLength)
     {
 	if (m_weLearningRate < 0 ){
 	    
@@ -192,8 +218,7 @@ namespace optimizers {
 	
 	    // get the input layer
 	    layers::InputLayer<TDevice> *layer = 
-		dynamic_cast<layers::InputLayer<TDevice>*>(
-				this->_neuralNetwork().layers().front().get());
+		dynamic_cast<layers::InputLayer<TDevice>*>(nn.layers().front().get());
 	
 	    // because dummy error is zero, no need to know where dummy starts, 
 	    // just udpate using all the data
@@ -255,190 +280,117 @@ namespace optimizers {
 	    // skip updateing the weights if learning rate is negative
 	    
 	}else{
+	    // Modify 20181018: one fused pass over the arenas of all the layers
+	    const typename Optimizer<TDevice>::param_segments_t &segments = this->_segments();
 	    
-	   
-	    // Update the parameter
-	    internal::UpdateWeightFn_withMask updateWeightFn;
-	    internal::UpdateWeightFn          updateWeightFn2;
-	    
-	    for (size_t i = 1; i < this->_neuralNetwork().layers().size(); ++i) {
-        	layers::TrainableLayer<TDevice> *layer = 
-		    dynamic_cast<layers::TrainableLayer<TDevice>*>(
-					this->_neuralNetwork().layers()[i].get());
-		layers::MDNLayer<TDevice> *mdnlayer = 
-			dynamic_cast<layers::MDNLayer<TDevice>*>(
-					this->_neuralNetwork().layers()[i].get());
-		    
-		if (!layer && !(mdnlayer && mdnlayer->flagTrainable()))
-		    continue;
-		
-		// Adjust the gradient (only for trainble hidden layer, not MDN layer)
-		if (this->_optOption()>0 && layer){
-		    if (this->_optOption() == OPTIMIZATION_AVEGRAD){
-			// average gradient over mini-batch
-			thrust::transform(this->_curWeightUpdates()[i].begin(),
-					  this->_curWeightUpdates()[i].end(),
-					  this->_curWeightUpdates()[i].begin(),
-					  internal::divideOpe((real_t)fracLength));
-			    
-		    }else if (this->_optOption() == OPTIMIZATION_ADAGRAD){
-			// AdaGrad
-			internal::AdaGradAccumulateUpdate adaUpdateFn;
-			adaUpdateFn.fracLength = (real_t)fracLength;
-			adaUpdateFn.weightMask = (layer->flagUseWeightMask()?
-						  helpers::getRawPointer(layer->weightMask()):
-						  NULL);
-			thrust::for_each(
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].begin(),   
-						   this->_weightStats()[i].begin(),
-						   thrust::counting_iterator<int>(0))),
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].end(),
-						   this->_weightStats()[i].end(),
-						   thrust::counting_iterator<int>(0)+
-						   m_weightDeltas[i].size())),
-			     adaUpdateFn
-			);
-			/* Fatal error: 
-			   m_weightDeltas.size() is used instead of m_weightDeltas[i].size()
-			 */
-			
-		    }else if (this->_optOption() == OPTIMIZATION_ADAM){
-			// Adam
-			// Update the beta1 and beta2
-			m_adamBeta1Accum = m_adamBeta1Accum * OP_ADAMBETA1;
-			m_adamBeta2Accum = m_adamBeta2Accum * OP_ADAMBETA2;
-			
-			internal::AdamAccumulateUpdate adaUpdateFn;
-			adaUpdateFn.fracLength = (real_t)fracLength;
-			adaUpdateFn.beta1Accum = m_adamBeta1Accum;
-			adaUpdateFn.beta2Accum = m_adamBeta2Accum;
-			adaUpdateFn.mvBuffer   = helpers::getRawPointer(this->_weightStats()[i]);
-			adaUpdateFn.weightMask = (layer->flagUseWeightMask()?
-						  helpers::getRawPointer(layer->weightMask()):
-						  NULL);
-			
-			thrust::for_each(
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].begin(),   
-						   thrust::counting_iterator<int>(0))),
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].end(),
-						   thrust::counting_iterator<int>(0)+
-						   m_weightDeltas[i].size())),
-			     adaUpdateFn
-			);
-
-			/* Fatal error: 
-			   m_weightDeltas.size() is used instead of m_weightDeltas[i].size()
-			 */
-
-		    }else if(this->_optOption() == OPTIMIZATION_STOCHASTIC_ADAGRAD){
-			// AdaGrad, but just accumulate the gradients
-			internal::AdaGradAccumulate adaUpdateFn;
-			adaUpdateFn.fracLength = (real_t)fracLength;
-			adaUpdateFn.weightMask = (layer->flagUseWeightMask()?
-						  helpers::getRawPointer(layer->weightMask()):
-						  NULL);
-			thrust::for_each(
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].begin(),   
-						   this->_weightStats()[i].begin(),
-						   thrust::counting_iterator<int>(0))),
-			     thrust::make_zip_iterator(
-				thrust::make_tuple(this->_curWeightUpdates()[i].end(),
-						   this->_weightStats()[i].end(),
-						   thrust::counting_iterator<int>(0)+
-						   m_weightDeltas[i].size())),
-			     adaUpdateFn
-			);
-			/* Fatal error: 
-			   m_weightDeltas.size() is used instead of m_weightDeltas[i].size()
-			 */
-
-		    }else{
-			// nothing
+	    internal::FusedUpdateFn fn;
+	    fn.optOption       = this->_optOption();
+	    fn.fracLength      = (real_t)fracLength;
+	    fn.learningRate    = m_learningRate;
+	    fn.momentum        = m_momentum;
+	    fn.seg             = -1;
+	    fn.segStart        = helpers::getRawPointer(segments.start);
+	    fn.segNum          = segments.num;
+	    fn.adaptIdx        = helpers::getRawPointer(segments.adaptIdx);
+	    fn.segLearningRate = helpers::getRawPointer(segments.learningRate);
+	    fn.weights         = helpers::getRawPointer(segments.weights);
+	    fn.weightMask      = helpers::getRawPointer(segments.weightMask);
+	    fn.gradients       = (this->_gradientsInLayers() ?
+				  helpers::getRawPointer(segments.gradients) : NULL);
+	    fn.weightDeltas    = helpers::getRawPointer(m_weightDeltas);
+	    fn.weightStats     = (this->_weightStats().empty() ?
+				  NULL : helpers::getRawPointer(this->_weightStats()));
+	    fn.adamCorr        = NULL;
+
+	    // Adam: the bias corrections of the segments are computed once on the host.
+	    //  The accumulated beta advances once per trainable layer (same as before)
+	    if (this->_optOption() == OPTIMIZATION_ADAM){
+		Cpu::int_vector  adaptIdx = segments.adaptIdx;
+		Cpu::real_vector adamCorr(2 * segments.num, 1.0);
+		for (int i = 0; i < segments.num; i++){
+		    if (adaptIdx[i] < 0)
+			continue;
+		    real_t beta1Acc = m_adamBeta1Accum;
+		    real_t beta2Acc = m_adamBeta2Accum;
+		    for (int k = 0; k <= adaptIdx[i]; k++){
+			beta1Acc = beta1Acc * OP_ADAMBETA1;
+			beta2Acc = beta2Acc * OP_ADAMBETA2;
 		    }
+		    adamCorr[2 * i]     = 1.0 / (1.0 - beta1Acc);
+		    adamCorr[2 * i + 1] = 1.0 / (1.0 - beta2Acc);
 		}
-
-		// if mask is utilized
-		if (layer && layer->flagUseWeightMask()){
-		    updateWeightFn.momentum      = m_momentum;
-		    updateWeightFn.learningRate  = m_learningRate;
-		    
-		    if (layer->learningRate() > -0.5) // In fact, >= 0.0
-			updateWeightFn.learningRate = layer->learningRate();
-
-		    updateWeightFn.weights       = helpers::getRawPointer(layer->weights());
-		    updateWeightFn.weightUpdates = helpers::getRawPointer(
-							this->_curWeightUpdates()[i]);
-		    updateWeightFn.weightDeltas  = helpers::getRawPointer(m_weightDeltas[i]);
-		
-		    // Add 0413 for Weight mask
-		    updateWeightFn.weightMask    = helpers::getRawPointer(layer->weightMask());
-		
-		    thrust::transform(
-				      thrust::counting_iterator<int>(0),
-				      thrust::counting_iterator<int>((int)layer->weights().size()),
-				      layer->weights().begin(),
-				      updateWeightFn
-				      );
-		    
-		// if mask is not used
-		}else if(layer){
-		    updateWeightFn2.momentum      = m_momentum;
-		    updateWeightFn2.learningRate  = m_learningRate;
-		    
-		    if (layer->learningRate() > -0.5) // In fact, >= 0.0
-			updateWeightFn2.learningRate = layer->learningRate();
-		    
-
-		    updateWeightFn2.weights       = helpers::getRawPointer(layer->weights());
-		    updateWeightFn2.weightUpdates = helpers::getRawPointer(
-							this->_curWeightUpdates()[i]);
-		    updateWeightFn2.weightDeltas  = helpers::getRawPointer(m_weightDeltas[i]);
-				
-		    thrust::transform(
-				    thrust::counting_iterator<int>(0),
-				    thrust::counting_iterator<int>((int)layer->weights().size()),
-				    layer->weights().begin(),
-				    updateWeightFn2);
-		    
-		// trainable MDN layer
-		}else if(mdnlayer && mdnlayer->flagTrainable()){
-		    updateWeightFn2.momentum     = m_momentum;
-		    updateWeightFn2.learningRate = m_learningRate;
-		    //if (layer->learningRate() >= 0.0)
-		    //     updateWeightFn2.learningRate = layer->learningRate();
-		    
-
-		    updateWeightFn2.weights       = helpers::getRawPointer(mdnlayer->weights());
-		    updateWeightFn2.weightUpdates = helpers::getRawPointer(
-							this->_curWeightUpdates()[i]);
-		    updateWeightFn2.weightDeltas  = helpers::getRawPointer(m_weightDeltas[i]);
-		    
-		    //Cpu::real_vector temp1 = this->_curWeightUpdates()[i];
-		    //Cpu::real_vector temp2 = mdnlayer->weights();
-		    //temp1[0] = temp1[0];
-
-		    thrust::transform(
-				    thrust::counting_iterator<int>(0),
-				    thrust::counting_iterator<int>((int)mdnlayer->weights().size()),
-				    mdnlayer->weights().begin(),
-				    updateWeightFn2);
-
-		    //temp1 = this->_curWeightUpdates()[i];
-		    //temp2 = mdnlayer->weights();
-		    //temp1[0] = temp1[0];
-		    
-		}else{
-		    throw std::runtime_error("Impossible Error");
+		m_adamCorr  = adamCorr;
+		fn.adamCorr = helpers::getRawPointer(m_adamCorr);
+	    }
+	    
+	    helpers::fused::forEach(this->_curWeightUpdates(), fn.segStart, fn.segNum,
+				    segments.total, fn,
+				    Configuration::instance().trainingThreads());
+
+	    // Adam: the accumulated beta advanced once per trainable layer
+	    if (this->_optOption() == OPTIMIZATION_ADAM){
+		for (int i = 0; i < segments.adaptNum; i++){
+		    m_adamBeta1Accum = m_adamBeta1Accum * OP_ADAMBETA1;
+		    m_adamBeta2Accum = m_adamBeta2Accum * OP_ADAMBETA2;
 		}
 	    }
 	}
     }
 
+    // Add 20181018: asynchronous training
+    //  nn shares the weights of this->_neuralNetwork(). The gradients of nn are applied to
+    //  the shared weights directly, while other threads may be reading or updating them.
+    //  Only SGD (with momentum) and the averaged gradient are supported
+    template <typename TDevice>
+    void SteepestDescentOptimizer<TDevice>::_updateWeightsAsync(NeuralNetwork<TDevice> &nn,
+								 int fracLength)
+    {
+	if (m_learningRate < 0)
+	    return;
+	
+	internal::UpdateWeightFn_withMask updateWeightFn;
+	internal::UpdateWeightFn          updateWeightFn2;
+	
+	for (size_t i = 1; i < nn.layers().size(); ++i) {
+	    layers::TrainableLayer<TDevice> *layer = 
+		dynamic_cast<layers::TrainableLayer<TDevice>*>(nn.layers()[i].get());
+	    if (!layer)
+		continue;
+
+	    real_t learningRate = m_learningRate;
+	    if (layer->learningRate() > -0.5) // In fact, >= 0.0
+		learningRate = layer->learningRate();
+	    // average gradient over mini-batch
+	    if (this->_optOption() == OPTIMIZATION_AVEGRAD)
+		learningRate = learningRate / (real_t)fracLength;
+	    
+	    if (layer->flagUseWeightMask()){
+		updateWeightFn.momentum      = m_momentum;
+		updateWeightFn.learningRate  = learningRate;
+		updateWeightFn.weights       = helpers::getRawPointer(layer->weights());
+		updateWeightFn.weightUpdates = helpers::getRawPointer(layer->weightUpdates());
+		updateWeightFn.weightDeltas  = (helpers::getRawPointer(m_weightDeltas) +
+						this->_segOffset()[i]);
+		updateWeightFn.weightMask    = helpers::getRawPointer(layer->weightMask());
+		thrust::transform(thrust::counting_iterator<int>(0),
+				  thrust::counting_iterator<int>((int)layer->weights().size()),
+				  layer->weights().begin(),
+				  updateWeightFn);
+	    }else{
+		updateWeightFn2.momentum      = m_momentum;
+		updateWeightFn2.learningRate  = learningRate;
+		updateWeightFn2.weights       = helpers::getRawPointer(layer->weights());
+		updateWeightFn2.weightUpdates = helpers::getRawPointer(layer->weightUpdates());
+		updateWeightFn2.weightDeltas  = (helpers::getRawPointer(m_weightDeltas) +
+						 this->_segOffset()[i]);
+		thrust::transform(thrust::counting_iterator<int>(0),
+				  thrust::counting_iterator<int>((int)layer->weights().size()),
+				  layer->weights().begin(),
+				  updateWeightFn2);
+	    }
+	}
+    }
+
     template <typename TDevice>
     SteepestDescentOptimizer<TDevice>::SteepestDescentOptimizer(
         NeuralNetwork<TDevice> &neuralNetwork, data_sets::DataSet &trainingSet, 
@@ -459,9 +411,8 @@ namespace optimizers {
 	, m_adamBeta2Accum     (1.0)
     {
         // intialize the weight deltas vectors with zeros
-        m_weightDeltas = this->_curWeightUpdates();
-        for (size_t i = 0; i < m_weightDeltas.size(); ++i)
-            thrust::fill(m_weightDeltas[i].begin(), m_weightDeltas[i].end(), 0);
+	// Modify 20181018: arena of the same layout as the gradients
+        m_weightDeltas = real_vector(this->_curWeightUpdates().size(), 0.0);
     }
 
     template <typename TDevice>
@@ -469,14 +420,44 @@ namespace optimizers {
     {
     }
 
+    template <typename TDevice>
+    void SteepestDescentOptimizer<TDevice>::_exportAdamState(
+		const helpers::JsonDocument &jsonDoc) const
+    {
+	// without them, the bias correction of Adam restarts from the first step
+	if (this->_optOption() != OPTIMIZATION_ADAM)
+	    return;
+	jsonDoc->AddMember("steepest_descent_optimizer_adam_beta1_accum",
+			   (double)m_adamBeta1Accum, jsonDoc->GetAllocator());
+	jsonDoc->AddMember("steepest_descent_optimizer_adam_beta2_accum",
+			   (double)m_adamBeta2Accum, jsonDoc->GetAllocator());
+    }
+
     template <typename TDevice>
     void SteepestDescentOptimizer<TDevice>::exportState(const helpers::JsonDocument &jsonDoc) const
     {
         Optimizer<TDevice>::exportState(jsonDoc);
+	_exportAdamState(jsonDoc);
 
-	if (m_momentum>0.0)
+	if (m_momentum>0.0){
+	    // saved per layer
+	    std::vector<real_vector> weightDeltas;
+	    this->_splitArena(m_weightDeltas, 1, weightDeltas);
 	    Optimizer<TDevice>::_exportWeights(jsonDoc, "steepest_descent_optimizer_weight_deltas", 
-					       m_weightDeltas);
+					       weightDeltas);
+	}
+    }
+
+    template <typename TDevice>
+    void SteepestDescentOptimizer<TDevice>::exportCheckpoint(
+		helpers::checkpoint::Checkpoint *ckpt) const
+    {
+        Optimizer<TDevice>::exportCheckpoint(ckpt);
+	_exportAdamState(&ckpt->header());
+
+	if (m_momentum>0.0)
+	    this->_exportArena(ckpt, "steepest_descent_optimizer_weight_deltas",
+			       m_weightDeltas, 1);
     }
 
     template <typename TDevice>
@@ -484,9 +465,21 @@ namespace optimizers {
     {
         Optimizer<TDevice>::importState(jsonDoc);
 
-	if (m_momentum>0.0)
+	// Add 20181018: Adam continues the bias correction of the saved state
+	if (jsonDoc->HasMember("steepest_descent_optimizer_adam_beta1_accum")){
+	    m_adamBeta1Accum = helpers::checkedJsonGet<real_t>(
+		*jsonDoc, "steepest_descent_optimizer_adam_beta1_accum");
+	    m_adamBeta2Accum = helpers::checkedJsonGet<real_t>(
+		*jsonDoc, "steepest_descent_optimizer_adam_beta2_accum");
+	}
+
+	if (m_momentum>0.0){
+	    std::vector<real_vector> weightDeltas;
+	    this->_splitArena(m_weightDeltas, 1, weightDeltas);
 	    Optimizer<TDevice>::_importWeights(jsonDoc, "steepest_descent_optimizer_weight_deltas", 
-					       &m_weightDeltas);
+					       &weightDeltas);
+	    this->_mergeArena(weightDeltas, 1, m_weightDeltas);
+	}
     }
 
     template <typename TDevice>
@@ -517,9 +510,7 @@ namespace optimizers {
     void SteepestDescentOptimizer<TDevice>::reinit()
     {
 	// intialize the weight deltas vectors with zeros
-        m_weightDeltas = this->_curWeightUpdates();
-        for (size_t i = 0; i < m_weightDeltas.size(); ++i)
-            thrust::fill(m_weightDeltas[i].begin(), m_weightDeltas[i].end(), 0);
+        m_weightDeltas = real_vector(this->_curWeightUpdates().size(), 0.0);
 	this->_reinit();
 
     }
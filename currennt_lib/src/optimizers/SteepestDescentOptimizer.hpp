@@ -44,7 +44,7 @@ namespace optimizers {
         real_t                   m_learningRate;
 	real_t                   m_learningRateAdjust;
         const real_t             m_momentum;
-        std::vector<real_vector> m_weightDeltas;
+        real_vector              m_weightDeltas;      // arena, see Optimizer::param_segments_t
 
         /* Add 16-02-22 Wang: for WE updating */
 	const real_t m_weLearningRate;
@@ -52,6 +52,10 @@ namespace optimizers {
 	/* Add 17-05-19 Wang: for Adam*/
 	real_t  m_adamBeta1Accum;
 	real_t  m_adamBeta2Accum;
+	real_vector m_adamCorr;         // bias corrections of the segments in this step
+
+	/* Add 20181018: the accumulated betas of Adam in the saved state */
+	void _exportAdamState(const helpers::JsonDocument &jsonDoc) const;
 
     protected:
         virtual void _updateWeights(int fracLength);
@@ -59,6 +63,10 @@ namespace optimizers {
 	/* Add 16-02-22 Wang: for WE updating */
 	virtual void _updateWeInput(int fracLength);
 
+	/* Add 20181018: asynchronous training */
+	virtual void _updateWeightsAsync(NeuralNetwork<TDevice> &nn, int fracLength);
+	virtual void _updateWeInputAsync(NeuralNetwork<TDevice> &nn, int fracLength);
+
     public:
         /**
          * Constructs the optimizer
@@ -101,6 +109,11 @@ namespace optimizers {
          */
         virtual void exportState(const helpers::JsonDocument &jsonDoc) const;
 
+        /**
+         * @see Optimizer::exportCheckpoint
+         */
+        virtual void exportCheckpoint(helpers::checkpoint::Checkpoint *ckpt) const;
+
         /**
          * @see Optimizer::importState
          */
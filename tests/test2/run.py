@@ -0,0 +1,113 @@
+#!/usr/bin/python
+import subprocess;
+import struct;
+import math;
+import json;
+
+# Distributed training with 2 processes on this machine.
+# The gradients are summed in the order of rank by all the transports,
+# so the networks trained over shm and unix sockets must be identical.
+# Rank r takes the fractions r, r+2, ... and the weights are updated with
+# the sum over the ranks, which is one fraction of 2 x parallel_sequences
+# in a single process: the weights must match within maxWeightDiff
+
+numProc         = 2
+parallelSeqs    = 2
+maxWeightDiff   = 1e-5
+
+# Small regression data set in NetCDF classic format (CDF-1)
+def writeNc(fileName):
+	seqLengths = [3, 5, 4, 7, 6, 5, 8, 4]
+	inputSize  = 3
+	targetSize = 2
+	tagLength  = 8
+	numSteps   = sum(seqLengths)
+
+	inputs  = []
+	targets = []
+	for t in range(numSteps):
+		x = [math.sin(0.37 * t + k) for k in range(inputSize)]
+		inputs  += x
+		targets += [0.5 * x[0] - 0.2 * x[1], x[1] * x[2]]
+	tags = b''.join([('seq{}'.format(i)).encode().ljust(tagLength, b'\0')
+			 for i in range(len(seqLengths))])
+
+	def pad(data):
+		return data + b'\0' * ((4 - len(data) % 4) % 4)
+	def name(n):
+		return struct.pack('>i', len(n)) + pad(n.encode())
+
+	dims = [('numSeqs', len(seqLengths)), ('numTimesteps', numSteps),
+		('inputPattSize', inputSize), ('targetPattSize', targetSize),
+		('maxSeqTagLength', tagLength)]
+	# name, dimension ids, nc_type (2: char, 4: int, 5: float), data
+	vars = [('seqTags',        [0, 4], 2, tags),
+		('seqLengths',     [0],    4, struct.pack('>%di' % len(seqLengths), *seqLengths)),
+		('inputs',         [1, 2], 5, struct.pack('>%df' % len(inputs), *inputs)),
+		('targetPatterns', [1, 3], 5, struct.pack('>%df' % len(targets), *targets))]
+
+	header = b'CDF\x01' + struct.pack('>i', 0)
+	header += struct.pack('>ii', 10, len(dims))
+	for d in dims:
+		header += name(d[0]) + struct.pack('>i', d[1])
+	header += struct.pack('>ii', 0, 0)
+	varHeaderSize = 8
+	for v in vars:
+		varHeaderSize += len(name(v[0])) + 4 * (len(v[1]) + 1) + 8 + 12
+	begin = len(header) + varHeaderSize
+
+	header += struct.pack('>ii', 11, len(vars))
+	for v in vars:
+		header += name(v[0]) + struct.pack('>i', len(v[1]))
+		header += struct.pack('>%di' % len(v[1]), *v[1])
+		header += struct.pack('>ii', 0, 0)
+		header += struct.pack('>iii', v[2], len(pad(v[3])), begin)
+		begin += len(pad(v[3]))
+
+	f = open(fileName, 'wb')
+	f.write(header)
+	for v in vars:
+		f.write(pad(v[3]))
+	f.close()
+
+def train(size, address, outFile):
+	procs = []
+	for rank in range(size):
+		procs.append(subprocess.Popen(['../../build/currennt', 'config.cfg',
+					       '--dist_size', str(size),
+					       '--dist_rank', str(rank),
+					       '--dist_address', address,
+					       '--parallel_sequences', str(parallelSeqs * numProc // size),
+					       '--save_network', outFile]))
+	for p in procs:
+		if p.wait() != 0:
+			print('Training failed with address {}'.format(address))
+			exit(1)
+	return json.load(open(outFile))
+
+writeNc('data.nc')
+shmNet    = train(numProc, 'shm:currennt_test2', 'trained_network_shm.jsn')
+unixNet   = train(numProc, 'unix:currennt_test2.sock', 'trained_network_unix.jsn')
+singleNet = train(1, 'shm:currennt_test2', 'trained_network_single.jsn')
+
+if shmNet['layers'] != unixNet['layers'] or shmNet['layers'] != singleNet['layers']:
+	print('The layers sections differ!')
+	exit(1)
+
+for layer in shmNet['weights']:
+	for type in shmNet['weights'][layer]:
+		shmWeights    = shmNet   ['weights'][layer][type]
+		unixWeights   = unixNet  ['weights'][layer][type]
+		singleWeights = singleNet['weights'][layer][type]
+		if shmWeights != unixWeights:
+			print('Different weights in weights.{}.{}'.format(layer, type))
+			exit(1)
+		for i in range(len(shmWeights)):
+			if abs(shmWeights[i] - singleWeights[i]) > maxWeightDiff:
+				print('Different weights in weights.{}.{}[{}]:'.format(layer, type, i))
+				print('Single process: {}'.format(singleWeights[i]))
+				print('{} processes:    {}'.format(numProc, shmWeights[i]))
+				exit(1)
+
+print('Test successful')
+exit(0)
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * This file is an addtional component of CURRENNT.
+ * Xin WANG
+ * National Institute of Informatics, Japan
+ * 2018
+ *
+ * This file is part of CURRENNT.
+ * Copyright (c) 2013 Johannes Bergmann, Felix Weninger, Bjoern Schuller
+ * Institute for Human-Machine Communication
+ * Technische Universitaet Muenchen (TUM)
+ * D-80290 Munich, Germany
+ *
+ *
+ * CURRENNT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CURRENNT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CURRENNT.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+/*
+ * Benchmark of the gated activation of the WaveNet core (wavnetc) on the CPU
+ *
+ *  passes:  the pass sequence before the fusion. Forward: load the projected context,
+ *           conv output + tanh(context), tanh * sigmoid. Backward: gradients of the
+ *           gate, then gradients of the context
+ *  element: helpers::gatedForward/gatedBackward called per element (GPU layout)
+ *  step:    helpers::gatedForward/gatedBackward called per time step (CPU layout,
+ *           contiguous loops over the channels)
+ *
+ *  usage: bench_wavenet [timeSteps] [repeat]
+ */
+
+#ifndef __CUDACC__
+#define __host__
+#define __device__
+#endif
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <sys/time.h>
+
+typedef float real_t;
+
+#include "helpers/gatedActivation.cuh"
+
+namespace {
+
+    using activation_functions::Tanh;
+    using activation_functions::Logistic;
+
+    const int FRAME_SHIFT = 80;     // time steps per frame of the context
+    
+    struct data_t
+    {
+	int size;                   // channels
+	int timeNum;
+	int frameNum;
+	std::vector<real_t> fromConv, projData, frameIndex, coreBuf, contextTanh;
+	std::vector<real_t> outputs, errors, preErrors;
+	std::vector<char>   patTypes;
+    };
+
+    double now()
+    {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+    }
+
+    real_t uniform()
+    {
+	return (real_t)rand() / RAND_MAX * 4.0 - 2.0;
+    }
+    
+    void passesForward(data_t &d)
+    {
+	int S = d.size, n = d.timeNum * 2 * S;
+	for (int i = 0; i < n; i++){
+	    int t = i / (2 * S), f = (int)d.frameIndex[t];
+	    d.coreBuf[i] = ((d.patTypes[t] == 0 || f >= d.frameNum) ?
+			    0.0 : d.projData[f * 2 * S + i % (2 * S)]);
+	}
+	for (int i = 0; i < n; i++){
+	    int t = i / (2 * S);
+	    if (d.patTypes[t] == 0){
+		d.coreBuf[i] = d.contextTanh[i] = 0.0;
+	    }else{
+		d.contextTanh[i] = Tanh::fn(d.coreBuf[i]);
+		d.coreBuf[i]     = d.fromConv[i] + d.contextTanh[i];
+	    }
+	}
+	for (int i = 0; i < d.timeNum * S; i++){
+	    int t = i / S, idx = t * 2 * S + i % S;
+	    d.outputs[i] = ((d.patTypes[t] == 0) ?
+			    0.0 : Tanh::fn(d.coreBuf[idx]) * Logistic::fn(d.coreBuf[idx + S]));
+	}
+    }
+
+    void passesBackward(data_t &d)
+    {
+	int S = d.size, n = d.timeNum * 2 * S;
+	for (int i = 0; i < n; i++){
+	    int t = i / (2 * S), dim = i % (2 * S), idx = t * 2 * S + dim;
+	    if (d.patTypes[t] == 0){
+		d.preErrors[i] = 0.0;
+	    }else if (dim < S){
+		real_t tmp = Tanh::fn(d.coreBuf[idx]);
+		d.preErrors[i] = ((1.0 - tmp * tmp) * Logistic::fn(d.coreBuf[idx + S]) *
+				  d.errors[t * S + dim]);
+	    }else{
+		real_t tmp = Logistic::fn(d.coreBuf[idx]);
+		d.preErrors[i] = (Tanh::fn(d.coreBuf[idx - S]) * (tmp * (1.0 - tmp)) *
+				  d.errors[t * S + dim - S]);
+	    }
+	}
+	for (int i = 0; i < n; i++)
+	    d.contextTanh[i] = Tanh::deriv(d.contextTanh[i]) * d.preErrors[i];
+    }
+
+    // the gated activation of the channels [dimIdx, dimIdx + num) of time step t
+    void fusedForward(data_t &d, const int t, const int dimIdx, const int num)
+    {
+	int S = d.size, idx = t * 2 * S + dimIdx;
+	if (d.patTypes[t] == 0){
+	    for (int i = 0; i < num; i++)
+		d.outputs[t * S + dimIdx + i] = 0.0;
+	    helpers::gatedZero(num, S, &d.coreBuf[idx], &d.contextTanh[idx]);
+	    return;
+	}
+	int f = (int)d.frameIndex[t];
+	helpers::gatedForward(num, S, &d.fromConv[idx],
+			      (f < d.frameNum ? &d.projData[f * 2 * S + dimIdx] : NULL),
+			      &d.coreBuf[idx], &d.contextTanh[idx], &d.outputs[t * S + dimIdx]);
+    }
+
+    void fusedBackward(data_t &d, const int t, const int dimIdx, const int num)
+    {
+	int S = d.size, idx = t * 2 * S + dimIdx;
+	if (d.patTypes[t] == 0)
+	    helpers::gatedZero(num, S, &d.preErrors[idx], &d.contextTanh[idx]);
+	else
+	    helpers::gatedBackward(num, S, &d.coreBuf[idx], &d.errors[t * S + dimIdx],
+				   &d.preErrors[idx], &d.contextTanh[idx]);
+    }
+
+    void elementForward(data_t &d)
+    {
+	for (int i = 0; i < d.timeNum * d.size; i++)
+	    fusedForward(d, i / d.size, i % d.size, 1);
+    }
+
+    void elementBackward(data_t &d)
+    {
+	for (int i = 0; i < d.timeNum * d.size; i++)
+	    fusedBackward(d, i / d.size, i % d.size, 1);
+    }
+
+    void stepForward(data_t &d)
+    {
+	for (int t = 0; t < d.timeNum; t++)
+	    fusedForward(d, t, 0, d.size);
+    }
+
+    void stepBackward(data_t &d)
+    {
+	for (int t = 0; t < d.timeNum; t++)
+	    fusedBackward(d, t, 0, d.size);
+    }
+
+    // milliseconds per call of fn, and the checksum of the buffers written by fn.
+    //  contextTanh is restored before each call (the backward pass overwrites it)
+    double timeIt(void (*fn)(data_t&), data_t &d, const std::vector<real_t> &contextTanh,
+		  const bool backward, const int repeat, double &checksum)
+    {
+	double total = 0.0;
+	for (int i = 0; i <= repeat; i++){
+	    d.contextTanh = contextTanh;
+	    double start = now();
+	    fn(d);
+	    if (i > 0)
+		total += now() - start;
+	}
+	checksum = 0.0;
+	for (size_t i = 0; i < d.contextTanh.size(); i++)
+	    checksum += (backward ? (d.preErrors[i] + d.contextTanh[i]) :
+			 (d.coreBuf[i] + d.contextTanh[i]));
+	for (size_t i = 0; !backward && i < d.outputs.size(); i++)
+	    checksum += d.outputs[i];
+	return total / repeat;
+    }
+
+    void report(const char *name, void (*fns[3])(data_t&), data_t &d,
+		const std::vector<real_t> &contextTanh, const bool backward, const int repeat)
+    {
+	double ms[3], sums[3];
+	for (int j = 0; j < 3; j++)
+	    ms[j] = timeIt(fns[j], d, contextTanh, backward, repeat, sums[j]);
+	printf("%8d %9s %12.2f %12.2f %12.2f\n", d.size, name, ms[0], ms[1], ms[2]);
+	// vectorized exp (e.g. -ffast-math) differs from the scalar one in the last bits
+	if (std::fabs(sums[0] - sums[1]) > 1e-4 * std::fabs(sums[0]) ||
+	    std::fabs(sums[0] - sums[2]) > 1e-4 * std::fabs(sums[0]))
+	    printf("WARNING: the results of the %s pass differ\n", name);
+    }
+    
+}
+
+int main(int argc, char **argv)
+{
+    int timeNum = (argc > 1 ? atoi(argv[1]) : 16000);   // 1s of 16kHz waveform
+    int repeat  = (argc > 2 ? atoi(argv[2]) : 10);
+    const int sizes[] = {64, 128, 256};
+
+    printf("time steps %d, repeat %d\n", timeNum, repeat);
+    printf("%8s %9s %12s %12s %12s\n", "channels", "pass", "passes(ms)", "element(ms)",
+	   "step(ms)");
+    
+    for (int k = 0; k < 3; k++){
+	data_t d;
+	d.size     = sizes[k];
+	d.timeNum  = timeNum;
+	d.frameNum = timeNum / FRAME_SHIFT + 1;
+	srand(1234);
+	d.fromConv.resize(timeNum * 2 * d.size);
+	d.projData.resize(d.frameNum * 2 * d.size);
+	d.errors.resize(timeNum * d.size);
+	for (size_t i = 0; i < d.fromConv.size(); i++) d.fromConv[i] = uniform();
+	for (size_t i = 0; i < d.projData.size(); i++) d.projData[i] = uniform();
+	for (size_t i = 0; i < d.errors.size();   i++) d.errors[i]   = uniform();
+	d.frameIndex.resize(timeNum);
+	for (int t = 0; t < timeNum; t++)
+	    d.frameIndex[t] = t / FRAME_SHIFT;
+	// dummy time steps at the end of the fraction
+	d.patTypes.assign(timeNum, 1);
+	for (int t = timeNum - timeNum / 100; t < timeNum; t++)
+	    d.patTypes[t] = 0;
+	d.coreBuf.resize(timeNum * 2 * d.size);
+	d.contextTanh.resize(timeNum * 2 * d.size);
+	d.preErrors.resize(timeNum * 2 * d.size);
+	d.outputs.resize(timeNum * d.size);
+
+	void (*forward[3])(data_t&)  = {passesForward,  elementForward,  stepForward};
+	void (*backward[3])(data_t&) = {passesBackward, elementBackward, stepBackward};
+	report("forward",  forward,  d, d.contextTanh, false, repeat);
+	// the backward pass starts from the results of the forward pass
+	std::vector<real_t> contextTanh = d.contextTanh;
+	report("backward", backward, d, contextTanh,   true,  repeat);
+    }
+    return 0;
+}
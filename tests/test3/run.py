@@ -0,0 +1,24 @@
+#!/usr/bin/python
+import subprocess;
+import sys;
+
+# Benchmark of the gated activation of the WaveNet core on the CPU (64-256 channels)
+#  usage: run.py [compiler flags]     (default: -O3)
+# The timing of the former pass sequence, the fused kernel called per element and
+# the fused kernel called per time step (the CPU path of wavnetc) are printed
+
+flags = sys.argv[1:] if len(sys.argv) > 1 else ['-O3']
+
+if subprocess.call(['c++'] + flags + ['-I../../currennt_lib/src', '-o', 'bench_wavenet',
+				      'bench_wavenet.cpp']) != 0:
+	print('Compilation failed')
+	exit(1)
+
+output = subprocess.check_output(['./bench_wavenet']).decode()
+print(output)
+if 'WARNING' in output:
+	print('Test failed')
+	exit(1)
+
+print('Test successful')
+exit(0)
@@ -0,0 +1,108 @@
+#!/usr/bin/python
+import subprocess;
+import struct;
+import shutil;
+import math;
+import json;
+
+# Resume from a mid-epoch autosave.
+# The data set has 4 fractions of parallel_sequences sequences. The training
+# writes an autosave inside the epoch after fraction 3 (autosave_fractions),
+# and the network trained by --continue from the autosave of epoch 2 (which
+# only trains fraction 4 of epoch 2) must match the network trained without
+# interruption. Adam is used, so the accumulated betas must be restored too.
+# The JSON autosave keeps 6 digits of the weights, the binary one all of them
+
+maxWeightDiffJson   = 1e-5
+maxWeightDiffBinary = 1e-7
+
+# Small regression data set in NetCDF classic format (CDF-1)
+def writeNc(fileName):
+	seqLengths = [3, 5, 4, 7, 6, 5, 8, 4]
+	inputSize  = 3
+	targetSize = 2
+	tagLength  = 8
+	numSteps   = sum(seqLengths)
+
+	inputs  = []
+	targets = []
+	for t in range(numSteps):
+		x = [math.sin(0.37 * t + k) for k in range(inputSize)]
+		inputs  += x
+		targets += [0.5 * x[0] - 0.2 * x[1], x[1] * x[2]]
+	tags = b''.join([('seq{}'.format(i)).encode().ljust(tagLength, b'\0')
+			 for i in range(len(seqLengths))])
+
+	def pad(data):
+		return data + b'\0' * ((4 - len(data) % 4) % 4)
+	def name(n):
+		return struct.pack('>i', len(n)) + pad(n.encode())
+
+	dims = [('numSeqs', len(seqLengths)), ('numTimesteps', numSteps),
+		('inputPattSize', inputSize), ('targetPattSize', targetSize),
+		('maxSeqTagLength', tagLength)]
+	# name, dimension ids, nc_type (2: char, 4: int, 5: float), data
+	vars = [('seqTags',        [0, 4], 2, tags),
+		('seqLengths',     [0],    4, struct.pack('>%di' % len(seqLengths), *seqLengths)),
+		('inputs',         [1, 2], 5, struct.pack('>%df' % len(inputs), *inputs)),
+		('targetPatterns', [1, 3], 5, struct.pack('>%df' % len(targets), *targets))]
+
+	header = b'CDF\x01' + struct.pack('>i', 0)
+	header += struct.pack('>ii', 10, len(dims))
+	for d in dims:
+		header += name(d[0]) + struct.pack('>i', d[1])
+	header += struct.pack('>ii', 0, 0)
+	varHeaderSize = 8
+	for v in vars:
+		varHeaderSize += len(name(v[0])) + 4 * (len(v[1]) + 1) + 8 + 12
+	begin = len(header) + varHeaderSize
+
+	header += struct.pack('>ii', 11, len(vars))
+	for v in vars:
+		header += name(v[0]) + struct.pack('>i', len(v[1]))
+		header += struct.pack('>%di' % len(v[1]), *v[1])
+		header += struct.pack('>ii', 0, 0)
+		header += struct.pack('>iii', v[2], len(pad(v[3])), begin)
+		begin += len(pad(v[3]))
+
+	f = open(fileName, 'wb')
+	f.write(header)
+	for v in vars:
+		f.write(pad(v[3]))
+	f.close()
+
+
+def train(args, outFile):
+	if subprocess.call(['../../build/currennt'] + args) != 0:
+		print('Training failed: {}'.format(' '.join(args)))
+		exit(1)
+	return json.load(open(outFile))
+
+def compare(fullNet, resumedNet, maxWeightDiff):
+	if fullNet['layers'] != resumedNet['layers']:
+		print('The layers sections differ!')
+		exit(1)
+	for layer in fullNet['weights']:
+		for type in fullNet['weights'][layer]:
+			fullWeights    = fullNet   ['weights'][layer][type]
+			resumedWeights = resumedNet['weights'][layer][type]
+			for i in range(len(fullWeights)):
+				if abs(fullWeights[i] - resumedWeights[i]) > maxWeightDiff:
+					print('Different weights in weights.{}.{}[{}]:'.format(layer, type, i))
+					print('Without interruption: {}'.format(fullWeights[i]))
+					print('Resumed:              {}'.format(resumedWeights[i]))
+					exit(1)
+
+writeNc('data.nc')
+for binary, maxWeightDiff in [('false', maxWeightDiffJson), ('true', maxWeightDiffBinary)]:
+	prefix  = 'test4_' + binary
+	fullNet = train(['config.cfg', '--autosave_binary', binary, '--autosave_prefix', prefix,
+			 '--save_network', prefix + '_trained.jsn'], prefix + '_trained.jsn')
+	# --continue takes the options of the autosave, so the resumed training
+	# writes the same autosave and network files
+	shutil.copy(prefix + '_epoch002.mid.autosave', prefix + '_resume.autosave')
+	resumedNet = train(['--continue', prefix + '_resume.autosave'], prefix + '_trained.jsn')
+	compare(fullNet, resumedNet, maxWeightDiff)
+
+print('Test successful')
+exit(0)